@@ -0,0 +1,211 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Capture.h"
+
+#define CAPTURE_MAX_PAYLOAD     (0xFFFF - FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE)
+
+//
+// Copies into the ring at Offset, wrapping around its end
+// 
+static VOID
+CaptureBufferCopyIn(
+    _Inout_ PCAPTURE_BUFFER Buffer,
+    _In_ ULONG Offset,
+    _In_reads_bytes_(Length) const VOID *Source,
+    _In_ ULONG Length)
+{
+    ULONG first = min(Length, Buffer->Capacity - Offset);
+
+    RtlCopyMemory(Buffer->Storage + Offset, Source, first);
+    RtlCopyMemory(Buffer->Storage, (const UCHAR *)Source + first, Length - first);
+}
+
+//
+// Copies out of the ring from Offset, wrapping around its end
+// 
+static VOID
+CaptureBufferCopyOut(
+    _In_ const CAPTURE_BUFFER *Buffer,
+    _In_ ULONG Offset,
+    _Out_writes_(Length) PVOID Destination,
+    _In_ ULONG Length)
+{
+    ULONG first = min(Length, Buffer->Capacity - Offset);
+
+    RtlCopyMemory(Destination, Buffer->Storage + Offset, first);
+    RtlCopyMemory((PUCHAR)Destination + first, Buffer->Storage, Length - first);
+}
+
+//
+// Appends a record if it fits
+// 
+static BOOLEAN
+CaptureBufferPut(
+    _Inout_ PCAPTURE_BUFFER Buffer,
+    _In_ UCHAR Type,
+    _In_ LONGLONG Timestamp,
+    _In_ LONG Status,
+    _In_opt_ const UCHAR *Setup,
+    _In_reads_bytes_(Length) const VOID *Payload,
+    _In_ ULONG Length)
+{
+    FIRESHOCK_CAPTURE_RECORD    record;
+    ULONG                       size = FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE + Length;
+    ULONG                       tail;
+
+    if (size > Buffer->Capacity - Buffer->Used)
+    {
+        return FALSE;
+    }
+
+    RtlZeroMemory(&record, FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE);
+
+    record.Size = (USHORT)size;
+    record.Type = Type;
+    record.Status = Status;
+    record.Timestamp = Timestamp;
+
+    if (Setup != NULL)
+    {
+        RtlCopyMemory(record.Setup, Setup, sizeof(record.Setup));
+    }
+
+    tail = (Buffer->Head + Buffer->Used) % Buffer->Capacity;
+
+    CaptureBufferCopyIn(Buffer, tail, &record, FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE);
+    CaptureBufferCopyIn(
+        Buffer,
+        (tail + FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE) % Buffer->Capacity,
+        Payload,
+        Length);
+
+    Buffer->Used += size;
+
+    return TRUE;
+}
+
+VOID
+CaptureBufferInitialize(
+    _Out_ PCAPTURE_BUFFER Buffer,
+    _In_ PVOID Storage,
+    _In_ ULONG Capacity,
+    _In_ USHORT DeviceType,
+    _In_ LONGLONG Frequency)
+{
+    RtlZeroMemory(Buffer, sizeof(CAPTURE_BUFFER));
+
+    Buffer->Storage = (PUCHAR)Storage;
+    Buffer->Capacity = Capacity;
+    Buffer->HeaderPending = TRUE;
+    Buffer->Header.Magic = FIRESHOCK_CAPTURE_MAGIC;
+    Buffer->Header.Version = FIRESHOCK_CAPTURE_VERSION;
+    Buffer->Header.DeviceType = DeviceType;
+    Buffer->Header.Frequency = Frequency;
+}
+
+//
+// Records a transfer, returns FALSE if it had to be dropped.
+// 
+BOOLEAN
+CaptureBufferAppend(
+    _Inout_ PCAPTURE_BUFFER Buffer,
+    _In_ UCHAR Type,
+    _In_ LONGLONG Timestamp,
+    _In_ LONG Status,
+    _In_opt_ const UCHAR *Setup,
+    _In_reads_bytes_(Length) const VOID *Payload,
+    _In_ ULONG Length)
+{
+    Length = min(Length, CAPTURE_MAX_PAYLOAD);
+
+    //
+    // Mark the gap before anything recorded after it
+    // 
+    if (Buffer->Lost > 0)
+    {
+        if (!CaptureBufferPut(Buffer, FIRESHOCK_CAPTURE_RECORD_LOST, Timestamp, 0, NULL, &Buffer->Lost, sizeof(ULONG)))
+        {
+            Buffer->Lost++;
+            return FALSE;
+        }
+
+        Buffer->Lost = 0;
+    }
+
+    if (!CaptureBufferPut(Buffer, Type, Timestamp, Status, Setup, Payload, Length))
+    {
+        Buffer->Lost++;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+// Moves the header, if still pending, and as many whole records as fit
+// into Output. Returns the number of bytes written.
+// 
+ULONG
+CaptureBufferRead(
+    _Inout_ PCAPTURE_BUFFER Buffer,
+    _Out_writes_(Length) PUCHAR Output,
+    _In_ ULONG Length)
+{
+    ULONG   written = 0;
+    USHORT  size;
+
+    if (Buffer->HeaderPending)
+    {
+        if (Length < sizeof(FIRESHOCK_CAPTURE_HEADER))
+        {
+            return 0;
+        }
+
+        RtlCopyMemory(Output, &Buffer->Header, sizeof(FIRESHOCK_CAPTURE_HEADER));
+
+        written = sizeof(FIRESHOCK_CAPTURE_HEADER);
+        Buffer->HeaderPending = FALSE;
+    }
+
+    while (Buffer->Used > 0)
+    {
+        CaptureBufferCopyOut(Buffer, Buffer->Head, &size, sizeof(USHORT));
+
+        if (size > Length - written)
+        {
+            break;
+        }
+
+        CaptureBufferCopyOut(Buffer, Buffer->Head, Output + written, size);
+
+        written += size;
+        Buffer->Head = (Buffer->Head + size) % Buffer->Capacity;
+        Buffer->Used -= size;
+    }
+
+    return written;
+}
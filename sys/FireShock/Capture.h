@@ -0,0 +1,89 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include "Portable.h"
+#include "FireShock.h"
+
+//
+// Traffic capture buffer
+// 
+// Byte ring holding FIRESHOCK_CAPTURE_RECORDs in the format they get
+// handed out in, preceded by the stream's FIRESHOCK_CAPTURE_HEADER. Records
+// that don't fit are dropped and accounted for with a lost record once
+// space frees up again. Callers serialize access.
+// 
+typedef struct _CAPTURE_BUFFER
+{
+    PUCHAR Storage;
+
+    ULONG Capacity;
+
+    //
+    // Offset of the oldest record and bytes in use
+    // 
+    ULONG Head;
+
+    ULONG Used;
+
+    //
+    // Records dropped since the last lost record
+    // 
+    ULONG Lost;
+
+    //
+    // Header not handed out yet
+    // 
+    BOOLEAN HeaderPending;
+
+    FIRESHOCK_CAPTURE_HEADER Header;
+
+} CAPTURE_BUFFER, *PCAPTURE_BUFFER;
+
+VOID
+CaptureBufferInitialize(
+    _Out_ PCAPTURE_BUFFER Buffer,
+    _In_ PVOID Storage,
+    _In_ ULONG Capacity,
+    _In_ USHORT DeviceType,
+    _In_ LONGLONG Frequency);
+
+BOOLEAN
+CaptureBufferAppend(
+    _Inout_ PCAPTURE_BUFFER Buffer,
+    _In_ UCHAR Type,
+    _In_ LONGLONG Timestamp,
+    _In_ LONG Status,
+    _In_opt_ const UCHAR *Setup,
+    _In_reads_bytes_(Length) const VOID *Payload,
+    _In_ ULONG Length);
+
+ULONG
+CaptureBufferRead(
+    _Inout_ PCAPTURE_BUFFER Buffer,
+    _Out_writes_(Length) PUCHAR Output,
+    _In_ ULONG Length);
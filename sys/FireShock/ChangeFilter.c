@@ -0,0 +1,112 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "ChangeFilter.h"
+
+#define CHANGE_FILTER_AXIS_MOVED(_a_, _b_, _t_)     (((_a_) > (_b_) ? (_a_) - (_b_) : (_b_) - (_a_)) > (_t_))
+
+VOID
+ChangeFilterConfigure(
+    _Out_ PCHANGE_FILTER Filter,
+    _In_ BOOLEAN Enabled,
+    _In_ UCHAR AxisThreshold,
+    _In_ LONGLONG KeepAliveInterval)
+{
+    RtlZeroMemory(Filter, sizeof(CHANGE_FILTER));
+
+    Filter->Enabled = Enabled;
+    Filter->AxisThreshold = AxisThreshold;
+    Filter->KeepAliveInterval = KeepAliveInterval;
+}
+
+//
+// Returns TRUE if State should be delivered.
+// 
+BOOLEAN
+ChangeFilterTest(
+    _In_ const CHANGE_FILTER *Filter,
+    _In_ const FIRESHOCK_CONTROLLER_STATE *State,
+    _In_ LONGLONG Timestamp)
+{
+    const FIRESHOCK_CONTROLLER_STATE   *last = &Filter->Last;
+    UCHAR                               threshold = Filter->AxisThreshold;
+    ULONG                               i;
+
+    if (!Filter->Enabled || !Filter->Primed)
+    {
+        return TRUE;
+    }
+
+    if (State->Buttons != last->Buttons)
+    {
+        return TRUE;
+    }
+
+    if (Filter->KeepAliveInterval > 0
+        && Timestamp - Filter->LastTimestamp >= Filter->KeepAliveInterval)
+    {
+        return TRUE;
+    }
+
+    if (CHANGE_FILTER_AXIS_MOVED(State->LeftThumbX, last->LeftThumbX, threshold)
+        || CHANGE_FILTER_AXIS_MOVED(State->LeftThumbY, last->LeftThumbY, threshold)
+        || CHANGE_FILTER_AXIS_MOVED(State->RightThumbX, last->RightThumbX, threshold)
+        || CHANGE_FILTER_AXIS_MOVED(State->RightThumbY, last->RightThumbY, threshold)
+        || CHANGE_FILTER_AXIS_MOVED(State->LeftTrigger, last->LeftTrigger, threshold)
+        || CHANGE_FILTER_AXIS_MOVED(State->RightTrigger, last->RightTrigger, threshold))
+    {
+        return TRUE;
+    }
+
+    for (i = 0; i < FIRESHOCK_PRESSURE_COUNT; i++)
+    {
+        if (CHANGE_FILTER_AXIS_MOVED(State->Pressure[i], last->Pressure[i], threshold))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+//
+// Records State as delivered.
+// 
+VOID
+ChangeFilterUpdate(
+    _Inout_ PCHANGE_FILTER Filter,
+    _In_ const FIRESHOCK_CONTROLLER_STATE *State,
+    _In_ LONGLONG Timestamp)
+{
+    if (!Filter->Enabled)
+    {
+        return;
+    }
+
+    RtlCopyMemory(&Filter->Last, State, sizeof(FIRESHOCK_CONTROLLER_STATE));
+    Filter->LastTimestamp = Timestamp;
+    Filter->Primed = TRUE;
+}
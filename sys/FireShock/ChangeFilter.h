@@ -0,0 +1,80 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "Portable.h"
+#include "FireShock.h"
+
+//
+// Change-only delivery
+// 
+// Decides per handle whether a decoded report differs enough from the one
+// last delivered to be worth a wakeup. Motion data is not compared since
+// it never settles; the keep-alive interval covers clients relying on it.
+// 
+typedef struct _CHANGE_FILTER
+{
+    BOOLEAN Enabled;
+
+    //
+    // An axis has to move further than this to count as changed
+    // 
+    UCHAR AxisThreshold;
+
+    //
+    // Deliver regardless after this many ticks, 0 disables
+    // 
+    LONGLONG KeepAliveInterval;
+
+    //
+    // Last holds the state delivered at LastTimestamp
+    // 
+    BOOLEAN Primed;
+
+    LONGLONG LastTimestamp;
+
+    FIRESHOCK_CONTROLLER_STATE Last;
+
+} CHANGE_FILTER, *PCHANGE_FILTER;
+
+VOID
+ChangeFilterConfigure(
+    _Out_ PCHANGE_FILTER Filter,
+    _In_ BOOLEAN Enabled,
+    _In_ UCHAR AxisThreshold,
+    _In_ LONGLONG KeepAliveInterval);
+
+BOOLEAN
+ChangeFilterTest(
+    _In_ const CHANGE_FILTER *Filter,
+    _In_ const FIRESHOCK_CONTROLLER_STATE *State,
+    _In_ LONGLONG Timestamp);
+
+VOID
+ChangeFilterUpdate(
+    _Inout_ PCHANGE_FILTER Filter,
+    _In_ const FIRESHOCK_CONTROLLER_STATE *State,
+    _In_ LONGLONG Timestamp);
@@ -55,6 +55,13 @@ Return Value:
     WDFDEVICE                       device;
     NTSTATUS                        status;
     WDF_DEVICE_PNP_CAPABILITIES     pnpCapabilities;
+    WDF_IO_TYPE_CONFIG              ioTypeConfig;
+    PDEVICE_CONTEXT                 pDeviceContext;
+    WDF_OBJECT_ATTRIBUTES           attributes;
+    WDF_WORKITEM_CONFIG             workItemConfig;
+    WDF_TIMER_CONFIG                timerConfig;
+    WDF_FILEOBJECT_CONFIG           fileConfig;
+    ULONG                           index;
 
     WDF_PNPPOWER_EVENT_CALLBACKS_INIT(&pnpPowerCallbacks);
     pnpPowerCallbacks.EvtDevicePrepareHardware = FireShockEvtDevicePrepareHardware;
@@ -62,12 +69,123 @@ Return Value:
     pnpPowerCallbacks.EvtDeviceD0Exit = FireShockEvtDeviceD0Exit;
     WdfDeviceInitSetPnpPowerEventCallbacks(DeviceInit, &pnpPowerCallbacks);
 
+    //
+    // METHOD_*_DIRECT IOCTLs (the shared input ring) get the client
+    // buffer mapped instead of copied. The default threshold lets the
+    // framework copy small buffers anyway, which would leave the client
+    // with a private ring; the MAP handler rejects anything that is not
+    // whole pages so direct I/O is always honoured.
+    //
+    WDF_IO_TYPE_CONFIG_INIT(&ioTypeConfig);
+    ioTypeConfig.DeviceControlIoType = WdfDeviceIoDirect;
+    ioTypeConfig.DirectTransferThreshold = 0;
+    WdfDeviceInitSetIoTypeEx(DeviceInit, &ioTypeConfig);
+
+    //
+    // Per-handle settings live in the file object context
+    //
+    WDF_FILEOBJECT_CONFIG_INIT(&fileConfig, FireShockEvtDeviceFileCreate, WDF_NO_EVENT_CALLBACK, FireShockEvtFileCleanup);
+    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, FILE_CONTEXT);
+    WdfDeviceInitSetFileObjectConfig(DeviceInit, &fileConfig, &attributes);
+
+    //
+    // Requests get stamped on arrival to measure their queue wait
+    //
+    WdfDeviceInitSetIoInCallerContextCallback(DeviceInit, FireShockEvtIoInCallerContext);
+
+    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, REQUEST_CONTEXT);
+    WdfDeviceInitSetRequestAttributes(DeviceInit, &attributes);
+
     WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&deviceAttributes, DEVICE_CONTEXT);
+    deviceAttributes.EvtCleanupCallback = FireShockEvtDeviceContextCleanup;
 
     status = WdfDeviceCreate(&DeviceInit, &deviceAttributes, &device);
 
     if (NT_SUCCESS(status)) 
     {
+        pDeviceContext = DeviceGetContext(device);
+
+        HistogramReset(&pDeviceContext->Counters.ControlTransferLatency);
+        HistogramReset(&pDeviceContext->Counters.InputInterArrival);
+        HistogramReset(&pDeviceContext->Counters.InputDelivery);
+
+        for (index = 0; index < FIRESHOCK_QUEUE_CLASS_COUNT; index++)
+        {
+            HistogramReset(&pDeviceContext->Counters.QueueWait[index]);
+        }
+
+        //
+        // Assigns DeviceIndex
+        //
+        status = FireShockDriverAddDevice(device);
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = device;
+
+        status = WdfSpinLockCreate(&attributes, &pDeviceContext->InputLock);
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        status = WdfSpinLockCreate(&attributes, &pDeviceContext->OutputLock);
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        status = WdfSpinLockCreate(&attributes, &pDeviceContext->FeatureLock);
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        status = WdfSpinLockCreate(&attributes, &pDeviceContext->CaptureLock);
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        status = WdfSpinLockCreate(&attributes, &pDeviceContext->SimulatorLock);
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        status = WdfSpinLockCreate(&attributes, &pDeviceContext->ControlPoolLock);
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        WDF_WORKITEM_CONFIG_INIT(&workItemConfig, FireShockEvtFeatureFetchWorkItem);
+
+        status = WdfWorkItemCreate(&workItemConfig, &attributes, &pDeviceContext->FeatureWorkItem);
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        WDF_WORKITEM_CONFIG_INIT(&workItemConfig, DsUsbEvtReaderRecoveryWorkItem);
+
+        status = WdfWorkItemCreate(&workItemConfig, &attributes, &pDeviceContext->ReaderRecoveryWorkItem);
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
+        WDF_TIMER_CONFIG_INIT(&timerConfig, DsUsbEvtReaderRecoveryTimerFunc);
+
+        status = WdfTimerCreate(&timerConfig, &attributes, &pDeviceContext->ReaderRecoveryTimer);
+        if (!NT_SUCCESS(status))
+        {
+            return status;
+        }
+
         WDF_DEVICE_PNP_CAPABILITIES_INIT(&pnpCapabilities);
         pnpCapabilities.Removable = WdfTrue;
         pnpCapabilities.SurpriseRemovalOK = WdfTrue;
@@ -99,3 +217,81 @@ Return Value:
     return status;
 }
 
+
+//
+// Leaves the collection of devices served by aggregated reads
+// 
+VOID
+FireShockEvtDeviceContextCleanup(
+    _In_ WDFOBJECT Object
+)
+{
+    FireShockDriverRemoveDevice((WDFDEVICE)Object);
+}
+
+//
+// New handles start reading with the next report
+// 
+VOID
+FireShockEvtDeviceFileCreate(
+    _In_ WDFDEVICE Device,
+    _In_ WDFREQUEST Request,
+    _In_ WDFFILEOBJECT FileObject
+)
+{
+    PDEVICE_CONTEXT pDeviceContext = DeviceGetContext(Device);
+
+    WdfSpinLockAcquire(pDeviceContext->InputLock);
+    FileGetContext(FileObject)->LastSequence = pDeviceContext->InputSequence;
+    WdfSpinLockRelease(pDeviceContext->InputLock);
+
+    WdfRequestComplete(Request, STATUS_SUCCESS);
+}
+
+//
+// Handle is going away, stop collecting aggregated reports on its behalf
+// 
+VOID
+FireShockEvtFileCleanup(
+    _In_ WDFFILEOBJECT FileObject
+)
+{
+    FireShockAggregateUnregister(FileGetContext(FileObject));
+}
+
+//
+// Reads a DWORD value from the device's hardware key, returns Default if absent
+// 
+ULONG
+FireShockQueryDeviceSetting(
+    _In_ WDFDEVICE Device,
+    _In_ PCUNICODE_STRING ValueName,
+    _In_ ULONG Default
+)
+{
+    NTSTATUS    status;
+    WDFKEY      key;
+    ULONG       value = Default;
+
+    status = WdfDeviceOpenRegistryKey(
+        Device,
+        PLUGPLAY_REGKEY_DEVICE,
+        KEY_READ,
+        WDF_NO_OBJECT_ATTRIBUTES,
+        &key
+    );
+
+    if (!NT_SUCCESS(status))
+    {
+        return Default;
+    }
+
+    if (!NT_SUCCESS(WdfRegistryQueryULong(key, ValueName, &value)))
+    {
+        value = Default;
+    }
+
+    WdfRegistryClose(key);
+
+    return value;
+}
@@ -25,6 +25,139 @@
 
 EXTERN_C_START
 
+//
+// Number of recent input reports kept for handles to catch up on, a power
+// of two so the slot of a sequence number survives its wrap-around
+//
+#define INPUT_HISTORY_DEPTH     64
+
+//
+// Number of control transfers that can be in flight at once
+//
+#define CONTROL_POOL_DEPTH      4
+
+//
+// Input report as received from the interrupt-in endpoint
+//
+typedef struct _INPUT_REPORT
+{
+    LONGLONG Timestamp;
+
+    ULONG Sequence;
+
+    ULONG Length;
+
+    UCHAR Buffer[FIRESHOCK_INPUT_REPORT_LENGTH];
+
+} INPUT_REPORT, *PINPUT_REPORT;
+
+//
+// Called once an asynchronous control transfer finished. Buffer holds the
+// data received from the device and is only valid for the duration of the call.
+//
+typedef VOID
+EVT_DSUSB_CONTROL_TRANSFER_COMPLETE(
+    _In_ NTSTATUS Status,
+    _In_reads_bytes_(Transferred) PVOID Buffer,
+    _In_ ULONG Transferred,
+    _In_opt_ WDFCONTEXT Context
+);
+
+typedef EVT_DSUSB_CONTROL_TRANSFER_COMPLETE *PFN_DSUSB_CONTROL_TRANSFER_COMPLETE;
+
+//
+// Preallocated control transfer, reused for every request sent with it
+//
+typedef struct _CONTROL_TRANSFER
+{
+    WDFREQUEST Request;
+
+    WDFMEMORY Memory;
+
+    PUCHAR Buffer;
+
+    //
+    // Taken by a transfer, protected by ControlPoolLock
+    //
+    BOOLEAN InUse;
+
+    //
+    // Handed to the I/O target and not completed yet, protected by
+    // ControlPoolLock
+    //
+    BOOLEAN Sent;
+
+    BOOLEAN DeviceToHost;
+
+    WDF_USB_CONTROL_SETUP_PACKET SetupPacket;
+
+    ULONG Length;
+
+    LONGLONG StartTimestamp;
+
+    //
+    // Set for asynchronous transfers only
+    //
+    PFN_DSUSB_CONTROL_TRANSFER_COMPLETE Completion;
+
+    WDFCONTEXT CompletionContext;
+
+} CONTROL_TRANSFER, *PCONTROL_TRANSFER;
+
+//
+// Hot path counters, only ever touched with interlocked operations
+//
+typedef struct _DEVICE_COUNTERS
+{
+    LONG64 volatile ReportsReceived;
+
+    LONG64 volatile ReportsDelivered;
+
+    LONG64 volatile ReportsNoReadPending;
+
+    LONG64 volatile BytesReceived;
+
+    LONG64 volatile BytesDelivered;
+
+    LONG64 volatile OutputWrites;
+
+    //
+    // Control transfers, in microseconds
+    //
+    HISTOGRAM ControlTransferLatency;
+
+    LONG volatile ReadersFailed;
+
+    LONG volatile ReaderRecoveries;
+
+    LONG volatile PipeResets;
+
+    LONG volatile LastTimeToRecover;
+
+    LONG volatile MaxTimeToRecover;
+
+    //
+    // Performance counter value at the last D0 entry, 0 while powered down
+    //
+    LONG64 volatile D0EntryTimestamp;
+
+    //
+    // Time between consecutive interrupt-in transfers
+    //
+    HISTOGRAM InputInterArrival;
+
+    //
+    // Time from interrupt-in completion to client request completion
+    //
+    HISTOGRAM InputDelivery;
+
+    //
+    // Time from request arrival to dispatch, per FIRESHOCK_QUEUE_CLASS_*
+    //
+    HISTOGRAM QueueWait[FIRESHOCK_QUEUE_CLASS_COUNT];
+
+} DEVICE_COUNTERS, *PDEVICE_COUNTERS;
+
 //
 // The device context performs the same job as
 // a WDM device extension in the driver frameworks
@@ -48,16 +181,206 @@ typedef struct _DEVICE_CONTEXT
     DS_DEVICE_TYPE DeviceType;
 
     //
-    // Device instance index
+    // Device instance index, the player slot if below FIRESHOCK_SLOT_COUNT,
+    // protected by the driver context lock
     // 
     ULONG DeviceIndex;
 
     WDFQUEUE IoReadQueue;
 
+    //
+    // Sequential queue for FIRESHOCK_QUEUE_CLASS_FEATURE IOCTLs, keeps
+    // control transfers from holding up the other IOCTLs
+    //
+    WDFQUEUE FeatureQueue;
+
     BD_ADDR HostAddress;
 
     BD_ADDR DeviceAddress;
 
+    //
+    // FIRESHOCK_FEATURE_* data that doesn't need to be fetched again
+    //
+    LONG volatile FeatureCacheValid;
+
+    //
+    // Fetches feature data in the background after power-up
+    //
+    WDFWORKITEM FeatureWorkItem;
+
+    //
+    // Protects FeatureFetchPending
+    //
+    WDFSPINLOCK FeatureLock;
+
+    BOOLEAN FeatureFetchPending;
+
+    //
+    // Requests depending on feature data while it's being fetched
+    //
+    WDFQUEUE FeatureWaitQueue;
+
+    //
+    // Startup timing, milliseconds since EvtDevicePrepareHardware (0 = not yet)
+    //
+    LONGLONG PrepareHardwareTimestamp;
+
+    ULONG TimeToFirstReport;
+
+    ULONG TimeToFeatures;
+
+    //
+    // Protects the input delivery state below
+    //
+    WDFSPINLOCK InputLock;
+
+    //
+    // Sequence number of the last received input report
+    //
+    ULONG InputSequence;
+
+    //
+    // Pending request owning the client-mapped input ring
+    //
+    WDFREQUEST InputRingRequest;
+
+    INPUT_RING InputRing;
+
+    //
+    // Clients waiting for the input ring to become non-empty
+    //
+    WDFQUEUE InputRingWaitQueue;
+
+    //
+    // IOCTL_FIRESHOCK_READ_AGGREGATED requests issued on this device,
+    // served with reports of any device
+    //
+    WDFQUEUE AggregateWaitQueue;
+
+    //
+    // Recent reports, each in slot Sequence % INPUT_HISTORY_DEPTH. Every
+    // handle reads them at its own pace (FILE_CONTEXT::LastSequence).
+    //
+    INPUT_REPORT InputHistory[INPUT_HISTORY_DEPTH];
+
+    //
+    // Sequence number of the last report discarded on power-down
+    //
+    ULONG InputHistoryStart;
+
+    //
+    // Most recently received report, in InputHistory
+    //
+    PINPUT_REPORT InputLatest;
+
+    //
+    // Brings the continuous reader back after it gave up, the state is
+    // protected by InputLock
+    //
+    BOOLEAN ReaderRecoveryEnabled;
+
+    RECOVERY_POLICY ReaderRecovery;
+
+    WDFTIMER ReaderRecoveryTimer;
+
+    WDFWORKITEM ReaderRecoveryWorkItem;
+
+    BOOLEAN ReaderRestartPending;
+
+    BOOLEAN ReaderResetPending;
+
+    BOOLEAN ReaderReinitPending;
+
+    //
+    // Protects the output stage state below
+    //
+    WDFSPINLOCK OutputLock;
+
+    BOOLEAN OutputInFlight;
+
+    //
+    // Most recent report not yet handed to the device, newer ones replace it
+    //
+    BOOLEAN OutputPending;
+
+    UCHAR OutputPendingReport[DS3_HID_OUTPUT_REPORT_SIZE];
+
+    //
+    // The pending report is the one in flight, it stops being pending once
+    // its transfer completes
+    //
+    BOOLEAN OutputPendingInFlight;
+
+    //
+    // Last report handed to the device, identical writes get absorbed
+    //
+    BOOLEAN OutputLastSentValid;
+
+    UCHAR OutputLastSent[DS3_HID_OUTPUT_REPORT_SIZE];
+
+    LONGLONG OutputLastSentTime;
+
+    //
+    // Performance counter ticks after which an identical report is sent
+    // anyway, 0 disables
+    //
+    LONGLONG OutputRefreshInterval;
+
+    FIRESHOCK_OUTPUT_STATISTICS OutputStatistics;
+
+    //
+    // Protects the InUse flags of ControlPool
+    //
+    WDFSPINLOCK ControlPoolLock;
+
+    //
+    // Control transfers created once in EvtDevicePrepareHardware, so sending
+    // one allocates nothing
+    //
+    CONTROL_TRANSFER ControlPool[CONTROL_POOL_DEPTH];
+
+    DEVICE_COUNTERS Counters;
+
+    //
+    // Protects the traffic capture state below
+    //
+    WDFSPINLOCK CaptureLock;
+
+    //
+    // Checked without the lock to keep the transfer paths cheap while off
+    //
+    BOOLEAN volatile CaptureEnabled;
+
+    WDFMEMORY CaptureMemory;
+
+    CAPTURE_BUFFER Capture;
+
+    //
+    // Synthetic controller standing in for the device (SimulatedReportRate)
+    //
+    BOOLEAN Simulated;
+
+    //
+    // Protects Simulator
+    //
+    WDFSPINLOCK SimulatorLock;
+
+    SIMULATOR Simulator;
+
+    WDFTIMER SimulatorTimer;
+
+    //
+    // Reports per second
+    //
+    ULONG SimulatorReportRate;
+
+    //
+    // Reports due since SimulatorStartTimestamp, only touched by the timer
+    //
+    LONGLONG SimulatorStartTimestamp;
+
+    ULONGLONG SimulatorReports;
+
 } DEVICE_CONTEXT, *PDEVICE_CONTEXT;
 
 //
@@ -67,6 +390,60 @@ typedef struct _DEVICE_CONTEXT
 //
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DEVICE_CONTEXT, DeviceGetContext)
 
+//
+// Per-handle context
+//
+typedef struct _FILE_CONTEXT
+{
+    //
+    // How reads on this handle get served
+    // 
+    FIRESHOCK_READ_MODE ReadMode;
+
+    //
+    // FIRESHOCK_REPORT_FORMAT_* flags
+    // 
+    ULONG ReportFormat;
+
+    //
+    // Sequence number of the last report this handle has been through,
+    // protected by InputLock
+    // 
+    ULONG LastSequence;
+
+    //
+    // Reports overwritten in the history before this handle got to them,
+    // since the last batch read
+    // 
+    ULONG Dropped;
+
+    //
+    // Suppresses reports that barely differ from the last delivered one
+    // 
+    CHANGE_FILTER ChangeFilter;
+
+    //
+    // Handle counts towards the aggregated read clients, protected by the
+    // driver context lock
+    // 
+    BOOLEAN Aggregated;
+
+    //
+    // Number of the next aggregated report this handle gets, protected by
+    // the driver context lock
+    // 
+    ULONG AggregateSequence;
+
+    //
+    // Aggregated reports overwritten before this handle got to them, since
+    // the last aggregated read
+    // 
+    ULONG AggregateDropped;
+
+} FILE_CONTEXT, *PFILE_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(FILE_CONTEXT, FileGetContext)
+
 //
 // DualShock 4-specific context
 // 
@@ -83,9 +460,31 @@ typedef struct _DS4_DEVICE_CONTEXT
     UCHAR OutputReportBuffer[DS4_HID_OUTPUT_REPORT_SIZE];
 
     //
-    // Cached input report
+    // OutputReportBuffer changed since it was last sent, protected by OutputLock
+    // 
+    BOOLEAN OutputReportDirty;
+
+    //
+    // Timer period in milliseconds
+    // 
+    ULONG OutputReportPeriod;
+
+    //
+    // Preallocated interrupt-out write, one is in flight at most
+    // (DEVICE_CONTEXT::OutputInFlight)
+    // 
+    WDFREQUEST OutputRequest;
+
+    WDFMEMORY OutputMemory;
+
+    PUCHAR OutputTransferBuffer;
+
+    //
+    // Motion calibration read from the device once
     // 
-    //DS4_REPORT LastReport;
+    BOOLEAN CalibrationValid;
+
+    DS4_CALIBRATION Calibration;
 
 } DS4_DEVICE_CONTEXT, *PDS4_DEVICE_CONTEXT;
 
@@ -102,4 +501,29 @@ FireShockCreateDevice(
 
 NTSTATUS Ds3Init(PDEVICE_CONTEXT Context);
 
+NTSTATUS Ds3FetchAddresses(PDEVICE_CONTEXT Context);
+
+NTSTATUS Ds4FetchCalibration(WDFDEVICE Device);
+
+VOID Ds4OutputSubmit(WDFDEVICE Device, PVOID Report, size_t Length);
+
+NTSTATUS Ds4OutputInitialize(WDFDEVICE Device);
+
+EVT_WDF_TIMER Ds4EvtOutputReportTimerFunc;
+
+EVT_WDF_REQUEST_COMPLETION_ROUTINE Ds4EvtOutputReportWriteComplete;
+
+EVT_WDF_OBJECT_CONTEXT_CLEANUP FireShockEvtDeviceContextCleanup;
+
+EVT_WDF_DEVICE_FILE_CREATE FireShockEvtDeviceFileCreate;
+
+EVT_WDF_FILE_CLEANUP FireShockEvtFileCleanup;
+
+ULONG
+FireShockQueryDeviceSetting(
+    _In_ WDFDEVICE Device,
+    _In_ PCUNICODE_STRING ValueName,
+    _In_ ULONG Default
+    );
+
 EXTERN_C_END
@@ -61,19 +61,23 @@ Return Value:
     WDF_DRIVER_CONFIG config;
     NTSTATUS status;
     WDF_OBJECT_ATTRIBUTES attributes;
+    WDFDRIVER driver;
+    PDRIVER_CONTEXT pDriverContext;
 
     //
     // Initialize WPP Tracing
     //
     WPP_INIT_TRACING( DriverObject, RegistryPath );
 
+    TraceLoggingRegister(FireShockTraceLoggingProvider);
+
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
     //
     // Register a cleanup callback so that we can call WPP_CLEANUP when
     // the framework driver object is deleted during driver unload.
     //
-    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, DRIVER_CONTEXT);
     attributes.EvtCleanupCallback = FireShockEvtDriverContextCleanup;
 
     WDF_DRIVER_CONFIG_INIT(&config,
@@ -84,11 +88,30 @@ Return Value:
                              RegistryPath,
                              &attributes,
                              &config,
-                             WDF_NO_HANDLE
+                             &driver
                              );
 
     if (!NT_SUCCESS(status)) {
         TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "WdfDriverCreate failed %!STATUS!", status);
+        TraceLoggingUnregister(FireShockTraceLoggingProvider);
+        WPP_CLEANUP(DriverObject);
+        return status;
+    }
+
+    pDriverContext = DriverGetContext(driver);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = driver;
+
+    status = WdfSpinLockCreate(&attributes, &pDriverContext->Lock);
+
+    if (NT_SUCCESS(status)) {
+        status = WdfCollectionCreate(&attributes, &pDriverContext->Devices);
+    }
+
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER, "Creating the device collection failed %!STATUS!", status);
+        TraceLoggingUnregister(FireShockTraceLoggingProvider);
         WPP_CLEANUP(DriverObject);
         return status;
     }
@@ -158,9 +181,538 @@ Return Value:
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
+    TraceLoggingUnregister(FireShockTraceLoggingProvider);
+
     //
     // Stop WPP Tracing
     //
     WPP_CLEANUP( WdfDriverWdmGetDriverObject( (WDFDRIVER) DriverObject) );
 
 }
+
+//
+// Occupies a free slot, or else the one left the longest time ago. Returns
+// FIRESHOCK_SLOT_COUNT if all are occupied.
+// Must be called with the driver context lock held.
+// 
+static ULONG
+FireShockSlotAcquire(
+    _In_ PDRIVER_CONTEXT DriverContext,
+    _In_ WDFDEVICE Device
+)
+{
+    PDRIVER_SLOT    pSlot;
+    ULONG           slot = FIRESHOCK_SLOT_COUNT;
+    ULONG           index;
+
+    for (index = 0; index < FIRESHOCK_SLOT_COUNT; index++)
+    {
+        pSlot = &DriverContext->Slots[index];
+
+        if (pSlot->Info.State == FireShockSlotFree)
+        {
+            slot = index;
+            break;
+        }
+
+        if (pSlot->Info.State == FireShockSlotDisconnected
+            && (slot == FIRESHOCK_SLOT_COUNT
+                || (LONG)(pSlot->LastUsed - DriverContext->Slots[slot].LastUsed) < 0))
+        {
+            slot = index;
+        }
+    }
+
+    if (slot < FIRESHOCK_SLOT_COUNT)
+    {
+        //
+        // The address stays until the device turns out to be another one
+        // 
+        DriverContext->Slots[slot].Info.State = FireShockSlotConnected;
+        DriverContext->Slots[slot].Device = Device;
+        DriverContext->Slots[slot].Bound = FALSE;
+    }
+
+    return slot;
+}
+
+//
+// Gives a slot up, it stays reserved if the device's address is known.
+// Must be called with the driver context lock held.
+// 
+static VOID
+FireShockSlotRelease(
+    _In_ PDRIVER_CONTEXT DriverContext,
+    _In_ ULONG Slot
+)
+{
+    PDRIVER_SLOT pSlot = &DriverContext->Slots[Slot];
+
+    pSlot->Info.State = pSlot->Info.AddressValid ? FireShockSlotDisconnected : FireShockSlotFree;
+    pSlot->Device = NULL;
+    pSlot->Bound = FALSE;
+}
+
+//
+// Adds a device to the collection and assigns it a slot, its final one
+// is known once the device address is (see FireShockDriverBindDevice).
+// 
+NTSTATUS
+FireShockDriverAddDevice(
+    _In_ WDFDEVICE Device
+)
+{
+    NTSTATUS            status;
+    PDRIVER_CONTEXT     pDriverContext = DriverGetContext(WdfGetDriver());
+    PDEVICE_CONTEXT     pDeviceContext = DeviceGetContext(Device);
+    ULONG               deviceIndex;
+    ULONG               index;
+    ULONG               count;
+
+    WdfSpinLockAcquire(pDriverContext->Lock);
+
+    count = WdfCollectionGetCount(pDriverContext->Devices);
+
+    //
+    // Without a slot, take the lowest unused index past them
+    // 
+    for (deviceIndex = FireShockSlotAcquire(pDriverContext, Device); deviceIndex >= FIRESHOCK_SLOT_COUNT; deviceIndex++)
+    {
+        for (index = 0; index < count; index++)
+        {
+            if (DeviceGetContext(WdfCollectionGetItem(pDriverContext->Devices, index))->DeviceIndex == deviceIndex)
+            {
+                break;
+            }
+        }
+
+        if (index == count)
+        {
+            break;
+        }
+    }
+
+    pDeviceContext->DeviceIndex = deviceIndex;
+
+    status = WdfCollectionAdd(pDriverContext->Devices, Device);
+
+    if (!NT_SUCCESS(status) && deviceIndex < FIRESHOCK_SLOT_COUNT)
+    {
+        FireShockSlotRelease(pDriverContext, deviceIndex);
+    }
+
+    WdfSpinLockRelease(pDriverContext->Lock);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DRIVER,
+            "WdfCollectionAdd failed with status %!STATUS!", status);
+        return status;
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
+        "Device 0x%p got index %d", Device, deviceIndex);
+
+    return status;
+}
+
+//
+// Removes a device from the collection, its slot is kept for it.
+// 
+VOID
+FireShockDriverRemoveDevice(
+    _In_ WDFDEVICE Device
+)
+{
+    PDRIVER_CONTEXT     pDriverContext = DriverGetContext(WdfGetDriver());
+    PDEVICE_CONTEXT     pDeviceContext = DeviceGetContext(Device);
+    ULONG               index;
+
+    WdfSpinLockAcquire(pDriverContext->Lock);
+
+    for (index = 0; index < WdfCollectionGetCount(pDriverContext->Devices); index++)
+    {
+        if (WdfCollectionGetItem(pDriverContext->Devices, index) == Device)
+        {
+            WdfCollectionRemoveItem(pDriverContext->Devices, index);
+
+            if (pDeviceContext->DeviceIndex < FIRESHOCK_SLOT_COUNT)
+            {
+                pDriverContext->Slots[pDeviceContext->DeviceIndex].Info.DeviceType = pDeviceContext->DeviceType;
+                pDriverContext->Slots[pDeviceContext->DeviceIndex].LastUsed = ++pDriverContext->SlotClock;
+
+                FireShockSlotRelease(pDriverContext, pDeviceContext->DeviceIndex);
+            }
+
+            break;
+        }
+    }
+
+    WdfSpinLockRelease(pDriverContext->Lock);
+}
+
+//
+// Moves a device to the slot it had before, if any and still available,
+// once its address is known. The slot it's in is kept for it otherwise.
+// 
+VOID
+FireShockDriverBindDevice(
+    _In_ WDFDEVICE Device
+)
+{
+    PDRIVER_CONTEXT     pDriverContext = DriverGetContext(WdfGetDriver());
+    PDEVICE_CONTEXT     pDeviceContext = DeviceGetContext(Device);
+    PDRIVER_SLOT        pSlot;
+    ULONG               previous;
+    ULONG               index;
+
+    if (!(pDeviceContext->FeatureCacheValid & FIRESHOCK_FEATURE_DEVICE_ADDRESS))
+    {
+        return;
+    }
+
+    WdfSpinLockAcquire(pDriverContext->Lock);
+
+    previous = pDeviceContext->DeviceIndex;
+
+    for (index = 0; index < FIRESHOCK_SLOT_COUNT; index++)
+    {
+        pSlot = &pDriverContext->Slots[index];
+
+        if (pSlot->Info.AddressValid
+            && RtlEqualMemory(&pSlot->Info.Address, &pDeviceContext->DeviceAddress, sizeof(BD_ADDR))
+            && (pSlot->Info.State != FireShockSlotConnected || pSlot->Device == Device))
+        {
+            break;
+        }
+    }
+
+    if (index < FIRESHOCK_SLOT_COUNT && index != previous)
+    {
+        if (previous < FIRESHOCK_SLOT_COUNT)
+        {
+            FireShockSlotRelease(pDriverContext, previous);
+        }
+
+        pDriverContext->Slots[index].Info.State = FireShockSlotConnected;
+        pDriverContext->Slots[index].Device = Device;
+
+        pDeviceContext->DeviceIndex = index;
+    }
+
+    if (pDeviceContext->DeviceIndex < FIRESHOCK_SLOT_COUNT)
+    {
+        pSlot = &pDriverContext->Slots[pDeviceContext->DeviceIndex];
+
+        pSlot->Info.DeviceType = pDeviceContext->DeviceType;
+        pSlot->Info.AddressValid = TRUE;
+        pSlot->Info.Address = pDeviceContext->DeviceAddress;
+        pSlot->Bound = TRUE;
+    }
+
+    WdfSpinLockRelease(pDriverContext->Lock);
+
+    if (pDeviceContext->DeviceIndex != previous)
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER,
+            "Device 0x%p moved from index %d back to slot %d",
+            Device, previous, pDeviceContext->DeviceIndex);
+    }
+}
+
+//
+// Returns a snapshot of the slot table.
+// 
+VOID
+FireShockDriverGetSlots(
+    _Out_ PFIRESHOCK_GET_SLOTS Slots
+)
+{
+    PDRIVER_CONTEXT     pDriverContext = DriverGetContext(WdfGetDriver());
+    PDRIVER_SLOT        pSlot;
+    ULONG               index;
+
+    WdfSpinLockAcquire(pDriverContext->Lock);
+
+    Slots->DeviceCount = WdfCollectionGetCount(pDriverContext->Devices);
+
+    for (index = 0; index < FIRESHOCK_SLOT_COUNT; index++)
+    {
+        pSlot = &pDriverContext->Slots[index];
+
+        Slots->Slots[index] = pSlot->Info;
+
+        if (pSlot->Info.State == FireShockSlotConnected)
+        {
+            Slots->Slots[index].DeviceType = DeviceGetContext(pSlot->Device)->DeviceType;
+
+            //
+            // Address of the previous device, not the one in there now
+            // 
+            if (!pSlot->Bound)
+            {
+                Slots->Slots[index].AddressValid = FALSE;
+                RtlZeroMemory(&Slots->Slots[index].Address, sizeof(BD_ADDR));
+            }
+        }
+    }
+
+    WdfSpinLockRelease(pDriverContext->Lock);
+}
+
+//
+// Starts collecting reports for aggregated reads on behalf of a handle.
+// 
+VOID
+FireShockAggregateRegister(
+    _In_ PFILE_CONTEXT FileContext
+)
+{
+    PDRIVER_CONTEXT     pDriverContext = DriverGetContext(WdfGetDriver());
+
+    WdfSpinLockAcquire(pDriverContext->Lock);
+
+    if (!FileContext->Aggregated)
+    {
+        FileContext->Aggregated = TRUE;
+        FileContext->AggregateSequence = pDriverContext->AggregateSequence;
+        FileContext->AggregateDropped = 0;
+        InterlockedIncrement(&pDriverContext->AggregateClients);
+    }
+
+    WdfSpinLockRelease(pDriverContext->Lock);
+}
+
+//
+// Stops collecting reports on behalf of a handle.
+// 
+VOID
+FireShockAggregateUnregister(
+    _In_ PFILE_CONTEXT FileContext
+)
+{
+    PDRIVER_CONTEXT     pDriverContext = DriverGetContext(WdfGetDriver());
+
+    WdfSpinLockAcquire(pDriverContext->Lock);
+
+    if (FileContext->Aggregated)
+    {
+        FileContext->Aggregated = FALSE;
+        InterlockedDecrement(&pDriverContext->AggregateClients);
+    }
+
+    WdfSpinLockRelease(pDriverContext->Lock);
+}
+
+//
+// Adds a report to the aggregated backlog, overwriting the oldest one if
+// full, and hands it to the waiting aggregated reads.
+// 
+VOID
+FireShockAggregateReport(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ LONGLONG Timestamp,
+    _In_ ULONG Sequence,
+    _In_ PVOID Report,
+    _In_ size_t Length
+)
+{
+    PDRIVER_CONTEXT             pDriverContext = DriverGetContext(WdfGetDriver());
+    PFIRESHOCK_AGGREGATED_ENTRY pEntry;
+
+    //
+    // Nobody is interested, keep the report path cheap
+    // 
+    if (pDriverContext->AggregateClients == 0)
+    {
+        return;
+    }
+
+    WdfSpinLockAcquire(pDriverContext->Lock);
+
+    pEntry = &pDriverContext->AggregateBacklog[pDriverContext->AggregateSequence % AGGREGATE_BACKLOG_DEPTH];
+
+    pEntry->DeviceIndex = Context->DeviceIndex;
+    pEntry->Envelope.Timestamp = Timestamp;
+    pEntry->Envelope.Sequence = Sequence;
+    pEntry->Envelope.Length = (ULONG)Length;
+    RtlCopyMemory(pEntry->Report, Report, Length);
+
+    pDriverContext->AggregateSequence++;
+
+    WdfSpinLockRelease(pDriverContext->Lock);
+
+    FireShockAggregateDispatch();
+}
+
+//
+// Takes the oldest aggregated read of a queue whose handle has reports to go.
+// Must be called with the driver context lock held.
+// 
+static NTSTATUS
+FireShockAggregateRetrieveRequest(
+    _In_ PDRIVER_CONTEXT Context,
+    _In_ WDFQUEUE Queue,
+    _Out_ WDFREQUEST *Request
+)
+{
+    NTSTATUS        status;
+    WDFREQUEST      previous = NULL;
+    WDFREQUEST      found;
+    PFILE_CONTEXT   pFileContext;
+
+    for (;;)
+    {
+        status = WdfIoQueueFindRequest(Queue, previous, NULL, NULL, &found);
+
+        if (previous != NULL)
+        {
+            WdfObjectDereference(previous);
+        }
+
+        if (!NT_SUCCESS(status))
+        {
+            //
+            // STATUS_NOT_FOUND means previous left the queue meanwhile, start over
+            // 
+            if (status == STATUS_NOT_FOUND && previous != NULL)
+            {
+                previous = NULL;
+                continue;
+            }
+
+            return status;
+        }
+
+        pFileContext = FileGetContext(WdfRequestGetFileObject(found));
+
+        if (pFileContext->AggregateSequence != Context->AggregateSequence)
+        {
+            status = WdfIoQueueRetrieveFoundRequest(Queue, found, Request);
+
+            WdfObjectDereference(found);
+
+            if (NT_SUCCESS(status))
+            {
+                return status;
+            }
+
+            //
+            // Request got cancelled meanwhile
+            // 
+            previous = NULL;
+            continue;
+        }
+
+        previous = found;
+    }
+}
+
+//
+// Serves pending aggregated reads of all devices from the backlog, each
+// handle from where it left off.
+// 
+VOID
+FireShockAggregateDispatch(
+    VOID
+)
+{
+    NTSTATUS                    status;
+    PDRIVER_CONTEXT             pDriverContext = DriverGetContext(WdfGetDriver());
+    WDFREQUEST                  request;
+    PFIRESHOCK_AGGREGATED_BATCH pBatch;
+    PDEVICE_CONTEXT             pDeviceContext = NULL;
+    PFILE_CONTEXT               pFileContext;
+    size_t                      bufferLength;
+    ULONG                       count;
+    ULONG                       index;
+
+    for (;;)
+    {
+        request = NULL;
+        count = 0;
+
+        WdfSpinLockAcquire(pDriverContext->Lock);
+
+        for (index = 0; index < WdfCollectionGetCount(pDriverContext->Devices); index++)
+        {
+            pDeviceContext = DeviceGetContext(WdfCollectionGetItem(pDriverContext->Devices, index));
+
+            status = FireShockAggregateRetrieveRequest(
+                pDriverContext,
+                pDeviceContext->AggregateWaitQueue,
+                &request);
+
+            if (NT_SUCCESS(status))
+            {
+                break;
+            }
+
+            request = NULL;
+        }
+
+        if (request != NULL)
+        {
+            pFileContext = FileGetContext(WdfRequestGetFileObject(request));
+
+            status = WdfRequestRetrieveOutputBuffer(
+                request,
+                sizeof(FIRESHOCK_AGGREGATED_BATCH),
+                (LPVOID)&pBatch,
+                &bufferLength);
+
+            if (NT_SUCCESS(status))
+            {
+                //
+                // Skip what got overwritten before this handle got to it
+                // 
+                if (pDriverContext->AggregateSequence - pFileContext->AggregateSequence > AGGREGATE_BACKLOG_DEPTH)
+                {
+                    pFileContext->AggregateDropped +=
+                        pDriverContext->AggregateSequence - pFileContext->AggregateSequence - AGGREGATE_BACKLOG_DEPTH;
+                    pFileContext->AggregateSequence = pDriverContext->AggregateSequence - AGGREGATE_BACKLOG_DEPTH;
+                }
+
+                count = min(pDriverContext->AggregateSequence - pFileContext->AggregateSequence,
+                    (ULONG)(1 + (bufferLength - sizeof(FIRESHOCK_AGGREGATED_BATCH)) / sizeof(FIRESHOCK_AGGREGATED_ENTRY)));
+
+                for (index = 0; index < count; index++)
+                {
+                    RtlCopyMemory(
+                        &pBatch->Entries[index],
+                        &pDriverContext->AggregateBacklog[(pFileContext->AggregateSequence + index) % AGGREGATE_BACKLOG_DEPTH],
+                        sizeof(FIRESHOCK_AGGREGATED_ENTRY));
+                }
+
+                pFileContext->AggregateSequence += count;
+
+                pBatch->Count = count;
+                pBatch->Dropped = pFileContext->AggregateDropped;
+                pFileContext->AggregateDropped = 0;
+            }
+        }
+
+        WdfSpinLockRelease(pDriverContext->Lock);
+
+        if (request == NULL)
+        {
+            return;
+        }
+
+        FireShockEventRequestCompleted(
+            pDeviceContext,
+            request,
+            status,
+            NT_SUCCESS(status)
+                ? sizeof(FIRESHOCK_AGGREGATED_BATCH) + (count - 1) * sizeof(FIRESHOCK_AGGREGATED_ENTRY)
+                : 0,
+            (count > 0) ? pBatch->Entries[0].Envelope.Timestamp : 0);
+
+        WdfRequestCompleteWithInformation(
+            request,
+            status,
+            NT_SUCCESS(status)
+                ? sizeof(FIRESHOCK_AGGREGATED_BATCH) + (count - 1) * sizeof(FIRESHOCK_AGGREGATED_ENTRY)
+                : 0);
+    }
+}
@@ -24,6 +24,7 @@
 
 
 #include <windows.h>
+#include <TraceLoggingProvider.h>
 #include <wdf.h>
 #include <usb.h>
 #include <wdfusb.h>
@@ -31,14 +32,95 @@
 
 #include "FireShock.h"
 #include "DualShock.h"
+#include "InputRing.h"
+#include "DsDecode.h"
+#include "ChangeFilter.h"
+#include "Histogram.h"
+#include "Recovery.h"
+#include "Capture.h"
+#include "Simulator.h"
 #include "device.h"
 #include "Power.h"
 #include "DsUsb.h"
 #include "queue.h"
+#include "Events.h"
 #include "trace.h"
 
 EXTERN_C_START
 
+//
+// Maximum number of aggregated reports held back for a handle with no read
+// pending, a power of two so the backlog index survives sequence wrap
+//
+#define AGGREGATE_BACKLOG_DEPTH     256
+
+//
+// Player slot, its index is the DeviceIndex of the device occupying it
+//
+typedef struct _DRIVER_SLOT
+{
+    FIRESHOCK_SLOT Info;
+
+    //
+    // Occupying device while connected
+    //
+    WDFDEVICE Device;
+
+    //
+    // Info.Address belongs to Device, otherwise it's kept for a previous one
+    //
+    BOOLEAN Bound;
+
+    //
+    // SlotClock when the slot was left, the oldest one gets recycled first
+    //
+    ULONG LastUsed;
+
+} DRIVER_SLOT, *PDRIVER_SLOT;
+
+//
+// State shared by all devices hosted in this process
+//
+typedef struct _DRIVER_CONTEXT
+{
+    //
+    // Protects everything below
+    //
+    WDFSPINLOCK Lock;
+
+    //
+    // Every FireShock device in this host, for aggregated reads
+    //
+    WDFCOLLECTION Devices;
+
+    //
+    // Handles which issued IOCTL_FIRESHOCK_READ_AGGREGATED, reports only get
+    // collected while there are any
+    //
+    LONG volatile AggregateClients;
+
+    //
+    // Player slots, remembered for as long as the host process lives
+    //
+    DRIVER_SLOT Slots[FIRESHOCK_SLOT_COUNT];
+
+    ULONG SlotClock;
+
+    //
+    // Most recent reports of all devices, the one numbered s is stored at
+    // s % AGGREGATE_BACKLOG_DEPTH
+    //
+    FIRESHOCK_AGGREGATED_ENTRY AggregateBacklog[AGGREGATE_BACKLOG_DEPTH];
+
+    //
+    // Number the next report added to the backlog gets
+    //
+    ULONG AggregateSequence;
+
+} DRIVER_CONTEXT, *PDRIVER_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DRIVER_CONTEXT, DriverGetContext)
+
 //
 // WDFDRIVER Events
 //
@@ -47,4 +129,48 @@ DRIVER_INITIALIZE DriverEntry;
 EVT_WDF_DRIVER_DEVICE_ADD FireShockEvtDeviceAdd;
 EVT_WDF_OBJECT_CONTEXT_CLEANUP FireShockEvtDriverContextCleanup;
 
+NTSTATUS
+FireShockDriverAddDevice(
+    _In_ WDFDEVICE Device
+    );
+
+VOID
+FireShockDriverRemoveDevice(
+    _In_ WDFDEVICE Device
+    );
+
+VOID
+FireShockDriverBindDevice(
+    _In_ WDFDEVICE Device
+    );
+
+VOID
+FireShockDriverGetSlots(
+    _Out_ PFIRESHOCK_GET_SLOTS Slots
+    );
+
+VOID
+FireShockAggregateRegister(
+    _In_ PFILE_CONTEXT FileContext
+    );
+
+VOID
+FireShockAggregateUnregister(
+    _In_ PFILE_CONTEXT FileContext
+    );
+
+VOID
+FireShockAggregateReport(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ LONGLONG Timestamp,
+    _In_ ULONG Sequence,
+    _In_ PVOID Report,
+    _In_ size_t Length
+    );
+
+VOID
+FireShockAggregateDispatch(
+    VOID
+    );
+
 EXTERN_C_END
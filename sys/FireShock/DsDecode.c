@@ -0,0 +1,306 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "DsDecode.h"
+
+//
+// Motion data is transmitted big endian
+// 
+#define DS3_MOTION_AXIS(_r_, _o_)   ((SHORT)((((_r_)[(_o_)] << 8) | (_r_)[(_o_) + 1]) - DS3_MOTION_CENTER))
+
+//
+// Kept free of branches and calls so the batch loop below vectorizes.
+// 
+static __inline VOID
+DsDecodeDs3(
+    _In_ const UCHAR * __restrict Report,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE __restrict State)
+{
+    ULONG i;
+
+    State->Buttons = (ULONG)Report[DS3_REPORT_OFFSET_BUTTONS]
+        | ((ULONG)Report[DS3_REPORT_OFFSET_BUTTONS + 1] << 8)
+        | ((ULONG)(Report[DS3_REPORT_OFFSET_PS_BUTTON] & 0x01) << 16);
+
+    State->LeftThumbX = Report[DS3_REPORT_OFFSET_LEFT_THUMB_X];
+    State->LeftThumbY = Report[DS3_REPORT_OFFSET_LEFT_THUMB_Y];
+    State->RightThumbX = Report[DS3_REPORT_OFFSET_RIGHT_THUMB_X];
+    State->RightThumbY = Report[DS3_REPORT_OFFSET_RIGHT_THUMB_Y];
+
+    for (i = 0; i < FIRESHOCK_PRESSURE_COUNT; i++)
+    {
+        State->Pressure[i] = Report[DS3_REPORT_OFFSET_PRESSURE + i];
+    }
+
+    State->LeftTrigger = State->Pressure[FIRESHOCK_PRESSURE_L2];
+    State->RightTrigger = State->Pressure[FIRESHOCK_PRESSURE_R2];
+
+    for (i = 0; i < 3; i++)
+    {
+        State->Accelerometer[i] = DS3_MOTION_AXIS(Report, DS3_REPORT_OFFSET_ACCELEROMETER + i * 2);
+    }
+
+    //
+    // Single gyro measuring rotation around the vertical axis
+    // 
+    State->Gyroscope[0] = 0;
+    State->Gyroscope[1] = DS3_MOTION_AXIS(Report, DS3_REPORT_OFFSET_GYROSCOPE);
+    State->Gyroscope[2] = 0;
+
+    RtlZeroMemory(State->Touch, sizeof(State->Touch));
+}
+
+//
+// Motion data and calibration values are transmitted little endian
+// 
+#define DS4_WORD(_r_, _o_)          ((SHORT)((_r_)[(_o_)] | ((_r_)[(_o_) + 1] << 8)))
+
+//
+// D-pad hat switch position (0 = north, clockwise, 8 = released) to button bits
+// 
+static const UCHAR Ds4HatToDpad[16] =
+{
+    0x10, 0x30, 0x20, 0x60, 0x40, 0xC0, 0x80, 0x90,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+static __inline LONG
+DsDecodeDs4Axis(
+    _In_ const DS4_AXIS_CALIBRATION *Calibration,
+    _In_ LONG Raw)
+{
+    return (LONG)(((LONGLONG)(Raw - Calibration->Bias) * Calibration->Numerator) / Calibration->Denominator);
+}
+
+static __inline VOID
+DsDecodeDs4(
+    _In_ const UCHAR * __restrict Report,
+    _In_opt_ const DS4_CALIBRATION * __restrict Calibration,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE __restrict State)
+{
+    const UCHAR    *buttons = &Report[DS4_REPORT_OFFSET_BUTTONS];
+    const UCHAR    *point;
+    ULONG           i;
+
+    //
+    // Translate to DualShock 3 button positions
+    // 
+    State->Buttons = Ds4HatToDpad[buttons[0] & 0x0F]
+        | ((buttons[0] & 0x10) ? FIRESHOCK_BUTTON_SQUARE : 0)
+        | ((buttons[0] & 0x20) ? FIRESHOCK_BUTTON_CROSS : 0)
+        | ((buttons[0] & 0x40) ? FIRESHOCK_BUTTON_CIRCLE : 0)
+        | ((buttons[0] & 0x80) ? FIRESHOCK_BUTTON_TRIANGLE : 0)
+        | ((buttons[1] & 0x01) ? FIRESHOCK_BUTTON_L1 : 0)
+        | ((buttons[1] & 0x02) ? FIRESHOCK_BUTTON_R1 : 0)
+        | ((buttons[1] & 0x04) ? FIRESHOCK_BUTTON_L2 : 0)
+        | ((buttons[1] & 0x08) ? FIRESHOCK_BUTTON_R2 : 0)
+        | ((buttons[1] & 0x10) ? FIRESHOCK_BUTTON_SELECT : 0)
+        | ((buttons[1] & 0x20) ? FIRESHOCK_BUTTON_START : 0)
+        | ((buttons[1] & 0x40) ? FIRESHOCK_BUTTON_L3 : 0)
+        | ((buttons[1] & 0x80) ? FIRESHOCK_BUTTON_R3 : 0)
+        | ((buttons[2] & 0x01) ? FIRESHOCK_BUTTON_PS : 0)
+        | ((buttons[2] & 0x02) ? FIRESHOCK_BUTTON_TOUCHPAD : 0);
+
+    State->LeftThumbX = Report[DS4_REPORT_OFFSET_LEFT_THUMB_X];
+    State->LeftThumbY = Report[DS4_REPORT_OFFSET_LEFT_THUMB_Y];
+    State->RightThumbX = Report[DS4_REPORT_OFFSET_RIGHT_THUMB_X];
+    State->RightThumbY = Report[DS4_REPORT_OFFSET_RIGHT_THUMB_Y];
+    State->LeftTrigger = Report[DS4_REPORT_OFFSET_LEFT_TRIGGER];
+    State->RightTrigger = Report[DS4_REPORT_OFFSET_RIGHT_TRIGGER];
+
+    //
+    // No pressure sensitive buttons besides the triggers
+    // 
+    RtlZeroMemory(State->Pressure, sizeof(State->Pressure));
+    State->Pressure[FIRESHOCK_PRESSURE_L2] = State->LeftTrigger;
+    State->Pressure[FIRESHOCK_PRESSURE_R2] = State->RightTrigger;
+
+    for (i = 0; i < 3; i++)
+    {
+        State->Gyroscope[i] = DS4_WORD(Report, DS4_REPORT_OFFSET_GYROSCOPE + i * 2);
+        State->Accelerometer[i] = DS4_WORD(Report, DS4_REPORT_OFFSET_ACCELEROMETER + i * 2);
+    }
+
+    if (Calibration != NULL)
+    {
+        for (i = 0; i < 3; i++)
+        {
+            State->Gyroscope[i] = DsDecodeDs4Axis(&Calibration->Gyroscope[i], State->Gyroscope[i]);
+            State->Accelerometer[i] = DsDecodeDs4Axis(&Calibration->Accelerometer[i], State->Accelerometer[i]);
+        }
+    }
+
+    //
+    // The first touch report holds the current contacts
+    // 
+    for (i = 0; i < FIRESHOCK_TOUCH_POINT_COUNT; i++)
+    {
+        point = &Report[DS4_REPORT_OFFSET_TOUCH_POINTS + i * DS4_TOUCH_POINT_SIZE];
+
+        State->Touch[i].Active = (point[0] & 0x80) == 0;
+        State->Touch[i].Id = point[0] & 0x7F;
+        State->Touch[i].X = (USHORT)(point[1] | ((point[2] & 0x0F) << 8));
+        State->Touch[i].Y = (USHORT)((point[2] >> 4) | (point[3] << 4));
+    }
+}
+
+//
+// Decodes a single DualShock 3 or Navigation controller report.
+// 
+BOOLEAN
+DsDecodeDs3Report(
+    _In_reads_bytes_(Length) const UCHAR *Report,
+    _In_ size_t Length,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State)
+{
+    if (Length < DS3_HID_INPUT_REPORT_SIZE || Report[0] != 0x01)
+    {
+        RtlZeroMemory(State, sizeof(FIRESHOCK_CONTROLLER_STATE));
+        return FALSE;
+    }
+
+    DsDecodeDs3(Report, State);
+
+    return TRUE;
+}
+
+VOID
+DsDecodeDs3Batch(
+    _In_ const UCHAR *Reports,
+    _In_ size_t ReportStride,
+    _Out_ PUCHAR States,
+    _In_ size_t StateStride,
+    _In_ size_t Count)
+{
+    size_t i;
+
+    for (i = 0; i < Count; i++)
+    {
+        DsDecodeDs3(
+            Reports + i * ReportStride,
+            (PFIRESHOCK_CONTROLLER_STATE)(States + i * StateStride));
+    }
+}
+
+//
+// Derives motion calibration from feature report 0x02. Returns FALSE if
+// the data is implausible, leaving Calibration untouched.
+// 
+BOOLEAN
+DsDecodeDs4Calibration(
+    _In_reads_bytes_(Length) const UCHAR *Feature,
+    _In_ size_t Length,
+    _Out_ PDS4_CALIBRATION Calibration)
+{
+    DS4_CALIBRATION calibration;
+    LONG            bias;
+    LONG            plus;
+    LONG            minus;
+    LONG            speed2x;
+    ULONG           i;
+
+    if (Length < DS4_FEATURE_REPORT_CALIBRATION_SIZE || Feature[0] != DS4_FEATURE_REPORT_CALIBRATION)
+    {
+        return FALSE;
+    }
+
+    speed2x = DS4_WORD(Feature, 19) + DS4_WORD(Feature, 21);
+
+    for (i = 0; i < 3; i++)
+    {
+        //
+        // Pitch, yaw and roll biases followed by all "plus", then all "minus" values
+        // 
+        bias = DS4_WORD(Feature, 1 + i * 2);
+        plus = DS4_WORD(Feature, 7 + i * 2);
+        minus = DS4_WORD(Feature, 13 + i * 2);
+
+        calibration.Gyroscope[i].Bias = bias;
+        calibration.Gyroscope[i].Numerator = speed2x * DS4_GYRO_RES_PER_DEG_S;
+        calibration.Gyroscope[i].Denominator = (plus > bias ? plus - bias : bias - plus)
+            + (minus > bias ? minus - bias : bias - minus);
+
+        //
+        // Readings at +1g and -1g
+        // 
+        plus = DS4_WORD(Feature, 23 + i * 4);
+        minus = DS4_WORD(Feature, 25 + i * 4);
+
+        calibration.Accelerometer[i].Bias = plus - (plus - minus) / 2;
+        calibration.Accelerometer[i].Numerator = 2 * DS4_ACC_RES_PER_G;
+        calibration.Accelerometer[i].Denominator = plus - minus;
+
+        if (calibration.Gyroscope[i].Denominator == 0 || calibration.Accelerometer[i].Denominator == 0)
+        {
+            return FALSE;
+        }
+    }
+
+    RtlCopyMemory(Calibration, &calibration, sizeof(DS4_CALIBRATION));
+
+    return TRUE;
+}
+
+//
+// Decodes a single DualShock 4 report.
+// 
+BOOLEAN
+DsDecodeDs4Report(
+    _In_reads_bytes_(Length) const UCHAR *Report,
+    _In_ size_t Length,
+    _In_opt_ const DS4_CALIBRATION *Calibration,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State)
+{
+    if (Length < DS4_HID_INPUT_REPORT_SIZE || Report[0] != 0x01)
+    {
+        RtlZeroMemory(State, sizeof(FIRESHOCK_CONTROLLER_STATE));
+        return FALSE;
+    }
+
+    DsDecodeDs4(Report, Calibration, State);
+
+    return TRUE;
+}
+
+VOID
+DsDecodeDs4Batch(
+    _In_ const UCHAR *Reports,
+    _In_ size_t ReportStride,
+    _In_opt_ const DS4_CALIBRATION *Calibration,
+    _Out_ PUCHAR States,
+    _In_ size_t StateStride,
+    _In_ size_t Count)
+{
+    size_t i;
+
+    for (i = 0; i < Count; i++)
+    {
+        DsDecodeDs4(
+            Reports + i * ReportStride,
+            Calibration,
+            (PFIRESHOCK_CONTROLLER_STATE)(States + i * StateStride));
+    }
+}
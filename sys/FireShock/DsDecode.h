@@ -0,0 +1,151 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "Portable.h"
+#include "FireShock.h"
+#include "DualShock.h"
+
+//
+// Report decoding
+// 
+// Turns raw interrupt-in reports into FIRESHOCK_CONTROLLER_STATE. The
+// Navigation controller shares the DualShock 3 report layout and only
+// leaves the buttons and axes it lacks at rest. DualShock 4 buttons map
+// to their DualShock 3 counterparts (Share to Select, Options to Start).
+// 
+
+//
+// DualShock 3 input report offsets (report ID included)
+// 
+#define DS3_REPORT_OFFSET_BUTTONS               0x02
+#define DS3_REPORT_OFFSET_PS_BUTTON             0x04
+#define DS3_REPORT_OFFSET_LEFT_THUMB_X          0x06
+#define DS3_REPORT_OFFSET_LEFT_THUMB_Y          0x07
+#define DS3_REPORT_OFFSET_RIGHT_THUMB_X         0x08
+#define DS3_REPORT_OFFSET_RIGHT_THUMB_Y         0x09
+#define DS3_REPORT_OFFSET_PRESSURE              0x0E
+#define DS3_REPORT_OFFSET_ACCELEROMETER         0x29
+#define DS3_REPORT_OFFSET_GYROSCOPE             0x2F
+
+//
+// Motion sensor readings are unsigned 10 bit, centered here
+// 
+#define DS3_MOTION_CENTER                       0x200
+
+//
+// DualShock 4 input report offsets (USB, report ID included)
+// 
+#define DS4_REPORT_OFFSET_LEFT_THUMB_X          0x01
+#define DS4_REPORT_OFFSET_LEFT_THUMB_Y          0x02
+#define DS4_REPORT_OFFSET_RIGHT_THUMB_X         0x03
+#define DS4_REPORT_OFFSET_RIGHT_THUMB_Y         0x04
+#define DS4_REPORT_OFFSET_BUTTONS               0x05
+#define DS4_REPORT_OFFSET_LEFT_TRIGGER          0x08
+#define DS4_REPORT_OFFSET_RIGHT_TRIGGER         0x09
+#define DS4_REPORT_OFFSET_GYROSCOPE             0x0D
+#define DS4_REPORT_OFFSET_ACCELEROMETER         0x13
+#define DS4_REPORT_OFFSET_TOUCH_POINTS          0x23
+#define DS4_TOUCH_POINT_SIZE                    4
+
+//
+// Calibration feature report (USB layout)
+// 
+#define DS4_FEATURE_REPORT_CALIBRATION          0x02
+#define DS4_FEATURE_REPORT_CALIBRATION_SIZE     0x25
+
+#define DS4_ACC_RES_PER_G                       8192
+#define DS4_GYRO_RES_PER_DEG_S                  1024
+
+typedef struct _DS4_AXIS_CALIBRATION
+{
+    LONG Bias;
+
+    LONG Numerator;
+
+    LONG Denominator;
+
+} DS4_AXIS_CALIBRATION, *PDS4_AXIS_CALIBRATION;
+
+/**
+* \typedef struct _DS4_CALIBRATION
+*
+* \brief   Scales raw motion data to DS4_GYRO_RES_PER_DEG_S and DS4_ACC_RES_PER_G.
+*/
+typedef struct _DS4_CALIBRATION
+{
+    DS4_AXIS_CALIBRATION Gyroscope[3];
+
+    DS4_AXIS_CALIBRATION Accelerometer[3];
+
+} DS4_CALIBRATION, *PDS4_CALIBRATION;
+
+BOOLEAN
+DsDecodeDs3Report(
+    _In_reads_bytes_(Length) const UCHAR *Report,
+    _In_ size_t Length,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State);
+
+//
+// Decodes Count reports spaced ReportStride bytes apart, each at least
+// DS3_HID_INPUT_REPORT_SIZE long, into states spaced StateStride bytes
+// apart. Source and destination must not overlap.
+// 
+VOID
+DsDecodeDs3Batch(
+    _In_ const UCHAR *Reports,
+    _In_ size_t ReportStride,
+    _Out_ PUCHAR States,
+    _In_ size_t StateStride,
+    _In_ size_t Count);
+
+BOOLEAN
+DsDecodeDs4Calibration(
+    _In_reads_bytes_(Length) const UCHAR *Feature,
+    _In_ size_t Length,
+    _Out_ PDS4_CALIBRATION Calibration);
+
+//
+// Calibration is optional, raw motion data is passed on without it.
+// 
+BOOLEAN
+DsDecodeDs4Report(
+    _In_reads_bytes_(Length) const UCHAR *Report,
+    _In_ size_t Length,
+    _In_opt_ const DS4_CALIBRATION *Calibration,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State);
+
+//
+// Same as DsDecodeDs3Batch for reports of at least DS4_HID_INPUT_REPORT_SIZE.
+// 
+VOID
+DsDecodeDs4Batch(
+    _In_ const UCHAR *Reports,
+    _In_ size_t ReportStride,
+    _In_opt_ const DS4_CALIBRATION *Calibration,
+    _Out_ PUCHAR States,
+    _In_ size_t StateStride,
+    _In_ size_t Count);
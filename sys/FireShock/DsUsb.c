@@ -26,158 +26,2113 @@
 #include "Driver.h"
 #include "DsUsb.tmh"
 
+//
+// Records the interval between two performance counter values in microseconds.
+// 
+VOID
+DsUsbCountersRecordInterval(
+    _Inout_ PHISTOGRAM Histogram,
+    _In_ LONGLONG Start,
+    _In_ LONGLONG End
+)
+{
+    LARGE_INTEGER frequency;
+
+    QueryPerformanceFrequency(&frequency);
+
+    HistogramRecord(Histogram, End > Start ? (ULONGLONG)(End - Start) * 1000000 / frequency.QuadPart : 0);
+}
+
+//
+// Accounts for input handed to a client request, safe to call concurrently.
+// 
+VOID
+DsUsbCountersRecordDelivery(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ ULONG Reports,
+    _In_ size_t Bytes
+)
+{
+    InterlockedExchangeAdd64(&Context->Counters.ReportsDelivered, Reports);
+    InterlockedExchangeAdd64(&Context->Counters.BytesDelivered, (LONG64)Bytes);
+}
+
+//
+// Fills a FIRESHOCK_COUNTERS block from the live counters. The fields are
+// read individually, so they may be off by the transfers in flight.
+// 
+VOID
+DsUsbCountersSnapshot(
+    _In_ PDEVICE_CONTEXT Context,
+    _Out_ PFIRESHOCK_COUNTERS Counters
+)
+{
+    PDEVICE_COUNTERS    pCounters = &Context->Counters;
+    FIRESHOCK_HISTOGRAM controlTransferLatency;
+    FIRESHOCK_HISTOGRAM histogram;
+    LARGE_INTEGER       timestamp;
+    LARGE_INTEGER       frequency;
+    LONG64              d0EntryTimestamp;
+    ULONG               index;
+
+    RtlZeroMemory(Counters, sizeof(FIRESHOCK_COUNTERS));
+
+    Counters->Version = FIRESHOCK_COUNTERS_VERSION;
+    Counters->Size = sizeof(FIRESHOCK_COUNTERS);
+
+    Counters->ReportsReceived = ReadNoFence64(&pCounters->ReportsReceived);
+    Counters->ReportsDelivered = ReadNoFence64(&pCounters->ReportsDelivered);
+    Counters->ReportsNoReadPending = ReadNoFence64(&pCounters->ReportsNoReadPending);
+    Counters->BytesReceived = ReadNoFence64(&pCounters->BytesReceived);
+    Counters->BytesDelivered = ReadNoFence64(&pCounters->BytesDelivered);
+    Counters->OutputWrites = ReadNoFence64(&pCounters->OutputWrites);
+
+    HistogramSnapshot(&pCounters->ControlTransferLatency, &controlTransferLatency, FALSE);
+
+    Counters->ControlTransfers = controlTransferLatency.Count;
+    Counters->ControlTransferLatencyMin = controlTransferLatency.Min;
+    Counters->ControlTransferLatencyMax = controlTransferLatency.Max;
+
+    if (controlTransferLatency.Count > 0)
+    {
+        Counters->ControlTransferLatencyAvg = (ULONG)(controlTransferLatency.Total / controlTransferLatency.Count);
+    }
+
+    RtlCopyMemory(Counters->ControlTransferLatency, controlTransferLatency.Buckets, sizeof(Counters->ControlTransferLatency));
+
+    Counters->ControlTransferLatencyP50 = HistogramPercentile(&controlTransferLatency, 50);
+    Counters->ControlTransferLatencyP99 = HistogramPercentile(&controlTransferLatency, 99);
+
+    HistogramSnapshot(&pCounters->InputDelivery, &histogram, FALSE);
+
+    Counters->InputDeliveryP50 = HistogramPercentile(&histogram, 50);
+    Counters->InputDeliveryP99 = HistogramPercentile(&histogram, 99);
+
+    HistogramSnapshot(&pCounters->InputInterArrival, &histogram, FALSE);
+
+    Counters->InputInterArrivalP50 = HistogramPercentile(&histogram, 50);
+    Counters->InputInterArrivalP99 = HistogramPercentile(&histogram, 99);
+
+    Counters->ReadersFailed = ReadNoFence(&pCounters->ReadersFailed);
+    Counters->ReaderRecoveries = ReadNoFence(&pCounters->ReaderRecoveries);
+    Counters->PipeResets = ReadNoFence(&pCounters->PipeResets);
+    Counters->LastTimeToRecover = ReadNoFence(&pCounters->LastTimeToRecover);
+    Counters->MaxTimeToRecover = ReadNoFence(&pCounters->MaxTimeToRecover);
+
+    d0EntryTimestamp = ReadNoFence64(&pCounters->D0EntryTimestamp);
+
+    if (d0EntryTimestamp != 0)
+    {
+        QueryPerformanceCounter(&timestamp);
+        QueryPerformanceFrequency(&frequency);
+
+        Counters->TimeSinceD0Entry = (ULONG)((timestamp.QuadPart - d0EntryTimestamp) * 1000 / frequency.QuadPart);
+    }
+
+    for (index = 0; index < FIRESHOCK_QUEUE_CLASS_COUNT; index++)
+    {
+        HistogramSnapshot(&pCounters->QueueWait[index], &Counters->QueueWait[index], FALSE);
+    }
+
+    //
+    // The output stage keeps its own statistics under OutputLock
+    // 
+    WdfSpinLockAcquire(Context->OutputLock);
+    Counters->OutputSent = Context->OutputStatistics.Sent;
+    Counters->OutputCoalesced = Context->OutputStatistics.Coalesced;
+    WdfSpinLockRelease(Context->OutputLock);
+}
+
+//
+// Creates the requests and buffers control transfers are sent with.
+// 
+NTSTATUS
+DsUsbControlPoolInitialize(
+    _In_ WDFDEVICE Device
+)
+{
+    NTSTATUS                status;
+    PDEVICE_CONTEXT         pDeviceContext;
+    PCONTROL_TRANSFER       pTransfer;
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    ULONG                   index;
+
+    pDeviceContext = DeviceGetContext(Device);
+
+    for (index = 0; index < CONTROL_POOL_DEPTH; index++)
+    {
+        pTransfer = &pDeviceContext->ControlPool[index];
+
+        //
+        // Survives from an earlier EvtDevicePrepareHardware
+        // 
+        if (pTransfer->Request != NULL)
+        {
+            continue;
+        }
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = Device;
+
+        status = WdfRequestCreate(
+            &attributes,
+            WdfUsbTargetDeviceGetIoTarget(pDeviceContext->UsbDevice),
+            &pTransfer->Request);
+
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+                "WdfRequestCreate failed with status %!STATUS!", status);
+            pTransfer->Request = NULL;
+            return status;
+        }
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = pTransfer->Request;
+
+        status = WdfMemoryCreate(
+            &attributes,
+            NonPagedPool,
+            FIRESHOCK_POOL_TAG,
+            CONTROL_TRANSFER_BUFFER_LENGTH,
+            &pTransfer->Memory,
+            (PVOID*)&pTransfer->Buffer);
+
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+                "WdfMemoryCreate failed with status %!STATUS!", status);
+            WdfObjectDelete(pTransfer->Request);
+            pTransfer->Request = NULL;
+            return status;
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+//
+// Takes a free control transfer from the pool and formats it for the given
+// request. Data for the device gets copied in, the caller's buffer isn't
+// referenced afterwards.
+// 
+static NTSTATUS
+DsUsbControlTransferPrepare(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDF_USB_BMREQUEST_DIRECTION Direction,
+    _In_ WDF_USB_BMREQUEST_TYPE Type,
+    _In_ BYTE Request,
+    _In_ USHORT Value,
+    _In_ USHORT Index,
+    _In_ PVOID Buffer,
+    _In_ ULONG BufferLength,
+    _Out_ PCONTROL_TRANSFER *Transfer
+)
+{
+    NTSTATUS                    status;
+    PCONTROL_TRANSFER           pTransfer = NULL;
+    WDF_REQUEST_REUSE_PARAMS    reuseParams;
+    WDFMEMORY_OFFSET            memoryOffset;
+    LARGE_INTEGER               start;
+    ULONG                       index;
+
+    *Transfer = NULL;
+
+    if (Type != BmRequestClass)
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (BufferLength > CONTROL_TRANSFER_BUFFER_LENGTH)
+    {
+        return STATUS_INVALID_BUFFER_SIZE;
+    }
+
+    WdfSpinLockAcquire(Context->ControlPoolLock);
+
+    for (index = 0; index < CONTROL_POOL_DEPTH; index++)
+    {
+        if (Context->ControlPool[index].Request != NULL && !Context->ControlPool[index].InUse)
+        {
+            pTransfer = &Context->ControlPool[index];
+            pTransfer->InUse = TRUE;
+            break;
+        }
+    }
+
+    WdfSpinLockRelease(Context->ControlPoolLock);
+
+    if (pTransfer == NULL)
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, TRACE_DSUSB,
+            "All %d control transfers are in flight", CONTROL_POOL_DEPTH);
+        return STATUS_DEVICE_BUSY;
+    }
+
+    WDF_USB_CONTROL_SETUP_PACKET_INIT_CLASS(&pTransfer->SetupPacket,
+        Direction,
+        BmRequestToInterface,
+        Request,
+        Value,
+        Index);
+
+    pTransfer->DeviceToHost = (Direction == BmRequestDeviceToHost);
+    pTransfer->Length = BufferLength;
+    pTransfer->Completion = NULL;
+    pTransfer->CompletionContext = NULL;
+
+    if (!pTransfer->DeviceToHost)
+    {
+        RtlCopyMemory(pTransfer->Buffer, Buffer, BufferLength);
+    }
+
+    if (!Context->Simulated)
+    {
+        WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+        WdfRequestReuse(pTransfer->Request, &reuseParams);
+
+        memoryOffset.BufferOffset = 0;
+        memoryOffset.BufferLength = BufferLength;
+
+        status = WdfUsbTargetDeviceFormatRequestForControlTransfer(
+            Context->UsbDevice,
+            pTransfer->Request,
+            &pTransfer->SetupPacket,
+            (BufferLength > 0) ? pTransfer->Memory : NULL,
+            (BufferLength > 0) ? &memoryOffset : NULL);
+
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+                "WdfUsbTargetDeviceFormatRequestForControlTransfer failed with status %!STATUS!", status);
+
+            WdfSpinLockAcquire(Context->ControlPoolLock);
+            pTransfer->InUse = FALSE;
+            WdfSpinLockRelease(Context->ControlPoolLock);
+
+            return status;
+        }
+    }
+
+    QueryPerformanceCounter(&start);
+    pTransfer->StartTimestamp = start.QuadPart;
+
+    FireShockEventControlTransferStart(Context, pTransfer->SetupPacket.Generic.Bytes, start.QuadPart);
+
+    *Transfer = pTransfer;
+
+    return STATUS_SUCCESS;
+}
+
+//
+// Answers a control transfer from the simulator instead of the device.
+// 
+static NTSTATUS
+DsUsbControlTransferSimulate(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PCONTROL_TRANSFER Transfer,
+    _Out_ PULONG Transferred
+)
+{
+    BOOLEAN handled;
+
+    WdfSpinLockAcquire(Context->SimulatorLock);
+
+    handled = SimulatorControlTransfer(
+        &Context->Simulator,
+        Transfer->SetupPacket.Generic.Bytes,
+        Transfer->Buffer,
+        Transfer->Length,
+        Transferred);
+
+    WdfSpinLockRelease(Context->SimulatorLock);
+
+    return handled ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+}
+
+//
+// Accounts for a finished control transfer, notifies the asynchronous sender
+// and puts the transfer back into the pool for a waiting output report.
+// 
+static VOID
+DsUsbControlTransferFinish(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PCONTROL_TRANSFER Transfer,
+    _In_ NTSTATUS Status,
+    _In_ ULONG Transferred
+)
+{
+    LARGE_INTEGER end;
+    BOOLEAN       resume;
+
+    QueryPerformanceCounter(&end);
+
+    DsUsbCountersRecordInterval(&Context->Counters.ControlTransferLatency, Transfer->StartTimestamp, end.QuadPart);
+
+    FireShockEventControlTransferStop(
+        Context,
+        Transfer->SetupPacket.Generic.Bytes,
+        Status,
+        Transferred,
+        Transfer->StartTimestamp,
+        end.QuadPart);
+
+    DsUsbCaptureTransfer(
+        Context,
+        FIRESHOCK_CAPTURE_RECORD_CONTROL,
+        end.QuadPart,
+        Status,
+        Transfer->SetupPacket.Generic.Bytes,
+        Transfer->Buffer,
+        Transfer->DeviceToHost ? Transferred : Transfer->Length);
+
+    if (!NT_SUCCESS(Status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+            "Control transfer failed with status %!STATUS! (%d)\n",
+            Status, Transferred);
+    }
+
+    if (Transfer->Completion != NULL)
+    {
+        Transfer->Completion(Status, Transfer->Buffer, Transferred, Transfer->CompletionContext);
+    }
+
+    WdfSpinLockAcquire(Context->ControlPoolLock);
+    Transfer->InUse = FALSE;
+    WdfSpinLockRelease(Context->ControlPoolLock);
+
+    //
+    // A slot is free again, retry an output report that couldn't get one
+    //
+    WdfSpinLockAcquire(Context->OutputLock);
+
+    resume = (Context->OutputPending && !Context->OutputInFlight);
+
+    if (resume)
+    {
+        Context->OutputInFlight = TRUE;
+    }
+
+    WdfSpinLockRelease(Context->OutputLock);
+
+    if (resume)
+    {
+        DsUsbOutputSendPending(Context);
+    }
+}
+
 //
 // Sends a custom buffer to the device's control endpoint.
 // 
 NTSTATUS
-SendControlRequest(
+SendControlRequest(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDF_USB_BMREQUEST_DIRECTION Direction,
+    _In_ WDF_USB_BMREQUEST_TYPE Type,
+    _In_ BYTE Request,
+    _In_ USHORT Value,
+    _In_ USHORT Index,
+    _In_ PVOID Buffer,
+    _In_ ULONG BufferLength)
+{
+    NTSTATUS                        status;
+    PCONTROL_TRANSFER               pTransfer;
+    WDF_REQUEST_SEND_OPTIONS        sendOptions;
+    WDF_REQUEST_COMPLETION_PARAMS   completionParams;
+    ULONG                           bytesTransferred = 0;
+
+    status = DsUsbControlTransferPrepare(
+        Context,
+        Direction,
+        Type,
+        Request,
+        Value,
+        Index,
+        Buffer,
+        BufferLength,
+        &pTransfer);
+
+    if (!NT_SUCCESS(status))
+    {
+        return status;
+    }
+
+    if (Context->Simulated)
+    {
+        status = DsUsbControlTransferSimulate(Context, pTransfer, &bytesTransferred);
+    }
+    else
+    {
+        WDF_REQUEST_SEND_OPTIONS_INIT(
+            &sendOptions,
+            WDF_REQUEST_SEND_OPTION_SYNCHRONOUS | WDF_REQUEST_SEND_OPTION_TIMEOUT
+        );
+
+        WDF_REQUEST_SEND_OPTIONS_SET_TIMEOUT(
+            &sendOptions,
+            DEFAULT_CONTROL_TRANSFER_TIMEOUT
+        );
+
+        WdfRequestSend(
+            pTransfer->Request,
+            WdfUsbTargetDeviceGetIoTarget(Context->UsbDevice),
+            &sendOptions);
+
+        status = WdfRequestGetStatus(pTransfer->Request);
+
+        if (NT_SUCCESS(status))
+        {
+            WDF_REQUEST_COMPLETION_PARAMS_INIT(&completionParams);
+            WdfRequestGetCompletionParams(pTransfer->Request, &completionParams);
+
+            bytesTransferred = (ULONG)completionParams.Parameters.Usb.Completion->Parameters.DeviceControlTransfer.Length;
+        }
+    }
+
+    if (NT_SUCCESS(status) && pTransfer->DeviceToHost)
+    {
+        RtlCopyMemory(Buffer, pTransfer->Buffer, min(bytesTransferred, BufferLength));
+    }
+
+    DsUsbControlTransferFinish(Context, pTransfer, status, bytesTransferred);
+
+    return status;
+}
+
+//
+// Sends a custom buffer to the device's control endpoint without waiting
+// for it. Completion is called once the transfer finished, possibly before
+// this returns, unless sending fails right away. Fails with STATUS_DEVICE_BUSY
+// while CONTROL_POOL_DEPTH transfers are in flight.
+// 
+NTSTATUS
+SendControlRequestAsync(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDF_USB_BMREQUEST_DIRECTION Direction,
+    _In_ WDF_USB_BMREQUEST_TYPE Type,
+    _In_ BYTE Request,
+    _In_ USHORT Value,
+    _In_ USHORT Index,
+    _In_ PVOID Buffer,
+    _In_ ULONG BufferLength,
+    _In_ PFN_DSUSB_CONTROL_TRANSFER_COMPLETE Completion,
+    _In_opt_ WDFCONTEXT CompletionContext)
+{
+    NTSTATUS                    status;
+    PCONTROL_TRANSFER           pTransfer;
+    WDF_REQUEST_SEND_OPTIONS    sendOptions;
+    ULONG                       bytesTransferred = 0;
+
+    status = DsUsbControlTransferPrepare(
+        Context,
+        Direction,
+        Type,
+        Request,
+        Value,
+        Index,
+        Buffer,
+        BufferLength,
+        &pTransfer);
+
+    if (!NT_SUCCESS(status))
+    {
+        return status;
+    }
+
+    pTransfer->Completion = Completion;
+    pTransfer->CompletionContext = CompletionContext;
+
+    if (Context->Simulated)
+    {
+        status = DsUsbControlTransferSimulate(Context, pTransfer, &bytesTransferred);
+
+        DsUsbControlTransferFinish(Context, pTransfer, status, bytesTransferred);
+
+        return STATUS_SUCCESS;
+    }
+
+    WdfRequestSetCompletionRoutine(
+        pTransfer->Request,
+        DsUsbEvtControlTransferComplete,
+        pTransfer);
+
+    WDF_REQUEST_SEND_OPTIONS_INIT(&sendOptions, WDF_REQUEST_SEND_OPTION_TIMEOUT);
+    WDF_REQUEST_SEND_OPTIONS_SET_TIMEOUT(&sendOptions, DEFAULT_CONTROL_TRANSFER_TIMEOUT);
+
+    WdfSpinLockAcquire(Context->ControlPoolLock);
+    pTransfer->Sent = TRUE;
+    WdfSpinLockRelease(Context->ControlPoolLock);
+
+    if (WdfRequestSend(
+        pTransfer->Request,
+        WdfUsbTargetDeviceGetIoTarget(Context->UsbDevice),
+        &sendOptions))
+    {
+        return STATUS_SUCCESS;
+    }
+
+    status = WdfRequestGetStatus(pTransfer->Request);
+
+    TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+        "WdfRequestSend failed with status %!STATUS!", status);
+
+    WdfSpinLockAcquire(Context->ControlPoolLock);
+    pTransfer->Sent = FALSE;
+    pTransfer->InUse = FALSE;
+    WdfSpinLockRelease(Context->ControlPoolLock);
+
+    return status;
+}
+
+VOID
+DsUsbEvtControlTransferComplete(
+    _In_ WDFREQUEST Request,
+    _In_ WDFIOTARGET Target,
+    _In_ PWDF_REQUEST_COMPLETION_PARAMS Params,
+    _In_ WDFCONTEXT Context
+)
+{
+    PCONTROL_TRANSFER   pTransfer = (PCONTROL_TRANSFER)Context;
+    PDEVICE_CONTEXT     pDeviceContext = DeviceGetContext(WdfIoTargetGetDevice(Target));
+    NTSTATUS            status;
+    ULONG               bytesTransferred = 0;
+
+    UNREFERENCED_PARAMETER(Request);
+
+    //
+    // From here on the request may be reused, keep the pool from
+    // cancelling it
+    //
+    WdfSpinLockAcquire(pDeviceContext->ControlPoolLock);
+    pTransfer->Sent = FALSE;
+    WdfSpinLockRelease(pDeviceContext->ControlPoolLock);
+
+    status = Params->IoStatus.Status;
+
+    if (NT_SUCCESS(status))
+    {
+        bytesTransferred = (ULONG)Params->Parameters.Usb.Completion->Parameters.DeviceControlTransfer.Length;
+    }
+
+    DsUsbControlTransferFinish(
+        pDeviceContext,
+        pTransfer,
+        status,
+        bytesTransferred);
+}
+
+//
+// Aborts the asynchronous control transfers in flight.
+// 
+VOID
+DsUsbControlPoolCancel(
+    _In_ PDEVICE_CONTEXT Context
+)
+{
+    PCONTROL_TRANSFER   pTransfer;
+    ULONG               index;
+
+    for (index = 0; index < CONTROL_POOL_DEPTH; index++)
+    {
+        pTransfer = &Context->ControlPool[index];
+
+        //
+        // Cancelled under the lock, so the request can't complete and get
+        // sent again for another transfer in between
+        //
+        WdfSpinLockAcquire(Context->ControlPoolLock);
+
+        if (pTransfer->Sent)
+        {
+            WdfRequestCancelSentRequest(pTransfer->Request);
+        }
+
+        WdfSpinLockRelease(Context->ControlPoolLock);
+    }
+}
+
+//
+// Reads the output stage settings.
+// 
+NTSTATUS
+DsUsbOutputInitialize(
+    _In_ WDFDEVICE Device
+)
+{
+    PDEVICE_CONTEXT         pDeviceContext;
+    LARGE_INTEGER           frequency;
+
+    DECLARE_CONST_UNICODE_STRING(refreshIntervalValueName, L"OutputRefreshInterval");
+
+    pDeviceContext = DeviceGetContext(Device);
+
+    //
+    // Milliseconds in the registry
+    // 
+    QueryPerformanceFrequency(&frequency);
+    pDeviceContext->OutputRefreshInterval =
+        FireShockQueryDeviceSetting(Device, &refreshIntervalValueName, 0) * frequency.QuadPart / 1000;
+
+    return STATUS_SUCCESS;
+}
+
+//
+// Hands the pending output report to the device. It stays pending until the
+// transfer completes, so a report that couldn't be sent isn't lost.
+// Must be called by whoever set OutputInFlight.
+// 
+VOID
+DsUsbOutputSendPending(
+    _In_ PDEVICE_CONTEXT Context
+)
+{
+    NTSTATUS        status;
+    UCHAR           report[DS3_HID_OUTPUT_REPORT_SIZE];
+
+    WdfSpinLockAcquire(Context->OutputLock);
+
+    RtlCopyMemory(report, Context->OutputPendingReport, DS3_HID_OUTPUT_REPORT_SIZE);
+    Context->OutputPendingInFlight = TRUE;
+
+    WdfSpinLockRelease(Context->OutputLock);
+
+    status = SendControlRequestAsync(
+        Context,
+        BmRequestHostToDevice,
+        BmRequestClass,
+        SetReport,
+        USB_SETUP_VALUE(HidReportRequestTypeOutput, HidReportRequestIdOne),
+        0,
+        report,
+        DS3_HID_OUTPUT_REPORT_SIZE,
+        DsUsbEvtOutputTransferComplete,
+        Context);
+
+    if (NT_SUCCESS(status))
+    {
+        return;
+    }
+
+    TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+        "Sending output report failed with status %!STATUS!", status);
+
+    //
+    // Keep the report pending, it's retried once a control transfer
+    // completes or the next report gets submitted
+    // 
+    WdfSpinLockAcquire(Context->OutputLock);
+    Context->OutputInFlight = FALSE;
+    Context->OutputPendingInFlight = FALSE;
+    Context->OutputStatistics.Failed++;
+    WdfSpinLockRelease(Context->OutputLock);
+}
+
+//
+// Queues an output report for asynchronous delivery. At most one transfer
+// is in flight, a report submitted meanwhile replaces any older pending one.
+// 
+VOID
+DsUsbOutputSubmit(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PVOID Report,
+    _In_ size_t Length
+)
+{
+    BOOLEAN         start = FALSE;
+    LARGE_INTEGER   timestamp;
+    PUCHAR          current;
+
+    Length = min(Length, DS3_HID_OUTPUT_REPORT_SIZE);
+
+    QueryPerformanceCounter(&timestamp);
+
+    WdfSpinLockAcquire(Context->OutputLock);
+
+    Context->OutputStatistics.Submitted++;
+
+    //
+    // Compare against what the device will end up with anyway
+    // 
+    current = Context->OutputPending ? Context->OutputPendingReport
+        : (Context->OutputLastSentValid ? Context->OutputLastSent : NULL);
+
+    if (current != NULL
+        && RtlCompareMemory(current, Report, Length) == Length
+        && (Context->OutputPending
+            || Context->OutputRefreshInterval == 0
+            || timestamp.QuadPart - Context->OutputLastSentTime < Context->OutputRefreshInterval))
+    {
+        Context->OutputStatistics.Absorbed++;
+        WdfSpinLockRelease(Context->OutputLock);
+        return;
+    }
+
+    if (Context->OutputPending && !Context->OutputPendingInFlight)
+    {
+        Context->OutputStatistics.Coalesced++;
+    }
+
+    RtlCopyMemory(Context->OutputPendingReport, Report, Length);
+    Context->OutputPending = TRUE;
+    Context->OutputPendingInFlight = FALSE;
+
+    if (!Context->OutputInFlight)
+    {
+        Context->OutputInFlight = TRUE;
+        start = TRUE;
+    }
+
+    WdfSpinLockRelease(Context->OutputLock);
+
+    if (start)
+    {
+        DsUsbOutputSendPending(Context);
+    }
+}
+
+//
+// Discards the pending output report and aborts the one in flight.
+// 
+VOID
+DsUsbOutputCancel(
+    _In_ PDEVICE_CONTEXT Context
+)
+{
+    WdfSpinLockAcquire(Context->OutputLock);
+    Context->OutputPending = FALSE;
+    Context->OutputPendingInFlight = FALSE;
+    Context->OutputLastSentValid = FALSE;
+    WdfSpinLockRelease(Context->OutputLock);
+
+    DsUsbControlPoolCancel(Context);
+}
+
+VOID
+DsUsbEvtOutputTransferComplete(
+    _In_ NTSTATUS Status,
+    _In_ PVOID Buffer,
+    _In_ ULONG Transferred,
+    _In_opt_ WDFCONTEXT Context
+)
+{
+    PDEVICE_CONTEXT pDeviceContext = (PDEVICE_CONTEXT)Context;
+    BOOLEAN         next;
+    LARGE_INTEGER   timestamp;
+
+    UNREFERENCED_PARAMETER(Transferred);
+
+    QueryPerformanceCounter(&timestamp);
+
+    WdfSpinLockAcquire(pDeviceContext->OutputLock);
+
+    pDeviceContext->OutputStatistics.Sent++;
+
+    if (NT_SUCCESS(Status))
+    {
+        RtlCopyMemory(pDeviceContext->OutputLastSent, Buffer, DS3_HID_OUTPUT_REPORT_SIZE);
+        pDeviceContext->OutputLastSentValid = TRUE;
+        pDeviceContext->OutputLastSentTime = timestamp.QuadPart;
+    }
+    else
+    {
+        //
+        // The device may or may not have picked it up, don't absorb a retry
+        // 
+        pDeviceContext->OutputLastSentValid = FALSE;
+        pDeviceContext->OutputStatistics.Failed++;
+    }
+
+    //
+    // Unless a newer report replaced it meanwhile
+    // 
+    if (pDeviceContext->OutputPendingInFlight)
+    {
+        pDeviceContext->OutputPending = FALSE;
+        pDeviceContext->OutputPendingInFlight = FALSE;
+    }
+
+    next = pDeviceContext->OutputPending;
+
+    if (!next)
+    {
+        pDeviceContext->OutputInFlight = FALSE;
+    }
+
+    WdfSpinLockRelease(pDeviceContext->OutputLock);
+
+    if (!NT_SUCCESS(Status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+            "Output report transfer failed with status %!STATUS!", Status);
+    }
+
+    if (next)
+    {
+        DsUsbOutputSendPending(pDeviceContext);
+    }
+}
+
+NTSTATUS
+DsUsbConfigContReaderForInterruptEndPoint(
+    _In_ WDFDEVICE Device
+)
+{
+    WDF_USB_CONTINUOUS_READER_CONFIG contReaderConfig;
+    NTSTATUS status;
+    PDEVICE_CONTEXT pDeviceContext;
+    ULONG numPendingReads;
+    ULONG transferLength;
+
+    DECLARE_CONST_UNICODE_STRING(pendingReadsValueName, L"InterruptInPendingReads");
+    DECLARE_CONST_UNICODE_STRING(transferLengthValueName, L"InterruptInTransferLength");
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DSUSB, "%!FUNC! Entry");
+
+    pDeviceContext = DeviceGetContext(Device);
+
+    //
+    // Size transfers to the actual report of each device type
+    // 
+    switch (pDeviceContext->DeviceType)
+    {
+    case DualShock3:
+        numPendingReads = DS3_DEFAULT_PENDING_READS;
+        transferLength = DS3_HID_INPUT_REPORT_SIZE;
+        break;
+    case DualShock4:
+        numPendingReads = DS4_DEFAULT_PENDING_READS;
+        transferLength = DS4_HID_INPUT_REPORT_SIZE;
+        break;
+    default:
+        numPendingReads = INTERRUPT_IN_DEFAULT_PENDING_READS;
+        transferLength = INTERRUPT_IN_BUFFER_LENGTH;
+        break;
+    }
+
+    //
+    // Values in the device's hardware key take precedence
+    // 
+    numPendingReads = FireShockQueryDeviceSetting(Device, &pendingReadsValueName, numPendingReads);
+    transferLength = FireShockQueryDeviceSetting(Device, &transferLengthValueName, transferLength);
+
+    if (numPendingReads < 1 || numPendingReads > INTERRUPT_IN_MAX_PENDING_READS)
+    {
+        numPendingReads = INTERRUPT_IN_DEFAULT_PENDING_READS;
+    }
+
+    if (transferLength < 1 || transferLength > INTERRUPT_IN_BUFFER_LENGTH)
+    {
+        transferLength = INTERRUPT_IN_BUFFER_LENGTH;
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DSUSB,
+        "Continuous reader uses %d pending reads of %d bytes",
+        numPendingReads, transferLength);
+
+    WDF_USB_CONTINUOUS_READER_CONFIG_INIT(&contReaderConfig,
+        DsUsbEvtUsbInterruptPipeReadComplete,
+        Device,    // Context
+        transferLength);   // TransferLength
+
+    contReaderConfig.EvtUsbTargetPipeReadersFailed = DsUsbEvtUsbInterruptReadersFailed;
+    contReaderConfig.NumPendingReads = (UCHAR)numPendingReads;
+
+    //
+    // Reader requests are not posted to the target automatically.
+    // Driver must explicitly call WdfIoTargetStart to kick start the
+    // reader.  In this sample, it's done in D0Entry.
+    //
+    status = WdfUsbTargetPipeConfigContinuousReader(pDeviceContext->InterruptReadPipe,
+        &contReaderConfig);
+
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+            "WdfUsbTargetPipeConfigContinuousReader failed %x\n",
+            status);
+        return status;
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DSUSB, "%!FUNC! Exit");
+
+    return status;
+}
+
+//
+// Hands a report received from the device to the ring, a pending read or
+// the backlog. Length must not exceed FIRESHOCK_INPUT_REPORT_LENGTH.
+// 
+VOID
+DsUsbInputReportReceived(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PVOID Report,
+    _In_ size_t Length,
+    _In_ LONGLONG Timestamp
+)
+{
+    NTSTATUS            status;
+    WDFREQUEST          request;
+    WDFREQUEST          waitRequest = NULL;
+    LARGE_INTEGER       frequency;
+    ULONG               sequence;
+    LONGLONG            timeToRecover;
+    BOOLEAN             recovered;
+    PINPUT_REPORT       pEntry;
+    ULONG               delivered = 0;
+    INPUT_REPORT        report;
+    BOOLEAN             batch;
+    NTSTATUS            batchStatus = STATUS_SUCCESS;
+    size_t              transferred = 0;
+
+    InterlockedIncrement64(&Context->Counters.ReportsReceived);
+    InterlockedExchangeAdd64(&Context->Counters.BytesReceived, (LONG64)Length);
+
+    DsUsbCaptureTransfer(
+        Context,
+        FIRESHOCK_CAPTURE_RECORD_INTERRUPT_IN,
+        Timestamp,
+        STATUS_SUCCESS,
+        NULL,
+        Report,
+        (ULONG)Length);
+
+    WdfSpinLockAcquire(Context->InputLock);
+
+    recovered = RecoveryPolicyOnSuccess(&Context->ReaderRecovery, Timestamp, &timeToRecover);
+
+    if (recovered)
+    {
+        QueryPerformanceFrequency(&frequency);
+
+        timeToRecover = timeToRecover * 1000 / frequency.QuadPart;
+
+        InterlockedIncrement(&Context->Counters.ReaderRecoveries);
+        InterlockedExchange(&Context->Counters.LastTimeToRecover, (LONG)timeToRecover);
+
+        if (timeToRecover > Context->Counters.MaxTimeToRecover)
+        {
+            InterlockedExchange(&Context->Counters.MaxTimeToRecover, (LONG)timeToRecover);
+        }
+
+        Context->ReaderReinitPending = TRUE;
+    }
+
+    if (Context->InputLatest != NULL)
+    {
+        DsUsbCountersRecordInterval(
+            &Context->Counters.InputInterArrival,
+            Context->InputLatest->Timestamp,
+            Timestamp);
+    }
+
+    if (Context->TimeToFirstReport == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+
+        Context->TimeToFirstReport = (ULONG)max(1,
+            (Timestamp - Context->PrepareHardwareTimestamp) * 1000 / frequency.QuadPart);
+    }
+
+    sequence = ++Context->InputSequence;
+
+    //
+    // The only copy, all handles read it from here
+    // 
+    pEntry = &Context->InputHistory[sequence % INPUT_HISTORY_DEPTH];
+
+    pEntry->Timestamp = Timestamp;
+    pEntry->Sequence = sequence;
+    pEntry->Length = (ULONG)Length;
+    RtlCopyMemory(pEntry->Buffer, Report, Length);
+
+    Context->InputLatest = pEntry;
+
+    if (InputRingIsAttached(&Context->InputRing))
+    {
+        InputRingPush(
+            &Context->InputRing,
+            Timestamp,
+            sequence,
+            Report,
+            Length);
+
+        if (!NT_SUCCESS(WdfIoQueueRetrieveNextRequest(Context->InputRingWaitQueue, &waitRequest)))
+        {
+            waitRequest = NULL;
+        }
+    }
+
+    WdfSpinLockRelease(Context->InputLock);
+
+    FireShockEventReportReceived(Context, sequence, (ULONG)Length, Timestamp);
+
+    if (recovered)
+    {
+        TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DSUSB,
+            "Input recovered after %d ms", (LONG)timeToRecover);
+
+        WdfWorkItemEnqueue(Context->ReaderRecoveryWorkItem);
+    }
+
+    if (waitRequest != NULL)
+    {
+        FireShockEventRequestCompleted(Context, waitRequest, STATUS_SUCCESS, 0, Timestamp);
+        WdfRequestComplete(waitRequest, STATUS_SUCCESS);
+    }
+
+    //
+    // Fan out to every handle with a read pending, the others pick the
+    // report up from the history once they read again
+    // 
+    for (;;)
+    {
+        WdfSpinLockAcquire(Context->InputLock);
+
+        status = DsUsbRetrieveInputRequest(Context, &request, &report, &batch);
+
+        if (NT_SUCCESS(status) && batch)
+        {
+            batchStatus = DsUsbInputBatchFill(Context, request, &transferred);
+        }
+
+        WdfSpinLockRelease(Context->InputLock);
+
+        if (!NT_SUCCESS(status))
+        {
+            break;
+        }
+
+        if (batch)
+        {
+            FireShockEventRequestCompleted(Context, request, batchStatus, transferred, Timestamp);
+            WdfRequestCompleteWithInformation(request, batchStatus, transferred);
+        }
+        else
+        {
+            DsUsbCompleteInputRequest(request, report.Timestamp, report.Sequence, report.Buffer, report.Length);
+        }
+
+        delivered++;
+    }
+
+    if (delivered == 0)
+    {
+        InterlockedIncrement64(&Context->Counters.ReportsNoReadPending);
+    }
+
+    FireShockAggregateReport(Context, Timestamp, sequence, Report, Length);
+}
+
+VOID
+DsUsbEvtUsbInterruptPipeReadComplete(
+    WDFUSBPIPE  Pipe,
+    WDFMEMORY   Buffer,
+    size_t      NumBytesTransferred,
+    WDFCONTEXT  Context
+)
+{
+    PDEVICE_CONTEXT     pDeviceContext;
+    size_t              rdrBufferLength;
+    LPVOID              rdrBuffer;
+    LARGE_INTEGER       timestamp;
+
+    UNREFERENCED_PARAMETER(Pipe);
+
+    QueryPerformanceCounter(&timestamp);
+
+    pDeviceContext = DeviceGetContext(Context);
+
+    //
+    // The simulated controller stands in for this one
+    // 
+    if (pDeviceContext->Simulated)
+    {
+        return;
+    }
+
+    rdrBuffer = WdfMemoryGetBuffer(Buffer, &rdrBufferLength);
+
+    //
+    // Only what the device actually sent gets passed on
+    // 
+    DsUsbInputReportReceived(
+        pDeviceContext,
+        rdrBuffer,
+        min(NumBytesTransferred, min(rdrBufferLength, FIRESHOCK_INPUT_REPORT_LENGTH)),
+        timestamp.QuadPart);
+}
+
+//
+// Returns the motion calibration to apply to DualShock 4 reports, if any.
+// Must be called with InputLock held.
+// 
+const DS4_CALIBRATION *
+DsUsbGetDs4Calibration(
+    _In_ PDEVICE_CONTEXT Context
+)
+{
+    PDS4_DEVICE_CONTEXT pDs4Context = Ds4GetContext(WdfObjectContextGetObject(Context));
+
+    return pDs4Context->CalibrationValid ? &pDs4Context->Calibration : NULL;
+}
+
+//
+// Decodes a report of whatever device type this is.
+// 
+BOOLEAN
+DsUsbDecodeReport(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PVOID Report,
+    _In_ size_t Length,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State
+)
+{
+    switch (Context->DeviceType)
+    {
+    case DualShock3:
+        return DsDecodeDs3Report(Report, Length, State);
+    case DualShock4:
+        return DsDecodeDs4Report(Report, Length, DsUsbGetDs4Calibration(Context), State);
+    default:
+        RtlZeroMemory(State, sizeof(FIRESHOCK_CONTROLLER_STATE));
+        return FALSE;
+    }
+}
+
+//
+// Decides if a report is of interest to the handle. State receives the
+// decoded report if the handle filters on changes.
+// Must be called with InputLock held.
+// 
+BOOLEAN
+DsUsbInputFilterAccepts(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PFILE_CONTEXT FileContext,
+    _In_ PINPUT_REPORT Report,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State
+)
+{
+    if (!FileContext->ChangeFilter.Enabled)
+    {
+        return TRUE;
+    }
+
+    DsUsbDecodeReport(Context, Report->Buffer, Report->Length, State);
+
+    return ChangeFilterTest(&FileContext->ChangeFilter, State, Report->Timestamp);
+}
+
+//
+// Moves the handle past reports no longer in the history, counting those
+// overwritten as dropped. Must be called with InputLock held.
+// 
+VOID
+DsUsbInputHistorySkip(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PFILE_CONTEXT FileContext
+)
+{
+    ULONG pending = Context->InputSequence - FileContext->LastSequence;
+    ULONG received = Context->InputSequence - Context->InputHistoryStart;
+    ULONG available = min(received, INPUT_HISTORY_DEPTH);
+
+    if (pending > available)
+    {
+        FileContext->Dropped += min(pending, received) - available;
+        FileContext->LastSequence = Context->InputSequence - available;
+    }
+}
+
+//
+// Copies the next report the handle hasn't been through yet and is
+// interested in, in the order of its read mode. State receives the decoded
+// report if the handle filters on changes.
+// Must be called with InputLock held.
+// 
+BOOLEAN
+DsUsbInputHistoryNext(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PFILE_CONTEXT FileContext,
+    _Out_ PINPUT_REPORT Report,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State
+)
+{
+    PINPUT_REPORT pEntry;
+
+    if (FileContext->ReadMode == FireShockReadModeLatest)
+    {
+        //
+        // Hand out the current state unless this handle has already seen it
+        // 
+        pEntry = Context->InputLatest;
+
+        if (pEntry == NULL || pEntry->Sequence == FileContext->LastSequence)
+        {
+            return FALSE;
+        }
+
+        FileContext->LastSequence = pEntry->Sequence;
+
+        if (!DsUsbInputFilterAccepts(Context, FileContext, pEntry, State))
+        {
+            return FALSE;
+        }
+
+        RtlCopyMemory(Report, pEntry, sizeof(INPUT_REPORT));
+        return TRUE;
+    }
+
+    DsUsbInputHistorySkip(Context, FileContext);
+
+    //
+    // Skip reports the handle isn't interested in
+    // 
+    while (FileContext->LastSequence != Context->InputSequence)
+    {
+        pEntry = &Context->InputHistory[++FileContext->LastSequence % INPUT_HISTORY_DEPTH];
+
+        if (DsUsbInputFilterAccepts(Context, FileContext, pEntry, State))
+        {
+            RtlCopyMemory(Report, pEntry, sizeof(INPUT_REPORT));
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+//
+// Takes the oldest pending read whose handle has a report to go. Batch
+// reads are flagged and left for the caller to drain with the handle's
+// position untouched, Report only receives the report for plain reads.
+// Must be called with InputLock held.
+// 
+NTSTATUS
+DsUsbRetrieveInputRequest(
+    _In_ PDEVICE_CONTEXT Context,
+    _Out_ WDFREQUEST *Request,
+    _Out_ PINPUT_REPORT Report,
+    _Out_ PBOOLEAN Batch
+)
+{
+    NTSTATUS                    status;
+    WDFREQUEST                  previous = NULL;
+    WDFREQUEST                  found;
+    PFILE_CONTEXT               pFileContext;
+    FIRESHOCK_CONTROLLER_STATE  state;
+    ULONG                       lastSequence;
+    ULONG                       dropped;
+    WDF_REQUEST_PARAMETERS      params;
+
+    *Batch = FALSE;
+
+    for (;;)
+    {
+        WDF_REQUEST_PARAMETERS_INIT(&params);
+
+        status = WdfIoQueueFindRequest(Context->IoReadQueue, previous, NULL, &params, &found);
+
+        if (previous != NULL)
+        {
+            WdfObjectDereference(previous);
+        }
+
+        if (!NT_SUCCESS(status))
+        {
+            //
+            // STATUS_NOT_FOUND means previous left the queue meanwhile, start over
+            // 
+            if (status == STATUS_NOT_FOUND && previous != NULL)
+            {
+                previous = NULL;
+                continue;
+            }
+
+            return status;
+        }
+
+        pFileContext = FileGetContext(WdfRequestGetFileObject(found));
+
+        lastSequence = pFileContext->LastSequence;
+        dropped = pFileContext->Dropped;
+
+        if (DsUsbInputHistoryNext(Context, pFileContext, Report, &state))
+        {
+            status = WdfIoQueueRetrieveFoundRequest(Context->IoReadQueue, found, Request);
+
+            WdfObjectDereference(found);
+
+            if (NT_SUCCESS(status))
+            {
+                if (params.Type == WdfRequestTypeDeviceControl)
+                {
+                    //
+                    // Drained from the first report the handle hasn't seen
+                    // 
+                    pFileContext->LastSequence = lastSequence;
+                    pFileContext->Dropped = dropped;
+
+                    *Batch = TRUE;
+                    return status;
+                }
+
+                ChangeFilterUpdate(&pFileContext->ChangeFilter, &state, Report->Timestamp);
+
+                return status;
+            }
+
+            //
+            // Request got cancelled meanwhile, the handle hasn't seen the report
+            // 
+            pFileContext->LastSequence = lastSequence;
+            pFileContext->Dropped = dropped;
+
+            previous = NULL;
+            continue;
+        }
+
+        previous = found;
+    }
+}
+
+//
+// Completes a read request with a single input report.
+// 
+VOID
+DsUsbCompleteInputRequest(
+    _In_ WDFREQUEST Request,
+    _In_ LONGLONG Timestamp,
+    _In_ ULONG Sequence,
+    _In_ PVOID Report,
+    _In_ size_t Length
+)
+{
+    NTSTATUS                    status;
+    size_t                      reqBufferLength;
+    PUCHAR                      reqBuffer;
+    PFIRESHOCK_REPORT_ENVELOPE  pEnvelope;
+    size_t                      headerLength = 0;
+    PFILE_CONTEXT               pFileContext;
+    PDEVICE_CONTEXT             pDeviceContext;
+    FIRESHOCK_CONTROLLER_STATE  state;
+    LARGE_INTEGER               now;
+
+    pFileContext = FileGetContext(WdfRequestGetFileObject(Request));
+    pDeviceContext = DeviceGetContext(WdfIoQueueGetDevice(WdfRequestGetIoQueue(Request)));
+
+    //
+    // Substitute the decoded state for the raw report
+    // 
+    if (pFileContext->ReportFormat & FIRESHOCK_REPORT_FORMAT_NORMALIZED)
+    {
+        //
+        // The calibration may get replaced concurrently
+        // 
+        WdfSpinLockAcquire(pDeviceContext->InputLock);
+
+        DsUsbDecodeReport(
+            pDeviceContext,
+            Report,
+            Length,
+            &state);
+
+        WdfSpinLockRelease(pDeviceContext->InputLock);
+
+        Report = &state;
+        Length = sizeof(FIRESHOCK_CONTROLLER_STATE);
+    }
+
+    if (pFileContext->ReportFormat & FIRESHOCK_REPORT_FORMAT_ENVELOPE)
+    {
+        headerLength = sizeof(FIRESHOCK_REPORT_ENVELOPE);
+    }
+
+    status = WdfRequestRetrieveOutputBuffer(Request,
+        headerLength + Length, (LPVOID)&reqBuffer, &reqBufferLength);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!", status);
+        WdfRequestComplete(Request, status);
+        return;
+    }
+
+    if (headerLength > 0)
+    {
+        pEnvelope = (PFIRESHOCK_REPORT_ENVELOPE)reqBuffer;
+
+        pEnvelope->Timestamp = Timestamp;
+        pEnvelope->Sequence = Sequence;
+        pEnvelope->Length = (ULONG)Length;
+    }
+
+    RtlCopyMemory(reqBuffer + headerLength, Report, Length);
+
+    QueryPerformanceCounter(&now);
+    DsUsbCountersRecordInterval(&pDeviceContext->Counters.InputDelivery, Timestamp, now.QuadPart);
+    DsUsbCountersRecordDelivery(pDeviceContext, 1, headerLength + Length);
+
+    FireShockEventRequestCompleted(pDeviceContext, Request, status, headerLength + Length, Timestamp);
+
+    WdfRequestCompleteWithInformation(Request, status, headerLength + Length);
+}
+
+//
+// Applies the checks DsUsbDecodeReport makes before decoding a report.
+// 
+static BOOLEAN
+DsUsbInputReportDecodable(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PINPUT_REPORT Report
+)
+{
+    switch (Context->DeviceType)
+    {
+    case DualShock3:
+        return Report->Length >= DS3_HID_INPUT_REPORT_SIZE && Report->Buffer[0] == 0x01;
+    case DualShock4:
+        return Report->Length >= DS4_HID_INPUT_REPORT_SIZE && Report->Buffer[0] == 0x01;
+    default:
+        return FALSE;
+    }
+}
+
+//
+// Stores a report in a batch entry, decoded if asked to. State already
+// holds the decoded report if the handle filters on changes.
+// 
+static VOID
+DsUsbInputBatchStore(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PFILE_CONTEXT FileContext,
+    _In_ PINPUT_REPORT Report,
+    _Inout_ PFIRESHOCK_CONTROLLER_STATE State,
+    _In_ BOOLEAN Normalize,
+    _Out_ PFIRESHOCK_INPUT_BATCH_ENTRY Entry
+)
+{
+    Entry->Envelope.Timestamp = Report->Timestamp;
+    Entry->Envelope.Sequence = Report->Sequence;
+
+    if (Normalize)
+    {
+        if (!FileContext->ChangeFilter.Enabled)
+        {
+            DsUsbDecodeReport(Context, Report->Buffer, Report->Length, State);
+        }
+
+        Entry->Envelope.Length = sizeof(FIRESHOCK_CONTROLLER_STATE);
+        RtlCopyMemory(Entry->Report, State, sizeof(FIRESHOCK_CONTROLLER_STATE));
+        RtlZeroMemory(&Entry->Report[sizeof(FIRESHOCK_CONTROLLER_STATE)],
+            FIRESHOCK_INPUT_REPORT_LENGTH - sizeof(FIRESHOCK_CONTROLLER_STATE));
+        return;
+    }
+
+    Entry->Envelope.Length = Report->Length;
+    RtlCopyMemory(Entry->Report, Report->Buffer, Report->Length);
+    RtlZeroMemory(&Entry->Report[Report->Length], FIRESHOCK_INPUT_REPORT_LENGTH - Report->Length);
+}
+
+//
+// Moves up to MaxEntries reports the handle hasn't been through yet into a
+// batch, in the order of its read mode and skipping those its change
+// filter rejects. Returns 0 if there was nothing to deliver, reports lost
+// meanwhile are then accounted for with the next batch.
+// Must be called with InputLock held.
+// 
+ULONG
+DsUsbInputHistoryDrain(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PFILE_CONTEXT FileContext,
+    _Out_ PFIRESHOCK_INPUT_BATCH Batch,
+    _In_ ULONG MaxEntries,
+    _In_ BOOLEAN Normalize
+)
+{
+    PINPUT_REPORT               pEntry;
+    ULONG                       count = 0;
+    ULONG                       head;
+    ULONG                       run;
+    ULONG                       index;
+    ULONG                       rejected;
+    INPUT_REPORT                report;
+    FIRESHOCK_CONTROLLER_STATE  state;
+
+    if (FileContext->ReadMode == FireShockReadModeLatest || FileContext->ChangeFilter.Enabled)
+    {
+        //
+        // Reports get picked one by one, like plain reads do
+        // 
+        while (count < MaxEntries && DsUsbInputHistoryNext(Context, FileContext, &report, &state))
+        {
+            ChangeFilterUpdate(&FileContext->ChangeFilter, &state, report.Timestamp);
+
+            DsUsbInputBatchStore(Context, FileContext, &report, &state, Normalize, &Batch->Entries[count++]);
+        }
+    }
+    else
+    {
+        DsUsbInputHistorySkip(Context, FileContext);
+
+        while (count < MaxEntries && FileContext->LastSequence != Context->InputSequence)
+        {
+            //
+            // Process the history in contiguous runs so they can be decoded in one go
+            // 
+            head = (FileContext->LastSequence + 1) % INPUT_HISTORY_DEPTH;
+
+            run = min(MaxEntries - count, Context->InputSequence - FileContext->LastSequence);
+            run = min(run, INPUT_HISTORY_DEPTH - head);
+            rejected = 0;
+
+            for (index = 0; index < run; index++)
+            {
+                pEntry = &Context->InputHistory[head + index];
+
+                Batch->Entries[count + index].Envelope.Timestamp = pEntry->Timestamp;
+                Batch->Entries[count + index].Envelope.Sequence = pEntry->Sequence;
+
+                if (Normalize)
+                {
+                    Batch->Entries[count + index].Envelope.Length = sizeof(FIRESHOCK_CONTROLLER_STATE);
+                    RtlZeroMemory(&Batch->Entries[count + index].Report[sizeof(FIRESHOCK_CONTROLLER_STATE)],
+                        FIRESHOCK_INPUT_REPORT_LENGTH - sizeof(FIRESHOCK_CONTROLLER_STATE));
+
+                    if (!DsUsbInputReportDecodable(Context, pEntry))
+                    {
+                        rejected++;
+                    }
+
+                    continue;
+                }
+
+                Batch->Entries[count + index].Envelope.Length = pEntry->Length;
+                RtlCopyMemory(Batch->Entries[count + index].Report, pEntry->Buffer, pEntry->Length);
+                RtlZeroMemory(&Batch->Entries[count + index].Report[pEntry->Length], FIRESHOCK_INPUT_REPORT_LENGTH - pEntry->Length);
+            }
+
+            if (Normalize && Context->DeviceType == DualShock3)
+            {
+                DsDecodeDs3Batch(
+                    Context->InputHistory[head].Buffer,
+                    sizeof(INPUT_REPORT),
+                    Batch->Entries[count].Report,
+                    sizeof(FIRESHOCK_INPUT_BATCH_ENTRY),
+                    run);
+            }
+            else if (Normalize && Context->DeviceType == DualShock4)
+            {
+                DsDecodeDs4Batch(
+                    Context->InputHistory[head].Buffer,
+                    sizeof(INPUT_REPORT),
+                    DsUsbGetDs4Calibration(Context),
+                    Batch->Entries[count].Report,
+                    sizeof(FIRESHOCK_INPUT_BATCH_ENTRY),
+                    run);
+            }
+
+            //
+            // The batch decoders take every report as valid, short or
+            // foreign ones get a zeroed state like on the single report path
+            // 
+            for (index = 0; rejected > 0 && index < run; index++)
+            {
+                if (!DsUsbInputReportDecodable(Context, &Context->InputHistory[head + index]))
+                {
+                    RtlZeroMemory(Batch->Entries[count + index].Report, sizeof(FIRESHOCK_CONTROLLER_STATE));
+                    rejected--;
+                }
+            }
+
+            FileContext->LastSequence += run;
+            count += run;
+        }
+    }
+
+    Batch->Count = count;
+    Batch->Dropped = 0;
+
+    if (count > 0)
+    {
+        Batch->Dropped = FileContext->Dropped;
+        FileContext->Dropped = 0;
+    }
+
+    return count;
+}
+
+//
+// Drains what the handle of a batch read has pending into its buffer.
+// Transferred receives the length to complete the request with, 0 if
+// there was nothing to deliver.
+// Must be called with InputLock held.
+// 
+NTSTATUS
+DsUsbInputBatchFill(
     _In_ PDEVICE_CONTEXT Context,
-    _In_ WDF_USB_BMREQUEST_DIRECTION Direction,
-    _In_ WDF_USB_BMREQUEST_TYPE Type,
-    _In_ BYTE Request,
-    _In_ USHORT Value,
-    _In_ USHORT Index,
-    _In_ PVOID Buffer,
-    _In_ ULONG BufferLength)
+    _In_ WDFREQUEST Request,
+    _Out_ size_t *Transferred
+)
 {
-    NTSTATUS                        status;
-    WDF_USB_CONTROL_SETUP_PACKET    controlSetupPacket;
-    WDF_REQUEST_SEND_OPTIONS        sendOptions;
-    WDF_MEMORY_DESCRIPTOR           memDesc;
-    ULONG                           bytesTransferred;
-
-    WDF_REQUEST_SEND_OPTIONS_INIT(
-        &sendOptions,
-        WDF_REQUEST_SEND_OPTION_TIMEOUT
-    );
-
-    WDF_REQUEST_SEND_OPTIONS_SET_TIMEOUT(
-        &sendOptions,
-        DEFAULT_CONTROL_TRANSFER_TIMEOUT
-    );
-
-    switch (Type)
-    {
-    case BmRequestClass:
-        WDF_USB_CONTROL_SETUP_PACKET_INIT_CLASS(&controlSetupPacket,
-            Direction,
-            BmRequestToInterface,
-            Request,
-            Value,
-            Index);
-        break;
-
-    default:
-        return STATUS_INVALID_PARAMETER;
-    }
+    NTSTATUS                status;
+    PFIRESHOCK_INPUT_BATCH  pBatch;
+    size_t                  bufferLength;
+    PFILE_CONTEXT           pFileContext;
+    ULONG                   count;
+    ULONG                   index;
+    LARGE_INTEGER           now;
 
-    WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(&memDesc,
-        Buffer,
-        BufferLength);
+    *Transferred = 0;
 
-    status = WdfUsbTargetDeviceSendControlTransferSynchronously(
-        Context->UsbDevice,
-        WDF_NO_HANDLE,
-        &sendOptions,
-        &controlSetupPacket,
-        &memDesc,
-        &bytesTransferred);
+    status = WdfRequestRetrieveOutputBuffer(
+        Request,
+        sizeof(FIRESHOCK_INPUT_BATCH),
+        (LPVOID)&pBatch,
+        &bufferLength);
 
     if (!NT_SUCCESS(status))
     {
         TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
-            "WdfUsbTargetDeviceSendControlTransferSynchronously failed with status %!STATUS! (%d)\n",
-            status, bytesTransferred);
+            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!", status);
+        return status;
     }
 
-    return status;
+    pFileContext = FileGetContext(WdfRequestGetFileObject(Request));
+
+    count = DsUsbInputHistoryDrain(
+        Context,
+        pFileContext,
+        pBatch,
+        (ULONG)(1 + (bufferLength - sizeof(FIRESHOCK_INPUT_BATCH)) / sizeof(FIRESHOCK_INPUT_BATCH_ENTRY)),
+        (pFileContext->ReportFormat & FIRESHOCK_REPORT_FORMAT_NORMALIZED) != 0);
+
+    if (count == 0)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    *Transferred = sizeof(FIRESHOCK_INPUT_BATCH) + (count - 1) * sizeof(FIRESHOCK_INPUT_BATCH_ENTRY);
+
+    QueryPerformanceCounter(&now);
+
+    for (index = 0; index < count; index++)
+    {
+        DsUsbCountersRecordInterval(
+            &Context->Counters.InputDelivery,
+            pBatch->Entries[index].Envelope.Timestamp,
+            now.QuadPart);
+    }
+
+    DsUsbCountersRecordDelivery(Context, count, *Transferred);
+
+    return STATUS_SUCCESS;
 }
 
+//
+// Starts recording traffic into a fresh capture, or stops recording.
+// What's been recorded stays available for reading either way.
+// 
 NTSTATUS
-DsUsbConfigContReaderForInterruptEndPoint(
-    _In_ WDFDEVICE Device
+DsUsbCaptureEnable(
+    _In_ WDFDEVICE Device,
+    _In_ BOOLEAN Enable
 )
 {
-    WDF_USB_CONTINUOUS_READER_CONFIG contReaderConfig;
-    NTSTATUS status;
-    PDEVICE_CONTEXT pDeviceContext;
+    NTSTATUS                status;
+    PDEVICE_CONTEXT         pDeviceContext = DeviceGetContext(Device);
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    WDFMEMORY               memory = NULL;
+    LARGE_INTEGER           frequency;
 
-    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DSUSB, "%!FUNC! Entry");
+    if (Enable && pDeviceContext->CaptureMemory == NULL)
+    {
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = Device;
 
-    pDeviceContext = DeviceGetContext(Device);
+        status = WdfMemoryCreate(
+            &attributes,
+            NonPagedPool,
+            FIRESHOCK_POOL_TAG,
+            CAPTURE_BUFFER_LENGTH,
+            &memory,
+            NULL);
 
-    WDF_USB_CONTINUOUS_READER_CONFIG_INIT(&contReaderConfig,
-        DsUsbEvtUsbInterruptPipeReadComplete,
-        Device,    // Context
-        INTERRUPT_IN_BUFFER_LENGTH);   // TransferLength
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+                "WdfMemoryCreate failed with status %!STATUS!", status);
+            return status;
+        }
+    }
 
-    contReaderConfig.EvtUsbTargetPipeReadersFailed = DsUsbEvtUsbInterruptReadersFailed;
+    QueryPerformanceFrequency(&frequency);
+
+    WdfSpinLockAcquire(pDeviceContext->CaptureLock);
+
+    if (Enable)
+    {
+        if (pDeviceContext->CaptureMemory == NULL)
+        {
+            pDeviceContext->CaptureMemory = memory;
+            memory = NULL;
+        }
+
+        CaptureBufferInitialize(
+            &pDeviceContext->Capture,
+            WdfMemoryGetBuffer(pDeviceContext->CaptureMemory, NULL),
+            CAPTURE_BUFFER_LENGTH,
+            (USHORT)pDeviceContext->DeviceType,
+            frequency.QuadPart);
+    }
+
+    pDeviceContext->CaptureEnabled = Enable;
+
+    WdfSpinLockRelease(pDeviceContext->CaptureLock);
 
     //
-    // Reader requests are not posted to the target automatically.
-    // Driver must explicitly call WdfIoTargetStart to kick start the
-    // reader.  In this sample, it's done in D0Entry.
-    // By default, framework queues two requests to the target
-    // endpoint. Driver can configure up to 10 requests with CONFIG macro.
-    //
-    status = WdfUsbTargetPipeConfigContinuousReader(pDeviceContext->InterruptReadPipe,
-        &contReaderConfig);
+    // Lost the race against another caller
+    // 
+    if (memory != NULL)
+    {
+        WdfObjectDelete(memory);
+    }
 
-    if (!NT_SUCCESS(status)) {
-        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
-            "WdfUsbTargetPipeConfigContinuousReader failed %x\n",
-            status);
-        return status;
+    return STATUS_SUCCESS;
+}
+
+//
+// Records a transfer if capturing.
+// 
+VOID
+DsUsbCaptureTransfer(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ UCHAR Type,
+    _In_ LONGLONG Timestamp,
+    _In_ NTSTATUS Status,
+    _In_opt_ const UCHAR *Setup,
+    _In_ PVOID Payload,
+    _In_ ULONG Length
+)
+{
+    if (!Context->CaptureEnabled)
+    {
+        return;
     }
 
-    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DSUSB, "%!FUNC! Exit");
+    WdfSpinLockAcquire(Context->CaptureLock);
+
+    if (Context->CaptureEnabled)
+    {
+        CaptureBufferAppend(&Context->Capture, Type, Timestamp, Status, Setup, Payload, Length);
+    }
+
+    WdfSpinLockRelease(Context->CaptureLock);
+}
+
+//
+// Moves recorded traffic to Buffer, returns the number of bytes written.
+// 
+ULONG
+DsUsbCaptureRead(
+    _In_ PDEVICE_CONTEXT Context,
+    _Out_ PUCHAR Buffer,
+    _In_ ULONG Length
+)
+{
+    ULONG written = 0;
+
+    WdfSpinLockAcquire(Context->CaptureLock);
+
+    if (Context->CaptureMemory != NULL)
+    {
+        written = CaptureBufferRead(&Context->Capture, Buffer, Length);
+    }
+
+    WdfSpinLockRelease(Context->CaptureLock);
+
+    return written;
+}
+
+//
+// Sets up the simulated controller if the device is configured to use one.
+// 
+NTSTATUS
+DsUsbSimulatorInitialize(
+    _In_ WDFDEVICE Device
+)
+{
+    NTSTATUS                status;
+    PDEVICE_CONTEXT         pDeviceContext = DeviceGetContext(Device);
+    WDF_TIMER_CONFIG        timerConfig;
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    LARGE_INTEGER           timestamp;
+    ULONG                   pattern;
+
+    DECLARE_CONST_UNICODE_STRING(reportRateValueName, L"SimulatedReportRate");
+    DECLARE_CONST_UNICODE_STRING(patternValueName, L"SimulatedPattern");
+
+    pDeviceContext->SimulatorReportRate = min(
+        FireShockQueryDeviceSetting(Device, &reportRateValueName, 0),
+        SIMULATOR_MAX_REPORT_RATE);
+
+    pDeviceContext->Simulated = (pDeviceContext->SimulatorReportRate > 0);
+
+    if (!pDeviceContext->Simulated)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    pattern = FireShockQueryDeviceSetting(Device, &patternValueName, SimulatorPatternSweep);
+
+    QueryPerformanceCounter(&timestamp);
+
+    SimulatorInitialize(
+        &pDeviceContext->Simulator,
+        pDeviceContext->DeviceType,
+        (SIMULATOR_PATTERN)pattern,
+        (ULONG)timestamp.QuadPart);
+
+    TraceEvents(TRACE_LEVEL_WARNING, TRACE_DSUSB,
+        "Simulating input at %d reports per second, pattern %d",
+        pDeviceContext->SimulatorReportRate, pattern);
+
+    if (pDeviceContext->SimulatorTimer != NULL)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    WDF_TIMER_CONFIG_INIT_PERIODIC(&timerConfig, DsUsbEvtSimulatorTimerFunc, SIMULATOR_TIMER_PERIOD);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device;
+
+    status = WdfTimerCreate(&timerConfig, &attributes, &pDeviceContext->SimulatorTimer);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+            "WdfTimerCreate failed with status %!STATUS!", status);
+    }
 
     return status;
 }
 
+//
+// Starts generating simulated reports, if simulating.
+// 
 VOID
-DsUsbEvtUsbInterruptPipeReadComplete(
-    WDFUSBPIPE  Pipe,
-    WDFMEMORY   Buffer,
-    size_t      NumBytesTransferred,
-    WDFCONTEXT  Context
+DsUsbSimulatorStart(
+    _In_ PDEVICE_CONTEXT Context
+)
+{
+    LARGE_INTEGER timestamp;
+
+    if (!Context->Simulated)
+    {
+        return;
+    }
+
+    QueryPerformanceCounter(&timestamp);
+
+    Context->SimulatorStartTimestamp = timestamp.QuadPart;
+    Context->SimulatorReports = 0;
+
+    WdfTimerStart(Context->SimulatorTimer, WDF_REL_TIMEOUT_IN_MS(SIMULATOR_TIMER_PERIOD));
+}
+
+//
+// Stops generating simulated reports, waits for the timer to finish.
+// 
+VOID
+DsUsbSimulatorStop(
+    _In_ PDEVICE_CONTEXT Context
+)
+{
+    if (Context->Simulated)
+    {
+        WdfTimerStop(Context->SimulatorTimer, TRUE);
+    }
+}
+
+//
+// Generates however many reports are due at the configured rate. The timer
+// resolution is coarser than the rate, so reports come in bursts sharing
+// one timestamp. Falling behind by more than a burst skips reports.
+// 
+VOID
+DsUsbEvtSimulatorTimerFunc(
+    _In_ WDFTIMER Timer
+)
+{
+    PDEVICE_CONTEXT     pDeviceContext;
+    LARGE_INTEGER       timestamp;
+    LARGE_INTEGER       frequency;
+    ULONGLONG           due;
+    ULONG               count;
+    ULONG               length;
+    UCHAR               report[FIRESHOCK_INPUT_REPORT_LENGTH];
+
+    pDeviceContext = DeviceGetContext(WdfTimerGetParentObject(Timer));
+
+    QueryPerformanceCounter(&timestamp);
+    QueryPerformanceFrequency(&frequency);
+
+    due = (ULONGLONG)(timestamp.QuadPart - pDeviceContext->SimulatorStartTimestamp)
+        * pDeviceContext->SimulatorReportRate / frequency.QuadPart;
+
+    if (due <= pDeviceContext->SimulatorReports)
+    {
+        return;
+    }
+
+    count = (ULONG)min(due - pDeviceContext->SimulatorReports, SIMULATOR_MAX_BURST);
+    pDeviceContext->SimulatorReports = due;
+
+    while (count-- > 0)
+    {
+        WdfSpinLockAcquire(pDeviceContext->SimulatorLock);
+        length = SimulatorNextReport(&pDeviceContext->Simulator, report, sizeof(report));
+        WdfSpinLockRelease(pDeviceContext->SimulatorLock);
+
+        //
+        // DualShock 3 not enabled yet
+        // 
+        if (length == 0)
+        {
+            break;
+        }
+
+        DsUsbInputReportReceived(pDeviceContext, report, length, timestamp.QuadPart);
+    }
+}
+
+//
+// Resumes recovering the continuous reader after a power-up.
+// 
+VOID
+DsUsbReaderRecoveryStart(
+    _In_ PDEVICE_CONTEXT Context
+)
+{
+    WdfSpinLockAcquire(Context->InputLock);
+
+    RecoveryPolicyInitialize(
+        &Context->ReaderRecovery,
+        INTERRUPT_IN_RESET_THRESHOLD,
+        INTERRUPT_IN_MIN_RETRY_DELAY,
+        INTERRUPT_IN_MAX_RETRY_DELAY);
+
+    Context->ReaderRestartPending = FALSE;
+    Context->ReaderResetPending = FALSE;
+    Context->ReaderReinitPending = FALSE;
+    Context->ReaderRecoveryEnabled = TRUE;
+
+    WdfSpinLockRelease(Context->InputLock);
+}
+
+//
+// Stops recovering the continuous reader, waits for any retry in progress.
+// Must be called before the interrupt-in target gets stopped.
+// 
+VOID
+DsUsbReaderRecoveryStop(
+    _In_ PDEVICE_CONTEXT Context
+)
+{
+    WdfSpinLockAcquire(Context->InputLock);
+    Context->ReaderRecoveryEnabled = FALSE;
+    WdfSpinLockRelease(Context->InputLock);
+
+    WdfTimerStop(Context->ReaderRecoveryTimer, TRUE);
+    WdfWorkItemFlush(Context->ReaderRecoveryWorkItem);
+}
+
+//
+// Retry delay elapsed, the restart itself has to happen at passive level.
+// 
+VOID
+DsUsbEvtReaderRecoveryTimerFunc(
+    _In_ WDFTIMER Timer
+)
+{
+    WdfWorkItemEnqueue(DeviceGetContext(WdfTimerGetParentObject(Timer))->ReaderRecoveryWorkItem);
+}
+
+//
+// Restarts the continuous reader, resetting the pipe first if failures
+// keep piling up, or re-initializes the device once input flows again.
+// 
+VOID
+DsUsbEvtReaderRecoveryWorkItem(
+    _In_ WDFWORKITEM WorkItem
 )
 {
     NTSTATUS            status;
     PDEVICE_CONTEXT     pDeviceContext;
-    WDFREQUEST          request;
-    size_t              reqBufferLength;
-    LPVOID              reqBuffer;
-    size_t              rdrBufferLength;
-    LPVOID              rdrBuffer;
+    WDFIOTARGET         target;
+    BOOLEAN             restart, reset, reinit;
 
-    UNREFERENCED_PARAMETER(Pipe);
-    UNREFERENCED_PARAMETER(NumBytesTransferred);
+    pDeviceContext = DeviceGetContext(WdfWorkItemGetParentObject(WorkItem));
+    target = WdfUsbTargetPipeGetIoTarget(pDeviceContext->InterruptReadPipe);
 
-    pDeviceContext = DeviceGetContext(Context);
-    rdrBuffer = WdfMemoryGetBuffer(Buffer, &rdrBufferLength);
+    WdfSpinLockAcquire(pDeviceContext->InputLock);
 
-    status = WdfIoQueueRetrieveNextRequest(pDeviceContext->IoReadQueue, &request);
+    restart = pDeviceContext->ReaderRestartPending && pDeviceContext->ReaderRecoveryEnabled;
+    reset = pDeviceContext->ReaderResetPending;
+    reinit = pDeviceContext->ReaderReinitPending && pDeviceContext->ReaderRecoveryEnabled;
 
-    if (NT_SUCCESS(status))
+    pDeviceContext->ReaderRestartPending = FALSE;
+    pDeviceContext->ReaderResetPending = FALSE;
+    pDeviceContext->ReaderReinitPending = FALSE;
+
+    WdfSpinLockRelease(pDeviceContext->InputLock);
+
+    if (restart)
     {
-        status = WdfRequestRetrieveOutputBuffer(request,
-            rdrBufferLength, &reqBuffer, &reqBufferLength);
+        WdfIoTargetStop(target, WdfIoTargetCancelSentIo);
+
+        if (reset)
+        {
+            status = WdfUsbTargetPipeResetSynchronously(pDeviceContext->InterruptReadPipe, WDF_NO_HANDLE, NULL);
+
+            InterlockedIncrement(&pDeviceContext->Counters.PipeResets);
+
+            if (!NT_SUCCESS(status))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+                    "WdfUsbTargetPipeResetSynchronously failed with status %!STATUS!", status);
+            }
+        }
+
+        status = WdfIoTargetStart(target);
 
         if (!NT_SUCCESS(status))
         {
             TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
-                "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!", status);
-            WdfRequestComplete(request, status);
-            return;
+                "WdfIoTargetStart failed with status %!STATUS!", status);
         }
+    }
 
-        RtlCopyMemory(reqBuffer, rdrBuffer, rdrBufferLength);
+    //
+    // The device may have lost its state along with the transfers
+    // 
+    if (reinit && pDeviceContext->DeviceType == DualShock3)
+    {
+        status = Ds3Init(pDeviceContext);
 
-        WdfRequestCompleteWithInformation(request, status, rdrBufferLength);
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+                "Ds3Init failed with status %!STATUS!", status);
+        }
     }
 }
 
+//
+// Instead of letting the framework resubmit right away, which spins as
+// fast as a flaky connection fails, retry after a growing delay.
+// 
 BOOLEAN
 DsUsbEvtUsbInterruptReadersFailed(
     _In_ WDFUSBPIPE Pipe,
@@ -185,13 +2140,44 @@ DsUsbEvtUsbInterruptReadersFailed(
     _In_ USBD_STATUS UsbdStatus
 )
 {
+    PDEVICE_CONTEXT     pDeviceContext;
+    LARGE_INTEGER       timestamp;
+    ULONG               delay;
+    BOOLEAN             reset;
+
     UNREFERENCED_PARAMETER(UsbdStatus);
-    UNREFERENCED_PARAMETER(Pipe);
+
+    pDeviceContext = DeviceGetContext(WdfIoTargetGetDevice(WdfUsbTargetPipeGetIoTarget(Pipe)));
+
+    InterlockedIncrement(&pDeviceContext->Counters.ReadersFailed);
+
+    QueryPerformanceCounter(&timestamp);
+
+    WdfSpinLockAcquire(pDeviceContext->InputLock);
+
+    if (!pDeviceContext->ReaderRecoveryEnabled)
+    {
+        WdfSpinLockRelease(pDeviceContext->InputLock);
+
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
+            "DsUsbEvtUsbInterruptReadersFailed called with status %!STATUS!",
+            Status);
+
+        return TRUE;
+    }
+
+    delay = RecoveryPolicyOnFailure(&pDeviceContext->ReaderRecovery, timestamp.QuadPart, &reset);
+
+    pDeviceContext->ReaderRestartPending = TRUE;
+    pDeviceContext->ReaderResetPending |= reset;
+
+    WdfSpinLockRelease(pDeviceContext->InputLock);
 
     TraceEvents(TRACE_LEVEL_ERROR, TRACE_DSUSB,
-        "DsUsbEvtUsbInterruptReadersFailed called with status %!STATUS!",
-        Status);
+        "DsUsbEvtUsbInterruptReadersFailed called with status %!STATUS!, retrying in %d ms (reset: %d)",
+        Status, delay, reset);
 
-    return TRUE;
-}
+    WdfTimerStart(pDeviceContext->ReaderRecoveryTimer, WDF_REL_TIMEOUT_IN_MS(delay));
 
+    return FALSE;
+}
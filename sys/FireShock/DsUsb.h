@@ -26,8 +26,18 @@
 #pragma once
 
 const __declspec(selectany) LONGLONG DEFAULT_CONTROL_TRANSFER_TIMEOUT = 5 * -1 * WDF_TIMEOUT_TO_SEC;
-#define INTERRUPT_IN_BUFFER_LENGTH          128
+#define INTERRUPT_IN_BUFFER_LENGTH          FIRESHOCK_INPUT_REPORT_LENGTH
+#define INTERRUPT_IN_DEFAULT_PENDING_READS  2
+#define INTERRUPT_IN_MAX_PENDING_READS      10
+#define INTERRUPT_IN_RESET_THRESHOLD        3
+#define INTERRUPT_IN_MIN_RETRY_DELAY        10
+#define INTERRUPT_IN_MAX_RETRY_DELAY        2000
 #define CONTROL_TRANSFER_BUFFER_LENGTH      64
+#define CAPTURE_BUFFER_LENGTH               (256 * 1024)
+#define SIMULATOR_MAX_REPORT_RATE           1000
+#define SIMULATOR_TIMER_PERIOD              1
+#define SIMULATOR_MAX_BURST                 64
+#define FIRESHOCK_POOL_TAG                  'kcSF'
 
 NTSTATUS
 SendControlRequest(
@@ -40,11 +50,179 @@ SendControlRequest(
     _In_ PVOID Buffer,
     _In_ ULONG BufferLength);
 
+NTSTATUS
+SendControlRequestAsync(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDF_USB_BMREQUEST_DIRECTION Direction,
+    _In_ WDF_USB_BMREQUEST_TYPE Type,
+    _In_ BYTE Request,
+    _In_ USHORT Value,
+    _In_ USHORT Index,
+    _In_ PVOID Buffer,
+    _In_ ULONG BufferLength,
+    _In_ PFN_DSUSB_CONTROL_TRANSFER_COMPLETE Completion,
+    _In_opt_ WDFCONTEXT CompletionContext);
+
+NTSTATUS
+DsUsbControlPoolInitialize(
+    _In_ WDFDEVICE Device);
+
+VOID
+DsUsbControlPoolCancel(
+    _In_ PDEVICE_CONTEXT Context);
+
 NTSTATUS
 DsUsbConfigContReaderForInterruptEndPoint(
     _In_ WDFDEVICE Device
 );
 
+const DS4_CALIBRATION *
+DsUsbGetDs4Calibration(
+    _In_ PDEVICE_CONTEXT Context);
+
+BOOLEAN
+DsUsbDecodeReport(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PVOID Report,
+    _In_ size_t Length,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State);
+
+BOOLEAN
+DsUsbInputFilterAccepts(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PFILE_CONTEXT FileContext,
+    _In_ PINPUT_REPORT Report,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State);
+
+VOID
+DsUsbInputHistorySkip(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PFILE_CONTEXT FileContext);
+
+BOOLEAN
+DsUsbInputHistoryNext(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PFILE_CONTEXT FileContext,
+    _Out_ PINPUT_REPORT Report,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State);
+
+NTSTATUS
+DsUsbRetrieveInputRequest(
+    _In_ PDEVICE_CONTEXT Context,
+    _Out_ WDFREQUEST *Request,
+    _Out_ PINPUT_REPORT Report,
+    _Out_ PBOOLEAN Batch);
+
+VOID
+DsUsbCompleteInputRequest(
+    _In_ WDFREQUEST Request,
+    _In_ LONGLONG Timestamp,
+    _In_ ULONG Sequence,
+    _In_ PVOID Report,
+    _In_ size_t Length);
+
+ULONG
+DsUsbInputHistoryDrain(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PFILE_CONTEXT FileContext,
+    _Out_ PFIRESHOCK_INPUT_BATCH Batch,
+    _In_ ULONG MaxEntries,
+    _In_ BOOLEAN Normalize);
+
+NTSTATUS
+DsUsbInputBatchFill(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDFREQUEST Request,
+    _Out_ size_t *Transferred);
+
+NTSTATUS
+DsUsbOutputInitialize(
+    _In_ WDFDEVICE Device);
+
+VOID
+DsUsbOutputSubmit(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PVOID Report,
+    _In_ size_t Length);
+
+VOID
+DsUsbOutputSendPending(
+    _In_ PDEVICE_CONTEXT Context);
+
+VOID
+DsUsbOutputCancel(
+    _In_ PDEVICE_CONTEXT Context);
+
+VOID
+DsUsbCountersRecordInterval(
+    _Inout_ PHISTOGRAM Histogram,
+    _In_ LONGLONG Start,
+    _In_ LONGLONG End);
+
+VOID
+DsUsbCountersRecordDelivery(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ ULONG Reports,
+    _In_ size_t Bytes);
+
+VOID
+DsUsbCountersSnapshot(
+    _In_ PDEVICE_CONTEXT Context,
+    _Out_ PFIRESHOCK_COUNTERS Counters);
+
+NTSTATUS
+DsUsbCaptureEnable(
+    _In_ WDFDEVICE Device,
+    _In_ BOOLEAN Enable);
+
+VOID
+DsUsbCaptureTransfer(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ UCHAR Type,
+    _In_ LONGLONG Timestamp,
+    _In_ NTSTATUS Status,
+    _In_opt_ const UCHAR *Setup,
+    _In_ PVOID Payload,
+    _In_ ULONG Length);
+
+ULONG
+DsUsbCaptureRead(
+    _In_ PDEVICE_CONTEXT Context,
+    _Out_ PUCHAR Buffer,
+    _In_ ULONG Length);
+
+VOID
+DsUsbInputReportReceived(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ PVOID Report,
+    _In_ size_t Length,
+    _In_ LONGLONG Timestamp);
+
+NTSTATUS
+DsUsbSimulatorInitialize(
+    _In_ WDFDEVICE Device);
+
+VOID
+DsUsbSimulatorStart(
+    _In_ PDEVICE_CONTEXT Context);
+
+VOID
+DsUsbSimulatorStop(
+    _In_ PDEVICE_CONTEXT Context);
+
+VOID
+DsUsbReaderRecoveryStart(
+    _In_ PDEVICE_CONTEXT Context);
+
+VOID
+DsUsbReaderRecoveryStop(
+    _In_ PDEVICE_CONTEXT Context);
+
+EVT_WDF_TIMER DsUsbEvtReaderRecoveryTimerFunc;
+EVT_WDF_TIMER DsUsbEvtSimulatorTimerFunc;
+EVT_WDF_WORKITEM DsUsbEvtReaderRecoveryWorkItem;
+EVT_WDF_REQUEST_COMPLETION_ROUTINE DsUsbEvtControlTransferComplete;
+EVT_DSUSB_CONTROL_TRANSFER_COMPLETE DsUsbEvtOutputTransferComplete;
 EVT_WDF_USB_READER_COMPLETION_ROUTINE DsUsbEvtUsbInterruptPipeReadComplete;
 EVT_WDF_USB_READERS_FAILED DsUsbEvtUsbInterruptReadersFailed;
 
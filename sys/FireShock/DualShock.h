@@ -26,12 +26,19 @@
 #pragma once
 
 #define DS3_HID_COMMAND_ENABLE_SIZE             0x04
+#define DS3_HID_INPUT_REPORT_SIZE               0x31
 #define DS3_HID_OUTPUT_REPORT_SIZE              0x30
+#define DS3_DEFAULT_PENDING_READS               3
 
 #define DS3_VENDOR_ID                           0x054C
 #define DS3_PRODUCT_ID                          0x0268
 
+#define DS4_HID_INPUT_REPORT_SIZE               0x40
 #define DS4_HID_OUTPUT_REPORT_SIZE              0x20
+#define DS4_DEFAULT_PENDING_READS               4
+#define DS4_DEFAULT_OUTPUT_REPORT_PERIOD        10
+#define DS4_MAX_OUTPUT_REPORT_PERIOD            1000
+#define DS4_OUTPUT_REPORT_TIMEOUT               500
 #define DS4_VENDOR_ID                           0x054C
 #define DS4_PRODUCT_ID                          0x05C4
 #define DS4_2_PRODUCT_ID                        0x09CC
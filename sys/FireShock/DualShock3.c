@@ -49,3 +49,68 @@ NTSTATUS Ds3Init(PDEVICE_CONTEXT Context)
         DS3_HID_COMMAND_ENABLE_SIZE
     );
 }
+
+//
+// Reads whichever of the device and host address isn't cached yet.
+// 
+NTSTATUS Ds3FetchAddresses(PDEVICE_CONTEXT Context)
+{
+    NTSTATUS    status = STATUS_SUCCESS;
+    UCHAR       controlTransferBuffer[CONTROL_TRANSFER_BUFFER_LENGTH];
+
+    if (!(Context->FeatureCacheValid & FIRESHOCK_FEATURE_DEVICE_ADDRESS))
+    {
+        status = SendControlRequest(
+            Context,
+            BmRequestDeviceToHost,
+            BmRequestClass,
+            GetReport,
+            Ds3FeatureDeviceAddress,
+            0,
+            controlTransferBuffer,
+            CONTROL_TRANSFER_BUFFER_LENGTH);
+
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_DUALSHOCK3,
+                "Requesting device address failed with %!STATUS!", status);
+            return status;
+        }
+
+        RtlCopyMemory(
+            &Context->DeviceAddress,
+            &controlTransferBuffer[4],
+            sizeof(BD_ADDR));
+
+        InterlockedOr(&Context->FeatureCacheValid, FIRESHOCK_FEATURE_DEVICE_ADDRESS);
+    }
+
+    if (!(Context->FeatureCacheValid & FIRESHOCK_FEATURE_HOST_ADDRESS))
+    {
+        status = SendControlRequest(
+            Context,
+            BmRequestDeviceToHost,
+            BmRequestClass,
+            GetReport,
+            Ds3FeatureHostAddress,
+            0,
+            controlTransferBuffer,
+            CONTROL_TRANSFER_BUFFER_LENGTH);
+
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_DUALSHOCK3,
+                "Requesting host address failed with %!STATUS!", status);
+            return status;
+        }
+
+        RtlCopyMemory(
+            &Context->HostAddress,
+            &controlTransferBuffer[2],
+            sizeof(BD_ADDR));
+
+        InterlockedOr(&Context->FeatureCacheValid, FIRESHOCK_FEATURE_HOST_ADDRESS);
+    }
+
+    return status;
+}
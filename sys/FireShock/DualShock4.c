@@ -0,0 +1,289 @@
+﻿/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Driver.h"
+#include "DualShock4.tmh"
+
+
+//
+// Takes a client-written output report, the timer picks it up.
+// 
+VOID Ds4OutputSubmit(WDFDEVICE Device, PVOID Report, size_t Length)
+{
+    PDEVICE_CONTEXT     pDeviceContext = DeviceGetContext(Device);
+    PDS4_DEVICE_CONTEXT pDs4Context = Ds4GetContext(Device);
+
+    Length = min(Length, DS4_HID_OUTPUT_REPORT_SIZE);
+
+    WdfSpinLockAcquire(pDeviceContext->OutputLock);
+
+    pDeviceContext->OutputStatistics.Submitted++;
+
+    if (RtlCompareMemory(pDs4Context->OutputReportBuffer, Report, Length) == Length)
+    {
+        pDeviceContext->OutputStatistics.Absorbed++;
+    }
+    else
+    {
+        if (pDs4Context->OutputReportDirty)
+        {
+            pDeviceContext->OutputStatistics.Coalesced++;
+        }
+
+        RtlCopyMemory(pDs4Context->OutputReportBuffer, Report, Length);
+        pDs4Context->OutputReportDirty = TRUE;
+    }
+
+    WdfSpinLockRelease(pDeviceContext->OutputLock);
+}
+
+//
+// Creates the request and buffer output reports get written with.
+// 
+NTSTATUS Ds4OutputInitialize(WDFDEVICE Device)
+{
+    NTSTATUS                status;
+    PDEVICE_CONTEXT         pDeviceContext = DeviceGetContext(Device);
+    PDS4_DEVICE_CONTEXT     pDs4Context = Ds4GetContext(Device);
+    WDF_OBJECT_ATTRIBUTES   attributes;
+
+    //
+    // Survives from an earlier EvtDevicePrepareHardware
+    // 
+    if (pDs4Context->OutputRequest != NULL)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = Device;
+
+    status = WdfRequestCreate(
+        &attributes,
+        WdfUsbTargetPipeGetIoTarget(pDeviceContext->InterruptWritePipe),
+        &pDs4Context->OutputRequest);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DUALSHOCK4,
+            "WdfRequestCreate failed with status %!STATUS!", status);
+        pDs4Context->OutputRequest = NULL;
+        return status;
+    }
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = pDs4Context->OutputRequest;
+
+    status = WdfMemoryCreate(
+        &attributes,
+        NonPagedPool,
+        FIRESHOCK_POOL_TAG,
+        DS4_HID_OUTPUT_REPORT_SIZE,
+        &pDs4Context->OutputMemory,
+        (PVOID*)&pDs4Context->OutputTransferBuffer);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DUALSHOCK4,
+            "WdfMemoryCreate failed with status %!STATUS!", status);
+        WdfObjectDelete(pDs4Context->OutputRequest);
+        pDs4Context->OutputRequest = NULL;
+        return status;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+//
+// Accounts for a finished output report write and frees the request up.
+// 
+static VOID Ds4OutputReportWriteFinish(WDFDEVICE Device, NTSTATUS Status)
+{
+    PDEVICE_CONTEXT     pDeviceContext = DeviceGetContext(Device);
+    PDS4_DEVICE_CONTEXT pDs4Context = Ds4GetContext(Device);
+
+    if (!NT_SUCCESS(Status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_DUALSHOCK4,
+            "Output report write failed with status %!STATUS!",
+            Status);
+    }
+
+    WdfSpinLockAcquire(pDeviceContext->OutputLock);
+
+    pDeviceContext->OutputInFlight = FALSE;
+
+    if (NT_SUCCESS(Status))
+    {
+        pDeviceContext->OutputStatistics.Sent++;
+    }
+    else
+    {
+        //
+        // Try again on the next tick unless a newer report is waiting anyway
+        // 
+        pDeviceContext->OutputStatistics.Failed++;
+        pDs4Context->OutputReportDirty = TRUE;
+    }
+
+    WdfSpinLockRelease(pDeviceContext->OutputLock);
+}
+
+//
+// Flushes the output report buffer to the interrupt-out endpoint if it
+// changed. The write completes asynchronously so the timer never waits
+// on the bus.
+// 
+VOID Ds4EvtOutputReportTimerFunc(WDFTIMER Timer)
+{
+    NTSTATUS                    status;
+    WDFDEVICE                   device;
+    PDEVICE_CONTEXT             pDeviceContext;
+    PDS4_DEVICE_CONTEXT         pDs4Context;
+    WDF_REQUEST_REUSE_PARAMS    reuseParams;
+    WDF_REQUEST_SEND_OPTIONS    sendOptions;
+
+    device = WdfTimerGetParentObject(Timer);
+    pDeviceContext = DeviceGetContext(device);
+    pDs4Context = Ds4GetContext(device);
+
+    WdfSpinLockAcquire(pDeviceContext->OutputLock);
+
+    //
+    // Nothing new or the previous write is still in flight
+    // 
+    if (!pDs4Context->OutputReportDirty || pDeviceContext->OutputInFlight)
+    {
+        WdfSpinLockRelease(pDeviceContext->OutputLock);
+        return;
+    }
+
+    RtlCopyMemory(pDs4Context->OutputTransferBuffer, pDs4Context->OutputReportBuffer, DS4_HID_OUTPUT_REPORT_SIZE);
+    pDs4Context->OutputReportDirty = FALSE;
+    pDeviceContext->OutputInFlight = TRUE;
+
+    WdfSpinLockRelease(pDeviceContext->OutputLock);
+
+    WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+    WdfRequestReuse(pDs4Context->OutputRequest, &reuseParams);
+
+    status = WdfUsbTargetPipeFormatRequestForWrite(
+        pDeviceContext->InterruptWritePipe,
+        pDs4Context->OutputRequest,
+        pDs4Context->OutputMemory,
+        NULL);
+
+    if (!NT_SUCCESS(status))
+    {
+        Ds4OutputReportWriteFinish(device, status);
+        return;
+    }
+
+    WdfRequestSetCompletionRoutine(
+        pDs4Context->OutputRequest,
+        Ds4EvtOutputReportWriteComplete,
+        device);
+
+    WDF_REQUEST_SEND_OPTIONS_INIT(&sendOptions, WDF_REQUEST_SEND_OPTION_TIMEOUT);
+    WDF_REQUEST_SEND_OPTIONS_SET_TIMEOUT(&sendOptions, WDF_REL_TIMEOUT_IN_MS(DS4_OUTPUT_REPORT_TIMEOUT));
+
+    if (!WdfRequestSend(
+        pDs4Context->OutputRequest,
+        WdfUsbTargetPipeGetIoTarget(pDeviceContext->InterruptWritePipe),
+        &sendOptions))
+    {
+        Ds4OutputReportWriteFinish(device, WdfRequestGetStatus(pDs4Context->OutputRequest));
+    }
+}
+
+VOID Ds4EvtOutputReportWriteComplete(
+    WDFREQUEST Request,
+    WDFIOTARGET Target,
+    PWDF_REQUEST_COMPLETION_PARAMS Params,
+    WDFCONTEXT Context)
+{
+    UNREFERENCED_PARAMETER(Request);
+    UNREFERENCED_PARAMETER(Target);
+
+    Ds4OutputReportWriteFinish((WDFDEVICE)Context, Params->IoStatus.Status);
+}
+
+//
+// Reads and caches motion calibration unless it's cached already.
+// 
+NTSTATUS Ds4FetchCalibration(WDFDEVICE Device)
+{
+    NTSTATUS            status;
+    PDEVICE_CONTEXT     pDeviceContext = DeviceGetContext(Device);
+    PDS4_DEVICE_CONTEXT pDs4Context = Ds4GetContext(Device);
+    UCHAR               controlTransferBuffer[CONTROL_TRANSFER_BUFFER_LENGTH];
+    DS4_CALIBRATION     calibration;
+
+    if (pDeviceContext->FeatureCacheValid & FIRESHOCK_FEATURE_CALIBRATION)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    status = SendControlRequest(
+        pDeviceContext,
+        BmRequestDeviceToHost,
+        BmRequestClass,
+        GetReport,
+        USB_SETUP_VALUE(HidReportRequestTypeFeature, DS4_FEATURE_REPORT_CALIBRATION),
+        0,
+        controlTransferBuffer,
+        DS4_FEATURE_REPORT_CALIBRATION_SIZE);
+
+    if (!NT_SUCCESS(status))
+    {
+        //
+        // Not fatal, motion data is delivered uncalibrated
+        // 
+        TraceEvents(TRACE_LEVEL_WARNING, TRACE_DUALSHOCK4,
+            "Reading motion calibration failed with status %!STATUS!", status);
+        return status;
+    }
+
+    if (!DsDecodeDs4Calibration(controlTransferBuffer, DS4_FEATURE_REPORT_CALIBRATION_SIZE, &calibration))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING, TRACE_DUALSHOCK4,
+            "Motion calibration data is invalid");
+        return STATUS_INVALID_DEVICE_STATE;
+    }
+
+    //
+    // Reports get decoded with the calibration under InputLock, never let
+    // them see a half-written one
+    // 
+    WdfSpinLockAcquire(pDeviceContext->InputLock);
+    pDs4Context->Calibration = calibration;
+    pDs4Context->CalibrationValid = TRUE;
+    WdfSpinLockRelease(pDeviceContext->InputLock);
+
+    InterlockedOr(&pDeviceContext->FeatureCacheValid, FIRESHOCK_FEATURE_CALIBRATION);
+
+    return status;
+}
@@ -0,0 +1,197 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Driver.h"
+
+//
+// Nefarius.FireShock
+// c746464a-f2aa-4dce-9beb-882f5a41527a
+//
+TRACELOGGING_DEFINE_PROVIDER(
+    FireShockTraceLoggingProvider,
+    "Nefarius.FireShock",
+    (0xc746464a, 0xf2aa, 0x4dce, 0x9b, 0xeb, 0x88, 0x2f, 0x5a, 0x41, 0x52, 0x7a));
+
+//
+// An input report arrived from the device (or the simulator).
+// 
+VOID
+FireShockEventReportReceived(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ ULONG Sequence,
+    _In_ ULONG Length,
+    _In_ LONGLONG Timestamp
+)
+{
+    TraceLoggingWrite(
+        FireShockTraceLoggingProvider,
+        "ReportReceived",
+        TraceLoggingLevel(TRACE_LEVEL_VERBOSE),
+        TraceLoggingKeyword(FIRESHOCK_EVENT_KEYWORD_INPUT),
+        TraceLoggingUInt32(Context->DeviceIndex, "DeviceIndex"),
+        TraceLoggingUInt32(Sequence, "Sequence"),
+        TraceLoggingUInt32(Length, "Length"),
+        TraceLoggingInt64(Timestamp, "Timestamp"));
+}
+
+//
+// A client request is about to be completed. ReportTimestamp is the one of
+// the oldest report handed out with it, 0 if none.
+// 
+VOID
+FireShockEventRequestCompleted(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDFREQUEST Request,
+    _In_ NTSTATUS Status,
+    _In_ ULONG_PTR Information,
+    _In_ LONGLONG ReportTimestamp
+)
+{
+    WDF_REQUEST_PARAMETERS  params;
+    LARGE_INTEGER           timestamp;
+
+    //
+    // Gathering the fields isn't free, skip it while nobody listens
+    // 
+    if (!TraceLoggingProviderEnabled(FireShockTraceLoggingProvider,
+        TRACE_LEVEL_VERBOSE, FIRESHOCK_EVENT_KEYWORD_REQUEST))
+    {
+        return;
+    }
+
+    QueryPerformanceCounter(&timestamp);
+
+    WDF_REQUEST_PARAMETERS_INIT(&params);
+    WdfRequestGetParameters(Request, &params);
+
+    TraceLoggingWrite(
+        FireShockTraceLoggingProvider,
+        "RequestCompleted",
+        TraceLoggingLevel(TRACE_LEVEL_VERBOSE),
+        TraceLoggingKeyword(FIRESHOCK_EVENT_KEYWORD_REQUEST),
+        TraceLoggingUInt32(Context->DeviceIndex, "DeviceIndex"),
+        TraceLoggingPointer(Request, "Request"),
+        TraceLoggingUInt32((ULONG)params.Type, "Type"),
+        TraceLoggingUInt32((params.Type == WdfRequestTypeDeviceControl)
+            ? params.Parameters.DeviceIoControl.IoControlCode : 0, "IoControlCode"),
+        TraceLoggingNTStatus(Status, "Status"),
+        TraceLoggingUInt64(Information, "Information"),
+        TraceLoggingInt64(RequestGetContext(Request)->ArrivalTimestamp, "ArrivalTimestamp"),
+        TraceLoggingInt64(ReportTimestamp, "ReportTimestamp"),
+        TraceLoggingInt64(timestamp.QuadPart, "Timestamp"));
+}
+
+//
+// A control transfer is being handed to the device.
+// 
+VOID
+FireShockEventControlTransferStart(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_reads_(8) const UCHAR *Setup,
+    _In_ LONGLONG Timestamp
+)
+{
+    TraceLoggingWrite(
+        FireShockTraceLoggingProvider,
+        "ControlTransferStart",
+        TraceLoggingLevel(TRACE_LEVEL_VERBOSE),
+        TraceLoggingKeyword(FIRESHOCK_EVENT_KEYWORD_CONTROL),
+        TraceLoggingUInt32(Context->DeviceIndex, "DeviceIndex"),
+        TraceLoggingBinary(Setup, 8, "Setup"),
+        TraceLoggingInt64(Timestamp, "Timestamp"));
+}
+
+//
+// A control transfer finished.
+// 
+VOID
+FireShockEventControlTransferStop(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_reads_(8) const UCHAR *Setup,
+    _In_ NTSTATUS Status,
+    _In_ ULONG Transferred,
+    _In_ LONGLONG StartTimestamp,
+    _In_ LONGLONG Timestamp
+)
+{
+    TraceLoggingWrite(
+        FireShockTraceLoggingProvider,
+        "ControlTransferStop",
+        TraceLoggingLevel(TRACE_LEVEL_VERBOSE),
+        TraceLoggingKeyword(FIRESHOCK_EVENT_KEYWORD_CONTROL),
+        TraceLoggingUInt32(Context->DeviceIndex, "DeviceIndex"),
+        TraceLoggingBinary(Setup, 8, "Setup"),
+        TraceLoggingNTStatus(Status, "Status"),
+        TraceLoggingUInt32(Transferred, "Transferred"),
+        TraceLoggingInt64(StartTimestamp, "StartTimestamp"),
+        TraceLoggingInt64(Timestamp, "Timestamp"));
+}
+
+//
+// The device entered D0 and is about to deliver input.
+// 
+VOID
+FireShockEventD0Entry(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDF_POWER_DEVICE_STATE PreviousState,
+    _In_ LONGLONG Timestamp
+)
+{
+    LARGE_INTEGER frequency;
+
+    QueryPerformanceFrequency(&frequency);
+
+    TraceLoggingWrite(
+        FireShockTraceLoggingProvider,
+        "D0Entry",
+        TraceLoggingLevel(TRACE_LEVEL_INFORMATION),
+        TraceLoggingKeyword(FIRESHOCK_EVENT_KEYWORD_POWER),
+        TraceLoggingUInt32(Context->DeviceIndex, "DeviceIndex"),
+        TraceLoggingUInt32((ULONG)Context->DeviceType, "DeviceType"),
+        TraceLoggingUInt32((ULONG)PreviousState, "PreviousState"),
+        TraceLoggingInt64(Timestamp, "Timestamp"),
+        TraceLoggingInt64(frequency.QuadPart, "Frequency"));
+}
+
+//
+// The device is leaving D0.
+// 
+VOID
+FireShockEventD0Exit(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDF_POWER_DEVICE_STATE TargetState,
+    _In_ LONGLONG Timestamp
+)
+{
+    TraceLoggingWrite(
+        FireShockTraceLoggingProvider,
+        "D0Exit",
+        TraceLoggingLevel(TRACE_LEVEL_INFORMATION),
+        TraceLoggingKeyword(FIRESHOCK_EVENT_KEYWORD_POWER),
+        TraceLoggingUInt32(Context->DeviceIndex, "DeviceIndex"),
+        TraceLoggingUInt32((ULONG)TargetState, "TargetState"),
+        TraceLoggingInt64(Timestamp, "Timestamp"));
+}
@@ -0,0 +1,84 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#pragma once
+
+EXTERN_C_START
+
+//
+// Structured events for offline latency analysis. All timestamps are
+// performance counter values, D0Entry carries the counter frequency.
+//
+TRACELOGGING_DECLARE_PROVIDER(FireShockTraceLoggingProvider);
+
+#define FIRESHOCK_EVENT_KEYWORD_INPUT       0x1
+#define FIRESHOCK_EVENT_KEYWORD_REQUEST     0x2
+#define FIRESHOCK_EVENT_KEYWORD_CONTROL     0x4
+#define FIRESHOCK_EVENT_KEYWORD_POWER       0x8
+
+VOID
+FireShockEventReportReceived(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ ULONG Sequence,
+    _In_ ULONG Length,
+    _In_ LONGLONG Timestamp);
+
+VOID
+FireShockEventRequestCompleted(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDFREQUEST Request,
+    _In_ NTSTATUS Status,
+    _In_ ULONG_PTR Information,
+    _In_ LONGLONG ReportTimestamp);
+
+VOID
+FireShockEventControlTransferStart(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_reads_(8) const UCHAR *Setup,
+    _In_ LONGLONG Timestamp);
+
+VOID
+FireShockEventControlTransferStop(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_reads_(8) const UCHAR *Setup,
+    _In_ NTSTATUS Status,
+    _In_ ULONG Transferred,
+    _In_ LONGLONG StartTimestamp,
+    _In_ LONGLONG Timestamp);
+
+VOID
+FireShockEventD0Entry(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDF_POWER_DEVICE_STATE PreviousState,
+    _In_ LONGLONG Timestamp);
+
+VOID
+FireShockEventD0Exit(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDF_POWER_DEVICE_STATE TargetState,
+    _In_ LONGLONG Timestamp);
+
+EXTERN_C_END
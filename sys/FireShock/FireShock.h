@@ -48,9 +48,273 @@
                                                             METHOD_BUFFERED,    \
                                                             FILE_READ_ACCESS)
 
+//
+// Hands the output buffer to the driver as shared input ring
+// (FIRESHOCK_INPUT_RING_HEADER, mind the alignment requirements).
+// The request stays pending for as long as the ring is in use, also across
+// power-downs; cancel it or close the handle to release the mapping. It
+// completes with STATUS_CANCELLED when the device gets removed.
+//
+#define IOCTL_FIRESHOCK_MAP_INPUT_RING          CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x04, \
+                                                            METHOD_OUT_DIRECT,  \
+                                                            FILE_READ_ACCESS)
+
+//
+// Completes as soon as the mapped input ring holds at least one report.
+//
+#define IOCTL_FIRESHOCK_WAIT_INPUT_RING         CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x05, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Returns as many backlogged input reports as fit into the output buffer,
+// waits for the next one if the backlog is empty. Read mode and change
+// filter of the handle apply like they do to plain reads.
+//
+#define IOCTL_FIRESHOCK_READ_INPUT_BATCH        CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x06, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Selects how reads issued on this handle get served (FIRESHOCK_READ_MODE).
+//
+#define IOCTL_FIRESHOCK_SET_READ_MODE           CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x07, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Selects the layout of reports delivered on this handle (FIRESHOCK_REPORT_FORMAT_*).
+//
+#define IOCTL_FIRESHOCK_SET_REPORT_FORMAT       CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x08, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Restricts reports delivered on this handle to those that differ from the
+// previously delivered one (FIRESHOCK_SET_CHANGE_FILTER).
+//
+#define IOCTL_FIRESHOCK_SET_CHANGE_FILTER       CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x09, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Returns counters of the output report path (FIRESHOCK_OUTPUT_STATISTICS).
+//
+#define IOCTL_FIRESHOCK_GET_OUTPUT_STATISTICS   CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x0A, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Reports which static feature data is cached (FIRESHOCK_FEATURE_*).
+//
+#define IOCTL_FIRESHOCK_GET_FEATURE_CACHE       CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x0B, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Drops cached feature data, it gets fetched from the device on next power-up.
+//
+#define IOCTL_FIRESHOCK_INVALIDATE_FEATURE_CACHE CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x0C, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_WRITE_ACCESS)
+
+//
+// Returns how long the device took to become usable (FIRESHOCK_STARTUP_TIMING).
+//
+#define IOCTL_FIRESHOCK_GET_STARTUP_TIMING      CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x0D, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Returns the device's performance counters (FIRESHOCK_COUNTERS).
+//
+#define IOCTL_FIRESHOCK_GET_COUNTERS            CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x0E, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Returns the input timing histograms (FIRESHOCK_INPUT_TIMING), optionally
+// resetting them (FIRESHOCK_GET_INPUT_TIMING).
+//
+#define IOCTL_FIRESHOCK_GET_INPUT_TIMING        CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x0F, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Starts or stops recording USB traffic (FIRESHOCK_SET_CAPTURE).
+//
+#define IOCTL_FIRESHOCK_SET_CAPTURE             CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x10, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_WRITE_ACCESS)
+
+//
+// Returns recorded traffic as a FIRESHOCK_CAPTURE_HEADER followed by
+// FIRESHOCK_CAPTURE_RECORDs, split across as many calls as needed.
+// Appending the output of each call to a file yields a replayable capture.
+//
+#define IOCTL_FIRESHOCK_READ_CAPTURE            CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x11, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Returns the index tagging this device's reports in aggregated reads. It
+// may change once after start-up, when the device returns to its previous
+// player slot (IOCTL_FIRESHOCK_GET_SLOTS).
+//
+#define IOCTL_FIRESHOCK_GET_DEVICE_INDEX        CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x12, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Same as IOCTL_FIRESHOCK_READ_INPUT_BATCH, but returns reports of every
+// FireShock device hosted alongside this one (FIRESHOCK_AGGREGATED_BATCH).
+// Can be issued on any device; reports are only collected once a handle
+// has issued it and until that handle gets closed. Every such handle gets
+// every report collected since its first request. Pending requests are
+// cancelled if the device they were issued on goes away, but keep being
+// served while it is in a low power state.
+//
+// Only devices loaded into the same driver host process (WUDFHost) are
+// aggregated. The INF enables host process sharing, but the system is free
+// to load a device into a host of its own anyway (e.g. once another driver
+// in the shared host crashed it); such a device shows up in neither the
+// batches nor the slot table of the others. Open one handle per host if
+// every pad has to be covered.
+//
+#define IOCTL_FIRESHOCK_READ_AGGREGATED         CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x13, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
+//
+// Returns the player slot table of all devices hosted alongside this one
+// (FIRESHOCK_GET_SLOTS). A slot index equals the DeviceIndex of the device
+// occupying it.
+//
+#define IOCTL_FIRESHOCK_GET_SLOTS               CTL_CODE(FILE_DEVICE_FIRESHOCK, \
+                                                            IOCTL_INDEX + 0x14, \
+                                                            METHOD_BUFFERED,    \
+                                                            FILE_READ_ACCESS)
+
 #define SET_HOST_BD_ADDR_CONTROL_BUFFER_LENGTH  8
+#define FIRESHOCK_INPUT_REPORT_LENGTH           0x80
+
+//
+// Prefix every report read from this handle with a FIRESHOCK_REPORT_ENVELOPE
+//
+#define FIRESHOCK_REPORT_FORMAT_ENVELOPE        0x00000001
+
+//
+// Deliver a decoded FIRESHOCK_CONTROLLER_STATE instead of the raw report
+//
+#define FIRESHOCK_REPORT_FORMAT_NORMALIZED      0x00000002
+
+//
+// FIRESHOCK_CONTROLLER_STATE button bits
+//
+#define FIRESHOCK_BUTTON_SELECT                 0x00000001
+#define FIRESHOCK_BUTTON_L3                     0x00000002
+#define FIRESHOCK_BUTTON_R3                     0x00000004
+#define FIRESHOCK_BUTTON_START                  0x00000008
+#define FIRESHOCK_BUTTON_DPAD_UP                0x00000010
+#define FIRESHOCK_BUTTON_DPAD_RIGHT             0x00000020
+#define FIRESHOCK_BUTTON_DPAD_DOWN              0x00000040
+#define FIRESHOCK_BUTTON_DPAD_LEFT              0x00000080
+#define FIRESHOCK_BUTTON_L2                     0x00000100
+#define FIRESHOCK_BUTTON_R2                     0x00000200
+#define FIRESHOCK_BUTTON_L1                     0x00000400
+#define FIRESHOCK_BUTTON_R1                     0x00000800
+#define FIRESHOCK_BUTTON_TRIANGLE               0x00001000
+#define FIRESHOCK_BUTTON_CIRCLE                 0x00002000
+#define FIRESHOCK_BUTTON_CROSS                  0x00004000
+#define FIRESHOCK_BUTTON_SQUARE                 0x00008000
+#define FIRESHOCK_BUTTON_PS                     0x00010000
+#define FIRESHOCK_BUTTON_TOUCHPAD               0x00020000
+
+//
+// FIRESHOCK_CONTROLLER_STATE pressure indices
+//
+#define FIRESHOCK_PRESSURE_DPAD_UP              0
+#define FIRESHOCK_PRESSURE_DPAD_RIGHT           1
+#define FIRESHOCK_PRESSURE_DPAD_DOWN            2
+#define FIRESHOCK_PRESSURE_DPAD_LEFT            3
+#define FIRESHOCK_PRESSURE_L2                   4
+#define FIRESHOCK_PRESSURE_R2                   5
+#define FIRESHOCK_PRESSURE_L1                   6
+#define FIRESHOCK_PRESSURE_R1                   7
+#define FIRESHOCK_PRESSURE_TRIANGLE             8
+#define FIRESHOCK_PRESSURE_CIRCLE               9
+#define FIRESHOCK_PRESSURE_CROSS                10
+#define FIRESHOCK_PRESSURE_SQUARE               11
+#define FIRESHOCK_PRESSURE_COUNT                12
 
+#define FIRESHOCK_TOUCH_POINT_COUNT             2
+
+//
+// Static feature data cached by the driver
+//
+#define FIRESHOCK_FEATURE_DEVICE_ADDRESS        0x00000001
+#define FIRESHOCK_FEATURE_HOST_ADDRESS          0x00000002
+#define FIRESHOCK_FEATURE_CALIBRATION           0x00000004
+
+//
+// FIRESHOCK_COUNTERS layout revision, bumped whenever fields get appended
+//
+#define FIRESHOCK_COUNTERS_VERSION              4
+
+//
+// Request classes, each dispatched from its own queue
+//
+#define FIRESHOCK_QUEUE_CLASS_CONTROL           0   // IOCTLs answered from cached state
+#define FIRESHOCK_QUEUE_CLASS_FEATURE           1   // IOCTLs that talk to the device
+#define FIRESHOCK_QUEUE_CLASS_READ              2
+#define FIRESHOCK_QUEUE_CLASS_WRITE             3
+#define FIRESHOCK_QUEUE_CLASS_COUNT             4
+
+//
+// Number of player slots, further devices get a DeviceIndex past the last slot
+//
+#define FIRESHOCK_SLOT_COUNT                    16
+
+//
+// Latency histogram buckets, bucket n counts samples that took less
+// than 2^n microseconds, the last one everything slower
+//
+#define FIRESHOCK_LATENCY_BUCKET_COUNT          24
+
+//
+// Traffic capture format
+//
+#define FIRESHOCK_CAPTURE_MAGIC                 0x50435346 // "FSCP"
+#define FIRESHOCK_CAPTURE_VERSION               1
+
+//
+// FIRESHOCK_CAPTURE_RECORD types
+//
+#define FIRESHOCK_CAPTURE_RECORD_INTERRUPT_IN   1
+#define FIRESHOCK_CAPTURE_RECORD_CONTROL        2
+#define FIRESHOCK_CAPTURE_RECORD_LOST           3
+
+#ifdef _WIN32
 #include <pshpack1.h>
+#else
+#pragma pack(push, 1)
+#endif
 
 /**
 * \typedef struct _BD_ADDR
@@ -71,6 +335,102 @@ typedef enum _DS_DEVICE_TYPE
 
 } DS_DEVICE_TYPE, *PDS_DEVICE_TYPE;
 
+typedef enum _FIRESHOCK_SLOT_STATE
+{
+    //
+    // Never used, or used by a device whose address never became known
+    // 
+    FireShockSlotFree,
+
+    //
+    // Occupied by a connected device
+    // 
+    FireShockSlotConnected,
+
+    //
+    // Reserved for the device with Address until it comes back, or until
+    // the slot is needed for another one
+    // 
+    FireShockSlotDisconnected
+
+} FIRESHOCK_SLOT_STATE, *PFIRESHOCK_SLOT_STATE;
+
+/**
+* \typedef struct _FIRESHOCK_TOUCH_POINT
+*
+* \brief   A finger on the touchpad.
+*/
+typedef struct _FIRESHOCK_TOUCH_POINT
+{
+    BOOLEAN Active;
+
+    //
+    // Changes with every new touch
+    // 
+    UCHAR Id;
+
+    //
+    // 0 to 1919 (left to right) and 0 to 941 (top to bottom)
+    // 
+    USHORT X;
+
+    USHORT Y;
+
+} FIRESHOCK_TOUCH_POINT, *PFIRESHOCK_TOUCH_POINT;
+
+/**
+* \typedef struct _FIRESHOCK_CONTROLLER_STATE
+*
+* \brief   Decoded controller state, identical for every supported device.
+*          Delivered instead of the raw report if FIRESHOCK_REPORT_FORMAT_NORMALIZED
+*          is set on the handle.
+*/
+typedef struct _FIRESHOCK_CONTROLLER_STATE
+{
+    //
+    // FIRESHOCK_BUTTON_* bits
+    // 
+    ULONG Buttons;
+
+    //
+    // Stick axes, 0x00 (left/up) to 0xFF (right/down)
+    // 
+    UCHAR LeftThumbX;
+
+    UCHAR LeftThumbY;
+
+    UCHAR RightThumbX;
+
+    UCHAR RightThumbY;
+
+    UCHAR LeftTrigger;
+
+    UCHAR RightTrigger;
+
+    //
+    // Analog button values indexed by FIRESHOCK_PRESSURE_*, zero if unsupported
+    // 
+    UCHAR Pressure[FIRESHOCK_PRESSURE_COUNT];
+
+    //
+    // Acceleration (X, Y, Z), zero at rest on the respective axis. Calibrated
+    // devices report 8192 per g.
+    // 
+    LONG Accelerometer[3];
+
+    //
+    // Angular velocity (pitch, yaw, roll), zero if unsupported. Calibrated
+    // devices report 1024 per degree per second.
+    // 
+    LONG Gyroscope[3];
+
+    //
+    // Touchpad contacts, inactive if unsupported
+    // 
+    FIRESHOCK_TOUCH_POINT Touch[FIRESHOCK_TOUCH_POINT_COUNT];
+
+} FIRESHOCK_CONTROLLER_STATE, *PFIRESHOCK_CONTROLLER_STATE;
+
 
 typedef struct _FIRESHOCK_GET_HOST_BD_ADDR
 {
@@ -96,4 +456,594 @@ typedef struct _FIRESHOCK_GET_DEVICE_TYPE
 
 } FIRESHOCK_GET_DEVICE_TYPE, *PFIRESHOCK_GET_DEVICE_TYPE;
 
+typedef struct _FIRESHOCK_GET_DEVICE_INDEX
+{
+    ULONG DeviceIndex;
+
+} FIRESHOCK_GET_DEVICE_INDEX, *PFIRESHOCK_GET_DEVICE_INDEX;
+
+typedef struct _FIRESHOCK_SLOT
+{
+    FIRESHOCK_SLOT_STATE State;
+
+    //
+    // Type of the device last occupying the slot
+    // 
+    DS_DEVICE_TYPE DeviceType;
+
+    //
+    // Address the slot is kept for, if known
+    // 
+    BOOLEAN AddressValid;
+
+    BD_ADDR Address;
+
+} FIRESHOCK_SLOT, *PFIRESHOCK_SLOT;
+
+/**
+* \typedef struct _FIRESHOCK_GET_SLOTS
+*
+* \brief   Output of IOCTL_FIRESHOCK_GET_SLOTS.
+*/
+typedef struct _FIRESHOCK_GET_SLOTS
+{
+    //
+    // Connected devices, including those without a slot
+    // 
+    ULONG DeviceCount;
+
+    FIRESHOCK_SLOT Slots[FIRESHOCK_SLOT_COUNT];
+
+} FIRESHOCK_GET_SLOTS, *PFIRESHOCK_GET_SLOTS;
+
+typedef enum _FIRESHOCK_READ_MODE
+{
+    //
+    // Every report gets delivered in order of arrival (default)
+    // 
+    FireShockReadModeQueued,
+
+    //
+    // Only the most recent report gets delivered, and only once
+    // 
+    FireShockReadModeLatest
+
+} FIRESHOCK_READ_MODE, *PFIRESHOCK_READ_MODE;
+
+typedef struct _FIRESHOCK_SET_READ_MODE
+{
+    FIRESHOCK_READ_MODE ReadMode;
+
+} FIRESHOCK_SET_READ_MODE, *PFIRESHOCK_SET_READ_MODE;
+
+typedef struct _FIRESHOCK_SET_REPORT_FORMAT
+{
+    ULONG Flags;
+
+} FIRESHOCK_SET_REPORT_FORMAT, *PFIRESHOCK_SET_REPORT_FORMAT;
+
+/**
+* \typedef struct _FIRESHOCK_SET_CHANGE_FILTER
+*
+* \brief   Input of IOCTL_FIRESHOCK_SET_CHANGE_FILTER. A report is delivered if
+*          any button changed, any stick, trigger or pressure value moved by
+*          more than AxisThreshold or KeepAliveInterval has passed.
+*/
+typedef struct _FIRESHOCK_SET_CHANGE_FILTER
+{
+    BOOLEAN Enabled;
+
+    UCHAR AxisThreshold;
+
+    //
+    // Milliseconds after which a report gets delivered unchanged, 0 disables
+    // 
+    ULONG KeepAliveInterval;
+
+} FIRESHOCK_SET_CHANGE_FILTER, *PFIRESHOCK_SET_CHANGE_FILTER;
+
+/**
+* \typedef struct _FIRESHOCK_OUTPUT_STATISTICS
+*
+* \brief   Output of IOCTL_FIRESHOCK_GET_OUTPUT_STATISTICS, counted since the
+*          device was started.
+*/
+typedef struct _FIRESHOCK_OUTPUT_STATISTICS
+{
+    //
+    // Output reports written by clients
+    // 
+    ULONG Submitted;
+
+    //
+    // Writes identical to what the device already had, never sent
+    // 
+    ULONG Absorbed;
+
+    //
+    // Reports replaced by a newer one before they could be sent
+    // 
+    ULONG Coalesced;
+
+    //
+    // Transfers sent to the device
+    // 
+    ULONG Sent;
+
+    //
+    // Transfers that failed or got cancelled
+    // 
+    ULONG Failed;
+
+} FIRESHOCK_OUTPUT_STATISTICS, *PFIRESHOCK_OUTPUT_STATISTICS;
+
+typedef struct _FIRESHOCK_GET_FEATURE_CACHE
+{
+    //
+    // FIRESHOCK_FEATURE_* values currently cached
+    // 
+    ULONG Valid;
+
+} FIRESHOCK_GET_FEATURE_CACHE, *PFIRESHOCK_GET_FEATURE_CACHE;
+
+typedef struct _FIRESHOCK_INVALIDATE_FEATURE_CACHE
+{
+    //
+    // FIRESHOCK_FEATURE_* values to refetch
+    // 
+    ULONG Features;
+
+} FIRESHOCK_INVALIDATE_FEATURE_CACHE, *PFIRESHOCK_INVALIDATE_FEATURE_CACHE;
+
+/**
+* \typedef struct _FIRESHOCK_STARTUP_TIMING
+*
+* \brief   Milliseconds from hardware preparation to the given event, 0 if it
+*          didn't happen yet.
+*/
+typedef struct _FIRESHOCK_STARTUP_TIMING
+{
+    //
+    // First interrupt-in transfer completed
+    // 
+    ULONG TimeToFirstReport;
+
+    //
+    // Feature data (addresses, calibration) fetched
+    // 
+    ULONG TimeToFeatures;
+
+} FIRESHOCK_STARTUP_TIMING, *PFIRESHOCK_STARTUP_TIMING;
+
+/**
+* \typedef struct _FIRESHOCK_HISTOGRAM
+*
+* \brief   Distribution of a duration in microseconds.
+*/
+typedef struct _FIRESHOCK_HISTOGRAM
+{
+    //
+    // Number of samples, Min and Max are 0 if there are none
+    // 
+    ULONG Count;
+
+    ULONG Min;
+
+    ULONG Max;
+
+    //
+    // Sum of all samples
+    // 
+    ULONGLONG Total;
+
+    ULONG Buckets[FIRESHOCK_LATENCY_BUCKET_COUNT];
+
+} FIRESHOCK_HISTOGRAM, *PFIRESHOCK_HISTOGRAM;
+
+/**
+* \typedef struct _FIRESHOCK_COUNTERS
+*
+* \brief   Hot path counters since the device got added. Fields only ever get
+*          appended, check Version and Size before reading newer ones.
+*/
+typedef struct _FIRESHOCK_COUNTERS
+{
+    //
+    // FIRESHOCK_COUNTERS_VERSION
+    // 
+    ULONG Version;
+
+    //
+    // Size of this structure in bytes
+    // 
+    ULONG Size;
+
+    //
+    // Interrupt-in transfers completed successfully
+    // 
+    ULONGLONG ReportsReceived;
+
+    //
+    // Reports handed to a client read
+    // 
+    ULONGLONG ReportsDelivered;
+
+    //
+    // Reports that arrived while no read was pending
+    // 
+    ULONGLONG ReportsNoReadPending;
+
+    ULONGLONG BytesReceived;
+
+    ULONGLONG BytesDelivered;
+
+    //
+    // Output reports written by clients
+    // 
+    ULONGLONG OutputWrites;
+
+    //
+    // Output transfers sent to the device
+    // 
+    ULONGLONG OutputSent;
+
+    //
+    // Output reports replaced by a newer one before they could be sent
+    // 
+    ULONGLONG OutputCoalesced;
+
+    //
+    // Control transfers sent through the preallocated pool, synchronous
+    // and asynchronous ones, and their latency in microseconds
+    // 
+    ULONGLONG ControlTransfers;
+
+    ULONG ControlTransferLatencyMin;
+
+    ULONG ControlTransferLatencyAvg;
+
+    ULONG ControlTransferLatencyMax;
+
+    ULONG ControlTransferLatency[FIRESHOCK_LATENCY_BUCKET_COUNT];
+
+    //
+    // Times the continuous reader gave up
+    // 
+    ULONG ReadersFailed;
+
+    //
+    // Milliseconds since the device last entered D0, 0 while powered down
+    // 
+    ULONG TimeSinceD0Entry;
+
+    //
+    // Times input flowed again after the continuous reader gave up, and
+    // the interrupt-in pipe resets it took (version 2)
+    // 
+    ULONG ReaderRecoveries;
+
+    ULONG PipeResets;
+
+    //
+    // Milliseconds from the first failure to the next report received
+    // 
+    ULONG LastTimeToRecover;
+
+    ULONG MaxTimeToRecover;
+
+    //
+    // Time from request arrival to dispatch, per FIRESHOCK_QUEUE_CLASS_*
+    // (version 3)
+    // 
+    FIRESHOCK_HISTOGRAM QueueWait[FIRESHOCK_QUEUE_CLASS_COUNT];
+
+    //
+    // Latency percentiles in microseconds, interpolated within the histogram
+    // bucket they fall into and that bucket's range narrowed to the observed
+    // minimum and maximum (version 4). The error is below the width of that
+    // range, at most 2^(n-1) - 1 for values from 2^(n-1) to 2^n - 1, and
+    // mostly far less: inter-arrival times of a steady 1 ms report rate
+    // come out within their spread around 1000.
+    // 
+    ULONG InputDeliveryP50;
+
+    ULONG InputDeliveryP99;
+
+    ULONG InputInterArrivalP50;
+
+    ULONG InputInterArrivalP99;
+
+    ULONG ControlTransferLatencyP50;
+
+    ULONG ControlTransferLatencyP99;
+
+} FIRESHOCK_COUNTERS, *PFIRESHOCK_COUNTERS;
+
+typedef struct _FIRESHOCK_GET_INPUT_TIMING
+{
+    //
+    // Start over once the current values are returned
+    // 
+    BOOLEAN Reset;
+
+} FIRESHOCK_GET_INPUT_TIMING, *PFIRESHOCK_GET_INPUT_TIMING;
+
+typedef struct _FIRESHOCK_INPUT_TIMING
+{
+    //
+    // Time between consecutive interrupt-in transfers
+    // 
+    FIRESHOCK_HISTOGRAM InterArrival;
+
+    //
+    // Time from interrupt-in completion to the report reaching a client
+    // 
+    FIRESHOCK_HISTOGRAM Delivery;
+
+} FIRESHOCK_INPUT_TIMING, *PFIRESHOCK_INPUT_TIMING;
+
+typedef struct _FIRESHOCK_SET_CAPTURE
+{
+    //
+    // Enabling discards anything recorded but not read yet
+    // 
+    BOOLEAN Enabled;
+
+} FIRESHOCK_SET_CAPTURE, *PFIRESHOCK_SET_CAPTURE;
+
+/**
+* \typedef struct _FIRESHOCK_CAPTURE_HEADER
+*
+* \brief   Starts a traffic capture.
+*/
+typedef struct _FIRESHOCK_CAPTURE_HEADER
+{
+    //
+    // FIRESHOCK_CAPTURE_MAGIC
+    // 
+    ULONG Magic;
+
+    //
+    // FIRESHOCK_CAPTURE_VERSION
+    // 
+    USHORT Version;
+
+    //
+    // DS_DEVICE_TYPE of the recorded device
+    // 
+    USHORT DeviceType;
+
+    //
+    // Performance counter frequency the record timestamps are based on
+    // 
+    LONGLONG Frequency;
+
+} FIRESHOCK_CAPTURE_HEADER, *PFIRESHOCK_CAPTURE_HEADER;
+
+/**
+* \typedef struct _FIRESHOCK_CAPTURE_RECORD
+*
+* \brief   A single transfer in a traffic capture.
+*/
+typedef struct _FIRESHOCK_CAPTURE_RECORD
+{
+    //
+    // Size of the record including the payload
+    // 
+    USHORT Size;
+
+    //
+    // FIRESHOCK_CAPTURE_RECORD_*
+    // 
+    UCHAR Type;
+
+    UCHAR Reserved;
+
+    //
+    // Completion status of the transfer
+    // 
+    LONG Status;
+
+    //
+    // Performance counter value at completion
+    // 
+    LONGLONG Timestamp;
+
+    //
+    // Setup packet of control transfers, zero otherwise
+    // 
+    UCHAR Setup[8];
+
+    //
+    // Data transferred, for lost records the ULONG count of records dropped
+    // 
+    UCHAR Payload[1];
+
+} FIRESHOCK_CAPTURE_RECORD, *PFIRESHOCK_CAPTURE_RECORD;
+
+#define FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE    FIELD_OFFSET(FIRESHOCK_CAPTURE_RECORD, Payload)
+
+/**
+* \typedef struct _FIRESHOCK_REPORT_ENVELOPE
+*
+* \brief   Delivery metadata preceding an input report.
+*/
+typedef struct _FIRESHOCK_REPORT_ENVELOPE
+{
+    //
+    // QueryPerformanceCounter() value taken when the interrupt transfer completed
+    // 
+    LONGLONG Timestamp;
+
+    //
+    // Monotonic report sequence number (per device), gaps indicate lost reports
+    // 
+    ULONG Sequence;
+
+    //
+    // Bytes actually transferred by the device
+    // 
+    ULONG Length;
+
+} FIRESHOCK_REPORT_ENVELOPE, *PFIRESHOCK_REPORT_ENVELOPE;
+
+typedef struct _FIRESHOCK_INPUT_BATCH_ENTRY
+{
+    FIRESHOCK_REPORT_ENVELOPE Envelope;
+
+    UCHAR Report[FIRESHOCK_INPUT_REPORT_LENGTH];
+
+} FIRESHOCK_INPUT_BATCH_ENTRY, *PFIRESHOCK_INPUT_BATCH_ENTRY;
+
+/**
+* \typedef struct _FIRESHOCK_INPUT_BATCH
+*
+* \brief   Output of IOCTL_FIRESHOCK_READ_INPUT_BATCH, the output buffer length
+*          determines the maximum number of entries returned.
+*/
+typedef struct _FIRESHOCK_INPUT_BATCH
+{
+    //
+    // Number of valid entries
+    // 
+    ULONG Count;
+
+    //
+    // Reports this handle lost to backlog overflow since its last batch
+    // 
+    ULONG Dropped;
+
+    FIRESHOCK_INPUT_BATCH_ENTRY Entries[1];
+
+} FIRESHOCK_INPUT_BATCH, *PFIRESHOCK_INPUT_BATCH;
+
+typedef struct _FIRESHOCK_AGGREGATED_ENTRY
+{
+    //
+    // Device the report came from (IOCTL_FIRESHOCK_GET_DEVICE_INDEX)
+    // 
+    ULONG DeviceIndex;
+
+    FIRESHOCK_REPORT_ENVELOPE Envelope;
+
+    UCHAR Report[FIRESHOCK_INPUT_REPORT_LENGTH];
+
+} FIRESHOCK_AGGREGATED_ENTRY, *PFIRESHOCK_AGGREGATED_ENTRY;
+
+/**
+* \typedef struct _FIRESHOCK_AGGREGATED_BATCH
+*
+* \brief   Output of IOCTL_FIRESHOCK_READ_AGGREGATED, the output buffer length
+*          determines the maximum number of entries returned.
+*/
+typedef struct _FIRESHOCK_AGGREGATED_BATCH
+{
+    //
+    // Number of valid entries
+    // 
+    ULONG Count;
+
+    //
+    // Reports lost to backlog overflow since the last batch
+    // 
+    ULONG Dropped;
+
+    FIRESHOCK_AGGREGATED_ENTRY Entries[1];
+
+} FIRESHOCK_AGGREGATED_BATCH, *PFIRESHOCK_AGGREGATED_BATCH;
+
+#ifdef _WIN32
 #include <poppack.h>
+#else
+#pragma pack(pop)
+#endif
+
+//
+// Shared-memory input ring
+// 
+// A client hands the driver a buffer via IOCTL_FIRESHOCK_MAP_INPUT_RING.
+// The driver is the only producer, the client the only consumer, so no
+// locks are required; Head and Tail are free-running counters, each one
+// written by exactly one side and living on its own cache line.
+// 
+// UMDF only maps whole pages into the driver host, anything else gets
+// silently copied and the client would watch a ring that never moves.
+// The buffer must therefore start on a FIRESHOCK_INPUT_RING_ALIGNMENT
+// boundary (VirtualAlloc does that) and span a multiple of it, the
+// driver rejects it with STATUS_INVALID_PARAMETER otherwise.
+// 
+#define FIRESHOCK_INPUT_RING_MAGIC          0x47525346 // "FSRG"
+#define FIRESHOCK_INPUT_RING_REPORT_LENGTH  FIRESHOCK_INPUT_REPORT_LENGTH
+#define FIRESHOCK_INPUT_RING_CACHE_LINE     0x40
+#define FIRESHOCK_INPUT_RING_ALIGNMENT      0x1000
+
+/**
+* \typedef struct _FIRESHOCK_INPUT_RING_ENTRY
+*
+* \brief   A single timestamped input report.
+*/
+typedef struct _FIRESHOCK_INPUT_RING_ENTRY
+{
+    //
+    // Performance counter value taken when the transfer completed
+    // 
+    LONGLONG Timestamp;
+
+    //
+    // Monotonic report sequence number (per device)
+    // 
+    ULONG Sequence;
+
+    //
+    // Valid bytes in Report
+    // 
+    ULONG Length;
+
+    UCHAR Report[FIRESHOCK_INPUT_RING_REPORT_LENGTH];
+
+} FIRESHOCK_INPUT_RING_ENTRY, *PFIRESHOCK_INPUT_RING_ENTRY;
+
+/**
+* \typedef struct _FIRESHOCK_INPUT_RING_HEADER
+*
+* \brief   Start of a mapped input ring, the entries follow directly.
+*/
+typedef struct _FIRESHOCK_INPUT_RING_HEADER
+{
+    ULONG Magic;
+
+    //
+    // Number of entries, always a power of two
+    // 
+    ULONG Capacity;
+
+    //
+    // Reports the producer discarded because the ring was full
+    // 
+    ULONG Dropped;
+
+    //
+    // Reports cut short to FIRESHOCK_INPUT_RING_REPORT_LENGTH
+    // 
+    ULONG Truncated;
+
+    UCHAR Reserved0[FIRESHOCK_INPUT_RING_CACHE_LINE - 4 * sizeof(ULONG)];
+
+    //
+    // Written by the driver only
+    // 
+    volatile ULONG Head;
+
+    UCHAR Reserved1[FIRESHOCK_INPUT_RING_CACHE_LINE - sizeof(ULONG)];
+
+    //
+    // Written by the client only
+    // 
+    volatile ULONG Tail;
+
+    UCHAR Reserved2[FIRESHOCK_INPUT_RING_CACHE_LINE - sizeof(ULONG)];
+
+} FIRESHOCK_INPUT_RING_HEADER, *PFIRESHOCK_INPUT_RING_HEADER;
+
+#define FIRESHOCK_INPUT_RING_MIN_LENGTH     (sizeof(FIRESHOCK_INPUT_RING_HEADER) + \
+                                                2 * sizeof(FIRESHOCK_INPUT_RING_ENTRY))
@@ -0,0 +1,235 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Histogram.h"
+
+#ifdef _WIN32
+#include <intrin.h>
+#endif
+
+#define HISTOGRAM_EMPTY_MIN     ((ULONG)~0)
+
+//
+// Number of significant bits in Value, i.e. the smallest n with Value < 2^n
+// 
+static __inline ULONG
+HistogramBitLength(
+    _In_ ULONG Value)
+{
+#ifdef _WIN32
+    unsigned long index;
+
+    return _BitScanReverse(&index, Value) ? index + 1 : 0;
+#else
+    return Value != 0 ? 32 - (ULONG)__builtin_clz(Value) : 0;
+#endif
+}
+
+VOID
+HistogramReset(
+    _Out_ PHISTOGRAM Histogram)
+{
+    RtlZeroMemory((PVOID)Histogram, sizeof(HISTOGRAM));
+
+    Histogram->Min = HISTOGRAM_EMPTY_MIN;
+}
+
+VOID
+HistogramRecord(
+    _Inout_ PHISTOGRAM Histogram,
+    _In_ ULONGLONG Microseconds)
+{
+    ULONG   value = Microseconds < HISTOGRAM_EMPTY_MIN ? (ULONG)Microseconds : HISTOGRAM_EMPTY_MIN - 1;
+    ULONG   bucket = HistogramBitLength(value);
+    ULONG   current, previous;
+
+    if (bucket >= FIRESHOCK_LATENCY_BUCKET_COUNT)
+    {
+        bucket = FIRESHOCK_LATENCY_BUCKET_COUNT - 1;
+    }
+
+    FsInterlockedIncrement32(&Histogram->Buckets[bucket]);
+    FsInterlockedAdd64(&Histogram->Total, value);
+    FsInterlockedIncrement32(&Histogram->Count);
+
+    //
+    // Only contended while the extremes are still moving
+    // 
+    for (current = Histogram->Min; value < current; current = previous)
+    {
+        previous = FsInterlockedCompareExchange32(&Histogram->Min, value, current);
+
+        if (previous == current)
+        {
+            break;
+        }
+    }
+
+    for (current = Histogram->Max; value > current; current = previous)
+    {
+        previous = FsInterlockedCompareExchange32(&Histogram->Max, value, current);
+
+        if (previous == current)
+        {
+            break;
+        }
+    }
+}
+
+//
+// Copies the histogram out, if Reset is set every field gets swapped for
+// its initial value so no sample recorded concurrently is lost entirely.
+// 
+VOID
+HistogramSnapshot(
+    _Inout_ PHISTOGRAM Histogram,
+    _Out_ PFIRESHOCK_HISTOGRAM Snapshot,
+    _In_ BOOLEAN Reset)
+{
+    ULONG i;
+
+    if (Reset)
+    {
+        Snapshot->Count = FsInterlockedExchange32(&Histogram->Count, 0);
+        Snapshot->Min = FsInterlockedExchange32(&Histogram->Min, HISTOGRAM_EMPTY_MIN);
+        Snapshot->Max = FsInterlockedExchange32(&Histogram->Max, 0);
+        Snapshot->Total = FsInterlockedExchange64(&Histogram->Total, 0);
+
+        for (i = 0; i < FIRESHOCK_LATENCY_BUCKET_COUNT; i++)
+        {
+            Snapshot->Buckets[i] = FsInterlockedExchange32(&Histogram->Buckets[i], 0);
+        }
+    }
+    else
+    {
+        Snapshot->Count = FsReadAcquire32(&Histogram->Count);
+        Snapshot->Min = FsReadAcquire32(&Histogram->Min);
+        Snapshot->Max = FsReadAcquire32(&Histogram->Max);
+        Snapshot->Total = FsInterlockedAdd64(&Histogram->Total, 0);
+
+        for (i = 0; i < FIRESHOCK_LATENCY_BUCKET_COUNT; i++)
+        {
+            Snapshot->Buckets[i] = FsReadAcquire32(&Histogram->Buckets[i]);
+        }
+    }
+
+    if (Snapshot->Min == HISTOGRAM_EMPTY_MIN)
+    {
+        Snapshot->Min = 0;
+    }
+}
+
+//
+// Estimates the value Percent percent of the samples don't exceed. 0 while
+// empty.
+// 
+// Buckets only tell the order of magnitude, so the samples are taken as
+// evenly spread over the range of the bucket the percentile falls into,
+// narrowed to the observed Min and Max. The estimate is off by less than
+// the width of that range: at most 2^(n-1) - 1 microseconds for a value
+// of 2^(n-1) to 2^n - 1 microseconds, a lot less when the samples sit
+// close together like those of a steady report rate.
+// 
+ULONG
+HistogramPercentile(
+    _In_ const FIRESHOCK_HISTOGRAM *Snapshot,
+    _In_ ULONG Percent)
+{
+    ULONGLONG   rank;
+    ULONGLONG   seen = 0;
+    ULONG       bucket;
+    ULONG       count;
+    ULONG       lower;
+    ULONG       upper;
+
+    if (Snapshot->Count == 0)
+    {
+        return 0;
+    }
+
+    rank = ((ULONGLONG)Snapshot->Count * min(Percent, 100) + 99) / 100;
+    rank = max(rank, 1);
+
+    for (bucket = 0; bucket < FIRESHOCK_LATENCY_BUCKET_COUNT; bucket++)
+    {
+        if (seen + Snapshot->Buckets[bucket] >= rank)
+        {
+            break;
+        }
+
+        seen += Snapshot->Buckets[bucket];
+    }
+
+    //
+    // Buckets may not add up to Count in a snapshot taken while samples
+    // were being recorded
+    // 
+    if (bucket == FIRESHOCK_LATENCY_BUCKET_COUNT)
+    {
+        return Snapshot->Max;
+    }
+
+    //
+    // Bucket n holds the values of bit length n, the last one is open-ended
+    // 
+    lower = (bucket == 0) ? 0 : 1UL << (bucket - 1);
+    upper = (bucket == 0) ? 0 : (bucket == FIRESHOCK_LATENCY_BUCKET_COUNT - 1) ? Snapshot->Max : (1UL << bucket) - 1;
+
+    lower = max(lower, Snapshot->Min);
+    upper = min(upper, Snapshot->Max);
+
+    if (lower >= upper)
+    {
+        return min(lower, Snapshot->Max);
+    }
+
+    count = Snapshot->Buckets[bucket];
+    rank -= seen;
+
+    if (count == 1)
+    {
+        //
+        // The only sample is the minimum or maximum if either falls into
+        // the bucket
+        // 
+        if (lower == Snapshot->Min)
+        {
+            return lower;
+        }
+
+        if (upper == Snapshot->Max)
+        {
+            return upper;
+        }
+
+        return lower + (upper - lower) / 2;
+    }
+
+    //
+    // The first sample of the bucket at lower, the last at upper
+    // 
+    return lower + (ULONG)((ULONGLONG)(upper - lower) * (rank - 1) / (count - 1));
+}
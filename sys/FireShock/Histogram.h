@@ -0,0 +1,74 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include "Portable.h"
+#include "FireShock.h"
+
+//
+// Lock-free duration histogram
+// 
+// Samples may be recorded from any number of threads at once without
+// synchronization. A snapshot taken meanwhile reads each field on its
+// own and is therefore only consistent to within the samples in flight.
+// 
+typedef struct _HISTOGRAM
+{
+    ULONG volatile Count;
+
+    //
+    // Smallest sample, ~0 while empty
+    // 
+    ULONG volatile Min;
+
+    ULONG volatile Max;
+
+    ULONGLONG volatile Total;
+
+    ULONG volatile Buckets[FIRESHOCK_LATENCY_BUCKET_COUNT];
+
+} HISTOGRAM, *PHISTOGRAM;
+
+VOID
+HistogramReset(
+    _Out_ PHISTOGRAM Histogram);
+
+VOID
+HistogramRecord(
+    _Inout_ PHISTOGRAM Histogram,
+    _In_ ULONGLONG Microseconds);
+
+VOID
+HistogramSnapshot(
+    _Inout_ PHISTOGRAM Histogram,
+    _Out_ PFIRESHOCK_HISTOGRAM Snapshot,
+    _In_ BOOLEAN Reset);
+
+ULONG
+HistogramPercentile(
+    _In_ const FIRESHOCK_HISTOGRAM *Snapshot,
+    _In_ ULONG Percent);
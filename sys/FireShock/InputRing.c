@@ -0,0 +1,171 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "InputRing.h"
+
+//
+// Prepares a client-supplied buffer as ring and attaches the producer to it.
+// 
+BOOLEAN
+InputRingAttach(
+    _Out_ PINPUT_RING Ring,
+    _In_ PVOID Buffer,
+    _In_ size_t BufferLength)
+{
+    PFIRESHOCK_INPUT_RING_HEADER    header;
+    size_t                          slots;
+    ULONG                           capacity = 1;
+
+    RtlZeroMemory(Ring, sizeof(INPUT_RING));
+
+    if (Buffer == NULL || BufferLength < FIRESHOCK_INPUT_RING_MIN_LENGTH)
+    {
+        return FALSE;
+    }
+
+    slots = (BufferLength - sizeof(FIRESHOCK_INPUT_RING_HEADER)) / sizeof(FIRESHOCK_INPUT_RING_ENTRY);
+
+    //
+    // Round down to a power of two so indexing is a simple mask
+    // 
+    while ((size_t)capacity * 2 <= slots && capacity < 0x80000000)
+    {
+        capacity *= 2;
+    }
+
+    header = (PFIRESHOCK_INPUT_RING_HEADER)Buffer;
+    RtlZeroMemory(header, sizeof(FIRESHOCK_INPUT_RING_HEADER));
+
+    header->Capacity = capacity;
+    header->Magic = FIRESHOCK_INPUT_RING_MAGIC;
+
+    Ring->Header = header;
+    Ring->Entries = (PFIRESHOCK_INPUT_RING_ENTRY)(header + 1);
+    Ring->Capacity = capacity;
+
+    return TRUE;
+}
+
+VOID
+InputRingDetach(
+    _Out_ PINPUT_RING Ring)
+{
+    RtlZeroMemory(Ring, sizeof(INPUT_RING));
+}
+
+BOOLEAN
+InputRingIsAttached(
+    _In_ PINPUT_RING Ring)
+{
+    return (Ring->Header != NULL);
+}
+
+BOOLEAN
+InputRingIsEmpty(
+    _In_ PINPUT_RING Ring)
+{
+    if (Ring->Header == NULL)
+    {
+        return TRUE;
+    }
+
+    return (FsReadAcquire32(&Ring->Header->Tail) == Ring->Head);
+}
+
+//
+// Publishes one report. Returns FALSE if the consumer fell behind and the
+// report had to be discarded; the consumer owns Tail, so the producer can
+// never make room by overwriting unread entries.
+// 
+BOOLEAN
+InputRingPush(
+    _Inout_ PINPUT_RING Ring,
+    _In_ LONGLONG Timestamp,
+    _In_ ULONG Sequence,
+    _In_reads_bytes_(Length) const VOID *Report,
+    _In_ size_t Length)
+{
+    PFIRESHOCK_INPUT_RING_ENTRY     entry;
+    ULONG                           tail;
+
+    if (Ring->Header == NULL)
+    {
+        return FALSE;
+    }
+
+    tail = FsReadAcquire32(&Ring->Header->Tail);
+
+    //
+    // Also covers a consumer that wrote garbage into Tail
+    // 
+    if ((ULONG)(Ring->Head - tail) >= Ring->Capacity)
+    {
+        Ring->Header->Dropped = ++Ring->Dropped;
+        return FALSE;
+    }
+
+    if (Length > FIRESHOCK_INPUT_RING_REPORT_LENGTH)
+    {
+        Ring->Header->Truncated = ++Ring->Truncated;
+        Length = FIRESHOCK_INPUT_RING_REPORT_LENGTH;
+    }
+
+    entry = &Ring->Entries[Ring->Head & (Ring->Capacity - 1)];
+
+    entry->Timestamp = Timestamp;
+    entry->Sequence = Sequence;
+    entry->Length = (ULONG)Length;
+    RtlCopyMemory(entry->Report, Report, Length);
+
+    FsWriteRelease32(&Ring->Header->Head, ++Ring->Head);
+
+    return TRUE;
+}
+
+BOOLEAN
+InputRingPop(
+    _Inout_ PFIRESHOCK_INPUT_RING_HEADER Header,
+    _Out_ PFIRESHOCK_INPUT_RING_ENTRY Entry)
+{
+    PFIRESHOCK_INPUT_RING_ENTRY     entries;
+    ULONG                           head;
+    ULONG                           tail;
+
+    head = FsReadAcquire32(&Header->Head);
+    tail = Header->Tail;
+
+    if (head == tail)
+    {
+        return FALSE;
+    }
+
+    entries = (PFIRESHOCK_INPUT_RING_ENTRY)(Header + 1);
+
+    RtlCopyMemory(Entry, &entries[tail & (Header->Capacity - 1)], sizeof(FIRESHOCK_INPUT_RING_ENTRY));
+
+    FsWriteRelease32(&Header->Tail, tail + 1);
+
+    return TRUE;
+}
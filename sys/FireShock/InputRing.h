@@ -0,0 +1,88 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "Portable.h"
+#include "FireShock.h"
+
+//
+// Shared-memory input ring, producer and consumer side of the layout
+// defined in FireShock.h
+// 
+
+//
+// Producer view of a mapped ring. Everything the producer relies on is
+// kept here instead of being re-read from memory the client can modify.
+// 
+typedef struct _INPUT_RING
+{
+    PFIRESHOCK_INPUT_RING_HEADER Header;
+
+    PFIRESHOCK_INPUT_RING_ENTRY Entries;
+
+    ULONG Capacity;
+
+    ULONG Head;
+
+    ULONG Dropped;
+
+    ULONG Truncated;
+
+} INPUT_RING, *PINPUT_RING;
+
+BOOLEAN
+InputRingAttach(
+    _Out_ PINPUT_RING Ring,
+    _In_ PVOID Buffer,
+    _In_ size_t BufferLength);
+
+VOID
+InputRingDetach(
+    _Out_ PINPUT_RING Ring);
+
+BOOLEAN
+InputRingIsAttached(
+    _In_ PINPUT_RING Ring);
+
+BOOLEAN
+InputRingIsEmpty(
+    _In_ PINPUT_RING Ring);
+
+BOOLEAN
+InputRingPush(
+    _Inout_ PINPUT_RING Ring,
+    _In_ LONGLONG Timestamp,
+    _In_ ULONG Sequence,
+    _In_reads_bytes_(Length) const VOID *Report,
+    _In_ size_t Length);
+
+//
+// Consumer side, used by clients on their own mapping
+// 
+BOOLEAN
+InputRingPop(
+    _Inout_ PFIRESHOCK_INPUT_RING_HEADER Header,
+    _Out_ PFIRESHOCK_INPUT_RING_ENTRY Entry);
@@ -0,0 +1,108 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+//
+// Modules including this header carry no framework dependencies so
+// they can be built and exercised outside of the driver host as well.
+// 
+#ifdef _WIN32
+
+#include <windows.h>
+
+#define FsReadAcquire32(_p_)            ((ULONG)ReadAcquire((LONG const volatile *)(_p_)))
+#define FsWriteRelease32(_p_, _v_)      WriteRelease((LONG volatile *)(_p_), (LONG)(_v_))
+
+#define FsInterlockedIncrement32(_p_)   ((ULONG)InterlockedIncrement((LONG volatile *)(_p_)))
+#define FsInterlockedExchange32(_p_, _v_) \
+    ((ULONG)InterlockedExchange((LONG volatile *)(_p_), (LONG)(_v_)))
+#define FsInterlockedCompareExchange32(_p_, _v_, _c_) \
+    ((ULONG)InterlockedCompareExchange((LONG volatile *)(_p_), (LONG)(_v_), (LONG)(_c_)))
+#define FsInterlockedAdd64(_p_, _v_)    InterlockedExchangeAdd64((LONG64 volatile *)(_p_), (LONG64)(_v_))
+#define FsInterlockedExchange64(_p_, _v_) \
+    ((ULONGLONG)InterlockedExchange64((LONG64 volatile *)(_p_), (LONG64)(_v_)))
+
+#else
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define VOID    void
+
+typedef void        *PVOID;
+typedef uint8_t     UCHAR, *PUCHAR;
+typedef uint8_t     BYTE, *PBYTE;
+typedef uint8_t     BOOLEAN, *PBOOLEAN;
+typedef int16_t     SHORT, *PSHORT;
+typedef uint16_t    USHORT, *PUSHORT;
+typedef int32_t     LONG, *PLONG;
+typedef uint32_t    ULONG, *PULONG;
+typedef int64_t     LONGLONG, *PLONGLONG;
+typedef uint64_t    ULONGLONG, *PULONGLONG;
+
+#ifndef TRUE
+#define TRUE    1
+#endif
+#ifndef FALSE
+#define FALSE   0
+#endif
+
+#ifndef _In_
+#define _In_
+#define _In_opt_
+#define _Out_
+#define _Inout_
+#define _In_reads_bytes_(_s_)
+#define _In_reads_(_s_)
+#define _Out_writes_(_s_)
+#endif
+
+#define RtlCopyMemory(_d_, _s_, _l_)    memcpy((_d_), (_s_), (_l_))
+#define RtlZeroMemory(_d_, _l_)         memset((_d_), 0, (_l_))
+
+#define FIELD_OFFSET(_t_, _f_)          ((LONG)offsetof(_t_, _f_))
+
+#define UNREFERENCED_PARAMETER(_p_)     ((void)(_p_))
+
+#ifndef min
+#define min(_a_, _b_)                   (((_a_) < (_b_)) ? (_a_) : (_b_))
+#define max(_a_, _b_)                   (((_a_) > (_b_)) ? (_a_) : (_b_))
+#endif
+
+#define FsReadAcquire32(_p_)            __atomic_load_n((_p_), __ATOMIC_ACQUIRE)
+#define FsWriteRelease32(_p_, _v_)      __atomic_store_n((_p_), (_v_), __ATOMIC_RELEASE)
+
+#define FsInterlockedIncrement32(_p_)   __atomic_add_fetch((_p_), 1, __ATOMIC_SEQ_CST)
+#define FsInterlockedExchange32(_p_, _v_) \
+    __atomic_exchange_n((_p_), (_v_), __ATOMIC_SEQ_CST)
+#define FsInterlockedCompareExchange32(_p_, _v_, _c_) \
+    __sync_val_compare_and_swap((_p_), (_c_), (_v_))
+#define FsInterlockedAdd64(_p_, _v_)    __atomic_fetch_add((_p_), (_v_), __ATOMIC_SEQ_CST)
+#define FsInterlockedExchange64(_p_, _v_) \
+    __atomic_exchange_n((_p_), (_v_), __ATOMIC_SEQ_CST)
+
+#endif
@@ -54,6 +54,10 @@ FireShockEvtDevicePrepareHardware(
     UCHAR                                   index;
     WDFUSBPIPE                              pipe;
     WDF_USB_PIPE_INFORMATION                pipeInfo;
+    WDF_TIMER_CONFIG                        timerConfig;
+    LARGE_INTEGER                           timestamp;
+
+    DECLARE_CONST_UNICODE_STRING(outputReportPeriodValueName, L"OutputReportPeriod");
 
     UNREFERENCED_PARAMETER(ResourcesRaw);
     UNREFERENCED_PARAMETER(ResourcesTranslated);
@@ -62,6 +66,14 @@ FireShockEvtDevicePrepareHardware(
 
     pDeviceContext = DeviceGetContext(Device);
 
+    //
+    // Start of the time-to-first-report measurement
+    // 
+    QueryPerformanceCounter(&timestamp);
+    pDeviceContext->PrepareHardwareTimestamp = timestamp.QuadPart;
+    pDeviceContext->TimeToFirstReport = 0;
+    pDeviceContext->TimeToFeatures = 0;
+
     if (pDeviceContext->UsbDevice == NULL) {
 
         status = WdfUsbTargetDeviceCreate(Device,
@@ -136,6 +148,39 @@ FireShockEvtDevicePrepareHardware(
         };
 
         RtlCopyMemory(pDs4Context->OutputReportBuffer, DefaultOutputReport, DS4_HID_OUTPUT_REPORT_SIZE);
+        pDs4Context->OutputReportDirty = TRUE;
+
+        pDs4Context->OutputReportPeriod = FireShockQueryDeviceSetting(
+            Device,
+            &outputReportPeriodValueName,
+            DS4_DEFAULT_OUTPUT_REPORT_PERIOD);
+
+        if (pDs4Context->OutputReportPeriod < 1 || pDs4Context->OutputReportPeriod > DS4_MAX_OUTPUT_REPORT_PERIOD)
+        {
+            pDs4Context->OutputReportPeriod = DS4_DEFAULT_OUTPUT_REPORT_PERIOD;
+        }
+
+        //
+        // Flushes the output report buffer to the device when it changed
+        // 
+        if (pDs4Context->OutputReportTimer == NULL)
+        {
+            WDF_TIMER_CONFIG_INIT_PERIODIC(
+                &timerConfig,
+                Ds4EvtOutputReportTimerFunc,
+                pDs4Context->OutputReportPeriod);
+
+            WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+            attributes.ParentObject = Device;
+
+            status = WdfTimerCreate(&timerConfig, &attributes, &pDs4Context->OutputReportTimer);
+            if (!NT_SUCCESS(status))
+            {
+                TraceEvents(TRACE_LEVEL_ERROR, TRACE_POWER,
+                    "WdfTimerCreate failed status %!STATUS!", status);
+                return status;
+            }
+        }
     }
 
 #pragma endregion
@@ -209,6 +254,26 @@ FireShockEvtDevicePrepareHardware(
 
     status = DsUsbConfigContReaderForInterruptEndPoint(Device);
 
+    if (NT_SUCCESS(status))
+    {
+        status = DsUsbOutputInitialize(Device);
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        status = DsUsbControlPoolInitialize(Device);
+    }
+
+    if (NT_SUCCESS(status) && pDeviceContext->DeviceType == DualShock4)
+    {
+        status = Ds4OutputInitialize(Device);
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        status = DsUsbSimulatorInitialize(Device);
+    }
+
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_POWER, "%!FUNC! Exit (%!STATUS!)", status);
 
     return status;
@@ -222,15 +287,14 @@ NTSTATUS FireShockEvtDeviceD0Entry(
     PDEVICE_CONTEXT         pDeviceContext;
     NTSTATUS                status;
     BOOLEAN                 isTargetStarted;
-    UCHAR                   controlTransferBuffer[CONTROL_TRANSFER_BUFFER_LENGTH];
+    PDS4_DEVICE_CONTEXT     pDs4Context;
+    LARGE_INTEGER           timestamp;
 
     pDeviceContext = DeviceGetContext(Device);
     isTargetStarted = FALSE;
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_POWER, "%!FUNC! Entry");
 
-    UNREFERENCED_PARAMETER(PreviousState);
-
     //
     // Since continuous reader is configured for this interrupt-pipe, we must explicitly start
     // the I/O target to get the framework to post read requests.
@@ -241,13 +305,36 @@ NTSTATUS FireShockEvtDeviceD0Entry(
         goto End;
     }
 
+    isTargetStarted = TRUE;
+
     status = WdfIoTargetStart(WdfUsbTargetPipeGetIoTarget(pDeviceContext->InterruptWritePipe));
     if (!NT_SUCCESS(status)) {
         TraceEvents(TRACE_LEVEL_ERROR, TRACE_POWER, "Failed to start interrupt write pipe %!STATUS!\n", status);
         goto End;
     }
 
-    isTargetStarted = TRUE;
+    QueryPerformanceCounter(&timestamp);
+    InterlockedExchange64(&pDeviceContext->Counters.D0EntryTimestamp, timestamp.QuadPart);
+
+    FireShockEventD0Entry(pDeviceContext, PreviousState, timestamp.QuadPart);
+
+    DsUsbReaderRecoveryStart(pDeviceContext);
+    DsUsbSimulatorStart(pDeviceContext);
+
+    if (pDeviceContext->DeviceType == DualShock3)
+    {
+        //
+        // Input starts flowing with this, anything else can wait
+        // 
+        status = Ds3Init(pDeviceContext);
+
+        if (!NT_SUCCESS(status))
+        {
+            TraceEvents(TRACE_LEVEL_ERROR, TRACE_POWER,
+                "Ds3Init failed with status %!STATUS!",
+                status);
+        }
+    }
 
 End:
 
@@ -257,69 +344,34 @@ End:
         // reader in preparation for the ensuing remove.
         //
         if (isTargetStarted) {
+            DsUsbReaderRecoveryStop(pDeviceContext);
+            DsUsbSimulatorStop(pDeviceContext);
+
+            InterlockedExchange64(&pDeviceContext->Counters.D0EntryTimestamp, 0);
+
             WdfIoTargetStop(WdfUsbTargetPipeGetIoTarget(pDeviceContext->InterruptReadPipe), WdfIoTargetCancelSentIo);
             WdfIoTargetStop(WdfUsbTargetPipeGetIoTarget(pDeviceContext->InterruptWritePipe), WdfIoTargetCancelSentIo);
         }
+
+        return status;
     }
 
     switch (pDeviceContext->DeviceType)
     {
     case DualShock3:
 
-        status = Ds3Init(pDeviceContext);
-
-        if (!NT_SUCCESS(status))
-        {
-            TraceEvents(TRACE_LEVEL_ERROR, TRACE_POWER,
-                "Ds3Init failed with status %!STATUS!",
-                status);
-        }
-        else
-        {
-            status = SendControlRequest(
-                pDeviceContext,
-                BmRequestDeviceToHost,
-                BmRequestClass,
-                GetReport,
-                Ds3FeatureDeviceAddress,
-                0,
-                controlTransferBuffer,
-                CONTROL_TRANSFER_BUFFER_LENGTH);
+        FireShockStartFeatureFetch(Device, FIRESHOCK_FEATURE_DEVICE_ADDRESS | FIRESHOCK_FEATURE_HOST_ADDRESS);
 
-            if (!NT_SUCCESS(status))
-            {
-                TraceEvents(TRACE_LEVEL_ERROR, TRACE_POWER,
-                    "Requesting device address failed with %!STATUS!", status);
-                return status;
-            }
+        break;
+    case DualShock4:
 
-            RtlCopyMemory(
-                &pDeviceContext->DeviceAddress,
-                &controlTransferBuffer[4],
-                sizeof(BD_ADDR));
-
-            status = SendControlRequest(
-                pDeviceContext,
-                BmRequestDeviceToHost,
-                BmRequestClass,
-                GetReport,
-                Ds3FeatureHostAddress,
-                0,
-                controlTransferBuffer,
-                CONTROL_TRANSFER_BUFFER_LENGTH);
+        pDs4Context = Ds4GetContext(Device);
 
-            if (!NT_SUCCESS(status))
-            {
-                TraceEvents(TRACE_LEVEL_ERROR, TRACE_POWER,
-                    "Requesting device address failed with %!STATUS!", status);
-                return status;
-            }
+        FireShockStartFeatureFetch(Device, FIRESHOCK_FEATURE_CALIBRATION);
 
-            RtlCopyMemory(
-                &pDeviceContext->HostAddress,
-                &controlTransferBuffer[2],
-                sizeof(BD_ADDR));
-        }
+        WdfTimerStart(
+            pDs4Context->OutputReportTimer,
+            WDF_REL_TIMEOUT_IN_MS(pDs4Context->OutputReportPeriod));
 
         break;
     default:
@@ -331,23 +383,166 @@ End:
     return status;
 }
 
+//
+// Queues fetching of whichever of the given static feature data isn't cached.
+// 
+VOID FireShockStartFeatureFetch(
+    _In_ WDFDEVICE  Device,
+    _In_ ULONG      Features
+)
+{
+    PDEVICE_CONTEXT pDeviceContext = DeviceGetContext(Device);
+
+    if ((pDeviceContext->FeatureCacheValid & Features) == Features)
+    {
+        return;
+    }
+
+    //
+    // Address requests arriving from now on wait for the work item
+    // 
+    WdfSpinLockAcquire(pDeviceContext->FeatureLock);
+    pDeviceContext->FeatureFetchPending = TRUE;
+    WdfSpinLockRelease(pDeviceContext->FeatureLock);
+
+    WdfWorkItemEnqueue(pDeviceContext->FeatureWorkItem);
+}
+
+//
+// Fetches static feature data off the D0Entry path, then releases the
+// requests that were waiting for it.
+// 
+VOID FireShockEvtFeatureFetchWorkItem(
+    _In_ WDFWORKITEM WorkItem
+)
+{
+    NTSTATUS                status = STATUS_SUCCESS;
+    WDFDEVICE               device;
+    PDEVICE_CONTEXT         pDeviceContext;
+    WDFREQUEST              request;
+    WDF_REQUEST_PARAMETERS  params;
+    LARGE_INTEGER           timestamp;
+    LARGE_INTEGER           frequency;
+
+    device = WdfWorkItemGetParentObject(WorkItem);
+    pDeviceContext = DeviceGetContext(device);
+
+    switch (pDeviceContext->DeviceType)
+    {
+    case DualShock3:
+        status = Ds3FetchAddresses(pDeviceContext);
+        break;
+    case DualShock4:
+        status = Ds4FetchCalibration(device);
+        break;
+    default:
+        break;
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_POWER,
+            "Fetching feature data failed with status %!STATUS!", status);
+    }
+
+    //
+    // Puts the device back into its previous slot
+    // 
+    FireShockDriverBindDevice(device);
+
+    QueryPerformanceCounter(&timestamp);
+    QueryPerformanceFrequency(&frequency);
+
+    WdfSpinLockAcquire(pDeviceContext->FeatureLock);
+
+    pDeviceContext->FeatureFetchPending = FALSE;
+
+    if (pDeviceContext->TimeToFeatures == 0)
+    {
+        pDeviceContext->TimeToFeatures = (ULONG)max(1,
+            (timestamp.QuadPart - pDeviceContext->PrepareHardwareTimestamp) * 1000 / frequency.QuadPart);
+    }
+
+    WdfSpinLockRelease(pDeviceContext->FeatureLock);
+
+    //
+    // Dispatch waiting requests again, they now find the data present.
+    // Only setting the host address needs the feature queue.
+    // 
+    while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(pDeviceContext->FeatureWaitQueue, &request)))
+    {
+        WDF_REQUEST_PARAMETERS_INIT(&params);
+        WdfRequestGetParameters(request, &params);
+
+        status = WdfRequestForwardToIoQueue(
+            request,
+            params.Parameters.DeviceIoControl.IoControlCode == IOCTL_FIRESHOCK_SET_HOST_BD_ADDR
+                ? pDeviceContext->FeatureQueue
+                : WdfDeviceGetDefaultQueue(device));
+
+        if (!NT_SUCCESS(status))
+        {
+            WdfRequestComplete(request, status);
+        }
+    }
+}
+
 NTSTATUS FireShockEvtDeviceD0Exit(
     _In_ WDFDEVICE              Device,
     _In_ WDF_POWER_DEVICE_STATE TargetState
 )
 {
     PDEVICE_CONTEXT         pDeviceContext;
-
-    UNREFERENCED_PARAMETER(TargetState);
+    LARGE_INTEGER           timestamp;
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_POWER, "%!FUNC! Entry");
 
     pDeviceContext = DeviceGetContext(Device);
 
+    QueryPerformanceCounter(&timestamp);
+
+    FireShockEventD0Exit(pDeviceContext, TargetState, timestamp.QuadPart);
+
+    DsUsbReaderRecoveryStop(pDeviceContext);
+    DsUsbSimulatorStop(pDeviceContext);
+
+    //
+    // No tick may start a write once the pipe is stopped
+    //
+    if (pDeviceContext->DeviceType == DualShock4)
+    {
+        WdfTimerStop(Ds4GetContext(Device)->OutputReportTimer, TRUE);
+    }
+
     WdfIoTargetStop(WdfUsbTargetPipeGetIoTarget(pDeviceContext->InterruptReadPipe), WdfIoTargetCancelSentIo);
     WdfIoTargetStop(WdfUsbTargetPipeGetIoTarget(pDeviceContext->InterruptWritePipe), WdfIoTargetCancelSentIo);
 
+    InterlockedExchange64(&pDeviceContext->Counters.D0EntryTimestamp, 0);
+
     WdfIoQueuePurgeSynchronously(pDeviceContext->IoReadQueue);
+    WdfIoQueuePurgeSynchronously(pDeviceContext->InputRingWaitQueue);
+
+    DsUsbOutputCancel(pDeviceContext);
+
+    WdfWorkItemFlush(pDeviceContext->FeatureWorkItem);
+
+    if (pDeviceContext->DeviceType == DualShock4)
+    {
+        //
+        // Device comes back with rumble and LEDs off, restore them
+        //
+        WdfSpinLockAcquire(pDeviceContext->OutputLock);
+        Ds4GetContext(Device)->OutputReportDirty = TRUE;
+        WdfSpinLockRelease(pDeviceContext->OutputLock);
+    }
+
+    //
+    // Reports from before the power transition are of no use anymore
+    //
+    WdfSpinLockAcquire(pDeviceContext->InputLock);
+    pDeviceContext->InputHistoryStart = pDeviceContext->InputSequence;
+    pDeviceContext->InputLatest = NULL;
+    WdfSpinLockRelease(pDeviceContext->InputLock);
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_POWER, "%!FUNC! Exit");
 
@@ -29,3 +29,9 @@ EVT_WDF_DEVICE_PREPARE_HARDWARE FireShockEvtDevicePrepareHardware;
 EVT_WDF_DEVICE_D0_ENTRY FireShockEvtDeviceD0Entry;
 EVT_WDF_DEVICE_D0_EXIT FireShockEvtDeviceD0Exit;
 
+EVT_WDF_WORKITEM FireShockEvtFeatureFetchWorkItem;
+
+VOID FireShockStartFeatureFetch(
+    _In_ WDFDEVICE  Device,
+    _In_ ULONG      Features
+);
@@ -38,9 +38,11 @@ Routine Description:
      The I/O dispatch callbacks for the frameworks device object
      are configured in this function.
 
-     A single default I/O Queue is configured for parallel request
-     processing, and a driver context memory allocation is created
-     to hold our structure QUEUE_CONTEXT.
+     Each class of requests gets its own queue so slow ones can't hold
+     up the others: IOCTLs land on the parallel default queue, which
+     forwards those talking to the device to the sequential feature queue.
+     Reads get a parallel queue, writes a sequential one to keep output
+     reports in order.
 
 Arguments:
 
@@ -55,6 +57,7 @@ Return Value:
     WDFQUEUE queue;
     NTSTATUS status;
     WDF_IO_QUEUE_CONFIG    queueConfig;
+    PDEVICE_CONTEXT pDeviceContext = DeviceGetContext(Device);
 
     //
     // Configure a default queue so that requests that are not
@@ -68,8 +71,70 @@ Return Value:
 
     queueConfig.EvtIoDeviceControl = FireShockEvtIoDeviceControl;
     queueConfig.EvtIoStop = FireShockEvtIoStop;
+
+    status = WdfIoQueueCreate(
+        Device,
+        &queueConfig,
+        WDF_NO_OBJECT_ATTRIBUTES,
+        &queue
+    );
+
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfIoQueueCreate failed %!STATUS!", status);
+        return status;
+    }
+
+    WDF_IO_QUEUE_CONFIG_INIT(
+        &queueConfig,
+        WdfIoQueueDispatchSequential
+    );
+
+    queueConfig.EvtIoDeviceControl = FireShockEvtIoDeviceControl;
+    queueConfig.EvtIoStop = FireShockEvtIoStop;
+
+    status = WdfIoQueueCreate(
+        Device,
+        &queueConfig,
+        WDF_NO_OBJECT_ATTRIBUTES,
+        &pDeviceContext->FeatureQueue
+    );
+
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfIoQueueCreate failed %!STATUS!", status);
+        return status;
+    }
+
+    WDF_IO_QUEUE_CONFIG_INIT(
+        &queueConfig,
+        WdfIoQueueDispatchParallel
+    );
+
     queueConfig.EvtIoRead = FireShockEvtIoRead;
+    queueConfig.EvtIoStop = FireShockEvtIoStop;
+
+    status = WdfIoQueueCreate(
+        Device,
+        &queueConfig,
+        WDF_NO_OBJECT_ATTRIBUTES,
+        &queue
+    );
+
+    if (NT_SUCCESS(status)) {
+        status = WdfDeviceConfigureRequestDispatching(Device, queue, WdfRequestTypeRead);
+    }
+
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "Creating the read queue failed %!STATUS!", status);
+        return status;
+    }
+
+    WDF_IO_QUEUE_CONFIG_INIT(
+        &queueConfig,
+        WdfIoQueueDispatchSequential
+    );
+
     queueConfig.EvtIoWrite = FireShockEvtIoWrite;
+    queueConfig.EvtIoStop = FireShockEvtIoStop;
 
     status = WdfIoQueueCreate(
         Device,
@@ -78,14 +143,70 @@ Return Value:
         &queue
     );
 
+    if (NT_SUCCESS(status)) {
+        status = WdfDeviceConfigureRequestDispatching(Device, queue, WdfRequestTypeWrite);
+    }
+
     if (!NT_SUCCESS(status)) {
-        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfIoQueueCreate failed %!STATUS!", status);
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "Creating the write queue failed %!STATUS!", status);
         return status;
     }
 
     return status;
 }
 
+//
+// Stamps requests on arrival, before they get queued
+// 
+VOID
+FireShockEvtIoInCallerContext(
+    _In_ WDFDEVICE Device,
+    _In_ WDFREQUEST Request
+)
+{
+    NTSTATUS        status;
+    LARGE_INTEGER   timestamp;
+
+    QueryPerformanceCounter(&timestamp);
+
+    RequestGetContext(Request)->ArrivalTimestamp = timestamp.QuadPart;
+
+    status = WdfDeviceEnqueueRequest(Device, Request);
+
+    if (!NT_SUCCESS(status))
+    {
+        WdfRequestComplete(Request, status);
+    }
+}
+
+//
+// Records the time a request spent queued, once
+// 
+VOID
+FireShockQueueRecordWait(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDFREQUEST Request,
+    _In_ ULONG Class
+)
+{
+    PREQUEST_CONTEXT    pRequestContext = RequestGetContext(Request);
+    LARGE_INTEGER       timestamp;
+
+    if (pRequestContext->ArrivalTimestamp == 0 || pRequestContext->WaitRecorded)
+    {
+        return;
+    }
+
+    QueryPerformanceCounter(&timestamp);
+
+    DsUsbCountersRecordInterval(
+        &Context->Counters.QueueWait[Class],
+        pRequestContext->ArrivalTimestamp,
+        timestamp.QuadPart);
+
+    pRequestContext->WaitRecorded = TRUE;
+}
+
 NTSTATUS
 FireShockIoReadQueueInitialize(
     WDFDEVICE Device
@@ -114,6 +235,63 @@ FireShockIoReadQueueInitialize(
         return status;
     }
 
+    WDF_IO_QUEUE_CONFIG_INIT(
+        &queueConfig,
+        WdfIoQueueDispatchManual
+    );
+
+    status = WdfIoQueueCreate(
+        Device,
+        &queueConfig,
+        WDF_NO_OBJECT_ATTRIBUTES,
+        &pDeviceContext->InputRingWaitQueue
+    );
+
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfIoQueueCreate failed %!STATUS!", status);
+        return status;
+    }
+
+    WDF_IO_QUEUE_CONFIG_INIT(
+        &queueConfig,
+        WdfIoQueueDispatchManual
+    );
+
+    status = WdfIoQueueCreate(
+        Device,
+        &queueConfig,
+        WDF_NO_OBJECT_ATTRIBUTES,
+        &pDeviceContext->FeatureWaitQueue
+    );
+
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfIoQueueCreate failed %!STATUS!", status);
+        return status;
+    }
+
+    WDF_IO_QUEUE_CONFIG_INIT(
+        &queueConfig,
+        WdfIoQueueDispatchManual
+    );
+
+    //
+    // Served with reports of the other devices, so it must keep delivering
+    // while this one idles in a low power state
+    // 
+    queueConfig.PowerManaged = WdfFalse;
+
+    status = WdfIoQueueCreate(
+        Device,
+        &queueConfig,
+        WDF_NO_OBJECT_ATTRIBUTES,
+        &pDeviceContext->AggregateWaitQueue
+    );
+
+    if (!NT_SUCCESS(status)) {
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE, "WdfIoQueueCreate failed %!STATUS!", status);
+        return status;
+    }
+
     return status;
 }
 
@@ -158,21 +336,92 @@ Return Value:
     PFIRESHOCK_GET_DEVICE_BD_ADDR   pGetDeviceAddr;
     PFIRESHOCK_SET_HOST_BD_ADDR     pSetHostAddr;
     PFIRESHOCK_GET_DEVICE_TYPE      pGetDeviceType;
-
-    TraceEvents(TRACE_LEVEL_INFORMATION,
+    PVOID                           pRingBuffer;
+    PFIRESHOCK_SET_READ_MODE        pSetReadMode;
+    PFIRESHOCK_SET_REPORT_FORMAT    pSetReportFormat;
+    PFIRESHOCK_SET_CHANGE_FILTER    pSetChangeFilter;
+    PFIRESHOCK_OUTPUT_STATISTICS    pOutputStatistics;
+    PFIRESHOCK_GET_FEATURE_CACHE    pGetFeatureCache;
+    PFIRESHOCK_INVALIDATE_FEATURE_CACHE pInvalidateFeatureCache;
+    PFIRESHOCK_STARTUP_TIMING       pStartupTiming;
+    PFIRESHOCK_COUNTERS             pCounters;
+    PFIRESHOCK_GET_INPUT_TIMING     pGetInputTiming;
+    PFIRESHOCK_INPUT_TIMING         pInputTiming;
+    PFIRESHOCK_SET_CAPTURE          pSetCapture;
+    PUCHAR                          pCapture;
+    PFIRESHOCK_GET_DEVICE_INDEX     pGetDeviceIndex;
+    PFIRESHOCK_AGGREGATED_BATCH     pAggregatedBatch;
+    PFIRESHOCK_GET_SLOTS            pGetSlots;
+    LARGE_INTEGER                   frequency;
+    BOOLEAN                         reset;
+    BOOLEAN                         feature;
+    BOOLEAN                         addresses;
+
+    TraceHotPath(TRACE_LEVEL_INFORMATION,
         TRACE_QUEUE,
         "%!FUNC! Queue 0x%p, Request 0x%p OutputBufferLength %d InputBufferLength %d IoControlCode %d",
         Queue, Request, (int)OutputBufferLength, (int)InputBufferLength, IoControlCode);
 
     pDeviceContext = DeviceGetContext(WdfIoQueueGetDevice(Queue));
 
+    feature = (IoControlCode == IOCTL_FIRESHOCK_SET_HOST_BD_ADDR);
+
+    addresses = (feature
+        || IoControlCode == IOCTL_FIRESHOCK_GET_HOST_BD_ADDR
+        || IoControlCode == IOCTL_FIRESHOCK_GET_DEVICE_BD_ADDR);
+
+    //
+    // Anything that may talk to the device gets out of the way of the rest
+    // 
+    if (feature && Queue != pDeviceContext->FeatureQueue)
+    {
+        status = WdfRequestForwardToIoQueue(Request, pDeviceContext->FeatureQueue);
+
+        if (!NT_SUCCESS(status))
+        {
+            WdfRequestComplete(Request, status);
+        }
+
+        return;
+    }
+
+    FireShockQueueRecordWait(
+        pDeviceContext,
+        Request,
+        feature ? FIRESHOCK_QUEUE_CLASS_FEATURE : FIRESHOCK_QUEUE_CLASS_CONTROL);
+
+    //
+    // Requests involving the addresses wait until they're fetched, reads
+    // of them are answered from the cache right here
+    // 
+    if (addresses)
+    {
+        WdfSpinLockAcquire(pDeviceContext->FeatureLock);
+
+        if (pDeviceContext->FeatureFetchPending)
+        {
+            status = WdfRequestForwardToIoQueue(Request, pDeviceContext->FeatureWaitQueue);
+
+            WdfSpinLockRelease(pDeviceContext->FeatureLock);
+
+            if (!NT_SUCCESS(status))
+            {
+                WdfRequestComplete(Request, status);
+            }
+
+            return;
+        }
+
+        WdfSpinLockRelease(pDeviceContext->FeatureLock);
+    }
+
     switch (IoControlCode)
     {
 #pragma region IOCTL_FIRESHOCK_GET_HOST_BD_ADDR
 
     case IOCTL_FIRESHOCK_GET_HOST_BD_ADDR:
 
-        TraceEvents(TRACE_LEVEL_INFORMATION,
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
             TRACE_QUEUE, "IOCTL_FIRESHOCK_GET_HOST_BD_ADDR");
 
         status = WdfRequestRetrieveOutputBuffer(
@@ -183,6 +432,13 @@ Return Value:
 
         if (NT_SUCCESS(status) && OutputBufferLength == sizeof(FIRESHOCK_GET_HOST_BD_ADDR))
         {
+            if (pDeviceContext->DeviceType == DualShock3
+                && !(pDeviceContext->FeatureCacheValid & FIRESHOCK_FEATURE_HOST_ADDRESS))
+            {
+                status = STATUS_DEVICE_NOT_READY;
+                break;
+            }
+
             transferred = OutputBufferLength;
             RtlCopyMemory(&pGetHostAddr->Host, &pDeviceContext->HostAddress, sizeof(BD_ADDR));
         }
@@ -195,7 +451,7 @@ Return Value:
 
     case IOCTL_FIRESHOCK_GET_DEVICE_BD_ADDR:
 
-        TraceEvents(TRACE_LEVEL_INFORMATION,
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
             TRACE_QUEUE, "IOCTL_FIRESHOCK_GET_DEVICE_BD_ADDR");
 
         status = WdfRequestRetrieveOutputBuffer(
@@ -206,6 +462,13 @@ Return Value:
 
         if (NT_SUCCESS(status) && OutputBufferLength == sizeof(FIRESHOCK_GET_DEVICE_BD_ADDR))
         {
+            if (pDeviceContext->DeviceType == DualShock3
+                && !(pDeviceContext->FeatureCacheValid & FIRESHOCK_FEATURE_DEVICE_ADDRESS))
+            {
+                status = STATUS_DEVICE_NOT_READY;
+                break;
+            }
+
             transferred = OutputBufferLength;
             RtlCopyMemory(&pGetDeviceAddr->Device, &pDeviceContext->DeviceAddress, sizeof(BD_ADDR));
         }
@@ -218,7 +481,7 @@ Return Value:
 
     case IOCTL_FIRESHOCK_SET_HOST_BD_ADDR:
 
-        TraceEvents(TRACE_LEVEL_INFORMATION,
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
             TRACE_QUEUE, "IOCTL_FIRESHOCK_SET_HOST_BD_ADDR");
 
         status = WdfRequestRetrieveInputBuffer(
@@ -252,6 +515,7 @@ Return Value:
             }
 
             RtlCopyMemory(&pDeviceContext->HostAddress, &pSetHostAddr->Host, sizeof(BD_ADDR));
+            InterlockedOr(&pDeviceContext->FeatureCacheValid, FIRESHOCK_FEATURE_HOST_ADDRESS);
         }
 
         break;
@@ -262,7 +526,7 @@ Return Value:
 
     case IOCTL_FIRESHOCK_GET_DEVICE_TYPE:
 
-        TraceEvents(TRACE_LEVEL_INFORMATION,
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
             TRACE_QUEUE, "IOCTL_FIRESHOCK_GET_DEVICE_TYPE");
 
         status = WdfRequestRetrieveOutputBuffer(
@@ -280,108 +544,721 @@ Return Value:
         break;
 
 #pragma endregion
-    }
 
-    WdfRequestCompleteWithInformation(Request, status, transferred);
-}
+#pragma region IOCTL_FIRESHOCK_MAP_INPUT_RING
 
-VOID
-FireShockEvtIoStop(
-    _In_ WDFQUEUE Queue,
-    _In_ WDFREQUEST Request,
-    _In_ ULONG ActionFlags
-)
-/*++
+    case IOCTL_FIRESHOCK_MAP_INPUT_RING:
 
-Routine Description:
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_MAP_INPUT_RING");
 
-    This event is invoked for a power-managed queue before the device leaves the working state (D0).
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            FIRESHOCK_INPUT_RING_MIN_LENGTH,
+            &pRingBuffer,
+            &bufferLength);
 
-Arguments:
+        if (!NT_SUCCESS(status))
+        {
+            break;
+        }
 
-    Queue -  Handle to the framework queue object that is associated with the
-             I/O request.
+        //
+        // Only whole pages are mapped, anything else would be a copy
+        // 
+        if (((ULONG_PTR)pRingBuffer & (FIRESHOCK_INPUT_RING_ALIGNMENT - 1)) != 0
+            || (bufferLength & (FIRESHOCK_INPUT_RING_ALIGNMENT - 1)) != 0)
+        {
+            status = STATUS_INVALID_PARAMETER;
+            break;
+        }
 
-    Request - Handle to a framework request object.
+        WdfSpinLockAcquire(pDeviceContext->InputLock);
 
-    ActionFlags - A bitwise OR of one or more WDF_REQUEST_STOP_ACTION_FLAGS-typed flags
-                  that identify the reason that the callback function is being called
-                  and whether the request is cancelable.
+        //
+        // One ring per device
+        // 
+        if (pDeviceContext->InputRingRequest != NULL)
+        {
+            status = STATUS_DEVICE_BUSY;
+        }
+        else if (!InputRingAttach(&pDeviceContext->InputRing, pRingBuffer, bufferLength))
+        {
+            status = STATUS_INVALID_PARAMETER;
+        }
+        else
+        {
+            status = WdfRequestMarkCancelableEx(Request, FireShockEvtInputRingRequestCancel);
 
-Return Value:
+            if (NT_SUCCESS(status))
+            {
+                pDeviceContext->InputRingRequest = Request;
+            }
+            else
+            {
+                InputRingDetach(&pDeviceContext->InputRing);
+            }
+        }
 
-    VOID
+        WdfSpinLockRelease(pDeviceContext->InputLock);
 
---*/
-{
-    TraceEvents(TRACE_LEVEL_INFORMATION,
-        TRACE_QUEUE,
-        "%!FUNC! Queue 0x%p, Request 0x%p ActionFlags %d",
-        Queue, Request, ActionFlags);
+        if (NT_SUCCESS(status))
+        {
+            //
+            // Stays pending until cancelled
+            // 
+            return;
+        }
 
-    //
-    // In most cases, the EvtIoStop callback function completes, cancels, or postpones
-    // further processing of the I/O request.
-    //
-    // Typically, the driver uses the following rules:
-    //
-    // - If the driver owns the I/O request, it either postpones further processing
-    //   of the request and calls WdfRequestStopAcknowledge, or it calls WdfRequestComplete
-    //   with a completion status value of STATUS_SUCCESS or STATUS_CANCELLED.
-    //  
-    //   The driver must call WdfRequestComplete only once, to either complete or cancel
-    //   the request. To ensure that another thread does not call WdfRequestComplete
-    //   for the same request, the EvtIoStop callback must synchronize with the driver's
-    //   other event callback functions, for instance by using interlocked operations.
-    //
-    // - If the driver has forwarded the I/O request to an I/O target, it either calls
-    //   WdfRequestCancelSentRequest to attempt to cancel the request, or it postpones
-    //   further processing of the request and calls WdfRequestStopAcknowledge.
-    //
-    // A driver might choose to take no action in EvtIoStop for requests that are
-    // guaranteed to complete in a small amount of time. For example, the driver might
-    // take no action for requests that are completed in one of the driver's request handlers.
-    //
+        TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE,
+            "Mapping input ring failed with %!STATUS!", status);
 
-    return;
-}
+        break;
 
-VOID FireShockEvtIoRead(
-    _In_ WDFQUEUE   Queue,
-    _In_ WDFREQUEST Request,
-    _In_ size_t     Length
-)
-{
-    NTSTATUS            status;
-    PDEVICE_CONTEXT     pDeviceContext;
+#pragma endregion
 
-    UNREFERENCED_PARAMETER(Length);
+#pragma region IOCTL_FIRESHOCK_WAIT_INPUT_RING
 
-    pDeviceContext = DeviceGetContext(WdfIoQueueGetDevice(Queue));
+    case IOCTL_FIRESHOCK_WAIT_INPUT_RING:
 
-    status = WdfRequestForwardToIoQueue(Request, pDeviceContext->IoReadQueue);
-    if (!NT_SUCCESS(status))
-    {
-        TraceEvents(TRACE_LEVEL_ERROR,
-            TRACE_QUEUE, "WdfRequestForwardToIoQueue failed with status %!STATUS!", status);
-        WdfRequestComplete(Request, status);
-    }
-}
+        WdfSpinLockAcquire(pDeviceContext->InputLock);
 
-VOID FireShockEvtIoWrite(
-    _In_ WDFQUEUE   Queue,
-    _In_ WDFREQUEST Request,
-    _In_ size_t     Length
-)
-{
-    NTSTATUS            status;
-    PDEVICE_CONTEXT     pDeviceContext;
-    LPVOID              buffer;
-    size_t              bufferLength;
-    size_t              transferred = 0;
+        if (!InputRingIsAttached(&pDeviceContext->InputRing))
+        {
+            status = STATUS_INVALID_DEVICE_STATE;
+        }
+        else if (InputRingIsEmpty(&pDeviceContext->InputRing))
+        {
+            //
+            // Checked and parked under the lock so a report arriving
+            // in between can not slip by unnoticed
+            // 
+            status = WdfRequestForwardToIoQueue(Request, pDeviceContext->InputRingWaitQueue);
+
+            if (NT_SUCCESS(status))
+            {
+                WdfSpinLockRelease(pDeviceContext->InputLock);
+                return;
+            }
+        }
+
+        WdfSpinLockRelease(pDeviceContext->InputLock);
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_SET_READ_MODE
+
+    case IOCTL_FIRESHOCK_SET_READ_MODE:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_SET_READ_MODE");
+
+        status = WdfRequestRetrieveInputBuffer(
+            Request,
+            sizeof(FIRESHOCK_SET_READ_MODE),
+            (LPVOID)&pSetReadMode,
+            &bufferLength);
+
+        if (NT_SUCCESS(status) && InputBufferLength == sizeof(FIRESHOCK_SET_READ_MODE))
+        {
+            switch (pSetReadMode->ReadMode)
+            {
+            case FireShockReadModeQueued:
+            case FireShockReadModeLatest:
+                FileGetContext(WdfRequestGetFileObject(Request))->ReadMode = pSetReadMode->ReadMode;
+                break;
+            default:
+                status = STATUS_INVALID_PARAMETER;
+                break;
+            }
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_SET_REPORT_FORMAT
+
+    case IOCTL_FIRESHOCK_SET_REPORT_FORMAT:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_SET_REPORT_FORMAT");
+
+        status = WdfRequestRetrieveInputBuffer(
+            Request,
+            sizeof(FIRESHOCK_SET_REPORT_FORMAT),
+            (LPVOID)&pSetReportFormat,
+            &bufferLength);
+
+        if (NT_SUCCESS(status) && InputBufferLength == sizeof(FIRESHOCK_SET_REPORT_FORMAT))
+        {
+            if (pSetReportFormat->Flags & ~(FIRESHOCK_REPORT_FORMAT_ENVELOPE | FIRESHOCK_REPORT_FORMAT_NORMALIZED))
+            {
+                status = STATUS_INVALID_PARAMETER;
+                break;
+            }
+
+            if ((pSetReportFormat->Flags & FIRESHOCK_REPORT_FORMAT_NORMALIZED)
+                && pDeviceContext->DeviceType == DsTypeUnknown)
+            {
+                status = STATUS_NOT_SUPPORTED;
+                break;
+            }
+
+            FileGetContext(WdfRequestGetFileObject(Request))->ReportFormat = pSetReportFormat->Flags;
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_READ_INPUT_BATCH
+
+    case IOCTL_FIRESHOCK_READ_INPUT_BATCH:
+
+        WdfSpinLockAcquire(pDeviceContext->InputLock);
+
+        status = DsUsbInputBatchFill(pDeviceContext, Request, &transferred);
+
+        if (NT_SUCCESS(status) && transferred == 0)
+        {
+            //
+            // Drained by the next report the handle takes
+            // 
+            status = WdfRequestForwardToIoQueue(Request, pDeviceContext->IoReadQueue);
+
+            if (NT_SUCCESS(status))
+            {
+                WdfSpinLockRelease(pDeviceContext->InputLock);
+                return;
+            }
+        }
+
+        WdfSpinLockRelease(pDeviceContext->InputLock);
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_SET_CHANGE_FILTER
+
+    case IOCTL_FIRESHOCK_SET_CHANGE_FILTER:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_SET_CHANGE_FILTER");
+
+        status = WdfRequestRetrieveInputBuffer(
+            Request,
+            sizeof(FIRESHOCK_SET_CHANGE_FILTER),
+            (LPVOID)&pSetChangeFilter,
+            &bufferLength);
+
+        if (NT_SUCCESS(status) && InputBufferLength == sizeof(FIRESHOCK_SET_CHANGE_FILTER))
+        {
+            //
+            // Comparison is based on the decoded state
+            // 
+            if (pSetChangeFilter->Enabled && pDeviceContext->DeviceType == DsTypeUnknown)
+            {
+                status = STATUS_NOT_SUPPORTED;
+                break;
+            }
+
+            QueryPerformanceFrequency(&frequency);
+
+            WdfSpinLockAcquire(pDeviceContext->InputLock);
+
+            ChangeFilterConfigure(
+                &FileGetContext(WdfRequestGetFileObject(Request))->ChangeFilter,
+                pSetChangeFilter->Enabled,
+                pSetChangeFilter->AxisThreshold,
+                pSetChangeFilter->KeepAliveInterval * frequency.QuadPart / 1000);
+
+            WdfSpinLockRelease(pDeviceContext->InputLock);
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_GET_OUTPUT_STATISTICS
+
+    case IOCTL_FIRESHOCK_GET_OUTPUT_STATISTICS:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_GET_OUTPUT_STATISTICS");
+
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            sizeof(FIRESHOCK_OUTPUT_STATISTICS),
+            (LPVOID)&pOutputStatistics,
+            &bufferLength);
+
+        if (NT_SUCCESS(status) && OutputBufferLength == sizeof(FIRESHOCK_OUTPUT_STATISTICS))
+        {
+            WdfSpinLockAcquire(pDeviceContext->OutputLock);
+            RtlCopyMemory(pOutputStatistics, &pDeviceContext->OutputStatistics, sizeof(FIRESHOCK_OUTPUT_STATISTICS));
+            WdfSpinLockRelease(pDeviceContext->OutputLock);
+
+            transferred = sizeof(FIRESHOCK_OUTPUT_STATISTICS);
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_GET_FEATURE_CACHE
+
+    case IOCTL_FIRESHOCK_GET_FEATURE_CACHE:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_GET_FEATURE_CACHE");
+
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            sizeof(FIRESHOCK_GET_FEATURE_CACHE),
+            (LPVOID)&pGetFeatureCache,
+            &bufferLength);
+
+        if (NT_SUCCESS(status) && OutputBufferLength == sizeof(FIRESHOCK_GET_FEATURE_CACHE))
+        {
+            pGetFeatureCache->Valid = (ULONG)pDeviceContext->FeatureCacheValid;
+            transferred = sizeof(FIRESHOCK_GET_FEATURE_CACHE);
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_INVALIDATE_FEATURE_CACHE
+
+    case IOCTL_FIRESHOCK_INVALIDATE_FEATURE_CACHE:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_INVALIDATE_FEATURE_CACHE");
+
+        status = WdfRequestRetrieveInputBuffer(
+            Request,
+            sizeof(FIRESHOCK_INVALIDATE_FEATURE_CACHE),
+            (LPVOID)&pInvalidateFeatureCache,
+            &bufferLength);
+
+        if (NT_SUCCESS(status) && InputBufferLength == sizeof(FIRESHOCK_INVALIDATE_FEATURE_CACHE))
+        {
+            InterlockedAnd(&pDeviceContext->FeatureCacheValid, ~(LONG)pInvalidateFeatureCache->Features);
+
+            //
+            // Stop applying the stale calibration until it got fetched again
+            // 
+            if (pDeviceContext->DeviceType == DualShock4
+                && (pInvalidateFeatureCache->Features & FIRESHOCK_FEATURE_CALIBRATION))
+            {
+                WdfSpinLockAcquire(pDeviceContext->InputLock);
+                Ds4GetContext(WdfIoQueueGetDevice(Queue))->CalibrationValid = FALSE;
+                WdfSpinLockRelease(pDeviceContext->InputLock);
+            }
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_GET_STARTUP_TIMING
+
+    case IOCTL_FIRESHOCK_GET_STARTUP_TIMING:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_GET_STARTUP_TIMING");
+
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            sizeof(FIRESHOCK_STARTUP_TIMING),
+            (LPVOID)&pStartupTiming,
+            &bufferLength);
+
+        if (NT_SUCCESS(status) && OutputBufferLength == sizeof(FIRESHOCK_STARTUP_TIMING))
+        {
+            pStartupTiming->TimeToFirstReport = pDeviceContext->TimeToFirstReport;
+            pStartupTiming->TimeToFeatures = pDeviceContext->TimeToFeatures;
+            transferred = sizeof(FIRESHOCK_STARTUP_TIMING);
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_GET_COUNTERS
+
+    case IOCTL_FIRESHOCK_GET_COUNTERS:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_GET_COUNTERS");
+
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            sizeof(FIRESHOCK_COUNTERS),
+            (LPVOID)&pCounters,
+            &bufferLength);
+
+        if (NT_SUCCESS(status) && OutputBufferLength == sizeof(FIRESHOCK_COUNTERS))
+        {
+            DsUsbCountersSnapshot(pDeviceContext, pCounters);
+            transferred = sizeof(FIRESHOCK_COUNTERS);
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_GET_INPUT_TIMING
+
+    case IOCTL_FIRESHOCK_GET_INPUT_TIMING:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_GET_INPUT_TIMING");
+
+        status = WdfRequestRetrieveInputBuffer(
+            Request,
+            sizeof(FIRESHOCK_GET_INPUT_TIMING),
+            (LPVOID)&pGetInputTiming,
+            &bufferLength);
+
+        if (!NT_SUCCESS(status) || InputBufferLength != sizeof(FIRESHOCK_GET_INPUT_TIMING))
+        {
+            break;
+        }
+
+        //
+        // Input and output share the system buffer, fetch the flag first
+        // 
+        reset = pGetInputTiming->Reset;
+
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            sizeof(FIRESHOCK_INPUT_TIMING),
+            (LPVOID)&pInputTiming,
+            &bufferLength);
+
+        if (NT_SUCCESS(status) && OutputBufferLength == sizeof(FIRESHOCK_INPUT_TIMING))
+        {
+            HistogramSnapshot(&pDeviceContext->Counters.InputInterArrival, &pInputTiming->InterArrival, reset);
+            HistogramSnapshot(&pDeviceContext->Counters.InputDelivery, &pInputTiming->Delivery, reset);
+            transferred = sizeof(FIRESHOCK_INPUT_TIMING);
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_SET_CAPTURE
+
+    case IOCTL_FIRESHOCK_SET_CAPTURE:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_SET_CAPTURE");
+
+        status = WdfRequestRetrieveInputBuffer(
+            Request,
+            sizeof(FIRESHOCK_SET_CAPTURE),
+            (LPVOID)&pSetCapture,
+            &bufferLength);
+
+        if (NT_SUCCESS(status) && InputBufferLength == sizeof(FIRESHOCK_SET_CAPTURE))
+        {
+            status = DsUsbCaptureEnable(WdfIoQueueGetDevice(Queue), pSetCapture->Enabled);
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_READ_CAPTURE
+
+    case IOCTL_FIRESHOCK_READ_CAPTURE:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_READ_CAPTURE");
+
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            sizeof(FIRESHOCK_CAPTURE_HEADER),
+            (LPVOID)&pCapture,
+            &bufferLength);
+
+        if (NT_SUCCESS(status))
+        {
+            transferred = DsUsbCaptureRead(pDeviceContext, pCapture, (ULONG)min(bufferLength, MAXULONG));
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_GET_DEVICE_INDEX
+
+    case IOCTL_FIRESHOCK_GET_DEVICE_INDEX:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_GET_DEVICE_INDEX");
+
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            sizeof(FIRESHOCK_GET_DEVICE_INDEX),
+            (LPVOID)&pGetDeviceIndex,
+            &bufferLength);
+
+        if (NT_SUCCESS(status) && OutputBufferLength == sizeof(FIRESHOCK_GET_DEVICE_INDEX))
+        {
+            transferred = OutputBufferLength;
+            pGetDeviceIndex->DeviceIndex = pDeviceContext->DeviceIndex;
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_READ_AGGREGATED
+
+    case IOCTL_FIRESHOCK_READ_AGGREGATED:
+
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            sizeof(FIRESHOCK_AGGREGATED_BATCH),
+            (LPVOID)&pAggregatedBatch,
+            &bufferLength);
+
+        if (!NT_SUCCESS(status))
+        {
+            break;
+        }
+
+        FireShockAggregateRegister(FileGetContext(WdfRequestGetFileObject(Request)));
+
+        //
+        // Parked first, then served from the backlog along with the
+        // requests of all other devices
+        // 
+        status = WdfRequestForwardToIoQueue(Request, pDeviceContext->AggregateWaitQueue);
+
+        if (NT_SUCCESS(status))
+        {
+            FireShockAggregateDispatch();
+            return;
+        }
+
+        break;
+
+#pragma endregion
+
+#pragma region IOCTL_FIRESHOCK_GET_SLOTS
+
+    case IOCTL_FIRESHOCK_GET_SLOTS:
+
+        TraceHotPath(TRACE_LEVEL_INFORMATION,
+            TRACE_QUEUE, "IOCTL_FIRESHOCK_GET_SLOTS");
+
+        status = WdfRequestRetrieveOutputBuffer(
+            Request,
+            sizeof(FIRESHOCK_GET_SLOTS),
+            (LPVOID)&pGetSlots,
+            &bufferLength);
+
+        if (NT_SUCCESS(status))
+        {
+            transferred = sizeof(FIRESHOCK_GET_SLOTS);
+            FireShockDriverGetSlots(pGetSlots);
+        }
+
+        break;
+
+#pragma endregion
+    }
+
+    FireShockEventRequestCompleted(pDeviceContext, Request, status, transferred, 0);
+
+    WdfRequestCompleteWithInformation(Request, status, transferred);
+}
+
+VOID
+FireShockEvtIoStop(
+    _In_ WDFQUEUE Queue,
+    _In_ WDFREQUEST Request,
+    _In_ ULONG ActionFlags
+)
+/*++
+
+Routine Description:
+
+    This event is invoked for a power-managed queue before the device leaves the working state (D0).
+
+Arguments:
+
+    Queue -  Handle to the framework queue object that is associated with the
+             I/O request.
+
+    Request - Handle to a framework request object.
+
+    ActionFlags - A bitwise OR of one or more WDF_REQUEST_STOP_ACTION_FLAGS-typed flags
+                  that identify the reason that the callback function is being called
+                  and whether the request is cancelable.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    PDEVICE_CONTEXT     pDeviceContext;
+    BOOLEAN             owned;
+    BOOLEAN             complete = FALSE;
+
+    TraceEvents(TRACE_LEVEL_INFORMATION,
+        TRACE_QUEUE,
+        "%!FUNC! Queue 0x%p, Request 0x%p ActionFlags %d",
+        Queue, Request, ActionFlags);
+
+    pDeviceContext = DeviceGetContext(WdfIoQueueGetDevice(Queue));
+
+    //
+    // All other requests the driver owns complete in their handlers, only
+    // the one holding the input ring stays pending indefinitely
+    //
+    WdfSpinLockAcquire(pDeviceContext->InputLock);
+    owned = (pDeviceContext->InputRingRequest == Request);
+    WdfSpinLockRelease(pDeviceContext->InputLock);
+
+    if (!owned)
+    {
+        return;
+    }
+
+    //
+    // The mapping outlives a power-down, keep the request until the
+    // client releases it
+    //
+    if (ActionFlags & WdfRequestStopActionSuspend)
+    {
+        WdfRequestStopAcknowledge(Request, FALSE);
+        return;
+    }
+
+    //
+    // Device is going away. Unless the cancel routine already got to it,
+    // release the ring and complete the request here.
+    //
+    WdfSpinLockAcquire(pDeviceContext->InputLock);
+
+    if (pDeviceContext->InputRingRequest == Request
+        && NT_SUCCESS(WdfRequestUnmarkCancelable(Request)))
+    {
+        pDeviceContext->InputRingRequest = NULL;
+        InputRingDetach(&pDeviceContext->InputRing);
+        complete = TRUE;
+    }
+
+    WdfSpinLockRelease(pDeviceContext->InputLock);
+
+    if (complete)
+    {
+        WdfRequestComplete(Request, STATUS_CANCELLED);
+    }
+}
+
+VOID FireShockEvtInputRingRequestCancel(
+    _In_ WDFREQUEST Request
+)
+/*++
+
+Routine Description:
+
+    Releases the shared input ring once the owning request gets cancelled
+    (typically because the client closed its handle).
+
+--*/
+{
+    PDEVICE_CONTEXT     pDeviceContext;
+
+    pDeviceContext = DeviceGetContext(WdfIoQueueGetDevice(WdfRequestGetIoQueue(Request)));
+
+    WdfSpinLockAcquire(pDeviceContext->InputLock);
+
+    pDeviceContext->InputRingRequest = NULL;
+    InputRingDetach(&pDeviceContext->InputRing);
+
+    WdfSpinLockRelease(pDeviceContext->InputLock);
+
+    WdfRequestComplete(Request, STATUS_CANCELLED);
+}
+
+VOID FireShockEvtIoRead(
+    _In_ WDFQUEUE   Queue,
+    _In_ WDFREQUEST Request,
+    _In_ size_t     Length
+)
+{
+    NTSTATUS            status;
+    PDEVICE_CONTEXT     pDeviceContext;
+    PFILE_CONTEXT       pFileContext;
+    INPUT_REPORT        report;
+    BOOLEAN             ready;
+    FIRESHOCK_CONTROLLER_STATE state;
+
+    UNREFERENCED_PARAMETER(Length);
+
+    pDeviceContext = DeviceGetContext(WdfIoQueueGetDevice(Queue));
+    pFileContext = FileGetContext(WdfRequestGetFileObject(Request));
+
+    FireShockQueueRecordWait(pDeviceContext, Request, FIRESHOCK_QUEUE_CLASS_READ);
+
+    WdfSpinLockAcquire(pDeviceContext->InputLock);
+
+    //
+    // Serve what this handle hasn't been through yet first
+    // 
+    ready = DsUsbInputHistoryNext(pDeviceContext, pFileContext, &report, &state);
+
+    if (ready)
+    {
+        ChangeFilterUpdate(&pFileContext->ChangeFilter, &state, report.Timestamp);
+
+        WdfSpinLockRelease(pDeviceContext->InputLock);
+
+        DsUsbCompleteInputRequest(Request, report.Timestamp, report.Sequence, report.Buffer, report.Length);
+        return;
+    }
+
+    status = WdfRequestForwardToIoQueue(Request, pDeviceContext->IoReadQueue);
+
+    WdfSpinLockRelease(pDeviceContext->InputLock);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR,
+            TRACE_QUEUE, "WdfRequestForwardToIoQueue failed with status %!STATUS!", status);
+        WdfRequestComplete(Request, status);
+    }
+}
+
+VOID FireShockEvtIoWrite(
+    _In_ WDFQUEUE   Queue,
+    _In_ WDFREQUEST Request,
+    _In_ size_t     Length
+)
+{
+    NTSTATUS            status;
+    PDEVICE_CONTEXT     pDeviceContext;
+    LPVOID              buffer;
+    size_t              bufferLength;
+    size_t              transferred = 0;
 
     pDeviceContext = DeviceGetContext(WdfIoQueueGetDevice(Queue));
 
+    FireShockQueueRecordWait(pDeviceContext, Request, FIRESHOCK_QUEUE_CLASS_WRITE);
+
+    InterlockedIncrement64(&pDeviceContext->Counters.OutputWrites);
+
     switch (pDeviceContext->DeviceType)
     {
     case DualShock3:
@@ -394,23 +1271,29 @@ VOID FireShockEvtIoWrite(
 
         if (NT_SUCCESS(status) && Length == bufferLength)
         {
-            status = SendControlRequest(
-                pDeviceContext,
-                BmRequestHostToDevice,
-                BmRequestClass,
-                SetReport,
-                USB_SETUP_VALUE(HidReportRequestTypeOutput, HidReportRequestIdOne),
-                0,
-                buffer,
-                (ULONG)bufferLength);
+            //
+            // Completes right away, the transfer happens in the background
+            // 
+            DsUsbOutputSubmit(pDeviceContext, buffer, bufferLength);
 
-            if (!NT_SUCCESS(status))
-            {
-                TraceEvents(TRACE_LEVEL_ERROR, TRACE_QUEUE,
-                    "SendControlRequest failed with status %!STATUS!",
-                    status);
-                break;
-            }
+            transferred = bufferLength;
+        }
+
+        break;
+    case DualShock4:
+
+        status = WdfRequestRetrieveInputBuffer(
+            Request,
+            DS4_HID_OUTPUT_REPORT_SIZE,
+            &buffer,
+            &bufferLength);
+
+        if (NT_SUCCESS(status) && Length == bufferLength)
+        {
+            //
+            // Sent by the output report timer
+            // 
+            Ds4OutputSubmit(WdfIoQueueGetDevice(Queue), buffer, bufferLength);
 
             transferred = bufferLength;
         }
@@ -421,5 +1304,7 @@ VOID FireShockEvtIoWrite(
         break;
     }
 
+    FireShockEventRequestCompleted(pDeviceContext, Request, status, transferred, 0);
+
     WdfRequestCompleteWithInformation(Request, status, transferred);
 }
\ No newline at end of file
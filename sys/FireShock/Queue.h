@@ -37,6 +37,22 @@ typedef struct _QUEUE_CONTEXT {
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(QUEUE_CONTEXT, QueueGetContext)
 
+//
+// Per-request context
+//
+typedef struct _REQUEST_CONTEXT {
+
+    //
+    // Performance counter value on arrival
+    //
+    LONGLONG ArrivalTimestamp;
+
+    BOOLEAN WaitRecorded;
+
+} REQUEST_CONTEXT, *PREQUEST_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(REQUEST_CONTEXT, RequestGetContext)
+
 NTSTATUS
 FireShockQueueInitialize(
     _In_ WDFDEVICE Device
@@ -47,6 +63,13 @@ FireShockIoReadQueueInitialize(
     _In_ WDFDEVICE Device
 );
 
+VOID
+FireShockQueueRecordWait(
+    _In_ PDEVICE_CONTEXT Context,
+    _In_ WDFREQUEST Request,
+    _In_ ULONG Class
+);
+
 //
 // Events from the IoQueue object
 //
@@ -55,4 +78,8 @@ EVT_WDF_IO_QUEUE_IO_STOP FireShockEvtIoStop;
 EVT_WDF_IO_QUEUE_IO_READ FireShockEvtIoRead;
 EVT_WDF_IO_QUEUE_IO_WRITE FireShockEvtIoWrite;
 
+EVT_WDF_REQUEST_CANCEL FireShockEvtInputRingRequestCancel;
+
+EVT_WDF_IO_IN_CALLER_CONTEXT FireShockEvtIoInCallerContext;
+
 EXTERN_C_END
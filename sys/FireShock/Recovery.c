@@ -0,0 +1,90 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Recovery.h"
+
+VOID
+RecoveryPolicyInitialize(
+    _Out_ PRECOVERY_POLICY Policy,
+    _In_ ULONG ResetThreshold,
+    _In_ ULONG MinBackoff,
+    _In_ ULONG MaxBackoff)
+{
+    RtlZeroMemory(Policy, sizeof(RECOVERY_POLICY));
+
+    Policy->ResetThreshold = ResetThreshold;
+    Policy->MinBackoff = MinBackoff;
+    Policy->MaxBackoff = max(MinBackoff, MaxBackoff);
+}
+
+//
+// Accounts for a failure, returns how long to wait before retrying and
+// whether the retry should reset the transfer's target first.
+// 
+ULONG
+RecoveryPolicyOnFailure(
+    _Inout_ PRECOVERY_POLICY Policy,
+    _In_ LONGLONG Timestamp,
+    _Out_ PBOOLEAN Reset)
+{
+    ULONG backoff = Policy->MinBackoff;
+    ULONG i;
+
+    if (Policy->ConsecutiveFailures++ == 0)
+    {
+        Policy->FailureTimestamp = Timestamp;
+    }
+
+    for (i = 1; i < Policy->ConsecutiveFailures && backoff != 0 && backoff < Policy->MaxBackoff; i++)
+    {
+        backoff *= 2;
+    }
+
+    *Reset = (Policy->ResetThreshold != 0 && Policy->ConsecutiveFailures >= Policy->ResetThreshold);
+
+    return min(backoff, Policy->MaxBackoff);
+}
+
+//
+// Accounts for a success, returns TRUE if it ended a series of failures.
+// 
+BOOLEAN
+RecoveryPolicyOnSuccess(
+    _Inout_ PRECOVERY_POLICY Policy,
+    _In_ LONGLONG Timestamp,
+    _Out_ PLONGLONG TimeToRecover)
+{
+    if (Policy->ConsecutiveFailures == 0)
+    {
+        return FALSE;
+    }
+
+    Policy->ConsecutiveFailures = 0;
+
+    *TimeToRecover = Timestamp - Policy->FailureTimestamp;
+
+    return TRUE;
+}
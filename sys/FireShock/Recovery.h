@@ -0,0 +1,79 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include "Portable.h"
+
+//
+// Transfer failure recovery
+// 
+// Spaces out retries of a failing transfer with exponential backoff and
+// asks for the more drastic reset once failures keep piling up. Time is
+// in whatever unit the caller uses for timestamps, backoff in the unit
+// the caller's timer takes. Callers serialize access.
+// 
+typedef struct _RECOVERY_POLICY
+{
+    //
+    // Consecutive failures after which each retry should reset first
+    // 
+    ULONG ResetThreshold;
+
+    //
+    // Delay before the first retry and the cap it doubles up to
+    // 
+    ULONG MinBackoff;
+
+    ULONG MaxBackoff;
+
+    ULONG ConsecutiveFailures;
+
+    //
+    // When the current series of failures began
+    // 
+    LONGLONG FailureTimestamp;
+
+} RECOVERY_POLICY, *PRECOVERY_POLICY;
+
+VOID
+RecoveryPolicyInitialize(
+    _Out_ PRECOVERY_POLICY Policy,
+    _In_ ULONG ResetThreshold,
+    _In_ ULONG MinBackoff,
+    _In_ ULONG MaxBackoff);
+
+ULONG
+RecoveryPolicyOnFailure(
+    _Inout_ PRECOVERY_POLICY Policy,
+    _In_ LONGLONG Timestamp,
+    _Out_ PBOOLEAN Reset);
+
+BOOLEAN
+RecoveryPolicyOnSuccess(
+    _Inout_ PRECOVERY_POLICY Policy,
+    _In_ LONGLONG Timestamp,
+    _Out_ PLONGLONG TimeToRecover);
@@ -0,0 +1,156 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Replay.h"
+
+#define REPLAY_PAYLOAD_LENGTH(_r_)  ((size_t)(_r_)->Size - FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE)
+
+//
+// Returns TRUE if Record holds a successful DualShock 4 calibration read
+// 
+static BOOLEAN
+ReplayIsCalibrationRead(
+    _In_ const FIRESHOCK_CAPTURE_RECORD *Record)
+{
+    return (Record->Type == FIRESHOCK_CAPTURE_RECORD_CONTROL
+        && Record->Status >= 0
+        && (Record->Setup[0] & 0x80) != 0
+        && Record->Setup[1] == GetReport
+        && Record->Setup[2] == DS4_FEATURE_REPORT_CALIBRATION
+        && Record->Setup[3] == HidReportRequestTypeFeature);
+}
+
+//
+// Validates the capture header, returns FALSE if Capture isn't one.
+// 
+BOOLEAN
+ReplayInitialize(
+    _Out_ PREPLAY Replay,
+    _In_reads_bytes_(Length) const VOID *Capture,
+    _In_ size_t Length,
+    _In_ BOOLEAN RealTime)
+{
+    RtlZeroMemory(Replay, sizeof(REPLAY));
+
+    if (Length < sizeof(FIRESHOCK_CAPTURE_HEADER))
+    {
+        return FALSE;
+    }
+
+    RtlCopyMemory(&Replay->Header, Capture, sizeof(FIRESHOCK_CAPTURE_HEADER));
+
+    if (Replay->Header.Magic != FIRESHOCK_CAPTURE_MAGIC
+        || Replay->Header.Version != FIRESHOCK_CAPTURE_VERSION
+        || Replay->Header.Frequency <= 0)
+    {
+        return FALSE;
+    }
+
+    Replay->Data = (const UCHAR *)Capture;
+    Replay->Length = Length;
+    Replay->Offset = sizeof(FIRESHOCK_CAPTURE_HEADER);
+    Replay->RealTime = RealTime;
+
+    return TRUE;
+}
+
+//
+// Returns the next record, or NULL at the end of the capture or where it
+// got truncated. Delay receives the microseconds to wait before handling
+// it to reproduce the recorded timing, always 0 unless replaying in real time.
+// 
+const FIRESHOCK_CAPTURE_RECORD *
+ReplayNext(
+    _Inout_ PREPLAY Replay,
+    _Out_ PULONGLONG Delay)
+{
+    const FIRESHOCK_CAPTURE_RECORD *record;
+    size_t                          remaining = Replay->Length - Replay->Offset;
+
+    *Delay = 0;
+
+    if (remaining < FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE)
+    {
+        return NULL;
+    }
+
+    record = (const FIRESHOCK_CAPTURE_RECORD *)(Replay->Data + Replay->Offset);
+
+    if (record->Size < FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE || record->Size > remaining)
+    {
+        return NULL;
+    }
+
+    Replay->Offset += record->Size;
+
+    if (Replay->RealTime && Replay->LastTimestamp != 0 && record->Timestamp > Replay->LastTimestamp)
+    {
+        *Delay = (ULONGLONG)(record->Timestamp - Replay->LastTimestamp) * 1000000 / Replay->Header.Frequency;
+    }
+
+    Replay->LastTimestamp = record->Timestamp;
+
+    if (Replay->Header.DeviceType == DualShock4 && ReplayIsCalibrationRead(record))
+    {
+        Replay->CalibrationValid = DsDecodeDs4Calibration(
+            record->Payload,
+            REPLAY_PAYLOAD_LENGTH(record),
+            &Replay->Calibration);
+    }
+
+    return record;
+}
+
+//
+// Decodes an interrupt-in record the way the driver would have.
+// 
+BOOLEAN
+ReplayDecode(
+    _In_ const REPLAY *Replay,
+    _In_ const FIRESHOCK_CAPTURE_RECORD *Record,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State)
+{
+    if (Record->Type != FIRESHOCK_CAPTURE_RECORD_INTERRUPT_IN || Record->Status < 0)
+    {
+        RtlZeroMemory(State, sizeof(FIRESHOCK_CONTROLLER_STATE));
+        return FALSE;
+    }
+
+    switch (Replay->Header.DeviceType)
+    {
+    case DualShock3:
+        return DsDecodeDs3Report(Record->Payload, REPLAY_PAYLOAD_LENGTH(Record), State);
+    case DualShock4:
+        return DsDecodeDs4Report(
+            Record->Payload,
+            REPLAY_PAYLOAD_LENGTH(Record),
+            Replay->CalibrationValid ? &Replay->Calibration : NULL,
+            State);
+    default:
+        RtlZeroMemory(State, sizeof(FIRESHOCK_CONTROLLER_STATE));
+        return FALSE;
+    }
+}
@@ -0,0 +1,83 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include "Portable.h"
+#include "FireShock.h"
+#include "DsDecode.h"
+
+//
+// Traffic capture replay
+// 
+// Walks a capture as read via IOCTL_FIRESHOCK_READ_CAPTURE and feeds its
+// interrupt-in reports through the driver's decoder, so report handling
+// can be exercised without hardware. Pacing is left to the host, which
+// gets told how long to wait to reproduce the original timing.
+// 
+typedef struct _REPLAY
+{
+    const UCHAR *Data;
+
+    size_t Length;
+
+    size_t Offset;
+
+    FIRESHOCK_CAPTURE_HEADER Header;
+
+    //
+    // Report delays like they were recorded, otherwise as fast as possible
+    // 
+    BOOLEAN RealTime;
+
+    LONGLONG LastTimestamp;
+
+    //
+    // Picked up from the capture like the driver would
+    // 
+    BOOLEAN CalibrationValid;
+
+    DS4_CALIBRATION Calibration;
+
+} REPLAY, *PREPLAY;
+
+BOOLEAN
+ReplayInitialize(
+    _Out_ PREPLAY Replay,
+    _In_reads_bytes_(Length) const VOID *Capture,
+    _In_ size_t Length,
+    _In_ BOOLEAN RealTime);
+
+const FIRESHOCK_CAPTURE_RECORD *
+ReplayNext(
+    _Inout_ PREPLAY Replay,
+    _Out_ PULONGLONG Delay);
+
+BOOLEAN
+ReplayDecode(
+    _In_ const REPLAY *Replay,
+    _In_ const FIRESHOCK_CAPTURE_RECORD *Record,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State);
@@ -0,0 +1,402 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Simulator.h"
+#include "DsDecode.h"
+
+#define SIMULATOR_SETUP_VALUE(_s_)      ((USHORT)((_s_)[2] | ((_s_)[3] << 8)))
+#define SIMULATOR_DS4_HAT_RELEASED      0x08
+
+//
+// DualShock 3 feature report layout
+// 
+#define DS3_FEATURE_DEVICE_ADDRESS_SIZE         0x12
+#define DS3_FEATURE_DEVICE_ADDRESS_OFFSET       4
+#define DS3_FEATURE_HOST_ADDRESS_SIZE           0x08
+#define DS3_FEATURE_HOST_ADDRESS_OFFSET         2
+
+static ULONG
+SimulatorRandom(
+    _Inout_ PSIMULATOR Simulator)
+{
+    ULONG x = Simulator->Random;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return (Simulator->Random = x);
+}
+
+//
+// Position on a triangle wave running from 0 to 255 and back
+// 
+static UCHAR
+SimulatorSweep(
+    _In_ ULONG Tick)
+{
+    Tick &= 0x1FF;
+
+    return (UCHAR)(Tick < 0x100 ? Tick : 0x1FF - Tick);
+}
+
+//
+// Fills State with the values the pattern prescribes for the current tick
+// 
+static VOID
+SimulatorNextState(
+    _Inout_ PSIMULATOR Simulator,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State)
+{
+    ULONG i;
+
+    RtlZeroMemory(State, sizeof(FIRESHOCK_CONTROLLER_STATE));
+
+    State->LeftThumbX = State->LeftThumbY = 0x80;
+    State->RightThumbX = State->RightThumbY = 0x80;
+
+    switch (Simulator->Pattern)
+    {
+    case SimulatorPatternSweep:
+
+        State->LeftThumbX = SimulatorSweep(Simulator->Tick);
+        State->LeftThumbY = SimulatorSweep(Simulator->Tick + 0x40);
+        State->RightThumbX = SimulatorSweep(Simulator->Tick + 0x80);
+        State->RightThumbY = SimulatorSweep(Simulator->Tick + 0xC0);
+        State->LeftTrigger = SimulatorSweep(Simulator->Tick);
+        State->RightTrigger = (UCHAR)(0xFF - State->LeftTrigger);
+
+        break;
+    case SimulatorPatternButtons:
+
+        //
+        // Held for 8 reports, released for 8
+        // 
+        if ((Simulator->Tick & 0x08) == 0)
+        {
+            State->Buttons = 1UL << ((Simulator->Tick >> 4) % 18);
+        }
+
+        break;
+    case SimulatorPatternNoise:
+
+        State->Buttons = SimulatorRandom(Simulator) & 0x3FFFF;
+        State->LeftThumbX = (UCHAR)SimulatorRandom(Simulator);
+        State->LeftThumbY = (UCHAR)SimulatorRandom(Simulator);
+        State->RightThumbX = (UCHAR)SimulatorRandom(Simulator);
+        State->RightThumbY = (UCHAR)SimulatorRandom(Simulator);
+        State->LeftTrigger = (UCHAR)SimulatorRandom(Simulator);
+        State->RightTrigger = (UCHAR)SimulatorRandom(Simulator);
+
+        for (i = 0; i < 3; i++)
+        {
+            State->Accelerometer[i] = (LONG)(SimulatorRandom(Simulator) & 0x1FF) - 0x100;
+            State->Gyroscope[i] = (LONG)(SimulatorRandom(Simulator) & 0x1FF) - 0x100;
+        }
+
+        break;
+    default:
+        break;
+    }
+}
+
+static VOID
+SimulatorBuildDs3Report(
+    _In_ const FIRESHOCK_CONTROLLER_STATE *State,
+    _Out_ PUCHAR Report)
+{
+    ULONG i;
+
+    RtlZeroMemory(Report, DS3_HID_INPUT_REPORT_SIZE);
+
+    Report[0] = 0x01;
+    Report[DS3_REPORT_OFFSET_BUTTONS] = (UCHAR)State->Buttons;
+    Report[DS3_REPORT_OFFSET_BUTTONS + 1] = (UCHAR)(State->Buttons >> 8);
+    Report[DS3_REPORT_OFFSET_PS_BUTTON] = (UCHAR)((State->Buttons & FIRESHOCK_BUTTON_PS) ? 0x01 : 0x00);
+    Report[DS3_REPORT_OFFSET_LEFT_THUMB_X] = State->LeftThumbX;
+    Report[DS3_REPORT_OFFSET_LEFT_THUMB_Y] = State->LeftThumbY;
+    Report[DS3_REPORT_OFFSET_RIGHT_THUMB_X] = State->RightThumbX;
+    Report[DS3_REPORT_OFFSET_RIGHT_THUMB_Y] = State->RightThumbY;
+
+    //
+    // Digital buttons report full pressure, the triggers their travel
+    // 
+    for (i = 0; i < FIRESHOCK_PRESSURE_COUNT; i++)
+    {
+        Report[DS3_REPORT_OFFSET_PRESSURE + i] = (State->Buttons & (FIRESHOCK_BUTTON_DPAD_UP << i)) ? 0xFF : 0x00;
+    }
+
+    Report[DS3_REPORT_OFFSET_PRESSURE + FIRESHOCK_PRESSURE_L2] = State->LeftTrigger;
+    Report[DS3_REPORT_OFFSET_PRESSURE + FIRESHOCK_PRESSURE_R2] = State->RightTrigger;
+
+    for (i = 0; i < 3; i++)
+    {
+        Report[DS3_REPORT_OFFSET_ACCELEROMETER + i * 2] = (UCHAR)((State->Accelerometer[i] + DS3_MOTION_CENTER) >> 8);
+        Report[DS3_REPORT_OFFSET_ACCELEROMETER + i * 2 + 1] = (UCHAR)(State->Accelerometer[i] + DS3_MOTION_CENTER);
+    }
+
+    Report[DS3_REPORT_OFFSET_GYROSCOPE] = (UCHAR)((State->Gyroscope[1] + DS3_MOTION_CENTER) >> 8);
+    Report[DS3_REPORT_OFFSET_GYROSCOPE + 1] = (UCHAR)(State->Gyroscope[1] + DS3_MOTION_CENTER);
+}
+
+static VOID
+SimulatorBuildDs4Report(
+    _In_ const FIRESHOCK_CONTROLLER_STATE *State,
+    _In_ ULONG Tick,
+    _Out_ PUCHAR Report)
+{
+    ULONG   buttons = State->Buttons;
+    UCHAR   hat = SIMULATOR_DS4_HAT_RELEASED;
+    ULONG   i;
+
+    RtlZeroMemory(Report, DS4_HID_INPUT_REPORT_SIZE);
+
+    //
+    // Only single d-pad directions are generated
+    // 
+    if (buttons & FIRESHOCK_BUTTON_DPAD_UP) hat = 0;
+    else if (buttons & FIRESHOCK_BUTTON_DPAD_RIGHT) hat = 2;
+    else if (buttons & FIRESHOCK_BUTTON_DPAD_DOWN) hat = 4;
+    else if (buttons & FIRESHOCK_BUTTON_DPAD_LEFT) hat = 6;
+
+    Report[0] = 0x01;
+    Report[DS4_REPORT_OFFSET_LEFT_THUMB_X] = State->LeftThumbX;
+    Report[DS4_REPORT_OFFSET_LEFT_THUMB_Y] = State->LeftThumbY;
+    Report[DS4_REPORT_OFFSET_RIGHT_THUMB_X] = State->RightThumbX;
+    Report[DS4_REPORT_OFFSET_RIGHT_THUMB_Y] = State->RightThumbY;
+
+    Report[DS4_REPORT_OFFSET_BUTTONS] = (UCHAR)(hat
+        | ((buttons & FIRESHOCK_BUTTON_SQUARE) ? 0x10 : 0)
+        | ((buttons & FIRESHOCK_BUTTON_CROSS) ? 0x20 : 0)
+        | ((buttons & FIRESHOCK_BUTTON_CIRCLE) ? 0x40 : 0)
+        | ((buttons & FIRESHOCK_BUTTON_TRIANGLE) ? 0x80 : 0));
+    Report[DS4_REPORT_OFFSET_BUTTONS + 1] = (UCHAR)(
+        ((buttons & FIRESHOCK_BUTTON_L1) ? 0x01 : 0)
+        | ((buttons & FIRESHOCK_BUTTON_R1) ? 0x02 : 0)
+        | ((buttons & FIRESHOCK_BUTTON_L2) ? 0x04 : 0)
+        | ((buttons & FIRESHOCK_BUTTON_R2) ? 0x08 : 0)
+        | ((buttons & FIRESHOCK_BUTTON_SELECT) ? 0x10 : 0)
+        | ((buttons & FIRESHOCK_BUTTON_START) ? 0x20 : 0)
+        | ((buttons & FIRESHOCK_BUTTON_L3) ? 0x40 : 0)
+        | ((buttons & FIRESHOCK_BUTTON_R3) ? 0x80 : 0));
+
+    //
+    // Upper six bits count reports
+    // 
+    Report[DS4_REPORT_OFFSET_BUTTONS + 2] = (UCHAR)(
+        ((buttons & FIRESHOCK_BUTTON_PS) ? 0x01 : 0)
+        | ((buttons & FIRESHOCK_BUTTON_TOUCHPAD) ? 0x02 : 0)
+        | (Tick << 2));
+
+    Report[DS4_REPORT_OFFSET_LEFT_TRIGGER] = State->LeftTrigger;
+    Report[DS4_REPORT_OFFSET_RIGHT_TRIGGER] = State->RightTrigger;
+
+    for (i = 0; i < 3; i++)
+    {
+        Report[DS4_REPORT_OFFSET_GYROSCOPE + i * 2] = (UCHAR)State->Gyroscope[i];
+        Report[DS4_REPORT_OFFSET_GYROSCOPE + i * 2 + 1] = (UCHAR)(State->Gyroscope[i] >> 8);
+        Report[DS4_REPORT_OFFSET_ACCELEROMETER + i * 2] = (UCHAR)State->Accelerometer[i];
+        Report[DS4_REPORT_OFFSET_ACCELEROMETER + i * 2 + 1] = (UCHAR)(State->Accelerometer[i] >> 8);
+    }
+
+    //
+    // No fingers on the touchpad
+    // 
+    for (i = 0; i < FIRESHOCK_TOUCH_POINT_COUNT; i++)
+    {
+        Report[DS4_REPORT_OFFSET_TOUCH_POINTS + i * DS4_TOUCH_POINT_SIZE] = 0x80;
+    }
+}
+
+//
+// Plausible calibration mapping raw readings to themselves
+// 
+static VOID
+SimulatorBuildDs4Calibration(
+    _Out_ PUCHAR Feature)
+{
+    ULONG i;
+
+    RtlZeroMemory(Feature, DS4_FEATURE_REPORT_CALIBRATION_SIZE);
+
+    Feature[0] = DS4_FEATURE_REPORT_CALIBRATION;
+
+    for (i = 0; i < 3; i++)
+    {
+        //
+        // Gyro plus and minus readings at +/-1024, speed 1 deg/s each way
+        // 
+        Feature[7 + i * 2 + 1] = 0x04;
+        Feature[13 + i * 2 + 1] = 0xFC;
+
+        //
+        // Accelerometer readings at +/-1g
+        // 
+        Feature[23 + i * 4 + 1] = DS4_ACC_RES_PER_G >> 8;
+        Feature[25 + i * 4 + 1] = (UCHAR)((-DS4_ACC_RES_PER_G) >> 8);
+    }
+
+    Feature[19] = 1;
+    Feature[21] = 1;
+}
+
+VOID
+SimulatorInitialize(
+    _Out_ PSIMULATOR Simulator,
+    _In_ DS_DEVICE_TYPE DeviceType,
+    _In_ SIMULATOR_PATTERN Pattern,
+    _In_ ULONG Seed)
+{
+    RtlZeroMemory(Simulator, sizeof(SIMULATOR));
+
+    Simulator->DeviceType = DeviceType;
+    Simulator->Pattern = Pattern < SimulatorPatternCount ? Pattern : SimulatorPatternIdle;
+    Simulator->Random = Seed != 0 ? Seed : 0x2545F491;
+
+    //
+    // Locally administered address derived from the seed
+    // 
+    Simulator->DeviceAddress.Address[0] = 0x02;
+    Simulator->DeviceAddress.Address[2] = (UCHAR)(Seed >> 24);
+    Simulator->DeviceAddress.Address[3] = (UCHAR)(Seed >> 16);
+    Simulator->DeviceAddress.Address[4] = (UCHAR)(Seed >> 8);
+    Simulator->DeviceAddress.Address[5] = (UCHAR)Seed;
+}
+
+//
+// Writes the next report to Report, returns its length or 0 if the
+// device isn't sending any (yet).
+// 
+ULONG
+SimulatorNextReport(
+    _Inout_ PSIMULATOR Simulator,
+    _Out_writes_(Length) PUCHAR Report,
+    _In_ ULONG Length)
+{
+    FIRESHOCK_CONTROLLER_STATE state;
+
+    switch (Simulator->DeviceType)
+    {
+    case DualShock3:
+
+        if (!Simulator->Started || Length < DS3_HID_INPUT_REPORT_SIZE)
+        {
+            return 0;
+        }
+
+        SimulatorNextState(Simulator, &state);
+        SimulatorBuildDs3Report(&state, Report);
+        Simulator->Tick++;
+
+        return DS3_HID_INPUT_REPORT_SIZE;
+    case DualShock4:
+
+        if (Length < DS4_HID_INPUT_REPORT_SIZE)
+        {
+            return 0;
+        }
+
+        SimulatorNextState(Simulator, &state);
+        SimulatorBuildDs4Report(&state, Simulator->Tick, Report);
+        Simulator->Tick++;
+
+        return DS4_HID_INPUT_REPORT_SIZE;
+    default:
+        return 0;
+    }
+}
+
+//
+// Answers a class request on the control endpoint. Returns FALSE for
+// requests a real device would stall.
+// 
+BOOLEAN
+SimulatorControlTransfer(
+    _Inout_ PSIMULATOR Simulator,
+    _In_reads_(8) const UCHAR *Setup,
+    _Inout_ PUCHAR Buffer,
+    _In_ ULONG Length,
+    _Out_ PULONG Transferred)
+{
+    BOOLEAN toHost = (Setup[0] & 0x80) != 0;
+    USHORT  value = SIMULATOR_SETUP_VALUE(Setup);
+
+    *Transferred = 0;
+
+    if (toHost && Setup[1] == GetReport)
+    {
+        if (Simulator->DeviceType == DualShock3 && value == Ds3FeatureDeviceAddress
+            && Length >= DS3_FEATURE_DEVICE_ADDRESS_SIZE)
+        {
+            RtlZeroMemory(Buffer, DS3_FEATURE_DEVICE_ADDRESS_SIZE);
+            RtlCopyMemory(&Buffer[DS3_FEATURE_DEVICE_ADDRESS_OFFSET], &Simulator->DeviceAddress, sizeof(BD_ADDR));
+            *Transferred = DS3_FEATURE_DEVICE_ADDRESS_SIZE;
+            return TRUE;
+        }
+
+        if (Simulator->DeviceType == DualShock3 && value == Ds3FeatureHostAddress
+            && Length >= DS3_FEATURE_HOST_ADDRESS_SIZE)
+        {
+            RtlZeroMemory(Buffer, DS3_FEATURE_HOST_ADDRESS_SIZE);
+            RtlCopyMemory(&Buffer[DS3_FEATURE_HOST_ADDRESS_OFFSET], &Simulator->HostAddress, sizeof(BD_ADDR));
+            *Transferred = DS3_FEATURE_HOST_ADDRESS_SIZE;
+            return TRUE;
+        }
+
+        if (Simulator->DeviceType == DualShock4
+            && value == ((HidReportRequestTypeFeature << 8) | DS4_FEATURE_REPORT_CALIBRATION)
+            && Length >= DS4_FEATURE_REPORT_CALIBRATION_SIZE)
+        {
+            SimulatorBuildDs4Calibration(Buffer);
+            *Transferred = DS4_FEATURE_REPORT_CALIBRATION_SIZE;
+            return TRUE;
+        }
+
+        return FALSE;
+    }
+
+    if (!toHost && Setup[1] == SetReport)
+    {
+        if (Simulator->DeviceType == DualShock3 && value == Ds3FeatureStartDevice)
+        {
+            Simulator->Started = TRUE;
+        }
+
+        if (Simulator->DeviceType == DualShock3 && value == Ds3FeatureHostAddress
+            && Length >= DS3_FEATURE_HOST_ADDRESS_OFFSET + sizeof(BD_ADDR))
+        {
+            RtlCopyMemory(&Simulator->HostAddress, &Buffer[DS3_FEATURE_HOST_ADDRESS_OFFSET], sizeof(BD_ADDR));
+        }
+
+        //
+        // Output reports and anything else get swallowed
+        // 
+        *Transferred = Length;
+        return TRUE;
+    }
+
+    return FALSE;
+}
@@ -0,0 +1,114 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include "Portable.h"
+#include "FireShock.h"
+#include "DualShock.h"
+
+//
+// Simulated controller
+// 
+// Produces synthetic interrupt-in reports and answers the feature report
+// requests the driver issues, standing in for a DualShock 3 or 4 so the
+// report path can be put under load without hardware. Like the real
+// DualShock 3 it stays silent until it receives the enable request.
+// Callers serialize access.
+// 
+typedef enum _SIMULATOR_PATTERN
+{
+    //
+    // Everything at rest, only the DualShock 4 report counter moves
+    // 
+    SimulatorPatternIdle,
+
+    //
+    // Sticks and triggers sweep their full range
+    // 
+    SimulatorPatternSweep,
+
+    //
+    // One button after another gets pressed and released
+    // 
+    SimulatorPatternButtons,
+
+    //
+    // Every control changes with every report
+    // 
+    SimulatorPatternNoise,
+
+    SimulatorPatternCount
+
+} SIMULATOR_PATTERN;
+
+typedef struct _SIMULATOR
+{
+    DS_DEVICE_TYPE DeviceType;
+
+    SIMULATOR_PATTERN Pattern;
+
+    //
+    // Reports generated so far
+    // 
+    ULONG Tick;
+
+    //
+    // Pseudo random number generator state, never 0
+    // 
+    ULONG Random;
+
+    //
+    // DualShock 3 enable request received
+    // 
+    BOOLEAN Started;
+
+    BD_ADDR DeviceAddress;
+
+    BD_ADDR HostAddress;
+
+} SIMULATOR, *PSIMULATOR;
+
+VOID
+SimulatorInitialize(
+    _Out_ PSIMULATOR Simulator,
+    _In_ DS_DEVICE_TYPE DeviceType,
+    _In_ SIMULATOR_PATTERN Pattern,
+    _In_ ULONG Seed);
+
+ULONG
+SimulatorNextReport(
+    _Inout_ PSIMULATOR Simulator,
+    _Out_writes_(Length) PUCHAR Report,
+    _In_ ULONG Length);
+
+BOOLEAN
+SimulatorControlTransfer(
+    _Inout_ PSIMULATOR Simulator,
+    _In_reads_(8) const UCHAR *Setup,
+    _Inout_ PUCHAR Buffer,
+    _In_ ULONG Length,
+    _Out_ PULONG Transferred);
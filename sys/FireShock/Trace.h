@@ -47,6 +47,7 @@ DEFINE_GUID(GUID_DEVINTERFACE_FIRESHOCK,
         WPP_DEFINE_BIT(TRACE_POWER)                                    \
         WPP_DEFINE_BIT(TRACE_DSUSB)                                    \
         WPP_DEFINE_BIT(TRACE_DUALSHOCK3)                                    \
+        WPP_DEFINE_BIT(TRACE_DUALSHOCK4)                                    \
         )                             
 
 #define WPP_FLAG_LEVEL_LOGGER(flag, level)                                  \
@@ -62,6 +63,24 @@ DEFINE_GUID(GUID_DEVINTERFACE_FIRESHOCK,
 #define WPP_LEVEL_FLAGS_ENABLED(lvl, flags) \
            (WPP_LEVEL_ENABLED(flags) && WPP_CONTROL(WPP_BIT_ ## flags).Level >= lvl)
 
+//
+// TraceHotPath is for messages issued per report or per request. Unless
+// enabled here, its condition is constant false and the calls compile away.
+//
+#ifndef FIRESHOCK_HOT_PATH_TRACING
+#if DBG
+#define FIRESHOCK_HOT_PATH_TRACING  1
+#else
+#define FIRESHOCK_HOT_PATH_TRACING  0
+#endif
+#endif
+
+#define WPP_HOTPATH_LEVEL_FLAGS_LOGGER(hotpath, lvl, flags) \
+           WPP_LEVEL_LOGGER(flags)
+
+#define WPP_HOTPATH_LEVEL_FLAGS_ENABLED(hotpath, lvl, flags) \
+           ((hotpath) && WPP_LEVEL_FLAGS_ENABLED(lvl, flags))
+
 //
 // This comment block is scanned by the trace preprocessor to define our
 // Trace function.
@@ -69,6 +88,7 @@ DEFINE_GUID(GUID_DEVINTERFACE_FIRESHOCK,
 // begin_wpp config
 // FUNC Trace{FLAG=MYDRIVER_ALL_INFO}(LEVEL, MSG, ...);
 // FUNC TraceEvents(LEVEL, FLAGS, MSG, ...);
+// FUNC TraceHotPath{HOTPATH=FIRESHOCK_HOT_PATH_TRACING}(LEVEL, FLAGS, MSG, ...);
 // end_wpp
 //
 
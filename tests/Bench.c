@@ -0,0 +1,398 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "Bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+ULONGLONG
+BenchNow(
+    VOID)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER    frequency;
+    LARGE_INTEGER           counter;
+
+    if (frequency.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    QueryPerformanceCounter(&counter);
+
+    return (ULONGLONG)((counter.QuadPart / frequency.QuadPart) * 1000000000LL
+        + (counter.QuadPart % frequency.QuadPart) * 1000000000LL / frequency.QuadPart);
+#else
+    struct timespec         now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (ULONGLONG)now.tv_sec * 1000000000ULL + (ULONGLONG)now.tv_nsec;
+#endif
+}
+
+static int
+BenchCompare(
+    const void *Left,
+    const void *Right)
+{
+    ULONGLONG left = *(const ULONGLONG *)Left;
+    ULONGLONG right = *(const ULONGLONG *)Right;
+
+    return (left > right) - (left < right);
+}
+
+ULONGLONG
+BenchPercentile(
+    _Inout_ PULONGLONG Samples,
+    _In_ size_t Count,
+    _In_ ULONG Percent)
+{
+    size_t  index;
+
+    if (Count == 0)
+    {
+        return 0;
+    }
+
+    qsort(Samples, Count, sizeof(ULONGLONG), BenchCompare);
+
+    //
+    // Nearest rank
+    // 
+    index = ((size_t)min(Percent, 100) * Count + 99) / 100;
+
+    return Samples[(index == 0) ? 0 : index - 1];
+}
+
+ULONG
+BenchArgument(
+    _In_ int argc,
+    _In_ char **argv,
+    _In_ int Index,
+    _In_ ULONG Default)
+{
+    if (Index >= argc)
+    {
+        return Default;
+    }
+
+    return (ULONG)strtoul(argv[Index], NULL, 0);
+}
+
+VOID
+BenchConsume(
+    _In_ const VOID *Data,
+    _In_ size_t Length)
+{
+    static UCHAR volatile   sink;
+    const UCHAR             *bytes = (const UCHAR *)Data;
+    size_t                  i;
+
+    for (i = 0; i < Length; i++)
+    {
+        sink ^= bytes[i];
+    }
+}
+
+VOID
+BenchMeasure(
+    _In_ const char *Benchmark,
+    _In_ const char *Case,
+    _In_ PBENCH_ROUTINE Routine,
+    _In_ PVOID Context,
+    _In_ ULONG Rounds,
+    _In_ ULONG Operations)
+{
+    PULONGLONG  samples;
+    ULONGLONG   start;
+    ULONGLONG   total = 0;
+    ULONG       round;
+
+    samples = (PULONGLONG)calloc(max(Rounds, 1), sizeof(ULONGLONG));
+
+    if (samples == NULL || Operations == 0)
+    {
+        abort();
+    }
+
+    //
+    // Warm up caches and branch predictors first
+    // 
+    for (round = 0; round < min(Rounds, 16); round++)
+    {
+        Routine(Context, round);
+    }
+
+    for (round = 0; round < Rounds; round++)
+    {
+        start = BenchNow();
+        Routine(Context, round);
+        samples[round] = BenchNow() - start;
+
+        total += samples[round];
+    }
+
+    //
+    // Samples are per round, percentiles get reported per operation
+    // 
+    printf("{\"benchmark\":\"%s\",\"case\":\"%s\",\"operations\":%llu,"
+        "\"ops_per_second\":%.0f,\"ns_per_op\":{\"mean\":%.2f,\"p50\":%.2f,\"p99\":%.2f}}\n",
+        Benchmark,
+        Case,
+        (unsigned long long)Rounds * Operations,
+        (double)Rounds * Operations * 1e9 / (double)(total ? total : 1),
+        (double)total / ((double)Rounds * Operations),
+        (double)BenchPercentile(samples, Rounds, 50) / Operations,
+        (double)BenchPercentile(samples, Rounds, 99) / Operations);
+
+    free(samples);
+}
+
+VOID
+BenchReportSamples(
+    _In_ const char *Benchmark,
+    _In_ const char *Case,
+    _Inout_ PULONGLONG Samples,
+    _In_ size_t Count)
+{
+    double  mean = 0;
+    double  variance = 0;
+    size_t  i;
+
+    for (i = 0; i < Count; i++)
+    {
+        mean += (double)Samples[i];
+    }
+
+    mean /= (double)max(Count, 1);
+
+    for (i = 0; i < Count; i++)
+    {
+        variance += ((double)Samples[i] - mean) * ((double)Samples[i] - mean);
+    }
+
+    variance /= (double)max(Count, 1);
+
+    printf("{\"benchmark\":\"%s\",\"case\":\"%s\",\"samples\":%llu,"
+        "\"ns\":{\"mean\":%.2f,\"stddev\":%.2f,\"p50\":%llu,\"p99\":%llu,\"max\":%llu}}\n",
+        Benchmark,
+        Case,
+        (unsigned long long)Count,
+        mean,
+        sqrt(variance),
+        (unsigned long long)BenchPercentile(Samples, Count, 50),
+        (unsigned long long)BenchPercentile(Samples, Count, 99),
+        (unsigned long long)BenchPercentile(Samples, Count, 100));
+}
+
+VOID
+BenchYield(
+    VOID)
+{
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+typedef struct _BENCH_THREAD
+{
+#ifdef _WIN32
+    HANDLE Handle;
+#else
+    pthread_t Handle;
+#endif
+
+    PBENCH_THREAD_ROUTINE Routine;
+
+    PVOID Context;
+
+} BENCH_THREAD;
+
+#ifdef _WIN32
+static DWORD WINAPI
+BenchThreadEntry(
+    LPVOID Parameter)
+{
+    PBENCH_THREAD thread = (PBENCH_THREAD)Parameter;
+
+    thread->Routine(thread->Context);
+
+    return 0;
+}
+#else
+static void *
+BenchThreadEntry(
+    void *Parameter)
+{
+    PBENCH_THREAD thread = (PBENCH_THREAD)Parameter;
+
+    thread->Routine(thread->Context);
+
+    return NULL;
+}
+#endif
+
+PBENCH_THREAD
+BenchThreadStart(
+    _In_ PBENCH_THREAD_ROUTINE Routine,
+    _In_ PVOID Context)
+{
+    PBENCH_THREAD thread = (PBENCH_THREAD)calloc(1, sizeof(BENCH_THREAD));
+
+    if (thread == NULL)
+    {
+        abort();
+    }
+
+    thread->Routine = Routine;
+    thread->Context = Context;
+
+#ifdef _WIN32
+    thread->Handle = CreateThread(NULL, 0, BenchThreadEntry, thread, 0, NULL);
+
+    if (thread->Handle == NULL)
+    {
+        abort();
+    }
+#else
+    if (pthread_create(&thread->Handle, NULL, BenchThreadEntry, thread) != 0)
+    {
+        abort();
+    }
+#endif
+
+    return thread;
+}
+
+VOID
+BenchThreadJoin(
+    _In_ PBENCH_THREAD Thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(Thread->Handle, INFINITE);
+    CloseHandle(Thread->Handle);
+#else
+    pthread_join(Thread->Handle, NULL);
+#endif
+
+    free(Thread);
+}
+
+typedef struct _BENCH_EVENT
+{
+#ifdef _WIN32
+    HANDLE Handle;
+#else
+    pthread_mutex_t Lock;
+
+    pthread_cond_t Condition;
+
+    BOOLEAN Signaled;
+#endif
+
+} BENCH_EVENT;
+
+PBENCH_EVENT
+BenchEventCreate(
+    VOID)
+{
+    PBENCH_EVENT event = (PBENCH_EVENT)calloc(1, sizeof(BENCH_EVENT));
+
+    if (event == NULL)
+    {
+        abort();
+    }
+
+#ifdef _WIN32
+    event->Handle = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+    pthread_mutex_init(&event->Lock, NULL);
+    pthread_cond_init(&event->Condition, NULL);
+#endif
+
+    return event;
+}
+
+VOID
+BenchEventSet(
+    _In_ PBENCH_EVENT Event)
+{
+#ifdef _WIN32
+    SetEvent(Event->Handle);
+#else
+    pthread_mutex_lock(&Event->Lock);
+    Event->Signaled = TRUE;
+    pthread_cond_signal(&Event->Condition);
+    pthread_mutex_unlock(&Event->Lock);
+#endif
+}
+
+VOID
+BenchEventWait(
+    _In_ PBENCH_EVENT Event)
+{
+#ifdef _WIN32
+    WaitForSingleObject(Event->Handle, INFINITE);
+#else
+    pthread_mutex_lock(&Event->Lock);
+
+    while (!Event->Signaled)
+    {
+        pthread_cond_wait(&Event->Condition, &Event->Lock);
+    }
+
+    Event->Signaled = FALSE;
+    pthread_mutex_unlock(&Event->Lock);
+#endif
+}
+
+VOID
+BenchEventDestroy(
+    _In_ PBENCH_EVENT Event)
+{
+#ifdef _WIN32
+    CloseHandle(Event->Handle);
+#else
+    pthread_cond_destroy(&Event->Condition);
+    pthread_mutex_destroy(&Event->Lock);
+#endif
+
+    free(Event);
+}
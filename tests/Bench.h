@@ -0,0 +1,134 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "Portable.h"
+
+//
+// Host-side benchmark support
+// 
+// Benchmarks print one JSON object per line on stdout so runs can be
+// collected and compared by scripts. Durations are in nanoseconds.
+// 
+
+ULONGLONG
+BenchNow(
+    VOID);
+
+//
+// Sorts Samples in place and returns the given percentile of them
+// 
+ULONGLONG
+BenchPercentile(
+    _Inout_ PULONGLONG Samples,
+    _In_ size_t Count,
+    _In_ ULONG Percent);
+
+//
+// Returns command line argument Index as number, Default without one
+// 
+ULONG
+BenchArgument(
+    _In_ int argc,
+    _In_ char **argv,
+    _In_ int Index,
+    _In_ ULONG Default);
+
+//
+// Keeps the compiler from optimizing away the work being measured
+// 
+VOID
+BenchConsume(
+    _In_ const VOID *Data,
+    _In_ size_t Length);
+
+//
+// Runs Rounds rounds of Operations operations each and reports the time
+// per operation as "benchmark" / "case" JSON line. Round counts up from 0.
+// 
+typedef VOID (*PBENCH_ROUTINE)(PVOID Context, ULONG Round);
+
+VOID
+BenchMeasure(
+    _In_ const char *Benchmark,
+    _In_ const char *Case,
+    _In_ PBENCH_ROUTINE Routine,
+    _In_ PVOID Context,
+    _In_ ULONG Rounds,
+    _In_ ULONG Operations);
+
+//
+// Reports the distribution of Count durations measured by the caller as
+// "benchmark" / "case" JSON line, sorts Samples in place
+// 
+VOID
+BenchReportSamples(
+    _In_ const char *Benchmark,
+    _In_ const char *Case,
+    _Inout_ PULONGLONG Samples,
+    _In_ size_t Count);
+
+//
+// Gives up the rest of the time slice, spinning threads must not starve
+// the thread they wait on when both share a core
+// 
+VOID
+BenchYield(
+    VOID);
+
+//
+// Threads and auto-reset events for the multi-threaded benchmarks
+// 
+typedef struct _BENCH_THREAD *PBENCH_THREAD;
+
+typedef VOID (*PBENCH_THREAD_ROUTINE)(PVOID Context);
+
+PBENCH_THREAD
+BenchThreadStart(
+    _In_ PBENCH_THREAD_ROUTINE Routine,
+    _In_ PVOID Context);
+
+VOID
+BenchThreadJoin(
+    _In_ PBENCH_THREAD Thread);
+
+typedef struct _BENCH_EVENT *PBENCH_EVENT;
+
+PBENCH_EVENT
+BenchEventCreate(
+    VOID);
+
+VOID
+BenchEventSet(
+    _In_ PBENCH_EVENT Event);
+
+VOID
+BenchEventWait(
+    _In_ PBENCH_EVENT Event);
+
+VOID
+BenchEventDestroy(
+    _In_ PBENCH_EVENT Event);
@@ -0,0 +1,101 @@
+cmake_minimum_required(VERSION 3.19)
+
+#
+# Compares the p50 and p99 of every benchmark case in RESULTS with the same
+# case in BASELINE, both files as written by the bench target, and fails if
+# any of them got slower by more than TOLERANCE percent (10 by default).
+# Cases missing from either file are skipped.
+#
+if(NOT DEFINED TOLERANCE)
+    set(TOLERANCE 10)
+endif()
+
+#
+# math() only knows integers, durations get compared in hundredths of a
+# nanosecond
+#
+function(to_hundredths value result)
+    if(NOT value MATCHES "^([0-9]+)(\\.([0-9]*))?$")
+        message(FATAL_ERROR "Unexpected duration ${value}")
+    endif()
+
+    set(integer ${CMAKE_MATCH_1})
+    string(SUBSTRING "${CMAKE_MATCH_3}00" 0 2 fraction)
+
+    math(EXPR hundredths "${integer} * 100 + 1${fraction} - 100")
+
+    set(${result} ${hundredths} PARENT_SCOPE)
+endfunction()
+
+#
+# Reads a JSON lines file into <prefix>_CASES and <prefix>_<case>_P50/_P99
+#
+function(read_benchmarks path prefix)
+    file(STRINGS ${path} lines)
+
+    set(cases)
+
+    foreach(line ${lines})
+        string(JSON benchmark GET "${line}" benchmark)
+        string(JSON name ERROR_VARIABLE error GET "${line}" case)
+
+        #
+        # InputRingBench names its runs by delivery path and report interval
+        #
+        if(error)
+            string(JSON path GET "${line}" path)
+            string(JSON interval GET "${line}" interval_ns)
+            set(name "${path}_${interval}")
+        endif()
+
+        #
+        # Per operation timings of measured routines, plain durations of
+        # samples or report latencies
+        #
+        foreach(member ns_per_op ns latency_ns)
+            string(JSON timings ERROR_VARIABLE error GET "${line}" ${member})
+
+            if(NOT error)
+                break()
+            endif()
+        endforeach()
+
+        string(JSON p50 GET "${timings}" p50)
+        string(JSON p99 GET "${timings}" p99)
+
+        list(APPEND cases "${benchmark}/${name}")
+        set(${prefix}_${benchmark}/${name}_P50 ${p50} PARENT_SCOPE)
+        set(${prefix}_${benchmark}/${name}_P99 ${p99} PARENT_SCOPE)
+    endforeach()
+
+    set(${prefix}_CASES ${cases} PARENT_SCOPE)
+endfunction()
+
+read_benchmarks(${BASELINE} BASELINE)
+read_benchmarks(${RESULTS} RESULTS)
+
+set(regressions 0)
+
+foreach(case ${RESULTS_CASES})
+    if(NOT DEFINED BASELINE_${case}_P50)
+        continue()
+    endif()
+
+    foreach(percentile P50 P99)
+        to_hundredths(${BASELINE_${case}_${percentile}} before)
+        to_hundredths(${RESULTS_${case}_${percentile}} after)
+
+        math(EXPR limit "${before} * (100 + ${TOLERANCE}) / 100")
+
+        if(after GREATER limit)
+            message(STATUS "${case} ${percentile}: ${BASELINE_${case}_${percentile}} -> ${RESULTS_${case}_${percentile}} ns")
+            math(EXPR regressions "${regressions} + 1")
+        endif()
+    endforeach()
+endforeach()
+
+if(regressions GREATER 0)
+    message(FATAL_ERROR "${regressions} percentiles regressed by more than ${TOLERANCE}%")
+endif()
+
+message(STATUS "No percentile regressed by more than ${TOLERANCE}%")
@@ -0,0 +1,147 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "FaultTransport.h"
+
+VOID
+FaultTransportInitialize(
+    _Out_ PFAULT_TRANSPORT Transport,
+    _In_ DS_DEVICE_TYPE DeviceType)
+{
+    RtlZeroMemory(Transport, sizeof(FAULT_TRANSPORT));
+
+    SimulatorInitialize(&Transport->Simulator, DeviceType, SimulatorPatternNoise, 1);
+
+    Transport->Simulator.Started = TRUE;
+}
+
+VOID
+FaultTransportInject(
+    _Inout_ PFAULT_TRANSPORT Transport,
+    _In_ FAULT_KIND Fault,
+    _In_ ULONG Count)
+{
+    switch (Fault)
+    {
+    case FaultNone:
+        Transport->Timeouts = 0;
+        Transport->Stalled = FALSE;
+        Transport->Disconnected = FALSE;
+        break;
+    case FaultTimeout:
+        Transport->Timeouts += Count;
+        break;
+    case FaultStall:
+        Transport->Stalled = TRUE;
+        break;
+    case FaultDisconnect:
+        Transport->Disconnected = TRUE;
+        break;
+    }
+}
+
+//
+// Reads the next report, or fails with the fault currently in effect.
+// 
+FAULT_KIND
+FaultTransportRead(
+    _Inout_ PFAULT_TRANSPORT Transport,
+    _Out_writes_(Length) PUCHAR Report,
+    _In_ ULONG Length,
+    _Out_ PULONG Transferred)
+{
+    FAULT_KIND fault = FaultNone;
+
+    *Transferred = 0;
+
+    Transport->Reads++;
+
+    if (Transport->Disconnected)
+    {
+        fault = FaultDisconnect;
+    }
+    else if (Transport->Stalled)
+    {
+        fault = FaultStall;
+    }
+    else if (Transport->Timeouts > 0)
+    {
+        Transport->Timeouts--;
+        fault = FaultTimeout;
+    }
+
+    if (fault != FaultNone)
+    {
+        Transport->FailedReads++;
+        return fault;
+    }
+
+    *Transferred = SimulatorNextReport(&Transport->Simulator, Report, Length);
+
+    return FaultNone;
+}
+
+//
+// Clears a halted endpoint, unless there's no device to talk to.
+// 
+VOID
+FaultTransportResetPipe(
+    _Inout_ PFAULT_TRANSPORT Transport)
+{
+    Transport->PipeResets++;
+
+    if (!Transport->Disconnected)
+    {
+        Transport->Stalled = FALSE;
+    }
+}
+
+FAULT_KIND
+FaultTransportControl(
+    _Inout_ PFAULT_TRANSPORT Transport,
+    _In_reads_(8) const UCHAR *Setup,
+    _Inout_ PUCHAR Buffer,
+    _In_ ULONG Length,
+    _Out_ PULONG Transferred)
+{
+    *Transferred = 0;
+
+    if (Transport->Disconnected)
+    {
+        return FaultDisconnect;
+    }
+
+    if (Transport->Simulator.DeviceType == DualShock3
+        && !(Setup[0] & 0x80) && Setup[1] == SetReport
+        && (USHORT)(Setup[2] | (Setup[3] << 8)) == Ds3FeatureStartDevice)
+    {
+        Transport->EnableRequests++;
+    }
+
+    return SimulatorControlTransfer(&Transport->Simulator, Setup, Buffer, Length, Transferred)
+        ? FaultNone
+        : FaultStall;
+}
@@ -0,0 +1,123 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include "Portable.h"
+#include "Simulator.h"
+
+//
+// Fault-injecting stand-in for the interrupt-in pipe and control endpoint
+// 
+// Wraps the simulated controller and fails reads the way a flaky cable or
+// hub does, so the reader recovery can be exercised without hardware.
+// 
+typedef enum _FAULT_KIND
+{
+    //
+    // The transfer went through
+    // 
+    FaultNone,
+
+    //
+    // Transfers time out, each injected one fails a single read
+    // 
+    FaultTimeout,
+
+    //
+    // The endpoint halts, every read fails until the pipe gets reset
+    // 
+    FaultStall,
+
+    //
+    // The device dropped off the bus, reads and control transfers fail
+    // until the fault gets cleared
+    // 
+    FaultDisconnect
+
+} FAULT_KIND;
+
+typedef struct _FAULT_TRANSPORT
+{
+    SIMULATOR Simulator;
+
+    //
+    // Timeouts left to inject
+    // 
+    ULONG Timeouts;
+
+    BOOLEAN Stalled;
+
+    BOOLEAN Disconnected;
+
+    ULONG Reads;
+
+    ULONG FailedReads;
+
+    ULONG PipeResets;
+
+    //
+    // DualShock 3 enable requests the device received
+    // 
+    ULONG EnableRequests;
+
+} FAULT_TRANSPORT, *PFAULT_TRANSPORT;
+
+//
+// The DualShock 3 starts out enabled, as after the initial handshake
+// 
+VOID
+FaultTransportInitialize(
+    _Out_ PFAULT_TRANSPORT Transport,
+    _In_ DS_DEVICE_TYPE DeviceType);
+
+//
+// Count only applies to FaultTimeout, FaultNone clears every fault
+// 
+VOID
+FaultTransportInject(
+    _Inout_ PFAULT_TRANSPORT Transport,
+    _In_ FAULT_KIND Fault,
+    _In_ ULONG Count);
+
+FAULT_KIND
+FaultTransportRead(
+    _Inout_ PFAULT_TRANSPORT Transport,
+    _Out_writes_(Length) PUCHAR Report,
+    _In_ ULONG Length,
+    _Out_ PULONG Transferred);
+
+VOID
+FaultTransportResetPipe(
+    _Inout_ PFAULT_TRANSPORT Transport);
+
+FAULT_KIND
+FaultTransportControl(
+    _Inout_ PFAULT_TRANSPORT Transport,
+    _In_reads_(8) const UCHAR *Setup,
+    _Inout_ PUCHAR Buffer,
+    _In_ ULONG Length,
+    _Out_ PULONG Transferred);
@@ -0,0 +1,325 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Pipeline.h"
+
+VOID
+PipelinePadInitialize(
+    _Out_ PPIPELINE_PAD Pad,
+    _In_ DS_DEVICE_TYPE DeviceType,
+    _In_ SIMULATOR_PATTERN Pattern,
+    _In_ ULONG Seed)
+{
+    UCHAR feature[DS4_FEATURE_REPORT_CALIBRATION_SIZE];
+    ULONG transferred;
+
+    //
+    // GET_REPORT for the calibration feature report
+    // 
+    static const UCHAR calibrationRequest[8] =
+    {
+        0xA1, GetReport, DS4_FEATURE_REPORT_CALIBRATION, HidReportRequestTypeFeature,
+        0x00, 0x00, DS4_FEATURE_REPORT_CALIBRATION_SIZE, 0x00
+    };
+
+    RtlZeroMemory(Pad, sizeof(PIPELINE_PAD));
+
+    SimulatorInitialize(&Pad->Simulator, DeviceType, Pattern, Seed);
+
+    //
+    // Skip the DualShock 3 enable handshake
+    // 
+    Pad->Simulator.Started = TRUE;
+
+    if (DeviceType == DualShock4
+        && SimulatorControlTransfer(&Pad->Simulator, calibrationRequest, feature, sizeof(feature), &transferred))
+    {
+        Pad->CalibrationValid = DsDecodeDs4Calibration(feature, transferred, &Pad->Calibration);
+    }
+
+    HistogramReset(&Pad->InterArrival);
+    HistogramReset(&Pad->Delivery);
+}
+
+//
+// Lets the pad produce its next report and files it like
+// DsUsbInputReportReceived does. Returns the report's sequence number.
+// 
+ULONG
+PipelinePadReceive(
+    _Inout_ PPIPELINE_PAD Pad,
+    _In_ LONGLONG Timestamp)
+{
+    PPIPELINE_REPORT pEntry;
+
+    if (Pad->Latest != NULL)
+    {
+        HistogramRecord(&Pad->InterArrival,
+            Timestamp > Pad->Latest->Timestamp ? (ULONGLONG)(Timestamp - Pad->Latest->Timestamp) : 0);
+    }
+
+    pEntry = &Pad->History[++Pad->Sequence % PIPELINE_HISTORY_DEPTH];
+
+    pEntry->Timestamp = Timestamp;
+    pEntry->Sequence = Pad->Sequence;
+    pEntry->Length = SimulatorNextReport(&Pad->Simulator, pEntry->Buffer, FIRESHOCK_INPUT_REPORT_LENGTH);
+
+    Pad->Latest = pEntry;
+
+    if (Pad->Ring != NULL && InputRingIsAttached(Pad->Ring))
+    {
+        InputRingPush(Pad->Ring, Timestamp, pEntry->Sequence, pEntry->Buffer, pEntry->Length);
+    }
+
+    return Pad->Sequence;
+}
+
+//
+// A handle opened now only gets the reports received from here on.
+// 
+VOID
+PipelineReaderInitialize(
+    _Out_ PPIPELINE_READER Reader,
+    _In_ const PIPELINE_PAD *Pad,
+    _In_ BOOLEAN Normalize)
+{
+    RtlZeroMemory(Reader, sizeof(PIPELINE_READER));
+
+    Reader->LastSequence = Pad->Sequence;
+    Reader->Normalize = Normalize;
+
+    ChangeFilterConfigure(&Reader->ChangeFilter, FALSE, 0, 0);
+}
+
+static const DS4_CALIBRATION *
+PipelineCalibration(
+    _In_ const PIPELINE_PAD *Pad)
+{
+    return Pad->CalibrationValid ? &Pad->Calibration : NULL;
+}
+
+static BOOLEAN
+PipelineDecodable(
+    _In_ const PIPELINE_PAD *Pad,
+    _In_ const PIPELINE_REPORT *Report)
+{
+    switch (Pad->Simulator.DeviceType)
+    {
+    case DualShock3:
+        return Report->Length >= DS3_HID_INPUT_REPORT_SIZE && Report->Buffer[0] == 0x01;
+    case DualShock4:
+        return Report->Length >= DS4_HID_INPUT_REPORT_SIZE && Report->Buffer[0] == 0x01;
+    default:
+        return FALSE;
+    }
+}
+
+static VOID
+PipelineDecode(
+    _In_ const PIPELINE_PAD *Pad,
+    _In_ const PIPELINE_REPORT *Report,
+    _Out_ PFIRESHOCK_CONTROLLER_STATE State)
+{
+    switch (Pad->Simulator.DeviceType)
+    {
+    case DualShock3:
+        DsDecodeDs3Report(Report->Buffer, Report->Length, State);
+        break;
+    case DualShock4:
+        DsDecodeDs4Report(Report->Buffer, Report->Length, PipelineCalibration(Pad), State);
+        break;
+    default:
+        RtlZeroMemory(State, sizeof(FIRESHOCK_CONTROLLER_STATE));
+        break;
+    }
+}
+
+//
+// DsUsbInputHistorySkip
+// 
+static VOID
+PipelineReaderSkip(
+    _In_ const PIPELINE_PAD *Pad,
+    _Inout_ PPIPELINE_READER Reader)
+{
+    ULONG pending = Pad->Sequence - Reader->LastSequence;
+    ULONG available = min(Pad->Sequence, PIPELINE_HISTORY_DEPTH);
+
+    if (pending > available)
+    {
+        Reader->Dropped += min(pending, Pad->Sequence) - available;
+        Reader->LastSequence = Pad->Sequence - available;
+    }
+}
+
+static VOID
+PipelineEntryStore(
+    _In_ const PIPELINE_REPORT *Report,
+    _In_opt_ const FIRESHOCK_CONTROLLER_STATE *State,
+    _Out_ PFIRESHOCK_INPUT_BATCH_ENTRY Entry)
+{
+    Entry->Envelope.Timestamp = Report->Timestamp;
+    Entry->Envelope.Sequence = Report->Sequence;
+
+    if (State != NULL)
+    {
+        Entry->Envelope.Length = sizeof(FIRESHOCK_CONTROLLER_STATE);
+        RtlCopyMemory(Entry->Report, State, sizeof(FIRESHOCK_CONTROLLER_STATE));
+        RtlZeroMemory(&Entry->Report[sizeof(FIRESHOCK_CONTROLLER_STATE)],
+            FIRESHOCK_INPUT_REPORT_LENGTH - sizeof(FIRESHOCK_CONTROLLER_STATE));
+        return;
+    }
+
+    Entry->Envelope.Length = Report->Length;
+    RtlCopyMemory(Entry->Report, Report->Buffer, Report->Length);
+    RtlZeroMemory(&Entry->Report[Report->Length], FIRESHOCK_INPUT_REPORT_LENGTH - Report->Length);
+}
+
+//
+// Moves up to MaxEntries pending reports into a batch the way
+// DsUsbInputHistoryDrain does for queued handles and accounts for their
+// delivery at Now. Returns the number of entries.
+// 
+ULONG
+PipelineReaderDrain(
+    _Inout_ PPIPELINE_PAD Pad,
+    _Inout_ PPIPELINE_READER Reader,
+    _Out_ PFIRESHOCK_INPUT_BATCH Batch,
+    _In_ ULONG MaxEntries,
+    _In_ LONGLONG Now)
+{
+    PPIPELINE_REPORT            pEntry;
+    ULONG                       count = 0;
+    ULONG                       head;
+    ULONG                       run;
+    ULONG                       index;
+    FIRESHOCK_CONTROLLER_STATE  state;
+
+    PipelineReaderSkip(Pad, Reader);
+
+    if (Reader->ChangeFilter.Enabled)
+    {
+        //
+        // Reports get picked one by one, like plain reads do
+        // 
+        while (count < MaxEntries && Reader->LastSequence != Pad->Sequence)
+        {
+            pEntry = &Pad->History[++Reader->LastSequence % PIPELINE_HISTORY_DEPTH];
+
+            PipelineDecode(Pad, pEntry, &state);
+
+            if (!ChangeFilterTest(&Reader->ChangeFilter, &state, pEntry->Timestamp))
+            {
+                continue;
+            }
+
+            ChangeFilterUpdate(&Reader->ChangeFilter, &state, pEntry->Timestamp);
+
+            PipelineEntryStore(pEntry, Reader->Normalize ? &state : NULL, &Batch->Entries[count++]);
+        }
+    }
+    else
+    {
+        while (count < MaxEntries && Reader->LastSequence != Pad->Sequence)
+        {
+            //
+            // Contiguous runs of the history get decoded in one go
+            // 
+            head = (Reader->LastSequence + 1) % PIPELINE_HISTORY_DEPTH;
+
+            run = min(MaxEntries - count, Pad->Sequence - Reader->LastSequence);
+            run = min(run, PIPELINE_HISTORY_DEPTH - head);
+
+            for (index = 0; index < run; index++)
+            {
+                pEntry = &Pad->History[head + index];
+
+                if (Reader->Normalize)
+                {
+                    Batch->Entries[count + index].Envelope.Timestamp = pEntry->Timestamp;
+                    Batch->Entries[count + index].Envelope.Sequence = pEntry->Sequence;
+                    Batch->Entries[count + index].Envelope.Length = sizeof(FIRESHOCK_CONTROLLER_STATE);
+                    RtlZeroMemory(&Batch->Entries[count + index].Report[sizeof(FIRESHOCK_CONTROLLER_STATE)],
+                        FIRESHOCK_INPUT_REPORT_LENGTH - sizeof(FIRESHOCK_CONTROLLER_STATE));
+                    continue;
+                }
+
+                PipelineEntryStore(pEntry, NULL, &Batch->Entries[count + index]);
+            }
+
+            if (Reader->Normalize && Pad->Simulator.DeviceType == DualShock3)
+            {
+                DsDecodeDs3Batch(
+                    Pad->History[head].Buffer,
+                    sizeof(PIPELINE_REPORT),
+                    Batch->Entries[count].Report,
+                    sizeof(FIRESHOCK_INPUT_BATCH_ENTRY),
+                    run);
+            }
+            else if (Reader->Normalize && Pad->Simulator.DeviceType == DualShock4)
+            {
+                DsDecodeDs4Batch(
+                    Pad->History[head].Buffer,
+                    sizeof(PIPELINE_REPORT),
+                    PipelineCalibration(Pad),
+                    Batch->Entries[count].Report,
+                    sizeof(FIRESHOCK_INPUT_BATCH_ENTRY),
+                    run);
+            }
+
+            //
+            // Short or foreign reports get a zeroed state
+            // 
+            for (index = 0; Reader->Normalize && index < run; index++)
+            {
+                if (!PipelineDecodable(Pad, &Pad->History[head + index]))
+                {
+                    RtlZeroMemory(Batch->Entries[count + index].Report, sizeof(FIRESHOCK_CONTROLLER_STATE));
+                }
+            }
+
+            Reader->LastSequence += run;
+            count += run;
+        }
+    }
+
+    Batch->Count = count;
+    Batch->Dropped = 0;
+
+    if (count > 0)
+    {
+        Batch->Dropped = Reader->Dropped;
+        Reader->Dropped = 0;
+    }
+
+    for (index = 0; index < count; index++)
+    {
+        HistogramRecord(&Pad->Delivery,
+            Now > Batch->Entries[index].Envelope.Timestamp ? (ULONGLONG)(Now - Batch->Entries[index].Envelope.Timestamp) : 0);
+    }
+
+    return count;
+}
@@ -0,0 +1,136 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include "Portable.h"
+#include "FireShock.h"
+#include "DsDecode.h"
+#include "ChangeFilter.h"
+#include "Histogram.h"
+#include "InputRing.h"
+#include "Simulator.h"
+
+//
+// Host model of the input path
+// 
+// Mirrors DsUsbInputReportReceived and DsUsbInputHistoryDrain on top of
+// the portable modules: every report is copied once into the history of
+// its pad, handles read from there at their own pace. Timestamps are
+// virtual and in microseconds so they go into the histograms as they are.
+// 
+
+//
+// INPUT_HISTORY_DEPTH of the driver (Device.h)
+// 
+#define PIPELINE_HISTORY_DEPTH  64
+
+typedef struct _PIPELINE_REPORT
+{
+    LONGLONG Timestamp;
+
+    ULONG Sequence;
+
+    ULONG Length;
+
+    UCHAR Buffer[FIRESHOCK_INPUT_REPORT_LENGTH];
+
+} PIPELINE_REPORT, *PPIPELINE_REPORT;
+
+typedef struct _PIPELINE_PAD
+{
+    SIMULATOR Simulator;
+
+    BOOLEAN CalibrationValid;
+
+    DS4_CALIBRATION Calibration;
+
+    //
+    // Sequence number of the last report received
+    // 
+    ULONG Sequence;
+
+    PPIPELINE_REPORT Latest;
+
+    PIPELINE_REPORT History[PIPELINE_HISTORY_DEPTH];
+
+    //
+    // Shared ring the reports get pushed to as well, optional
+    // 
+    PINPUT_RING Ring;
+
+    HISTOGRAM InterArrival;
+
+    HISTOGRAM Delivery;
+
+} PIPELINE_PAD, *PPIPELINE_PAD;
+
+//
+// Per handle state, the part of FILE_CONTEXT the drain works with
+// 
+typedef struct _PIPELINE_READER
+{
+    ULONG LastSequence;
+
+    ULONG Dropped;
+
+    BOOLEAN Normalize;
+
+    CHANGE_FILTER ChangeFilter;
+
+} PIPELINE_READER, *PPIPELINE_READER;
+
+VOID
+PipelinePadInitialize(
+    _Out_ PPIPELINE_PAD Pad,
+    _In_ DS_DEVICE_TYPE DeviceType,
+    _In_ SIMULATOR_PATTERN Pattern,
+    _In_ ULONG Seed);
+
+ULONG
+PipelinePadReceive(
+    _Inout_ PPIPELINE_PAD Pad,
+    _In_ LONGLONG Timestamp);
+
+VOID
+PipelineReaderInitialize(
+    _Out_ PPIPELINE_READER Reader,
+    _In_ const PIPELINE_PAD *Pad,
+    _In_ BOOLEAN Normalize);
+
+ULONG
+PipelineReaderDrain(
+    _Inout_ PPIPELINE_PAD Pad,
+    _Inout_ PPIPELINE_READER Reader,
+    _Out_ PFIRESHOCK_INPUT_BATCH Batch,
+    _In_ ULONG MaxEntries,
+    _In_ LONGLONG Now);
+
+//
+// Size of a batch holding _n_ entries
+// 
+#define PIPELINE_BATCH_LENGTH(_n_) \
+    (sizeof(FIRESHOCK_INPUT_BATCH) + ((_n_) - 1) * sizeof(FIRESHOCK_INPUT_BATCH_ENTRY))
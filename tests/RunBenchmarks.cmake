@@ -0,0 +1,22 @@
+#
+# Runs each executable in BENCHMARKS and writes their output to OUTPUT
+#
+file(WRITE ${OUTPUT} "")
+
+foreach(benchmark ${BENCHMARKS})
+    message(STATUS "Running ${benchmark}")
+
+    execute_process(
+        COMMAND ${benchmark}
+        OUTPUT_VARIABLE result
+        RESULT_VARIABLE status
+    )
+
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "${benchmark} failed with ${status}")
+    endif()
+
+    file(APPEND ${OUTPUT} "${result}")
+endforeach()
+
+message(STATUS "Results written to ${OUTPUT}")
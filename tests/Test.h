@@ -0,0 +1,59 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Minimal host-side test support
+// 
+// Each test program is a list of TEST_RUN()s in main() returning
+// TEST_RESULT(). A failed TEST_ASSERT reports its location and lets the
+// test carry on so one run shows every broken expectation.
+// 
+static int TestFailures;
+
+#define TEST_ASSERT(_e_)                                                    \
+    do                                                                      \
+    {                                                                       \
+        if (!(_e_))                                                         \
+        {                                                                   \
+            fprintf(stderr, "%s(%d): assertion failed: %s\n",              \
+                __FILE__, __LINE__, #_e_);                                  \
+            TestFailures++;                                                 \
+        }                                                                   \
+    } while (0)
+
+#define TEST_RUN(_f_)                                                       \
+    do                                                                      \
+    {                                                                       \
+        int _before_ = TestFailures;                                        \
+        _f_();                                                              \
+        printf("%s %s\n", (TestFailures == _before_) ? "PASS" : "FAIL", #_f_); \
+    } while (0)
+
+#define TEST_RESULT()   ((TestFailures == 0) ? EXIT_SUCCESS : EXIT_FAILURE)
@@ -0,0 +1,183 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "Traffic.h"
+#include "Replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static VOID
+BenchTrafficAllocate(
+    _Out_ PBENCH_TRAFFIC Traffic,
+    _In_ DS_DEVICE_TYPE DeviceType,
+    _In_ ULONG Count)
+{
+    RtlZeroMemory(Traffic, sizeof(BENCH_TRAFFIC));
+
+    Traffic->DeviceType = DeviceType;
+    Traffic->Reports = (PUCHAR)calloc(max(Count, 1), FIRESHOCK_INPUT_REPORT_LENGTH);
+    Traffic->Lengths = (PULONG)calloc(max(Count, 1), sizeof(ULONG));
+
+    if (Traffic->Reports == NULL || Traffic->Lengths == NULL)
+    {
+        abort();
+    }
+}
+
+//
+// Collects the interrupt-in reports of a capture file. Returns FALSE if
+// the file can't be read, isn't a capture or holds no reports.
+// 
+BOOLEAN
+BenchTrafficLoad(
+    _Out_ PBENCH_TRAFFIC Traffic,
+    _In_ const char *Path)
+{
+    FILE                            *file;
+    PUCHAR                          data;
+    long                            length;
+    REPLAY                          replay;
+    const FIRESHOCK_CAPTURE_RECORD  *record;
+    ULONGLONG                       delay;
+    ULONG                           payload;
+
+    RtlZeroMemory(Traffic, sizeof(BENCH_TRAFFIC));
+
+    file = fopen(Path, "rb");
+
+    if (file == NULL)
+    {
+        return FALSE;
+    }
+
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data = (PUCHAR)malloc(length > 0 ? (size_t)length : 1);
+
+    if (data == NULL || length <= 0 || fread(data, 1, (size_t)length, file) != (size_t)length
+        || !ReplayInitialize(&replay, data, (size_t)length, FALSE))
+    {
+        fclose(file);
+        free(data);
+        return FALSE;
+    }
+
+    fclose(file);
+
+    //
+    // Records are at least a header long, which bounds the report count
+    // 
+    BenchTrafficAllocate(Traffic, (DS_DEVICE_TYPE)replay.Header.DeviceType,
+        (ULONG)((size_t)length / FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE));
+
+    while ((record = ReplayNext(&replay, &delay)) != NULL)
+    {
+        if (record->Type != FIRESHOCK_CAPTURE_RECORD_INTERRUPT_IN || record->Status < 0)
+        {
+            continue;
+        }
+
+        payload = min(record->Size - FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE, FIRESHOCK_INPUT_REPORT_LENGTH);
+
+        RtlCopyMemory(BENCH_TRAFFIC_REPORT(Traffic, Traffic->Count), record->Payload, payload);
+        Traffic->Lengths[Traffic->Count++] = payload;
+    }
+
+    Traffic->CalibrationValid = replay.CalibrationValid;
+    Traffic->Calibration = replay.Calibration;
+
+    free(data);
+
+    if (Traffic->Count == 0)
+    {
+        BenchTrafficFree(Traffic);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+//
+// Lets the simulated controller produce Count reports in the given pattern.
+// 
+VOID
+BenchTrafficGenerate(
+    _Out_ PBENCH_TRAFFIC Traffic,
+    _In_ DS_DEVICE_TYPE DeviceType,
+    _In_ SIMULATOR_PATTERN Pattern,
+    _In_ ULONG Count)
+{
+    SIMULATOR   simulator;
+    UCHAR       feature[DS4_FEATURE_REPORT_CALIBRATION_SIZE];
+    ULONG       transferred;
+    ULONG       i;
+
+    //
+    // GET_REPORT for the calibration feature report
+    // 
+    static const UCHAR calibrationRequest[8] =
+    {
+        0xA1, GetReport, DS4_FEATURE_REPORT_CALIBRATION, HidReportRequestTypeFeature,
+        0x00, 0x00, DS4_FEATURE_REPORT_CALIBRATION_SIZE, 0x00
+    };
+
+    BenchTrafficAllocate(Traffic, DeviceType, Count);
+
+    SimulatorInitialize(&simulator, DeviceType, Pattern, Count);
+
+    //
+    // Skip the DualShock 3 enable handshake
+    // 
+    simulator.Started = TRUE;
+
+    if (DeviceType == DualShock4
+        && SimulatorControlTransfer(&simulator, calibrationRequest, feature, sizeof(feature), &transferred))
+    {
+        Traffic->CalibrationValid = DsDecodeDs4Calibration(feature, transferred, &Traffic->Calibration);
+    }
+
+    for (i = 0; i < Count; i++)
+    {
+        Traffic->Lengths[i] = SimulatorNextReport(
+            &simulator,
+            BENCH_TRAFFIC_REPORT(Traffic, i),
+            FIRESHOCK_INPUT_REPORT_LENGTH);
+    }
+
+    Traffic->Count = Count;
+}
+
+VOID
+BenchTrafficFree(
+    _Inout_ PBENCH_TRAFFIC Traffic)
+{
+    free(Traffic->Reports);
+    free(Traffic->Lengths);
+
+    RtlZeroMemory(Traffic, sizeof(BENCH_TRAFFIC));
+}
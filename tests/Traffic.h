@@ -0,0 +1,76 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "Portable.h"
+#include "FireShock.h"
+#include "DsDecode.h"
+#include "Simulator.h"
+
+//
+// Input reports to benchmark on
+// 
+// Either taken from a capture read via IOCTL_FIRESHOCK_READ_CAPTURE or
+// made up by the simulated controller. Report n starts at
+// Reports + n * FIRESHOCK_INPUT_REPORT_LENGTH and is Lengths[n] long.
+// 
+typedef struct _BENCH_TRAFFIC
+{
+    DS_DEVICE_TYPE DeviceType;
+
+    ULONG Count;
+
+    PUCHAR Reports;
+
+    PULONG Lengths;
+
+    //
+    // Motion calibration of the (simulated) DualShock 4
+    // 
+    BOOLEAN CalibrationValid;
+
+    DS4_CALIBRATION Calibration;
+
+} BENCH_TRAFFIC, *PBENCH_TRAFFIC;
+
+BOOLEAN
+BenchTrafficLoad(
+    _Out_ PBENCH_TRAFFIC Traffic,
+    _In_ const char *Path);
+
+VOID
+BenchTrafficGenerate(
+    _Out_ PBENCH_TRAFFIC Traffic,
+    _In_ DS_DEVICE_TYPE DeviceType,
+    _In_ SIMULATOR_PATTERN Pattern,
+    _In_ ULONG Count);
+
+VOID
+BenchTrafficFree(
+    _Inout_ PBENCH_TRAFFIC Traffic);
+
+#define BENCH_TRAFFIC_REPORT(_t_, _n_) \
+    (&(_t_)->Reports[(size_t)(_n_) * FIRESHOCK_INPUT_REPORT_LENGTH])
@@ -0,0 +1,158 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "ChangeFilter.h"
+#include "DsDecode.h"
+#include "Bench.h"
+#include "Traffic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Change filter cost
+// 
+// What a change-filtering handle adds per report on top of the decode:
+// the comparison with the last delivered state and, if it passes, taking
+// it over. Run on recorded input or on simulated pads at rest, where
+// nearly everything gets rejected, and with constantly changing input,
+// where everything passes.
+// 
+#define BENCH_STATES            4096
+#define BENCH_BATCH             64
+
+typedef struct _BENCH_CONTEXT
+{
+    CHANGE_FILTER Filter;
+
+    FIRESHOCK_CONTROLLER_STATE States[BENCH_STATES];
+
+    ULONG Count;
+
+} BENCH_CONTEXT, *PBENCH_CONTEXT;
+
+static VOID
+BenchFilter(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+    ULONG           first = (ULONG)(((ULONGLONG)Round * BENCH_BATCH) % (context->Count - BENCH_BATCH + 1));
+    LONGLONG        timestamp = (LONGLONG)Round * BENCH_BATCH;
+    ULONG           passed = 0;
+    ULONG           i;
+
+    for (i = 0; i < BENCH_BATCH; i++)
+    {
+        if (ChangeFilterTest(&context->Filter, &context->States[first + i], timestamp + i))
+        {
+            ChangeFilterUpdate(&context->Filter, &context->States[first + i], timestamp + i);
+            passed++;
+        }
+    }
+
+    BenchConsume(&passed, sizeof(passed));
+}
+
+//
+// Decodes the traffic up front so only the filter gets measured
+// 
+static VOID
+BenchRun(
+    PBENCH_CONTEXT Context,
+    PBENCH_TRAFFIC Traffic,
+    const char *Input,
+    ULONG Rounds)
+{
+    static const UCHAR  thresholds[] = { 0, 8 };
+    const char          *device = (Traffic->DeviceType == DualShock3) ? "ds3" : "ds4";
+    char                name[64];
+    ULONG               i;
+
+    Context->Count = min(Traffic->Count, BENCH_STATES);
+
+    for (i = 0; i < Context->Count; i++)
+    {
+        if (Traffic->DeviceType == DualShock3)
+        {
+            DsDecodeDs3Report(BENCH_TRAFFIC_REPORT(Traffic, i), Traffic->Lengths[i], &Context->States[i]);
+        }
+        else
+        {
+            DsDecodeDs4Report(BENCH_TRAFFIC_REPORT(Traffic, i), Traffic->Lengths[i],
+                Traffic->CalibrationValid ? &Traffic->Calibration : NULL, &Context->States[i]);
+        }
+    }
+
+    for (i = 0; i < sizeof(thresholds) / sizeof(thresholds[0]); i++)
+    {
+        ChangeFilterConfigure(&Context->Filter, TRUE, thresholds[i], 0);
+
+        snprintf(name, sizeof(name), "%s_%s_threshold_%u", device, Input, thresholds[i]);
+
+        BenchMeasure("filter", name, BenchFilter, Context, Rounds, BENCH_BATCH);
+    }
+
+    BenchTrafficFree(Traffic);
+}
+
+//
+// ChangeFilterBench [rounds] [capture file]
+// 
+int
+main(
+    int argc,
+    char **argv)
+{
+    static BENCH_CONTEXT    context;
+    BENCH_TRAFFIC           traffic;
+    ULONG                   rounds = BenchArgument(argc, argv, 1, 100000);
+    ULONG                   device;
+
+    if (argc > 2)
+    {
+        if (!BenchTrafficLoad(&traffic, argv[2]) || traffic.Count < BENCH_BATCH)
+        {
+            fprintf(stderr, "%s holds no usable capture\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+
+        BenchRun(&context, &traffic, "capture", rounds);
+
+        return EXIT_SUCCESS;
+    }
+
+    for (device = 0; device < 2; device++)
+    {
+        BenchTrafficGenerate(&traffic, device ? DualShock4 : DualShock3, SimulatorPatternIdle, BENCH_STATES);
+        BenchRun(&context, &traffic, "idle", rounds);
+
+        BenchTrafficGenerate(&traffic, device ? DualShock4 : DualShock3, SimulatorPatternNoise, BENCH_STATES);
+        BenchRun(&context, &traffic, "noise", rounds);
+    }
+
+    return EXIT_SUCCESS;
+}
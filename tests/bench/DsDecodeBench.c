@@ -0,0 +1,192 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "DsDecode.h"
+#include "Bench.h"
+#include "Traffic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Report decoding throughput
+// 
+// Decodes recorded reports (a capture file given on the command line) or
+// simulated ones, one at a time and through the batch decoders.
+// 
+#define BENCH_BATCH             64
+
+typedef struct _BENCH_CONTEXT
+{
+    BENCH_TRAFFIC Traffic;
+
+    FIRESHOCK_CONTROLLER_STATE States[BENCH_BATCH];
+
+} BENCH_CONTEXT, *PBENCH_CONTEXT;
+
+static ULONG
+BenchFirstReport(
+    PBENCH_CONTEXT Context,
+    ULONG Round)
+{
+    return (ULONG)(((ULONGLONG)Round * BENCH_BATCH) % (Context->Traffic.Count - BENCH_BATCH + 1));
+}
+
+static VOID
+BenchDs3Single(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+    ULONG           first = BenchFirstReport(context, Round);
+    ULONG           i;
+
+    for (i = 0; i < BENCH_BATCH; i++)
+    {
+        DsDecodeDs3Report(
+            BENCH_TRAFFIC_REPORT(&context->Traffic, first + i),
+            context->Traffic.Lengths[first + i],
+            &context->States[i]);
+    }
+
+    BenchConsume(context->States, sizeof(context->States));
+}
+
+static VOID
+BenchDs3Batch(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+
+    DsDecodeDs3Batch(
+        BENCH_TRAFFIC_REPORT(&context->Traffic, BenchFirstReport(context, Round)),
+        FIRESHOCK_INPUT_REPORT_LENGTH,
+        (PUCHAR)context->States,
+        sizeof(FIRESHOCK_CONTROLLER_STATE),
+        BENCH_BATCH);
+
+    BenchConsume(context->States, sizeof(context->States));
+}
+
+static const DS4_CALIBRATION *
+BenchCalibration(
+    PBENCH_CONTEXT Context)
+{
+    return Context->Traffic.CalibrationValid ? &Context->Traffic.Calibration : NULL;
+}
+
+static VOID
+BenchDs4Single(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+    ULONG           first = BenchFirstReport(context, Round);
+    ULONG           i;
+
+    for (i = 0; i < BENCH_BATCH; i++)
+    {
+        DsDecodeDs4Report(
+            BENCH_TRAFFIC_REPORT(&context->Traffic, first + i),
+            context->Traffic.Lengths[first + i],
+            BenchCalibration(context),
+            &context->States[i]);
+    }
+
+    BenchConsume(context->States, sizeof(context->States));
+}
+
+static VOID
+BenchDs4Batch(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+
+    DsDecodeDs4Batch(
+        BENCH_TRAFFIC_REPORT(&context->Traffic, BenchFirstReport(context, Round)),
+        FIRESHOCK_INPUT_REPORT_LENGTH,
+        BenchCalibration(context),
+        (PUCHAR)context->States,
+        sizeof(FIRESHOCK_CONTROLLER_STATE),
+        BENCH_BATCH);
+
+    BenchConsume(context->States, sizeof(context->States));
+}
+
+static VOID
+BenchRun(
+    PBENCH_CONTEXT Context,
+    ULONG Rounds)
+{
+    if (Context->Traffic.DeviceType == DualShock3)
+    {
+        BenchMeasure("decode", "ds3_single", BenchDs3Single, Context, Rounds, BENCH_BATCH);
+        BenchMeasure("decode", "ds3_batch", BenchDs3Batch, Context, Rounds, BENCH_BATCH);
+    }
+    else if (Context->Traffic.DeviceType == DualShock4)
+    {
+        BenchMeasure("decode", "ds4_single", BenchDs4Single, Context, Rounds, BENCH_BATCH);
+        BenchMeasure("decode", "ds4_batch", BenchDs4Batch, Context, Rounds, BENCH_BATCH);
+    }
+
+    BenchTrafficFree(&Context->Traffic);
+}
+
+//
+// DsDecodeBench [rounds] [capture file]
+// 
+// Without a capture both device types get measured on simulated noise.
+// 
+int
+main(
+    int argc,
+    char **argv)
+{
+    static BENCH_CONTEXT    context;
+    ULONG                   rounds = BenchArgument(argc, argv, 1, 100000);
+
+    if (argc > 2)
+    {
+        if (!BenchTrafficLoad(&context.Traffic, argv[2]) || context.Traffic.Count < BENCH_BATCH)
+        {
+            fprintf(stderr, "%s holds no usable capture\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+
+        BenchRun(&context, rounds);
+    }
+    else
+    {
+        BenchTrafficGenerate(&context.Traffic, DualShock3, SimulatorPatternNoise, 4096);
+        BenchRun(&context, rounds);
+
+        BenchTrafficGenerate(&context.Traffic, DualShock4, SimulatorPatternNoise, 4096);
+        BenchRun(&context, rounds);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Pipeline.h"
+#include "Bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Per-report cost against the number of handles
+// 
+// One pad, every open handle drains each report right after it arrives.
+// The report is stored once, so what grows with the handles is their copy
+// out of the history and, for normalized handles, the decode. Time per
+// operation is the cost of one report across all handles.
+// 
+#define BENCH_MAX_READERS   32
+
+typedef struct _BENCH_CONTEXT
+{
+    PIPELINE_PAD Pad;
+
+    PIPELINE_READER Readers[BENCH_MAX_READERS];
+
+    ULONG ReaderCount;
+
+    ULONGLONG Batch[PIPELINE_BATCH_LENGTH(8) / sizeof(ULONGLONG) + 1];
+
+} BENCH_CONTEXT, *PBENCH_CONTEXT;
+
+static VOID
+BenchReport(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT          context = (PBENCH_CONTEXT)Parameter;
+    PFIRESHOCK_INPUT_BATCH  batch = (PFIRESHOCK_INPUT_BATCH)context->Batch;
+    LONGLONG                now = (LONGLONG)(Round + 1) * 1000;
+    ULONG                   reader;
+
+    PipelinePadReceive(&context->Pad, now);
+
+    for (reader = 0; reader < context->ReaderCount; reader++)
+    {
+        PipelineReaderDrain(&context->Pad, &context->Readers[reader], batch, 8, now);
+    }
+
+    BenchConsume(batch, sizeof(FIRESHOCK_INPUT_BATCH));
+}
+
+//
+// FanOutBench [rounds] [readers]
+// 
+int
+main(
+    int argc,
+    char **argv)
+{
+    static BENCH_CONTEXT        context;
+    static const ULONG          readerCounts[] = { 1, 2, 4, 8, 16, 32 };
+    static const DS_DEVICE_TYPE deviceTypes[] = { DualShock3, DualShock4 };
+    static const char           *formats[] = { "raw", "normalized" };
+    ULONG                       rounds = BenchArgument(argc, argv, 1, 20000);
+    ULONG                       maxReaders = min(BenchArgument(argc, argv, 2, BENCH_MAX_READERS), BENCH_MAX_READERS);
+    ULONG                       device;
+    char                        name[48];
+    ULONG                       format;
+    ULONG                       i;
+    ULONG                       reader;
+
+    for (device = 0; device < 2; device++)
+    {
+        for (format = 0; format < 2; format++)
+        {
+            for (i = 0; i < sizeof(readerCounts) / sizeof(readerCounts[0]) && readerCounts[i] <= maxReaders; i++)
+            {
+                context.ReaderCount = readerCounts[i];
+
+                PipelinePadInitialize(&context.Pad, deviceTypes[device], SimulatorPatternNoise, 1);
+
+                for (reader = 0; reader < context.ReaderCount; reader++)
+                {
+                    PipelineReaderInitialize(&context.Readers[reader], &context.Pad, format != 0);
+                }
+
+                snprintf(name, sizeof(name), "%s_%s_readers_%lu",
+                    deviceTypes[device] == DualShock3 ? "ds3" : "ds4", formats[format], (unsigned long)context.ReaderCount);
+
+                BenchMeasure("fan_out", name, BenchReport, &context, rounds, 1);
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
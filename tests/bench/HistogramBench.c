@@ -0,0 +1,178 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Histogram.h"
+#include "Bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Histogram update cost
+// 
+// HistogramRecord runs twice per report, so it gets measured alone and
+// with other threads recording into the same histogram at the same time,
+// the way completions on several cores would. Snapshots and percentiles
+// only run on request and are listed for completeness.
+// 
+#define BENCH_SAMPLES           1024
+
+typedef struct _BENCH_CONTEXT
+{
+    HISTOGRAM Histogram;
+
+    //
+    // Plausible latencies in microseconds, mostly around a millisecond
+    // with a tail
+    // 
+    ULONG Samples[BENCH_SAMPLES];
+
+    FIRESHOCK_HISTOGRAM Snapshot;
+
+    ULONG volatile Stop;
+
+} BENCH_CONTEXT, *PBENCH_CONTEXT;
+
+static VOID
+BenchRecord(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+    ULONG           i;
+
+    UNREFERENCED_PARAMETER(Round);
+
+    for (i = 0; i < BENCH_SAMPLES; i++)
+    {
+        HistogramRecord(&context->Histogram, context->Samples[i]);
+    }
+}
+
+static VOID
+BenchSnapshot(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+
+    UNREFERENCED_PARAMETER(Round);
+
+    HistogramSnapshot(&context->Histogram, &context->Snapshot, FALSE);
+
+    BenchConsume(&context->Snapshot, sizeof(context->Snapshot));
+}
+
+static VOID
+BenchPercentiles(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+    ULONG           percentiles[2];
+
+    UNREFERENCED_PARAMETER(Round);
+
+    percentiles[0] = HistogramPercentile(&context->Snapshot, 50);
+    percentiles[1] = HistogramPercentile(&context->Snapshot, 99);
+
+    BenchConsume(percentiles, sizeof(percentiles));
+}
+
+//
+// Keeps recording until told to stop
+// 
+static VOID
+BenchContend(
+    PVOID Parameter)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+    ULONG           i;
+
+    while (!context->Stop)
+    {
+        for (i = 0; i < BENCH_SAMPLES; i++)
+        {
+            HistogramRecord(&context->Histogram, context->Samples[i]);
+        }
+
+        BenchYield();
+    }
+}
+
+//
+// HistogramBench [rounds] [contending threads]
+// 
+int
+main(
+    int argc,
+    char **argv)
+{
+    static BENCH_CONTEXT    context;
+    ULONG                   rounds = BenchArgument(argc, argv, 1, 10000);
+    ULONG                   threads = BenchArgument(argc, argv, 2, 3);
+    PBENCH_THREAD          *contenders;
+    ULONG                   seed = 0x2545F491;
+    ULONG                   i;
+
+    for (i = 0; i < BENCH_SAMPLES; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+
+        context.Samples[i] = 900 + (seed >> 22) + ((i % 64) == 0 ? (seed >> 12) : 0);
+    }
+
+    HistogramReset(&context.Histogram);
+
+    BenchMeasure("histogram", "record", BenchRecord, &context, rounds, BENCH_SAMPLES);
+    BenchMeasure("histogram", "snapshot", BenchSnapshot, &context, rounds, 1);
+    BenchMeasure("histogram", "percentile", BenchPercentiles, &context, rounds, 2);
+
+    contenders = (PBENCH_THREAD *)calloc(max(threads, 1), sizeof(PBENCH_THREAD));
+
+    if (contenders == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < threads; i++)
+    {
+        contenders[i] = BenchThreadStart(BenchContend, &context);
+    }
+
+    BenchMeasure("histogram", "record_contended", BenchRecord, &context, rounds, BENCH_SAMPLES);
+
+    context.Stop = TRUE;
+
+    for (i = 0; i < threads; i++)
+    {
+        BenchThreadJoin(contenders[i]);
+    }
+
+    free(contenders);
+
+    return EXIT_SUCCESS;
+}
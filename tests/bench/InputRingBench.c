@@ -0,0 +1,308 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "InputRing.h"
+#include "Bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Shared input ring vs. one request per report
+// 
+// A producer thread stands in for the interrupt-in completion, a
+// consumer thread for the client. The request path hands over every
+// report with a pended read and its completion, the way ReadFile on the
+// device does; the ring path only wakes the consumer once it ran dry.
+// Saturated runs show throughput, paced runs the handoff latency.
+// 
+#define BENCH_REPORT_LENGTH     49
+
+#define BENCH_PACED_INTERVAL    20000   // ns between paced reports
+#define BENCH_PACED_REPORTS     10000
+
+typedef struct _BENCH_CONTEXT
+{
+    ULONG Reports;
+
+    ULONGLONG Interval;
+
+    PULONGLONG Latencies;
+
+    //
+    // Times the consumer had to block
+    // 
+    ULONG Waits;
+
+    //
+    // Times the producer found the ring full and had to retry
+    // 
+    ULONG Stalls;
+
+    PBENCH_EVENT Submitted;
+
+    PBENCH_EVENT Completed;
+
+    //
+    // Request path: the buffer of the one pending read
+    // 
+    ULONGLONG Timestamp;
+
+    UCHAR Report[BENCH_REPORT_LENGTH];
+
+    //
+    // Ring path
+    // 
+    INPUT_RING Ring;
+
+    ULONG volatile Waiting;
+
+} BENCH_CONTEXT, *PBENCH_CONTEXT;
+
+static VOID
+BenchPace(
+    PULONGLONG Deadline,
+    ULONGLONG Interval)
+{
+    if (Interval == 0)
+    {
+        return;
+    }
+
+    while (BenchNow() < *Deadline)
+    {
+        BenchYield();
+    }
+
+    *Deadline += Interval;
+}
+
+static VOID
+RequestProducer(
+    PVOID Parameter)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+    UCHAR           report[BENCH_REPORT_LENGTH] = { 0x01 };
+    ULONGLONG       deadline = BenchNow();
+    ULONG           i;
+
+    for (i = 0; i < context->Reports; i++)
+    {
+        report[1] = (UCHAR)i;
+
+        //
+        // The report can only go out once a read is pending
+        // 
+        BenchEventWait(context->Submitted);
+        BenchPace(&deadline, context->Interval);
+
+        context->Timestamp = BenchNow();
+        RtlCopyMemory(context->Report, report, sizeof(report));
+
+        BenchEventSet(context->Completed);
+    }
+}
+
+static VOID
+RequestConsumer(
+    PBENCH_CONTEXT Context)
+{
+    ULONG i;
+
+    for (i = 0; i < Context->Reports; i++)
+    {
+        BenchEventSet(Context->Submitted);
+        BenchEventWait(Context->Completed);
+
+        Context->Latencies[i] = BenchNow() - Context->Timestamp;
+        Context->Waits++;
+
+        BenchConsume(Context->Report, sizeof(Context->Report));
+    }
+}
+
+static VOID
+RingProducer(
+    PVOID Parameter)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+    UCHAR           report[BENCH_REPORT_LENGTH] = { 0x01 };
+    ULONGLONG       deadline = BenchNow();
+    ULONG           i;
+
+    for (i = 0; i < context->Reports; i++)
+    {
+        report[1] = (UCHAR)i;
+
+        BenchPace(&deadline, context->Interval);
+
+        //
+        // The driver would drop here, retry so every report gets timed
+        // 
+        while (!InputRingPush(&context->Ring, (LONGLONG)BenchNow(), i, report, sizeof(report)))
+        {
+            context->Stalls++;
+            BenchYield();
+        }
+
+        if (FsInterlockedExchange32(&context->Waiting, 0) != 0)
+        {
+            BenchEventSet(context->Completed);
+        }
+    }
+}
+
+static VOID
+RingConsumer(
+    PBENCH_CONTEXT Context)
+{
+    FIRESHOCK_INPUT_RING_ENTRY  entry;
+    ULONG                       i = 0;
+
+    while (i < Context->Reports)
+    {
+        if (!InputRingPop(Context->Ring.Header, &entry))
+        {
+            //
+            // Announce the wait, then look again so a report published
+            // meanwhile isn't slept on
+            // 
+            FsInterlockedExchange32(&Context->Waiting, 1);
+
+            if (!InputRingPop(Context->Ring.Header, &entry))
+            {
+                BenchEventWait(Context->Completed);
+                Context->Waits++;
+                continue;
+            }
+
+            if (FsInterlockedExchange32(&Context->Waiting, 0) == 0)
+            {
+                //
+                // The producer already saw the flag, eat its wakeup
+                // 
+                BenchEventWait(Context->Completed);
+            }
+        }
+
+        Context->Latencies[i++] = BenchNow() - (ULONGLONG)entry.Timestamp;
+
+        BenchConsume(entry.Report, entry.Length);
+    }
+}
+
+static VOID
+BenchRun(
+    const char *Path,
+    ULONG Reports,
+    ULONG Slots,
+    ULONGLONG Interval)
+{
+    BENCH_CONTEXT   context;
+    PBENCH_THREAD   producer;
+    PVOID           buffer = NULL;
+    ULONGLONG       start;
+    ULONGLONG       elapsed;
+    BOOLEAN         ring = (Path[1] == 'i');
+
+    RtlZeroMemory(&context, sizeof(context));
+
+    context.Reports = Reports;
+    context.Interval = Interval;
+    context.Latencies = (PULONGLONG)calloc(Reports, sizeof(ULONGLONG));
+    context.Submitted = BenchEventCreate();
+    context.Completed = BenchEventCreate();
+
+    if (ring)
+    {
+        size_t length = sizeof(FIRESHOCK_INPUT_RING_HEADER) + (size_t)Slots * sizeof(FIRESHOCK_INPUT_RING_ENTRY);
+
+        buffer = calloc(1, length);
+
+        if (buffer == NULL || !InputRingAttach(&context.Ring, buffer, length))
+        {
+            abort();
+        }
+    }
+
+    if (context.Latencies == NULL)
+    {
+        abort();
+    }
+
+    start = BenchNow();
+
+    producer = BenchThreadStart(ring ? RingProducer : RequestProducer, &context);
+
+    if (ring)
+    {
+        RingConsumer(&context);
+    }
+    else
+    {
+        RequestConsumer(&context);
+    }
+
+    BenchThreadJoin(producer);
+
+    elapsed = BenchNow() - start;
+
+    printf("{\"benchmark\":\"input_ring\",\"path\":\"%s\",\"interval_ns\":%llu,\"reports\":%lu,"
+        "\"reports_per_second\":%.0f,\"consumer_waits\":%lu,\"producer_stalls\":%lu,"
+        "\"latency_ns\":{\"p50\":%llu,\"p99\":%llu}}\n",
+        Path,
+        (unsigned long long)Interval,
+        (unsigned long)Reports,
+        (double)Reports * 1e9 / (double)(elapsed ? elapsed : 1),
+        (unsigned long)context.Waits,
+        (unsigned long)context.Stalls,
+        (unsigned long long)BenchPercentile(context.Latencies, Reports, 50),
+        (unsigned long long)BenchPercentile(context.Latencies, Reports, 99));
+
+    BenchEventDestroy(context.Completed);
+    BenchEventDestroy(context.Submitted);
+    free(context.Latencies);
+    free(buffer);
+}
+
+//
+// InputRingBench [reports] [ring slots]
+// 
+int
+main(
+    int argc,
+    char **argv)
+{
+    ULONG reports = BenchArgument(argc, argv, 1, 200000);
+    ULONG slots = BenchArgument(argc, argv, 2, 256);
+
+    BenchRun("request", reports, slots, 0);
+    BenchRun("ring", reports, slots, 0);
+
+    BenchRun("request", min(reports, BENCH_PACED_REPORTS), slots, BENCH_PACED_INTERVAL);
+    BenchRun("ring", min(reports, BENCH_PACED_REPORTS), slots, BENCH_PACED_INTERVAL);
+
+    return EXIT_SUCCESS;
+}
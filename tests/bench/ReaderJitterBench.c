@@ -0,0 +1,217 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Bench.h"
+#include "FireShock.h"
+#include "DualShock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Continuous reader settings against inter-arrival jitter
+// 
+// Model of the interrupt-in path on a virtual clock, the probe in
+// probe/ReaderJitterProbe.c measures the same on a real pad:
+// 
+// - the host controller polls the pad every frame, if no read is pending
+//   the poll is skipped and the pad's state of that frame never arrives
+// - a transfer completes with a short packet or a full buffer, a report
+//   exactly one packet long therefore waits for the next one if the
+//   buffer has room left
+// - completions are handled one at a time, the timestamp is taken when
+//   handling starts and the read is sent again once it's done; handling
+//   usually takes tens of microseconds but now and then the host process
+//   doesn't get to run for a few milliseconds
+// 
+// Reported is the time between consecutive timestamps, a mean above the
+// frame time means polls went unanswered and pad states got lost. The fixed transfer
+// length and the pending read limit are INTERRUPT_IN_BUFFER_LENGTH and
+// INTERRUPT_IN_MAX_PENDING_READS of the driver (DsUsb.h).
+// 
+#define MODEL_FRAME             1000000ULL
+#define MODEL_FIXED_LENGTH      128
+#define MODEL_MAX_PENDING_READS 10
+#define MODEL_MAX_PACKET        64
+#define MODEL_HANDLING          30000ULL
+#define MODEL_STALL_PERCENT     2
+#define MODEL_STALL_MAX         4000000ULL
+
+typedef struct _MODEL_READ
+{
+    //
+    // Time the read is pending with the host controller again
+    // 
+    ULONGLONG PendingAt;
+
+    //
+    // Bytes collected for the transfer so far
+    // 
+    ULONG Collected;
+
+} MODEL_READ, *PMODEL_READ;
+
+static ULONG
+ModelRandom(
+    PULONG State)
+{
+    *State = *State * 1664525 + 1013904223;
+
+    return *State >> 8;
+}
+
+//
+// Runs the reader until Count timestamps are taken and stores the
+// intervals between them in Samples
+// 
+static VOID
+ModelRun(
+    ULONG ReportLength,
+    ULONG PendingReads,
+    ULONG TransferLength,
+    PULONGLONG Samples,
+    ULONG Count)
+{
+    MODEL_READ  reads[MODEL_MAX_PENDING_READS];
+    ULONG       head = 0;
+    ULONG       random = 0x2545F491;
+    ULONGLONG   frame = 0;
+    ULONGLONG   handlerFree = 0;
+    ULONGLONG   start;
+    ULONGLONG   last = 0;
+    ULONG       taken = 0;
+    ULONG       packet = min(ReportLength, MODEL_MAX_PACKET);
+    PMODEL_READ pRead;
+
+    RtlZeroMemory(reads, sizeof(reads));
+
+    while (taken <= Count)
+    {
+        frame += MODEL_FRAME;
+
+        //
+        // Reads get filled in the order they were sent
+        // 
+        pRead = &reads[head];
+
+        if (pRead->PendingAt > frame)
+        {
+            continue;
+        }
+
+        pRead->Collected += packet;
+
+        if (packet == MODEL_MAX_PACKET && pRead->Collected + MODEL_MAX_PACKET <= TransferLength)
+        {
+            continue;
+        }
+
+        head = (head + 1) % PendingReads;
+
+        start = max(frame, handlerFree);
+
+        handlerFree = start + MODEL_HANDLING / 2 + ModelRandom(&random) % MODEL_HANDLING;
+
+        if (ModelRandom(&random) % 100 < MODEL_STALL_PERCENT)
+        {
+            handlerFree += ModelRandom(&random) % MODEL_STALL_MAX;
+        }
+
+        pRead->PendingAt = handlerFree;
+        pRead->Collected = 0;
+
+        if (taken > 0)
+        {
+            Samples[taken - 1] = start - last;
+        }
+
+        last = start;
+        taken++;
+    }
+}
+
+//
+// ReaderJitterBench [reports per setting]
+// 
+int
+main(
+    int argc,
+    char **argv)
+{
+    static const ULONG  pendingReads[] = { 1, 2, 3, 4, 6, 10 };
+    ULONG               count = BenchArgument(argc, argv, 1, 100000);
+    PULONGLONG          samples;
+    ULONG               transferLengths[3];
+    ULONG               reportLength;
+    ULONG               device;
+    ULONG               depth;
+    ULONG               length;
+    char                name[64];
+
+    samples = (PULONGLONG)calloc(max(count, 1), sizeof(ULONGLONG));
+
+    if (samples == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (device = 0; device < 2; device++)
+    {
+        reportLength = (device == 0) ? DS3_HID_INPUT_REPORT_SIZE : DS4_HID_INPUT_REPORT_SIZE;
+
+        //
+        // Report sized like the driver defaults to, one packet and the
+        // fixed length the driver used before
+        // 
+        transferLengths[0] = reportLength;
+        transferLengths[1] = MODEL_MAX_PACKET;
+        transferLengths[2] = MODEL_FIXED_LENGTH;
+
+        for (depth = 0; depth < sizeof(pendingReads) / sizeof(pendingReads[0]); depth++)
+        {
+            for (length = 0; length < 3; length++)
+            {
+                if (length > 0 && transferLengths[length] == transferLengths[length - 1])
+                {
+                    continue;
+                }
+
+                ModelRun(reportLength, pendingReads[depth], transferLengths[length], samples, count);
+
+                snprintf(name, sizeof(name), "%s_pending_%lu_length_%lu",
+                    device == 0 ? "ds3" : "ds4",
+                    (unsigned long)pendingReads[depth],
+                    (unsigned long)transferLengths[length]);
+
+                BenchReportSamples("reader_jitter", name, samples, count);
+            }
+        }
+    }
+
+    free(samples);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,179 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Pipeline.h"
+#include "Bench.h"
+#include "Traffic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Report copy cost
+// 
+// The copies a report goes through on its way to a client: into the
+// history when it arrives, once with the transferred length and once with
+// the full buffer length the driver used to copy, and into a batch entry
+// with the rest of the entry cleared when a handle reads it raw.
+// 
+#define BENCH_BATCH             64
+
+typedef struct _BENCH_CONTEXT
+{
+    BENCH_TRAFFIC Traffic;
+
+    PIPELINE_REPORT History[BENCH_BATCH];
+
+    FIRESHOCK_INPUT_BATCH_ENTRY Entries[BENCH_BATCH];
+
+} BENCH_CONTEXT, *PBENCH_CONTEXT;
+
+static ULONG
+BenchFirstReport(
+    PBENCH_CONTEXT Context,
+    ULONG Round)
+{
+    return (ULONG)(((ULONGLONG)Round * BENCH_BATCH) % (Context->Traffic.Count - BENCH_BATCH + 1));
+}
+
+static VOID
+BenchHistoryStore(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+    ULONG           first = BenchFirstReport(context, Round);
+    ULONG           i;
+
+    for (i = 0; i < BENCH_BATCH; i++)
+    {
+        context->History[i].Length = context->Traffic.Lengths[first + i];
+        RtlCopyMemory(context->History[i].Buffer, BENCH_TRAFFIC_REPORT(&context->Traffic, first + i),
+            context->History[i].Length);
+    }
+
+    BenchConsume(&context->History[Round % BENCH_BATCH], 1);
+}
+
+static VOID
+BenchHistoryStoreFixed(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+    ULONG           first = BenchFirstReport(context, Round);
+    ULONG           i;
+
+    for (i = 0; i < BENCH_BATCH; i++)
+    {
+        context->History[i].Length = FIRESHOCK_INPUT_REPORT_LENGTH;
+        RtlCopyMemory(context->History[i].Buffer, BENCH_TRAFFIC_REPORT(&context->Traffic, first + i),
+            FIRESHOCK_INPUT_REPORT_LENGTH);
+    }
+
+    BenchConsume(&context->History[Round % BENCH_BATCH], 1);
+}
+
+static VOID
+BenchBatchEntry(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT  context = (PBENCH_CONTEXT)Parameter;
+    ULONG           i;
+
+    UNREFERENCED_PARAMETER(Round);
+
+    for (i = 0; i < BENCH_BATCH; i++)
+    {
+        context->Entries[i].Envelope.Timestamp = context->History[i].Timestamp;
+        context->Entries[i].Envelope.Sequence = context->History[i].Sequence;
+        context->Entries[i].Envelope.Length = context->History[i].Length;
+        RtlCopyMemory(context->Entries[i].Report, context->History[i].Buffer, context->History[i].Length);
+        RtlZeroMemory(&context->Entries[i].Report[context->History[i].Length],
+            FIRESHOCK_INPUT_REPORT_LENGTH - context->History[i].Length);
+    }
+
+    BenchConsume(&context->Entries[Round % BENCH_BATCH], 1);
+}
+
+static VOID
+BenchRun(
+    PBENCH_CONTEXT Context,
+    ULONG Rounds)
+{
+    const char  *device = (Context->Traffic.DeviceType == DualShock3) ? "ds3" : "ds4";
+    char        name[48];
+
+    snprintf(name, sizeof(name), "%s_history_store", device);
+    BenchMeasure("copy", name, BenchHistoryStore, Context, Rounds, BENCH_BATCH);
+
+    snprintf(name, sizeof(name), "%s_history_store_fixed", device);
+    BenchMeasure("copy", name, BenchHistoryStoreFixed, Context, Rounds, BENCH_BATCH);
+
+    //
+    // Entries get filled from the history as the last round left it
+    // 
+    BenchHistoryStore(Context, 0);
+
+    snprintf(name, sizeof(name), "%s_batch_entry", device);
+    BenchMeasure("copy", name, BenchBatchEntry, Context, Rounds, BENCH_BATCH);
+
+    BenchTrafficFree(&Context->Traffic);
+}
+
+//
+// ReportCopyBench [rounds] [capture file]
+// 
+int
+main(
+    int argc,
+    char **argv)
+{
+    static BENCH_CONTEXT    context;
+    ULONG                   rounds = BenchArgument(argc, argv, 1, 100000);
+
+    if (argc > 2)
+    {
+        if (!BenchTrafficLoad(&context.Traffic, argv[2]) || context.Traffic.Count < BENCH_BATCH)
+        {
+            fprintf(stderr, "%s holds no usable capture\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+
+        BenchRun(&context, rounds);
+    }
+    else
+    {
+        BenchTrafficGenerate(&context.Traffic, DualShock3, SimulatorPatternNoise, 4096);
+        BenchRun(&context, rounds);
+
+        BenchTrafficGenerate(&context.Traffic, DualShock4, SimulatorPatternNoise, 4096);
+        BenchRun(&context, rounds);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Pipeline.h"
+#include "Bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Input path cost against the number of pads
+// 
+// Each round is one millisecond of a 1 kHz world: every pad receives a
+// report and its raw and normalized handle drain it right away. The time
+// per operation is the cost of one pad's report, so a flat curve over the
+// pad counts means the work scales linearly and nothing is shared between
+// pads that shouldn't be.
+// 
+#define BENCH_MAX_PADS  32
+
+typedef struct _BENCH_CONTEXT
+{
+    PPIPELINE_PAD Pads;
+
+    PIPELINE_READER Readers[BENCH_MAX_PADS][2];
+
+    ULONG PadCount;
+
+    ULONGLONG Batch[PIPELINE_BATCH_LENGTH(8) / sizeof(ULONGLONG) + 1];
+
+} BENCH_CONTEXT, *PBENCH_CONTEXT;
+
+static VOID
+BenchTick(
+    PVOID Parameter,
+    ULONG Round)
+{
+    PBENCH_CONTEXT          context = (PBENCH_CONTEXT)Parameter;
+    PFIRESHOCK_INPUT_BATCH  batch = (PFIRESHOCK_INPUT_BATCH)context->Batch;
+    LONGLONG                now = (LONGLONG)(Round + 1) * 1000;
+    ULONG                   pad;
+
+    for (pad = 0; pad < context->PadCount; pad++)
+    {
+        PipelinePadReceive(&context->Pads[pad], now);
+
+        PipelineReaderDrain(&context->Pads[pad], &context->Readers[pad][0], batch, 8, now);
+        PipelineReaderDrain(&context->Pads[pad], &context->Readers[pad][1], batch, 8, now);
+    }
+
+    BenchConsume(batch, sizeof(FIRESHOCK_INPUT_BATCH));
+}
+
+//
+// ScalingBench [rounds] [pads]
+// 
+int
+main(
+    int argc,
+    char **argv)
+{
+    static BENCH_CONTEXT    context;
+    static const ULONG      padCounts[] = { 1, 2, 4, 8, 16, 24, 32 };
+    ULONG                   rounds = BenchArgument(argc, argv, 1, 5000);
+    ULONG                   maxPads = min(BenchArgument(argc, argv, 2, BENCH_MAX_PADS), BENCH_MAX_PADS);
+    char                    name[32];
+    ULONG                   i;
+    ULONG                   pad;
+
+    context.Pads = (PPIPELINE_PAD)calloc(BENCH_MAX_PADS, sizeof(PIPELINE_PAD));
+
+    if (context.Pads == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < sizeof(padCounts) / sizeof(padCounts[0]) && padCounts[i] <= maxPads; i++)
+    {
+        context.PadCount = padCounts[i];
+
+        //
+        // A mix of both models, the way a room full of pads would be
+        // 
+        for (pad = 0; pad < context.PadCount; pad++)
+        {
+            PipelinePadInitialize(&context.Pads[pad], (pad & 1) ? DualShock4 : DualShock3, SimulatorPatternNoise, pad + 1);
+
+            PipelineReaderInitialize(&context.Readers[pad][0], &context.Pads[pad], FALSE);
+            PipelineReaderInitialize(&context.Readers[pad][1], &context.Pads[pad], TRUE);
+        }
+
+        snprintf(name, sizeof(name), "pads_%lu", (unsigned long)context.PadCount);
+
+        BenchMeasure("scaling", name, BenchTick, &context, rounds, context.PadCount);
+    }
+
+    free(context.Pads);
+
+    return EXIT_SUCCESS;
+}
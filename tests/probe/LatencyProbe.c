@@ -0,0 +1,152 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Probe.h"
+#include "Bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Input latency on a real pad
+// 
+// Time from the driver's interrupt-in completion, as stamped into the
+// report envelope, to the client's read returning with the report. Both
+// sides use the performance counter, so no clock translation is needed.
+// Measured for reads returning one report at a time, the way most clients
+// read, and for batch reads taking whatever piled up.
+// 
+#define PROBE_BATCH_ENTRIES     64
+#define PROBE_WARM_UP_READS     200
+
+static BOOLEAN
+ProbeMeasure(
+    PPROBE_DEVICE Device,
+    PFIRESHOCK_INPUT_BATCH Batch,
+    ULONG MaxEntries,
+    PULONGLONG Samples,
+    ULONG Count)
+{
+    ULONG           taken = 0;
+    ULONG           reads = 0;
+    ULONG           count;
+    ULONG           index;
+    LARGE_INTEGER   now;
+
+    while (taken < Count)
+    {
+        count = ProbeReadBatch(Device, Batch, MaxEntries);
+
+        QueryPerformanceCounter(&now);
+
+        if (count == 0)
+        {
+            return FALSE;
+        }
+
+        //
+        // Skip whatever was backlogged when the handle was opened
+        // 
+        if (++reads <= PROBE_WARM_UP_READS)
+        {
+            continue;
+        }
+
+        for (index = 0; index < count && taken < Count; index++)
+        {
+            Samples[taken++] = ProbeNanoseconds(Device, now.QuadPart - Batch->Entries[index].Envelope.Timestamp);
+        }
+    }
+
+    return TRUE;
+}
+
+//
+// LatencyProbe [reports] [device index]
+// 
+int
+main(
+    int argc,
+    char **argv)
+{
+    ULONG                   count = BenchArgument(argc, argv, 1, 20000);
+    ULONG                   deviceIndex = BenchArgument(argc, argv, 2, 0);
+    PROBE_DEVICE            device;
+    PFIRESHOCK_INPUT_BATCH  batch;
+    PULONGLONG              samples;
+    const char              *prefix;
+    char                    name[64];
+    int                     result = EXIT_SUCCESS;
+
+    if (!ProbeOpen(&device, deviceIndex))
+    {
+        fprintf(stderr, "No FireShock device %lu found\n", (unsigned long)deviceIndex);
+        return EXIT_FAILURE;
+    }
+
+    batch = (PFIRESHOCK_INPUT_BATCH)calloc(1,
+        sizeof(FIRESHOCK_INPUT_BATCH) + (PROBE_BATCH_ENTRIES - 1) * sizeof(FIRESHOCK_INPUT_BATCH_ENTRY));
+    samples = (PULONGLONG)calloc(max(count, 1), sizeof(ULONGLONG));
+
+    if (batch == NULL || samples == NULL)
+    {
+        ProbeClose(&device);
+        return EXIT_FAILURE;
+    }
+
+    prefix = (device.DeviceType == DualShock3) ? "ds3" : "ds4";
+
+    if (ProbeMeasure(&device, batch, 1, samples, count))
+    {
+        snprintf(name, sizeof(name), "%s_read", prefix);
+        BenchReportSamples("latency_device", name, samples, count);
+    }
+    else
+    {
+        result = EXIT_FAILURE;
+    }
+
+    if (result == EXIT_SUCCESS && ProbeMeasure(&device, batch, PROBE_BATCH_ENTRIES, samples, count))
+    {
+        snprintf(name, sizeof(name), "%s_read_batch", prefix);
+        BenchReportSamples("latency_device", name, samples, count);
+    }
+    else
+    {
+        result = EXIT_FAILURE;
+    }
+
+    if (result != EXIT_SUCCESS)
+    {
+        fprintf(stderr, "Reading input failed with %lu\n", GetLastError());
+    }
+
+    ProbeClose(&device);
+    free(samples);
+    free(batch);
+
+    return result;
+}
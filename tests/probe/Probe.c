@@ -0,0 +1,308 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Probe.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// GUID_DEVINTERFACE_FIRESHOCK (Trace.h)
+// 
+static const GUID ProbeInterfaceGuid =
+    { 0x51ab481a, 0x8d75, 0x4bb6, { 0x99, 0x44, 0x20, 0x0a, 0x2f, 0x99, 0x4e, 0x65 } };
+
+static HANDLE
+ProbeOpenPath(
+    _In_ const char *Path)
+{
+    return CreateFileA(
+        Path,
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL,
+        OPEN_EXISTING,
+        0,
+        NULL);
+}
+
+BOOLEAN
+ProbeOpen(
+    _Out_ PPROBE_DEVICE Device,
+    _In_ ULONG Index)
+{
+    SP_DEVICE_INTERFACE_DATA            interfaceData;
+    PSP_DEVICE_INTERFACE_DETAIL_DATA_A  detail;
+    DWORD                               required = 0;
+    FIRESHOCK_GET_DEVICE_TYPE           deviceType;
+    DWORD                               transferred;
+    LARGE_INTEGER                       frequency;
+
+    ZeroMemory(Device, sizeof(PROBE_DEVICE));
+
+    Device->Handle = INVALID_HANDLE_VALUE;
+    Device->DeviceInfoSet = SetupDiGetClassDevsA(
+        &ProbeInterfaceGuid,
+        NULL,
+        NULL,
+        DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+
+    if (Device->DeviceInfoSet == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    interfaceData.cbSize = sizeof(SP_DEVICE_INTERFACE_DATA);
+
+    if (!SetupDiEnumDeviceInterfaces(Device->DeviceInfoSet, NULL, &ProbeInterfaceGuid, Index, &interfaceData))
+    {
+        ProbeClose(Device);
+        return FALSE;
+    }
+
+    SetupDiGetDeviceInterfaceDetailA(Device->DeviceInfoSet, &interfaceData, NULL, 0, &required, NULL);
+
+    detail = (PSP_DEVICE_INTERFACE_DETAIL_DATA_A)calloc(1, max(required, sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA_A)));
+
+    if (detail == NULL)
+    {
+        ProbeClose(Device);
+        return FALSE;
+    }
+
+    detail->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA_A);
+    Device->DeviceInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
+
+    if (!SetupDiGetDeviceInterfaceDetailA(
+        Device->DeviceInfoSet,
+        &interfaceData,
+        detail,
+        required,
+        NULL,
+        &Device->DeviceInfoData)
+        || strlen(detail->DevicePath) >= sizeof(Device->Path))
+    {
+        free(detail);
+        ProbeClose(Device);
+        return FALSE;
+    }
+
+    strcpy_s(Device->Path, sizeof(Device->Path), detail->DevicePath);
+    free(detail);
+
+    Device->Handle = ProbeOpenPath(Device->Path);
+
+    if (Device->Handle == INVALID_HANDLE_VALUE
+        || !DeviceIoControl(Device->Handle, IOCTL_FIRESHOCK_GET_DEVICE_TYPE, NULL, 0,
+            &deviceType, sizeof(deviceType), &transferred, NULL))
+    {
+        ProbeClose(Device);
+        return FALSE;
+    }
+
+    QueryPerformanceFrequency(&frequency);
+
+    Device->DeviceType = deviceType.DeviceType;
+    Device->Frequency = frequency.QuadPart;
+
+    return TRUE;
+}
+
+VOID
+ProbeClose(
+    _Inout_ PPROBE_DEVICE Device)
+{
+    if (Device->Handle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(Device->Handle);
+        Device->Handle = INVALID_HANDLE_VALUE;
+    }
+
+    if (Device->DeviceInfoSet != INVALID_HANDLE_VALUE && Device->DeviceInfoSet != NULL)
+    {
+        SetupDiDestroyDeviceInfoList(Device->DeviceInfoSet);
+        Device->DeviceInfoSet = INVALID_HANDLE_VALUE;
+    }
+}
+
+BOOLEAN
+ProbeQuerySetting(
+    _In_ PPROBE_DEVICE Device,
+    _In_ const char *Name,
+    _Out_ PULONG Value)
+{
+    HKEY    key;
+    DWORD   type;
+    DWORD   data;
+    DWORD   length = sizeof(data);
+    LONG    result;
+
+    *Value = 0;
+
+    key = SetupDiOpenDevRegKey(Device->DeviceInfoSet, &Device->DeviceInfoData,
+        DICS_FLAG_GLOBAL, 0, DIREG_DEV, KEY_READ);
+
+    if (key == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    result = RegQueryValueExA(key, Name, NULL, &type, (LPBYTE)&data, &length);
+
+    RegCloseKey(key);
+
+    if (result != ERROR_SUCCESS || type != REG_DWORD)
+    {
+        return FALSE;
+    }
+
+    *Value = data;
+
+    return TRUE;
+}
+
+BOOLEAN
+ProbeApplySetting(
+    _In_ PPROBE_DEVICE Device,
+    _In_ const char *Name,
+    _In_opt_ const ULONG *Value)
+{
+    HKEY    key;
+    DWORD   data;
+    LONG    result;
+
+    key = SetupDiOpenDevRegKey(Device->DeviceInfoSet, &Device->DeviceInfoData,
+        DICS_FLAG_GLOBAL, 0, DIREG_DEV, KEY_SET_VALUE);
+
+    if (key == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    if (Value != NULL)
+    {
+        data = *Value;
+        result = RegSetValueExA(key, Name, 0, REG_DWORD, (const BYTE *)&data, sizeof(data));
+    }
+    else
+    {
+        result = RegDeleteValueA(key, Name);
+
+        if (result == ERROR_FILE_NOT_FOUND)
+        {
+            result = ERROR_SUCCESS;
+        }
+    }
+
+    RegCloseKey(key);
+
+    return result == ERROR_SUCCESS;
+}
+
+BOOLEAN
+ProbeRestart(
+    _Inout_ PPROBE_DEVICE Device)
+{
+    SP_PROPCHANGE_PARAMS    params;
+    ULONG                   attempt;
+
+    if (Device->Handle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(Device->Handle);
+        Device->Handle = INVALID_HANDLE_VALUE;
+    }
+
+    ZeroMemory(&params, sizeof(params));
+
+    params.ClassInstallHeader.cbSize = sizeof(SP_CLASSINSTALL_HEADER);
+    params.ClassInstallHeader.InstallFunction = DIF_PROPERTYCHANGE;
+    params.StateChange = DICS_PROPCHANGE;
+    params.Scope = DICS_FLAG_CONFIGSPECIFIC;
+    params.HwProfile = 0;
+
+    if (!SetupDiSetClassInstallParamsA(Device->DeviceInfoSet, &Device->DeviceInfoData,
+            &params.ClassInstallHeader, sizeof(params))
+        || !SetupDiCallClassInstaller(DIF_PROPERTYCHANGE, Device->DeviceInfoSet, &Device->DeviceInfoData))
+    {
+        return FALSE;
+    }
+
+    //
+    // The interface comes back under the same path once the stack is up
+    // 
+    for (attempt = 0; attempt < 100; attempt++)
+    {
+        Device->Handle = ProbeOpenPath(Device->Path);
+
+        if (Device->Handle != INVALID_HANDLE_VALUE)
+        {
+            return TRUE;
+        }
+
+        Sleep(100);
+    }
+
+    return FALSE;
+}
+
+ULONG
+ProbeReadBatch(
+    _In_ PPROBE_DEVICE Device,
+    _Out_ PFIRESHOCK_INPUT_BATCH Batch,
+    _In_ ULONG MaxEntries)
+{
+    DWORD transferred;
+
+    if (!DeviceIoControl(
+        Device->Handle,
+        IOCTL_FIRESHOCK_READ_INPUT_BATCH,
+        NULL,
+        0,
+        Batch,
+        (DWORD)(sizeof(FIRESHOCK_INPUT_BATCH) + (MaxEntries - 1) * sizeof(FIRESHOCK_INPUT_BATCH_ENTRY)),
+        &transferred,
+        NULL)
+        || transferred < sizeof(FIRESHOCK_INPUT_BATCH))
+    {
+        return 0;
+    }
+
+    return Batch->Count;
+}
+
+ULONGLONG
+ProbeNanoseconds(
+    _In_ PPROBE_DEVICE Device,
+    _In_ LONGLONG Ticks)
+{
+    if (Ticks <= 0)
+    {
+        return 0;
+    }
+
+    return (ULONGLONG)((Ticks / Device->Frequency) * 1000000000LL
+        + (Ticks % Device->Frequency) * 1000000000LL / Device->Frequency);
+}
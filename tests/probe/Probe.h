@@ -0,0 +1,111 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include <windows.h>
+#include <setupapi.h>
+
+#include "FireShock.h"
+
+//
+// User-mode measurements against a real pad
+// 
+// The probes open a FireShock device through its interface, read input
+// the way clients do and can change device settings in its hardware key,
+// which takes a device restart and administrative rights.
+// 
+typedef struct _PROBE_DEVICE
+{
+    HANDLE Handle;
+
+    HDEVINFO DeviceInfoSet;
+
+    SP_DEVINFO_DATA DeviceInfoData;
+
+    CHAR Path[MAX_PATH];
+
+    DS_DEVICE_TYPE DeviceType;
+
+    //
+    // Performance counter frequency the driver's timestamps are based on
+    // 
+    LONGLONG Frequency;
+
+} PROBE_DEVICE, *PPROBE_DEVICE;
+
+BOOLEAN
+ProbeOpen(
+    _Out_ PPROBE_DEVICE Device,
+    _In_ ULONG Index);
+
+VOID
+ProbeClose(
+    _Inout_ PPROBE_DEVICE Device);
+
+//
+// Reads a DWORD value of the device's hardware key, FALSE if it isn't set
+// 
+BOOLEAN
+ProbeQuerySetting(
+    _In_ PPROBE_DEVICE Device,
+    _In_ const char *Name,
+    _Out_ PULONG Value);
+
+//
+// Sets a DWORD value of the device's hardware key, or removes it if Value
+// is NULL. Takes effect with the next restart.
+// 
+BOOLEAN
+ProbeApplySetting(
+    _In_ PPROBE_DEVICE Device,
+    _In_ const char *Name,
+    _In_opt_ const ULONG *Value);
+
+//
+// Restarts the device and opens it again once its interface is back
+// 
+BOOLEAN
+ProbeRestart(
+    _Inout_ PPROBE_DEVICE Device);
+
+//
+// Blocks until at least one report is available, returns the number of
+// entries read into Batch or 0 on failure
+// 
+ULONG
+ProbeReadBatch(
+    _In_ PPROBE_DEVICE Device,
+    _Out_ PFIRESHOCK_INPUT_BATCH Batch,
+    _In_ ULONG MaxEntries);
+
+//
+// Converts a performance counter difference to nanoseconds
+// 
+ULONGLONG
+ProbeNanoseconds(
+    _In_ PPROBE_DEVICE Device,
+    _In_ LONGLONG Ticks);
@@ -0,0 +1,186 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Probe.h"
+#include "Bench.h"
+#include "DualShock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Continuous reader settings against inter-arrival jitter on a real pad
+// 
+// Applies every combination of pending reads and transfer length
+// bench/ReaderJitterBench.c models, restarting the device for each, and
+// reports the time between the driver's timestamps of consecutive reports.
+// Gaps in the sequence numbers end an interval without contributing to
+// it. The original settings are put back at the end. Needs administrative
+// rights for the restarts.
+// 
+#define PROBE_BATCH_ENTRIES     64
+#define PROBE_WARM_UP_REPORTS   500
+#define PROBE_MAX_PACKET        64
+#define PROBE_FIXED_LENGTH      128
+
+static const char PendingReadsValueName[] = "InterruptInPendingReads";
+static const char TransferLengthValueName[] = "InterruptInTransferLength";
+
+//
+// Collects Count intervals, returns FALSE if reading fails
+// 
+static BOOLEAN
+ProbeMeasure(
+    PPROBE_DEVICE Device,
+    PFIRESHOCK_INPUT_BATCH Batch,
+    PULONGLONG Samples,
+    ULONG Count)
+{
+    ULONG       taken = 0;
+    ULONG       received = 0;
+    ULONG       lastSequence = 0;
+    LONGLONG    lastTimestamp = 0;
+    ULONG       count;
+    ULONG       index;
+    const FIRESHOCK_REPORT_ENVELOPE *envelope;
+
+    while (taken < Count)
+    {
+        count = ProbeReadBatch(Device, Batch, PROBE_BATCH_ENTRIES);
+
+        if (count == 0)
+        {
+            return FALSE;
+        }
+
+        for (index = 0; index < count && taken < Count; index++)
+        {
+            envelope = &Batch->Entries[index].Envelope;
+
+            if (++received > PROBE_WARM_UP_REPORTS && envelope->Sequence == lastSequence + 1)
+            {
+                Samples[taken++] = ProbeNanoseconds(Device, envelope->Timestamp - lastTimestamp);
+            }
+
+            lastSequence = envelope->Sequence;
+            lastTimestamp = envelope->Timestamp;
+        }
+    }
+
+    return TRUE;
+}
+
+//
+// ReaderJitterProbe [reports per setting] [device index]
+// 
+int
+main(
+    int argc,
+    char **argv)
+{
+    static const ULONG      pendingReads[] = { 1, 2, 3, 4, 6, 10 };
+    ULONG                   count = BenchArgument(argc, argv, 1, 20000);
+    ULONG                   deviceIndex = BenchArgument(argc, argv, 2, 0);
+    PROBE_DEVICE            device;
+    PFIRESHOCK_INPUT_BATCH  batch;
+    PULONGLONG              samples;
+    ULONG                   transferLengths[3];
+    ULONG                   savedPendingReads;
+    ULONG                   savedTransferLength;
+    BOOLEAN                 hadPendingReads;
+    BOOLEAN                 hadTransferLength;
+    ULONG                   depth;
+    ULONG                   length;
+    char                    name[64];
+    int                     result = EXIT_SUCCESS;
+
+    if (!ProbeOpen(&device, deviceIndex))
+    {
+        fprintf(stderr, "No FireShock device %lu found\n", (unsigned long)deviceIndex);
+        return EXIT_FAILURE;
+    }
+
+    batch = (PFIRESHOCK_INPUT_BATCH)calloc(1,
+        sizeof(FIRESHOCK_INPUT_BATCH) + (PROBE_BATCH_ENTRIES - 1) * sizeof(FIRESHOCK_INPUT_BATCH_ENTRY));
+    samples = (PULONGLONG)calloc(max(count, 1), sizeof(ULONGLONG));
+
+    if (batch == NULL || samples == NULL)
+    {
+        ProbeClose(&device);
+        return EXIT_FAILURE;
+    }
+
+    hadPendingReads = ProbeQuerySetting(&device, PendingReadsValueName, &savedPendingReads);
+    hadTransferLength = ProbeQuerySetting(&device, TransferLengthValueName, &savedTransferLength);
+
+    transferLengths[0] = (device.DeviceType == DualShock3) ? DS3_HID_INPUT_REPORT_SIZE : DS4_HID_INPUT_REPORT_SIZE;
+    transferLengths[1] = PROBE_MAX_PACKET;
+    transferLengths[2] = PROBE_FIXED_LENGTH;
+
+    for (depth = 0; depth < sizeof(pendingReads) / sizeof(pendingReads[0]) && result == EXIT_SUCCESS; depth++)
+    {
+        for (length = 0; length < 3; length++)
+        {
+            if (length > 0 && transferLengths[length] == transferLengths[length - 1])
+            {
+                continue;
+            }
+
+            if (!ProbeApplySetting(&device, PendingReadsValueName, &pendingReads[depth])
+                || !ProbeApplySetting(&device, TransferLengthValueName, &transferLengths[length])
+                || !ProbeRestart(&device))
+            {
+                fprintf(stderr, "Applying the settings failed with %lu\n", GetLastError());
+                result = EXIT_FAILURE;
+                break;
+            }
+
+            if (!ProbeMeasure(&device, batch, samples, count))
+            {
+                fprintf(stderr, "Reading input failed with %lu\n", GetLastError());
+                result = EXIT_FAILURE;
+                break;
+            }
+
+            snprintf(name, sizeof(name), "%s_pending_%lu_length_%lu",
+                device.DeviceType == DualShock3 ? "ds3" : "ds4",
+                (unsigned long)pendingReads[depth],
+                (unsigned long)transferLengths[length]);
+
+            BenchReportSamples("reader_jitter_device", name, samples, count);
+        }
+    }
+
+    ProbeApplySetting(&device, PendingReadsValueName, hadPendingReads ? &savedPendingReads : NULL);
+    ProbeApplySetting(&device, TransferLengthValueName, hadTransferLength ? &savedTransferLength : NULL);
+    ProbeRestart(&device);
+
+    ProbeClose(&device);
+    free(samples);
+    free(batch);
+
+    return result;
+}
@@ -0,0 +1,386 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Capture.h"
+#include "Replay.h"
+#include "Simulator.h"
+#include "Test.h"
+
+#define CAPTURE_REPORTS         200
+#define CAPTURE_FREQUENCY       10000000
+#define CAPTURE_INTERVAL        10000   // 1 ms in performance counter ticks
+
+static UCHAR Storage[0x10000];
+
+static UCHAR Output[0x10000];
+
+static UCHAR Reports[CAPTURE_REPORTS][FIRESHOCK_INPUT_REPORT_LENGTH];
+
+static ULONG Lengths[CAPTURE_REPORTS];
+
+//
+// GET_REPORT for the DualShock 4 calibration feature report
+// 
+static const UCHAR CalibrationRequest[8] =
+{
+    0xA1, GetReport, DS4_FEATURE_REPORT_CALIBRATION, HidReportRequestTypeFeature,
+    0x00, 0x00, DS4_FEATURE_REPORT_CALIBRATION_SIZE, 0x00
+};
+
+//
+// Records CAPTURE_REPORTS simulated reports, 1 ms apart, preceded by the
+// DualShock 4 calibration read. Returns the capture length.
+// 
+static ULONG
+Record(
+    DS_DEVICE_TYPE DeviceType,
+    PCAPTURE_BUFFER Buffer)
+{
+    SIMULATOR   simulator;
+    UCHAR       feature[DS4_FEATURE_REPORT_CALIBRATION_SIZE];
+    ULONG       transferred;
+    ULONG       i;
+
+    CaptureBufferInitialize(Buffer, Storage, sizeof(Storage), (USHORT)DeviceType, CAPTURE_FREQUENCY);
+
+    SimulatorInitialize(&simulator, DeviceType, SimulatorPatternNoise, 7);
+    simulator.Started = TRUE;
+
+    if (DeviceType == DualShock4)
+    {
+        TEST_ASSERT(SimulatorControlTransfer(&simulator, CalibrationRequest, feature, sizeof(feature), &transferred));
+        TEST_ASSERT(CaptureBufferAppend(Buffer, FIRESHOCK_CAPTURE_RECORD_CONTROL, CAPTURE_INTERVAL, 0,
+            CalibrationRequest, feature, transferred));
+    }
+
+    for (i = 0; i < CAPTURE_REPORTS; i++)
+    {
+        Lengths[i] = SimulatorNextReport(&simulator, Reports[i], FIRESHOCK_INPUT_REPORT_LENGTH);
+
+        TEST_ASSERT(CaptureBufferAppend(Buffer, FIRESHOCK_CAPTURE_RECORD_INTERRUPT_IN,
+            (LONGLONG)(i + 2) * CAPTURE_INTERVAL, 0, NULL, Reports[i], Lengths[i]));
+    }
+
+    return CaptureBufferRead(Buffer, Output, sizeof(Output));
+}
+
+//
+// Every report comes back unaltered and decodes like it did live
+// 
+static VOID
+TestRoundTrip(
+    DS_DEVICE_TYPE DeviceType)
+{
+    CAPTURE_BUFFER                  buffer;
+    REPLAY                          replay;
+    const FIRESHOCK_CAPTURE_RECORD *record;
+    FIRESHOCK_CONTROLLER_STATE      replayed;
+    FIRESHOCK_CONTROLLER_STATE      expected;
+    ULONG                           length;
+    ULONGLONG                       delay;
+    ULONG                           i = 0;
+
+    length = Record(DeviceType, &buffer);
+
+    TEST_ASSERT(buffer.Used == 0);
+    TEST_ASSERT(ReplayInitialize(&replay, Output, length, FALSE));
+    TEST_ASSERT(replay.Header.DeviceType == DeviceType);
+
+    if (DeviceType == DualShock4)
+    {
+        record = ReplayNext(&replay, &delay);
+
+        TEST_ASSERT(record != NULL && record->Type == FIRESHOCK_CAPTURE_RECORD_CONTROL);
+        TEST_ASSERT(record != NULL && memcmp(record->Setup, CalibrationRequest, sizeof(CalibrationRequest)) == 0);
+        TEST_ASSERT(replay.CalibrationValid);
+    }
+
+    while ((record = ReplayNext(&replay, &delay)) != NULL)
+    {
+        TEST_ASSERT(delay == 0);
+        TEST_ASSERT(i < CAPTURE_REPORTS);
+
+        if (i >= CAPTURE_REPORTS)
+        {
+            break;
+        }
+
+        TEST_ASSERT(record->Type == FIRESHOCK_CAPTURE_RECORD_INTERRUPT_IN);
+        TEST_ASSERT(record->Status == 0);
+        TEST_ASSERT(record->Timestamp == (LONGLONG)(i + 2) * CAPTURE_INTERVAL);
+        TEST_ASSERT(record->Size == FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE + Lengths[i]);
+        TEST_ASSERT(memcmp(record->Payload, Reports[i], Lengths[i]) == 0);
+
+        TEST_ASSERT(ReplayDecode(&replay, record, &replayed));
+
+        if (DeviceType == DualShock3)
+        {
+            TEST_ASSERT(DsDecodeDs3Report(Reports[i], Lengths[i], &expected));
+        }
+        else
+        {
+            TEST_ASSERT(DsDecodeDs4Report(Reports[i], Lengths[i], &replay.Calibration, &expected));
+        }
+
+        TEST_ASSERT(memcmp(&replayed, &expected, sizeof(expected)) == 0);
+
+        i++;
+    }
+
+    TEST_ASSERT(i == CAPTURE_REPORTS);
+}
+
+static VOID
+TestDs3RoundTrip(
+    VOID)
+{
+    TestRoundTrip(DualShock3);
+}
+
+static VOID
+TestDs4RoundTrip(
+    VOID)
+{
+    TestRoundTrip(DualShock4);
+}
+
+//
+// Real time replay asks to wait out the recorded gaps
+// 
+static VOID
+TestTiming(
+    VOID)
+{
+    CAPTURE_BUFFER                  buffer;
+    REPLAY                          replay;
+    ULONG                           length;
+    ULONGLONG                       delay;
+    ULONG                           i;
+
+    length = Record(DualShock3, &buffer);
+
+    TEST_ASSERT(ReplayInitialize(&replay, Output, length, TRUE));
+
+    for (i = 0; ReplayNext(&replay, &delay) != NULL; i++)
+    {
+        TEST_ASSERT(delay == (i == 0 ? 0 : 1000));
+    }
+
+    TEST_ASSERT(i == CAPTURE_REPORTS);
+}
+
+//
+// Records that don't fit get dropped and reported once room frees up
+// 
+static VOID
+TestOverflow(
+    VOID)
+{
+    CAPTURE_BUFFER                  buffer;
+    REPLAY                          replay;
+    const FIRESHOCK_CAPTURE_RECORD *record;
+    UCHAR                           report[DS3_HID_INPUT_REPORT_SIZE];
+    ULONG                           size = FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE + sizeof(report);
+    ULONG                           lost;
+    ULONG                           length;
+    ULONGLONG                       delay;
+    ULONG                           i;
+
+    memset(report, 0x5A, sizeof(report));
+
+    //
+    // Room for three records, but not for the lost record after them
+    // 
+    CaptureBufferInitialize(&buffer, Storage, size * 3 + 8, DualShock3, CAPTURE_FREQUENCY);
+
+    for (i = 0; i < 5; i++)
+    {
+        TEST_ASSERT(CaptureBufferAppend(&buffer, FIRESHOCK_CAPTURE_RECORD_INTERRUPT_IN, i, 0, NULL, report, sizeof(report)) == (i < 3));
+    }
+
+    TEST_ASSERT(buffer.Lost == 2);
+
+    length = CaptureBufferRead(&buffer, Output, sizeof(Output));
+
+    TEST_ASSERT(length == sizeof(FIRESHOCK_CAPTURE_HEADER) + 3 * size);
+
+    TEST_ASSERT(CaptureBufferAppend(&buffer, FIRESHOCK_CAPTURE_RECORD_INTERRUPT_IN, 5, 0, NULL, report, sizeof(report)));
+
+    length += CaptureBufferRead(&buffer, Output + length, sizeof(Output) - length);
+
+    TEST_ASSERT(ReplayInitialize(&replay, Output, length, FALSE));
+
+    for (i = 0; i < 3; i++)
+    {
+        record = ReplayNext(&replay, &delay);
+        TEST_ASSERT(record != NULL && record->Timestamp == i);
+    }
+
+    record = ReplayNext(&replay, &delay);
+
+    TEST_ASSERT(record != NULL && record->Type == FIRESHOCK_CAPTURE_RECORD_LOST);
+
+    if (record != NULL)
+    {
+        memcpy(&lost, record->Payload, sizeof(lost));
+        TEST_ASSERT(lost == 2);
+    }
+
+    record = ReplayNext(&replay, &delay);
+
+    TEST_ASSERT(record != NULL && record->Timestamp == 5);
+    TEST_ASSERT(ReplayNext(&replay, &delay) == NULL);
+}
+
+//
+// Records straddling the end of the ring and reads too short for all of
+// them still come out whole and in order
+// 
+static VOID
+TestWraparound(
+    VOID)
+{
+    CAPTURE_BUFFER                  buffer;
+    REPLAY                          replay;
+    const FIRESHOCK_CAPTURE_RECORD *record;
+    UCHAR                           report[DS3_HID_INPUT_REPORT_SIZE];
+    ULONG                           size = FIRESHOCK_CAPTURE_RECORD_HEADER_SIZE + sizeof(report);
+    ULONG                           length;
+    ULONG                           chunk;
+    ULONGLONG                       delay;
+    ULONG                           appended = 0;
+    ULONG                           read = 0;
+    ULONG                           i;
+
+    CaptureBufferInitialize(&buffer, Storage, size * 4 + 7, DualShock3, CAPTURE_FREQUENCY);
+
+    memset(report, 0, sizeof(report));
+
+    //
+    // Too short for the header
+    // 
+    TEST_ASSERT(CaptureBufferRead(&buffer, Output, sizeof(FIRESHOCK_CAPTURE_HEADER) - 1) == 0);
+
+    length = CaptureBufferRead(&buffer, Output, sizeof(FIRESHOCK_CAPTURE_HEADER));
+
+    TEST_ASSERT(length == sizeof(FIRESHOCK_CAPTURE_HEADER));
+
+    for (i = 0; i < 50; i++)
+    {
+        while (buffer.Capacity - buffer.Used >= size)
+        {
+            TEST_ASSERT(CaptureBufferAppend(&buffer, FIRESHOCK_CAPTURE_RECORD_INTERRUPT_IN, appended, 0, NULL, report, sizeof(report)));
+            memset(report, (UCHAR)++appended, sizeof(report));
+        }
+
+        //
+        // Room for one and a half records, so one at a time
+        // 
+        chunk = CaptureBufferRead(&buffer, Output + length, size + size / 2);
+
+        TEST_ASSERT(chunk == size);
+
+        length += chunk;
+        read++;
+    }
+
+    length += CaptureBufferRead(&buffer, Output + length, sizeof(Output) - length);
+
+    TEST_ASSERT(buffer.Used == 0);
+    TEST_ASSERT(ReplayInitialize(&replay, Output, length, FALSE));
+
+    for (i = 0; (record = ReplayNext(&replay, &delay)) != NULL; i++)
+    {
+        TEST_ASSERT(record->Timestamp == i);
+        TEST_ASSERT(record->Payload[0] == (UCHAR)i && record->Payload[sizeof(report) - 1] == (UCHAR)i);
+    }
+
+    TEST_ASSERT(i == appended);
+    TEST_ASSERT(read == 50);
+}
+
+//
+// Anything but an intact capture is turned down or cut off where it breaks
+// 
+static VOID
+TestMalformed(
+    VOID)
+{
+    CAPTURE_BUFFER                  buffer;
+    REPLAY                          replay;
+    FIRESHOCK_CAPTURE_HEADER        header;
+    ULONG                           length;
+    ULONGLONG                       delay;
+    ULONG                           i;
+
+    length = Record(DualShock3, &buffer);
+
+    TEST_ASSERT(!ReplayInitialize(&replay, Output, sizeof(FIRESHOCK_CAPTURE_HEADER) - 1, FALSE));
+
+    memcpy(&header, Output, sizeof(header));
+
+    header.Magic++;
+    memcpy(Output, &header, sizeof(header));
+    TEST_ASSERT(!ReplayInitialize(&replay, Output, length, FALSE));
+    header.Magic--;
+
+    header.Version++;
+    memcpy(Output, &header, sizeof(header));
+    TEST_ASSERT(!ReplayInitialize(&replay, Output, length, FALSE));
+    header.Version--;
+
+    header.Frequency = 0;
+    memcpy(Output, &header, sizeof(header));
+    TEST_ASSERT(!ReplayInitialize(&replay, Output, length, FALSE));
+    header.Frequency = CAPTURE_FREQUENCY;
+
+    memcpy(Output, &header, sizeof(header));
+
+    //
+    // Cut into the last record
+    // 
+    TEST_ASSERT(ReplayInitialize(&replay, Output, length - 1, FALSE));
+
+    for (i = 0; ReplayNext(&replay, &delay) != NULL; i++)
+    {
+    }
+
+    TEST_ASSERT(i == CAPTURE_REPORTS - 1);
+}
+
+int
+main(
+    VOID)
+{
+    TEST_RUN(TestDs3RoundTrip);
+    TEST_RUN(TestDs4RoundTrip);
+    TEST_RUN(TestTiming);
+    TEST_RUN(TestOverflow);
+    TEST_RUN(TestWraparound);
+    TEST_RUN(TestMalformed);
+
+    return TEST_RESULT();
+}
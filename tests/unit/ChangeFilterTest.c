@@ -0,0 +1,285 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "ChangeFilter.h"
+#include "Test.h"
+
+//
+// Sticks centered, triggers and pressure released
+// 
+static VOID
+RestState(
+    PFIRESHOCK_CONTROLLER_STATE State)
+{
+    RtlZeroMemory(State, sizeof(FIRESHOCK_CONTROLLER_STATE));
+
+    State->LeftThumbX = State->LeftThumbY = 0x80;
+    State->RightThumbX = State->RightThumbY = 0x80;
+}
+
+static CHANGE_FILTER
+PrimedFilter(
+    UCHAR AxisThreshold,
+    LONGLONG KeepAliveInterval)
+{
+    CHANGE_FILTER               filter;
+    FIRESHOCK_CONTROLLER_STATE  state;
+
+    RestState(&state);
+
+    ChangeFilterConfigure(&filter, TRUE, AxisThreshold, KeepAliveInterval);
+    ChangeFilterUpdate(&filter, &state, 0);
+
+    return filter;
+}
+
+//
+// Without a delivered state to compare with, everything passes
+// 
+static VOID
+TestUnprimed(VOID)
+{
+    CHANGE_FILTER               filter;
+    FIRESHOCK_CONTROLLER_STATE  state;
+
+    RestState(&state);
+
+    ChangeFilterConfigure(&filter, FALSE, 10, 0);
+    TEST_ASSERT(ChangeFilterTest(&filter, &state, 0));
+
+    //
+    // Updates of a disabled filter are ignored
+    // 
+    ChangeFilterUpdate(&filter, &state, 0);
+    TEST_ASSERT(!filter.Primed);
+    TEST_ASSERT(ChangeFilterTest(&filter, &state, 1));
+
+    ChangeFilterConfigure(&filter, TRUE, 10, 0);
+    TEST_ASSERT(!filter.Primed);
+    TEST_ASSERT(ChangeFilterTest(&filter, &state, 0));
+
+    ChangeFilterUpdate(&filter, &state, 0);
+    TEST_ASSERT(filter.Primed);
+    TEST_ASSERT(!ChangeFilterTest(&filter, &state, 1));
+}
+
+//
+// A move up to the threshold stays in the deadzone, one more counts
+// 
+static VOID
+TestDeadzone(VOID)
+{
+    CHANGE_FILTER               filter = PrimedFilter(4, 0);
+    FIRESHOCK_CONTROLLER_STATE  state;
+    PUCHAR                      axes[6];
+    ULONG                       i;
+
+    RestState(&state);
+
+    axes[0] = &state.LeftThumbX;
+    axes[1] = &state.LeftThumbY;
+    axes[2] = &state.RightThumbX;
+    axes[3] = &state.RightThumbY;
+    axes[4] = &state.LeftTrigger;
+    axes[5] = &state.RightTrigger;
+
+    for (i = 0; i < 4; i++)
+    {
+        *axes[i] = 0x80 + 4;
+        TEST_ASSERT(!ChangeFilterTest(&filter, &state, 1));
+
+        *axes[i] = 0x80 - 4;
+        TEST_ASSERT(!ChangeFilterTest(&filter, &state, 1));
+
+        *axes[i] = 0x80 + 5;
+        TEST_ASSERT(ChangeFilterTest(&filter, &state, 1));
+
+        *axes[i] = 0x80 - 5;
+        TEST_ASSERT(ChangeFilterTest(&filter, &state, 1));
+
+        *axes[i] = 0x80;
+    }
+
+    for (i = 4; i < 6; i++)
+    {
+        *axes[i] = 4;
+        TEST_ASSERT(!ChangeFilterTest(&filter, &state, 1));
+
+        *axes[i] = 5;
+        TEST_ASSERT(ChangeFilterTest(&filter, &state, 1));
+
+        *axes[i] = 0;
+    }
+
+    for (i = 0; i < FIRESHOCK_PRESSURE_COUNT; i++)
+    {
+        state.Pressure[i] = 4;
+        TEST_ASSERT(!ChangeFilterTest(&filter, &state, 1));
+
+        state.Pressure[i] = 5;
+        TEST_ASSERT(ChangeFilterTest(&filter, &state, 1));
+
+        state.Pressure[i] = 0;
+    }
+
+    //
+    // Full deflection from the opposite end
+    // 
+    state.LeftThumbX = 0x00;
+    ChangeFilterUpdate(&filter, &state, 1);
+
+    state.LeftThumbX = 0xFF;
+    TEST_ASSERT(ChangeFilterTest(&filter, &state, 2));
+
+    //
+    // Threshold 0 passes every axis change
+    // 
+    filter = PrimedFilter(0, 0);
+    RestState(&state);
+
+    state.RightTrigger = 1;
+    TEST_ASSERT(ChangeFilterTest(&filter, &state, 1));
+}
+
+//
+// Drift below the threshold doesn't add up as long as nothing gets
+// delivered, the comparison is always against the last delivered state
+// 
+static VOID
+TestDrift(VOID)
+{
+    CHANGE_FILTER               filter = PrimedFilter(4, 0);
+    FIRESHOCK_CONTROLLER_STATE  state;
+    ULONG                       step;
+
+    RestState(&state);
+
+    for (step = 1; step <= 4; step++)
+    {
+        state.LeftThumbY = (UCHAR)(0x80 + step);
+        TEST_ASSERT(!ChangeFilterTest(&filter, &state, step));
+    }
+
+    state.LeftThumbY = 0x80 + 5;
+    TEST_ASSERT(ChangeFilterTest(&filter, &state, 5));
+
+    ChangeFilterUpdate(&filter, &state, 5);
+
+    state.LeftThumbY = 0x80 + 1;
+    TEST_ASSERT(!ChangeFilterTest(&filter, &state, 6));
+}
+
+//
+// Any button change counts, however large the deadzone
+// 
+static VOID
+TestButtons(VOID)
+{
+    CHANGE_FILTER               filter = PrimedFilter(255, 0);
+    FIRESHOCK_CONTROLLER_STATE  state;
+    ULONG                       bit;
+
+    RestState(&state);
+
+    for (bit = 0; bit < 32; bit++)
+    {
+        state.Buttons = 1UL << bit;
+        TEST_ASSERT(ChangeFilterTest(&filter, &state, 1));
+    }
+
+    state.Buttons = 1;
+    ChangeFilterUpdate(&filter, &state, 1);
+
+    TEST_ASSERT(!ChangeFilterTest(&filter, &state, 2));
+
+    state.Buttons = 0;
+    TEST_ASSERT(ChangeFilterTest(&filter, &state, 2));
+}
+
+//
+// Motion data never settles and isn't compared
+// 
+static VOID
+TestMotionIgnored(VOID)
+{
+    CHANGE_FILTER               filter = PrimedFilter(0, 0);
+    FIRESHOCK_CONTROLLER_STATE  state;
+
+    RestState(&state);
+
+    state.Accelerometer[0] = 1000;
+    state.Accelerometer[2] = -1000;
+    state.Gyroscope[1] = 12345;
+
+    TEST_ASSERT(!ChangeFilterTest(&filter, &state, 1));
+}
+
+//
+// Unchanged states go out once the keep-alive interval has passed
+// since the last delivery
+// 
+static VOID
+TestKeepAlive(VOID)
+{
+    CHANGE_FILTER               filter = PrimedFilter(4, 100);
+    FIRESHOCK_CONTROLLER_STATE  state;
+
+    RestState(&state);
+
+    TEST_ASSERT(!ChangeFilterTest(&filter, &state, 99));
+    TEST_ASSERT(ChangeFilterTest(&filter, &state, 100));
+
+    //
+    // A delivery for a change restarts the interval
+    // 
+    state.Buttons = 1;
+    ChangeFilterUpdate(&filter, &state, 60);
+
+    TEST_ASSERT(!ChangeFilterTest(&filter, &state, 100));
+    TEST_ASSERT(!ChangeFilterTest(&filter, &state, 159));
+    TEST_ASSERT(ChangeFilterTest(&filter, &state, 160));
+
+    //
+    // Without a keep-alive the state is held back indefinitely
+    // 
+    filter = PrimedFilter(4, 0);
+    RestState(&state);
+
+    TEST_ASSERT(!ChangeFilterTest(&filter, &state, 1000000000));
+}
+
+int
+main(VOID)
+{
+    TEST_RUN(TestUnprimed);
+    TEST_RUN(TestDeadzone);
+    TEST_RUN(TestDrift);
+    TEST_RUN(TestButtons);
+    TEST_RUN(TestMotionIgnored);
+    TEST_RUN(TestKeepAlive);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,551 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "DsDecode.h"
+#include "Test.h"
+
+//
+// Stride of the batch decode tests, with room to spot stray writes
+// 
+#define BATCH_COUNT             8
+#define BATCH_STATE_STRIDE      (sizeof(FIRESHOCK_CONTROLLER_STATE) + 16)
+
+//
+// DualShock 3 report as sent with nothing touched: sticks centered and
+// the motion sensors at rest
+// 
+static VOID
+BuildDs3Report(
+    PUCHAR Report)
+{
+    RtlZeroMemory(Report, DS3_HID_INPUT_REPORT_SIZE);
+
+    Report[0] = 0x01;
+    Report[DS3_REPORT_OFFSET_LEFT_THUMB_X] = 0x80;
+    Report[DS3_REPORT_OFFSET_LEFT_THUMB_Y] = 0x80;
+    Report[DS3_REPORT_OFFSET_RIGHT_THUMB_X] = 0x80;
+    Report[DS3_REPORT_OFFSET_RIGHT_THUMB_Y] = 0x80;
+
+    Report[DS3_REPORT_OFFSET_ACCELEROMETER + 0] = 0x02;
+    Report[DS3_REPORT_OFFSET_ACCELEROMETER + 2] = 0x02;
+    Report[DS3_REPORT_OFFSET_ACCELEROMETER + 4] = 0x02;
+    Report[DS3_REPORT_OFFSET_GYROSCOPE] = 0x02;
+}
+
+static VOID
+TestDs3Idle(
+    VOID)
+{
+    UCHAR                       report[DS3_HID_INPUT_REPORT_SIZE];
+    FIRESHOCK_CONTROLLER_STATE  state;
+    ULONG                       i;
+
+    BuildDs3Report(report);
+
+    TEST_ASSERT(DsDecodeDs3Report(report, sizeof(report), &state));
+    TEST_ASSERT(state.Buttons == 0);
+    TEST_ASSERT(state.LeftThumbX == 0x80 && state.LeftThumbY == 0x80);
+    TEST_ASSERT(state.RightThumbX == 0x80 && state.RightThumbY == 0x80);
+    TEST_ASSERT(state.LeftTrigger == 0 && state.RightTrigger == 0);
+
+    for (i = 0; i < 3; i++)
+    {
+        TEST_ASSERT(state.Accelerometer[i] == 0);
+        TEST_ASSERT(state.Gyroscope[i] == 0);
+    }
+
+    for (i = 0; i < FIRESHOCK_TOUCH_POINT_COUNT; i++)
+    {
+        TEST_ASSERT(!state.Touch[i].Active);
+    }
+}
+
+static VOID
+TestDs3Controls(
+    VOID)
+{
+    UCHAR                       report[DS3_HID_INPUT_REPORT_SIZE];
+    FIRESHOCK_CONTROLLER_STATE  state;
+    ULONG                       i;
+
+    BuildDs3Report(report);
+
+    //
+    // Select, D-pad left, R2, cross and PS held
+    // 
+    report[DS3_REPORT_OFFSET_BUTTONS] = 0x81;
+    report[DS3_REPORT_OFFSET_BUTTONS + 1] = 0x42;
+    report[DS3_REPORT_OFFSET_PS_BUTTON] = 0x01;
+
+    report[DS3_REPORT_OFFSET_LEFT_THUMB_X] = 0x00;
+    report[DS3_REPORT_OFFSET_LEFT_THUMB_Y] = 0xFF;
+    report[DS3_REPORT_OFFSET_RIGHT_THUMB_X] = 0x12;
+    report[DS3_REPORT_OFFSET_RIGHT_THUMB_Y] = 0xED;
+
+    for (i = 0; i < FIRESHOCK_PRESSURE_COUNT; i++)
+    {
+        report[DS3_REPORT_OFFSET_PRESSURE + i] = (UCHAR)(0x10 + i);
+    }
+
+    //
+    // Big endian, 0x200 at rest
+    // 
+    report[DS3_REPORT_OFFSET_ACCELEROMETER + 0] = 0x03;
+    report[DS3_REPORT_OFFSET_ACCELEROMETER + 1] = 0x00;
+    report[DS3_REPORT_OFFSET_ACCELEROMETER + 2] = 0x01;
+    report[DS3_REPORT_OFFSET_ACCELEROMETER + 3] = 0xF0;
+    report[DS3_REPORT_OFFSET_ACCELEROMETER + 4] = 0x02;
+    report[DS3_REPORT_OFFSET_ACCELEROMETER + 5] = 0x01;
+    report[DS3_REPORT_OFFSET_GYROSCOPE + 0] = 0x01;
+    report[DS3_REPORT_OFFSET_GYROSCOPE + 1] = 0x00;
+
+    TEST_ASSERT(DsDecodeDs3Report(report, sizeof(report), &state));
+
+    TEST_ASSERT(state.Buttons == (FIRESHOCK_BUTTON_SELECT | FIRESHOCK_BUTTON_DPAD_LEFT
+        | FIRESHOCK_BUTTON_R2 | FIRESHOCK_BUTTON_CROSS | FIRESHOCK_BUTTON_PS));
+
+    TEST_ASSERT(state.LeftThumbX == 0x00 && state.LeftThumbY == 0xFF);
+    TEST_ASSERT(state.RightThumbX == 0x12 && state.RightThumbY == 0xED);
+
+    for (i = 0; i < FIRESHOCK_PRESSURE_COUNT; i++)
+    {
+        TEST_ASSERT(state.Pressure[i] == 0x10 + i);
+    }
+
+    TEST_ASSERT(state.LeftTrigger == 0x10 + FIRESHOCK_PRESSURE_L2);
+    TEST_ASSERT(state.RightTrigger == 0x10 + FIRESHOCK_PRESSURE_R2);
+
+    TEST_ASSERT(state.Accelerometer[0] == 0x100);
+    TEST_ASSERT(state.Accelerometer[1] == -0x10);
+    TEST_ASSERT(state.Accelerometer[2] == 1);
+
+    //
+    // Only yaw is measured
+    // 
+    TEST_ASSERT(state.Gyroscope[0] == 0);
+    TEST_ASSERT(state.Gyroscope[1] == -0x100);
+    TEST_ASSERT(state.Gyroscope[2] == 0);
+}
+
+static VOID
+TestDs3Rejects(
+    VOID)
+{
+    UCHAR                       report[DS3_HID_INPUT_REPORT_SIZE];
+    FIRESHOCK_CONTROLLER_STATE  state;
+    FIRESHOCK_CONTROLLER_STATE  zero;
+
+    RtlZeroMemory(&zero, sizeof(zero));
+
+    BuildDs3Report(report);
+    report[DS3_REPORT_OFFSET_BUTTONS] = 0xFF;
+
+    memset(&state, 0xCC, sizeof(state));
+    TEST_ASSERT(!DsDecodeDs3Report(report, sizeof(report) - 1, &state));
+    TEST_ASSERT(memcmp(&state, &zero, sizeof(state)) == 0);
+
+    report[0] = 0x02;
+
+    memset(&state, 0xCC, sizeof(state));
+    TEST_ASSERT(!DsDecodeDs3Report(report, sizeof(report), &state));
+    TEST_ASSERT(memcmp(&state, &zero, sizeof(state)) == 0);
+}
+
+//
+// The batch path must produce exactly what single decodes do and stay
+// within each state
+// 
+static VOID
+TestDs3Batch(
+    VOID)
+{
+    static UCHAR                reports[BATCH_COUNT][FIRESHOCK_INPUT_REPORT_LENGTH];
+    static UCHAR                states[BATCH_COUNT][BATCH_STATE_STRIDE];
+    FIRESHOCK_CONTROLLER_STATE  expected;
+    ULONG                       i;
+    ULONG                       j;
+
+    for (i = 0; i < BATCH_COUNT; i++)
+    {
+        BuildDs3Report(reports[i]);
+
+        for (j = 2; j < DS3_HID_INPUT_REPORT_SIZE; j++)
+        {
+            reports[i][j] = (UCHAR)(i * 31 + j * 7);
+        }
+    }
+
+    memset(states, 0xCC, sizeof(states));
+
+    DsDecodeDs3Batch(reports[0], sizeof(reports[0]), states[0], sizeof(states[0]), BATCH_COUNT);
+
+    for (i = 0; i < BATCH_COUNT; i++)
+    {
+        TEST_ASSERT(DsDecodeDs3Report(reports[i], DS3_HID_INPUT_REPORT_SIZE, &expected));
+        TEST_ASSERT(memcmp(states[i], &expected, sizeof(expected)) == 0);
+
+        for (j = sizeof(FIRESHOCK_CONTROLLER_STATE); j < BATCH_STATE_STRIDE; j++)
+        {
+            TEST_ASSERT(states[i][j] == 0xCC);
+        }
+    }
+}
+
+//
+// DualShock 4 report as sent with nothing touched: sticks centered, D-pad
+// released and no touchpad contacts
+// 
+static VOID
+BuildDs4Report(
+    PUCHAR Report)
+{
+    ULONG i;
+
+    RtlZeroMemory(Report, DS4_HID_INPUT_REPORT_SIZE);
+
+    Report[0] = 0x01;
+    Report[DS4_REPORT_OFFSET_LEFT_THUMB_X] = 0x80;
+    Report[DS4_REPORT_OFFSET_LEFT_THUMB_Y] = 0x80;
+    Report[DS4_REPORT_OFFSET_RIGHT_THUMB_X] = 0x80;
+    Report[DS4_REPORT_OFFSET_RIGHT_THUMB_Y] = 0x80;
+    Report[DS4_REPORT_OFFSET_BUTTONS] = 0x08;
+
+    for (i = 0; i < FIRESHOCK_TOUCH_POINT_COUNT; i++)
+    {
+        Report[DS4_REPORT_OFFSET_TOUCH_POINTS + i * DS4_TOUCH_POINT_SIZE] = 0x80;
+    }
+}
+
+static VOID
+PutWord(
+    PUCHAR Buffer,
+    ULONG Offset,
+    SHORT Value)
+{
+    Buffer[Offset] = (UCHAR)(Value & 0xFF);
+    Buffer[Offset + 1] = (UCHAR)((USHORT)Value >> 8);
+}
+
+//
+// Calibration feature report of a pad with unbiased sensors: the gyros
+// read +-1000 at +-500 deg/s, the accelerometers +-8000 at +-1g
+// 
+static VOID
+BuildDs4Calibration(
+    PUCHAR Feature)
+{
+    ULONG i;
+
+    RtlZeroMemory(Feature, DS4_FEATURE_REPORT_CALIBRATION_SIZE);
+
+    Feature[0] = DS4_FEATURE_REPORT_CALIBRATION;
+
+    for (i = 0; i < 3; i++)
+    {
+        PutWord(Feature, 1 + i * 2, 0);
+        PutWord(Feature, 7 + i * 2, 1000);
+        PutWord(Feature, 13 + i * 2, -1000);
+        PutWord(Feature, 23 + i * 4, 8000);
+        PutWord(Feature, 25 + i * 4, -8000);
+    }
+
+    PutWord(Feature, 19, 500);
+    PutWord(Feature, 21, 500);
+}
+
+static VOID
+TestDs4Idle(
+    VOID)
+{
+    UCHAR                       report[DS4_HID_INPUT_REPORT_SIZE];
+    FIRESHOCK_CONTROLLER_STATE  state;
+    ULONG                       i;
+
+    BuildDs4Report(report);
+
+    TEST_ASSERT(DsDecodeDs4Report(report, sizeof(report), NULL, &state));
+    TEST_ASSERT(state.Buttons == 0);
+    TEST_ASSERT(state.LeftThumbX == 0x80 && state.LeftThumbY == 0x80);
+    TEST_ASSERT(state.RightThumbX == 0x80 && state.RightThumbY == 0x80);
+    TEST_ASSERT(state.LeftTrigger == 0 && state.RightTrigger == 0);
+
+    for (i = 0; i < FIRESHOCK_PRESSURE_COUNT; i++)
+    {
+        TEST_ASSERT(state.Pressure[i] == 0);
+    }
+
+    for (i = 0; i < FIRESHOCK_TOUCH_POINT_COUNT; i++)
+    {
+        TEST_ASSERT(!state.Touch[i].Active);
+    }
+}
+
+static VOID
+TestDs4Hat(
+    VOID)
+{
+    static const ULONG expected[] =
+    {
+        FIRESHOCK_BUTTON_DPAD_UP,
+        FIRESHOCK_BUTTON_DPAD_UP | FIRESHOCK_BUTTON_DPAD_RIGHT,
+        FIRESHOCK_BUTTON_DPAD_RIGHT,
+        FIRESHOCK_BUTTON_DPAD_RIGHT | FIRESHOCK_BUTTON_DPAD_DOWN,
+        FIRESHOCK_BUTTON_DPAD_DOWN,
+        FIRESHOCK_BUTTON_DPAD_DOWN | FIRESHOCK_BUTTON_DPAD_LEFT,
+        FIRESHOCK_BUTTON_DPAD_LEFT,
+        FIRESHOCK_BUTTON_DPAD_LEFT | FIRESHOCK_BUTTON_DPAD_UP,
+        0
+    };
+    UCHAR                       report[DS4_HID_INPUT_REPORT_SIZE];
+    FIRESHOCK_CONTROLLER_STATE  state;
+    ULONG                       hat;
+
+    BuildDs4Report(report);
+
+    for (hat = 0; hat < 16; hat++)
+    {
+        report[DS4_REPORT_OFFSET_BUTTONS] = (UCHAR)hat;
+
+        TEST_ASSERT(DsDecodeDs4Report(report, sizeof(report), NULL, &state));
+
+        //
+        // Values past "released" are reserved and must not set anything
+        // 
+        TEST_ASSERT(state.Buttons == (hat < 9 ? expected[hat] : 0));
+    }
+}
+
+static VOID
+TestDs4Controls(
+    VOID)
+{
+    UCHAR                       report[DS4_HID_INPUT_REPORT_SIZE];
+    FIRESHOCK_CONTROLLER_STATE  state;
+    PUCHAR                      point;
+
+    BuildDs4Report(report);
+
+    //
+    // Everything but the D-pad held
+    // 
+    report[DS4_REPORT_OFFSET_BUTTONS] = 0xF8;
+    report[DS4_REPORT_OFFSET_BUTTONS + 1] = 0xFF;
+    report[DS4_REPORT_OFFSET_BUTTONS + 2] = 0x03;
+
+    report[DS4_REPORT_OFFSET_LEFT_THUMB_X] = 0x01;
+    report[DS4_REPORT_OFFSET_RIGHT_THUMB_Y] = 0xFE;
+    report[DS4_REPORT_OFFSET_LEFT_TRIGGER] = 0x40;
+    report[DS4_REPORT_OFFSET_RIGHT_TRIGGER] = 0xC0;
+
+    PutWord(report, DS4_REPORT_OFFSET_GYROSCOPE, -3);
+    PutWord(report, DS4_REPORT_OFFSET_GYROSCOPE + 2, 0x1234);
+    PutWord(report, DS4_REPORT_OFFSET_ACCELEROMETER + 4, 8192);
+
+    //
+    // First contact at (0x123, 0x3A4) with ID 5, the second lifted
+    // 
+    point = &report[DS4_REPORT_OFFSET_TOUCH_POINTS];
+    point[0] = 0x05;
+    point[1] = 0x23;
+    point[2] = 0x41;
+    point[3] = 0x3A;
+
+    TEST_ASSERT(DsDecodeDs4Report(report, sizeof(report), NULL, &state));
+
+    TEST_ASSERT(state.Buttons == (FIRESHOCK_BUTTON_SQUARE | FIRESHOCK_BUTTON_CROSS
+        | FIRESHOCK_BUTTON_CIRCLE | FIRESHOCK_BUTTON_TRIANGLE
+        | FIRESHOCK_BUTTON_L1 | FIRESHOCK_BUTTON_R1
+        | FIRESHOCK_BUTTON_L2 | FIRESHOCK_BUTTON_R2
+        | FIRESHOCK_BUTTON_SELECT | FIRESHOCK_BUTTON_START
+        | FIRESHOCK_BUTTON_L3 | FIRESHOCK_BUTTON_R3
+        | FIRESHOCK_BUTTON_PS | FIRESHOCK_BUTTON_TOUCHPAD));
+
+    TEST_ASSERT(state.LeftThumbX == 0x01 && state.LeftThumbY == 0x80);
+    TEST_ASSERT(state.RightThumbX == 0x80 && state.RightThumbY == 0xFE);
+    TEST_ASSERT(state.LeftTrigger == 0x40 && state.RightTrigger == 0xC0);
+    TEST_ASSERT(state.Pressure[FIRESHOCK_PRESSURE_L2] == 0x40);
+    TEST_ASSERT(state.Pressure[FIRESHOCK_PRESSURE_R2] == 0xC0);
+
+    //
+    // Raw without calibration
+    // 
+    TEST_ASSERT(state.Gyroscope[0] == -3);
+    TEST_ASSERT(state.Gyroscope[1] == 0x1234);
+    TEST_ASSERT(state.Gyroscope[2] == 0);
+    TEST_ASSERT(state.Accelerometer[0] == 0);
+    TEST_ASSERT(state.Accelerometer[2] == 8192);
+
+    TEST_ASSERT(state.Touch[0].Active);
+    TEST_ASSERT(state.Touch[0].Id == 5);
+    TEST_ASSERT(state.Touch[0].X == 0x123);
+    TEST_ASSERT(state.Touch[0].Y == 0x3A4);
+    TEST_ASSERT(!state.Touch[1].Active);
+}
+
+static VOID
+TestDs4Calibration(
+    VOID)
+{
+    UCHAR                       feature[DS4_FEATURE_REPORT_CALIBRATION_SIZE];
+    UCHAR                       report[DS4_HID_INPUT_REPORT_SIZE];
+    DS4_CALIBRATION             calibration;
+    DS4_CALIBRATION             untouched;
+    FIRESHOCK_CONTROLLER_STATE  state;
+    ULONG                       i;
+
+    BuildDs4Calibration(feature);
+
+    TEST_ASSERT(DsDecodeDs4Calibration(feature, sizeof(feature), &calibration));
+
+    for (i = 0; i < 3; i++)
+    {
+        TEST_ASSERT(calibration.Gyroscope[i].Bias == 0);
+        TEST_ASSERT(calibration.Accelerometer[i].Bias == 0);
+    }
+
+    //
+    // 500 deg/s and 1g land on the resolutions the state promises
+    // 
+    BuildDs4Report(report);
+
+    for (i = 0; i < 3; i++)
+    {
+        PutWord(report, DS4_REPORT_OFFSET_GYROSCOPE + i * 2, 1000);
+        PutWord(report, DS4_REPORT_OFFSET_ACCELEROMETER + i * 2, -8000);
+    }
+
+    TEST_ASSERT(DsDecodeDs4Report(report, sizeof(report), &calibration, &state));
+
+    for (i = 0; i < 3; i++)
+    {
+        TEST_ASSERT(state.Gyroscope[i] == 500 * DS4_GYRO_RES_PER_DEG_S);
+        TEST_ASSERT(state.Accelerometer[i] == -DS4_ACC_RES_PER_G);
+    }
+
+    //
+    // Implausible data leaves the previous calibration alone
+    // 
+    memset(&untouched, 0xCC, sizeof(untouched));
+    memcpy(&calibration, &untouched, sizeof(calibration));
+
+    TEST_ASSERT(!DsDecodeDs4Calibration(feature, sizeof(feature) - 1, &calibration));
+
+    feature[0] = 0x05;
+    TEST_ASSERT(!DsDecodeDs4Calibration(feature, sizeof(feature), &calibration));
+
+    BuildDs4Calibration(feature);
+    PutWord(feature, 25, 8000);
+    TEST_ASSERT(!DsDecodeDs4Calibration(feature, sizeof(feature), &calibration));
+
+    BuildDs4Calibration(feature);
+    PutWord(feature, 9, 0);
+    PutWord(feature, 15, 0);
+    TEST_ASSERT(!DsDecodeDs4Calibration(feature, sizeof(feature), &calibration));
+
+    TEST_ASSERT(memcmp(&calibration, &untouched, sizeof(calibration)) == 0);
+}
+
+static VOID
+TestDs4Rejects(
+    VOID)
+{
+    UCHAR                       report[DS4_HID_INPUT_REPORT_SIZE];
+    FIRESHOCK_CONTROLLER_STATE  state;
+    FIRESHOCK_CONTROLLER_STATE  zero;
+
+    RtlZeroMemory(&zero, sizeof(zero));
+
+    BuildDs4Report(report);
+    report[DS4_REPORT_OFFSET_BUTTONS + 1] = 0xFF;
+
+    memset(&state, 0xCC, sizeof(state));
+    TEST_ASSERT(!DsDecodeDs4Report(report, sizeof(report) - 1, NULL, &state));
+    TEST_ASSERT(memcmp(&state, &zero, sizeof(state)) == 0);
+
+    report[0] = 0x11;
+
+    memset(&state, 0xCC, sizeof(state));
+    TEST_ASSERT(!DsDecodeDs4Report(report, sizeof(report), NULL, &state));
+    TEST_ASSERT(memcmp(&state, &zero, sizeof(state)) == 0);
+}
+
+static VOID
+TestDs4Batch(
+    VOID)
+{
+    static UCHAR                reports[BATCH_COUNT][FIRESHOCK_INPUT_REPORT_LENGTH];
+    static UCHAR                states[BATCH_COUNT][BATCH_STATE_STRIDE];
+    UCHAR                       feature[DS4_FEATURE_REPORT_CALIBRATION_SIZE];
+    DS4_CALIBRATION             calibration;
+    FIRESHOCK_CONTROLLER_STATE  expected;
+    ULONG                       i;
+    ULONG                       j;
+
+    BuildDs4Calibration(feature);
+    TEST_ASSERT(DsDecodeDs4Calibration(feature, sizeof(feature), &calibration));
+
+    for (i = 0; i < BATCH_COUNT; i++)
+    {
+        BuildDs4Report(reports[i]);
+
+        for (j = 1; j < DS4_HID_INPUT_REPORT_SIZE; j++)
+        {
+            reports[i][j] = (UCHAR)(i * 29 + j * 11);
+        }
+    }
+
+    memset(states, 0xCC, sizeof(states));
+
+    DsDecodeDs4Batch(reports[0], sizeof(reports[0]), &calibration, states[0], sizeof(states[0]), BATCH_COUNT);
+
+    for (i = 0; i < BATCH_COUNT; i++)
+    {
+        TEST_ASSERT(DsDecodeDs4Report(reports[i], DS4_HID_INPUT_REPORT_SIZE, &calibration, &expected));
+        TEST_ASSERT(memcmp(states[i], &expected, sizeof(expected)) == 0);
+
+        for (j = sizeof(FIRESHOCK_CONTROLLER_STATE); j < BATCH_STATE_STRIDE; j++)
+        {
+            TEST_ASSERT(states[i][j] == 0xCC);
+        }
+    }
+}
+
+int
+main(
+    VOID)
+{
+    TEST_RUN(TestDs3Idle);
+    TEST_RUN(TestDs3Controls);
+    TEST_RUN(TestDs3Rejects);
+    TEST_RUN(TestDs3Batch);
+    TEST_RUN(TestDs4Idle);
+    TEST_RUN(TestDs4Hat);
+    TEST_RUN(TestDs4Controls);
+    TEST_RUN(TestDs4Calibration);
+    TEST_RUN(TestDs4Rejects);
+    TEST_RUN(TestDs4Batch);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,354 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Histogram.h"
+#include "Bench.h"
+#include "Test.h"
+
+#define CONCURRENT_THREADS      4
+#define CONCURRENT_SAMPLES      100000
+
+static HISTOGRAM Concurrent;
+
+static ULONG
+BucketTotal(
+    const FIRESHOCK_HISTOGRAM *Snapshot)
+{
+    ULONG   total = 0;
+    ULONG   i;
+
+    for (i = 0; i < FIRESHOCK_LATENCY_BUCKET_COUNT; i++)
+    {
+        total += Snapshot->Buckets[i];
+    }
+
+    return total;
+}
+
+static VOID
+TestEmpty(
+    VOID)
+{
+    HISTOGRAM           histogram;
+    FIRESHOCK_HISTOGRAM snapshot;
+
+    HistogramReset(&histogram);
+    HistogramSnapshot(&histogram, &snapshot, FALSE);
+
+    TEST_ASSERT(snapshot.Count == 0);
+    TEST_ASSERT(snapshot.Min == 0 && snapshot.Max == 0);
+    TEST_ASSERT(snapshot.Total == 0);
+    TEST_ASSERT(BucketTotal(&snapshot) == 0);
+    TEST_ASSERT(HistogramPercentile(&snapshot, 50) == 0);
+    TEST_ASSERT(HistogramPercentile(&snapshot, 99) == 0);
+}
+
+//
+// Bucket n holds the samples of bit length n, the last one everything
+// longer
+// 
+static VOID
+TestBuckets(
+    VOID)
+{
+    static const struct
+    {
+        ULONGLONG Sample;
+        ULONG Bucket;
+    } cases[] =
+    {
+        { 0, 0 },
+        { 1, 1 },
+        { 2, 2 },
+        { 3, 2 },
+        { 4, 3 },
+        { 1000, 10 },
+        { 1023, 10 },
+        { 1024, 11 },
+        { (1UL << (FIRESHOCK_LATENCY_BUCKET_COUNT - 2)), FIRESHOCK_LATENCY_BUCKET_COUNT - 1 },
+        { (1UL << (FIRESHOCK_LATENCY_BUCKET_COUNT - 1)), FIRESHOCK_LATENCY_BUCKET_COUNT - 1 },
+        { 1ULL << 40, FIRESHOCK_LATENCY_BUCKET_COUNT - 1 },
+    };
+    HISTOGRAM           histogram;
+    FIRESHOCK_HISTOGRAM snapshot;
+    ULONG               i;
+    ULONG               j;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        HistogramReset(&histogram);
+        HistogramRecord(&histogram, cases[i].Sample);
+        HistogramSnapshot(&histogram, &snapshot, FALSE);
+
+        for (j = 0; j < FIRESHOCK_LATENCY_BUCKET_COUNT; j++)
+        {
+            TEST_ASSERT(snapshot.Buckets[j] == (j == cases[i].Bucket ? 1U : 0U));
+        }
+    }
+}
+
+static VOID
+TestStatistics(
+    VOID)
+{
+    HISTOGRAM           histogram;
+    FIRESHOCK_HISTOGRAM snapshot;
+
+    HistogramReset(&histogram);
+
+    HistogramRecord(&histogram, 40);
+    HistogramRecord(&histogram, 7);
+    HistogramRecord(&histogram, 900);
+    HistogramRecord(&histogram, 13);
+
+    HistogramSnapshot(&histogram, &snapshot, FALSE);
+
+    TEST_ASSERT(snapshot.Count == 4);
+    TEST_ASSERT(snapshot.Min == 7 && snapshot.Max == 900);
+    TEST_ASSERT(snapshot.Total == 960);
+
+    //
+    // Samples past 32 bit saturate instead of wrapping
+    // 
+    HistogramRecord(&histogram, 1ULL << 40);
+
+    HistogramSnapshot(&histogram, &snapshot, FALSE);
+
+    TEST_ASSERT(snapshot.Count == 5);
+    TEST_ASSERT(snapshot.Max == 0xFFFFFFFE);
+    TEST_ASSERT(snapshot.Total == 960ULL + 0xFFFFFFFE);
+}
+
+static VOID
+TestReset(
+    VOID)
+{
+    HISTOGRAM           histogram;
+    FIRESHOCK_HISTOGRAM snapshot;
+
+    HistogramReset(&histogram);
+
+    HistogramRecord(&histogram, 5);
+    HistogramRecord(&histogram, 500);
+
+    HistogramSnapshot(&histogram, &snapshot, TRUE);
+
+    TEST_ASSERT(snapshot.Count == 2);
+    TEST_ASSERT(snapshot.Min == 5 && snapshot.Max == 500);
+    TEST_ASSERT(BucketTotal(&snapshot) == 2);
+
+    HistogramSnapshot(&histogram, &snapshot, FALSE);
+
+    TEST_ASSERT(snapshot.Count == 0);
+    TEST_ASSERT(snapshot.Min == 0 && snapshot.Max == 0);
+    TEST_ASSERT(snapshot.Total == 0);
+    TEST_ASSERT(BucketTotal(&snapshot) == 0);
+
+    //
+    // Extremes start over after a reset
+    // 
+    HistogramRecord(&histogram, 50);
+
+    HistogramSnapshot(&histogram, &snapshot, FALSE);
+
+    TEST_ASSERT(snapshot.Min == 50 && snapshot.Max == 50);
+}
+
+static VOID
+TestPercentile(
+    VOID)
+{
+    HISTOGRAM           histogram;
+    FIRESHOCK_HISTOGRAM snapshot;
+    ULONG               i;
+
+    HistogramReset(&histogram);
+
+    //
+    // 1 to 1000 microseconds, evenly spread
+    // 
+    for (i = 1; i <= 1000; i++)
+    {
+        HistogramRecord(&histogram, i);
+    }
+
+    HistogramSnapshot(&histogram, &snapshot, FALSE);
+
+    //
+    // Evenly spread samples are what the interpolation assumes
+    // 
+    TEST_ASSERT(HistogramPercentile(&snapshot, 50) == 500);
+    TEST_ASSERT(HistogramPercentile(&snapshot, 90) == 900);
+    TEST_ASSERT(HistogramPercentile(&snapshot, 99) == 990);
+
+    TEST_ASSERT(HistogramPercentile(&snapshot, 0) == snapshot.Min);
+    TEST_ASSERT(HistogramPercentile(&snapshot, 100) == snapshot.Max);
+    TEST_ASSERT(HistogramPercentile(&snapshot, 250) == snapshot.Max);
+
+    //
+    // A single sample is its own percentile
+    // 
+    HistogramReset(&histogram);
+    HistogramRecord(&histogram, 300);
+    HistogramSnapshot(&histogram, &snapshot, FALSE);
+
+    TEST_ASSERT(HistogramPercentile(&snapshot, 1) == 300);
+    TEST_ASSERT(HistogramPercentile(&snapshot, 99) == 300);
+
+    //
+    // A steady 1 ms report rate with a little jitter stays within its
+    // spread although it shares the 512 to 1023 bucket with its p50
+    // 
+    HistogramReset(&histogram);
+
+    for (i = 0; i < 1000; i++)
+    {
+        HistogramRecord(&histogram, 990 + i % 21);
+    }
+
+    HistogramSnapshot(&histogram, &snapshot, FALSE);
+
+    TEST_ASSERT(HistogramPercentile(&snapshot, 50) >= 990);
+    TEST_ASSERT(HistogramPercentile(&snapshot, 50) <= 1010);
+    TEST_ASSERT(HistogramPercentile(&snapshot, 99) <= 1010);
+}
+
+//
+// Whatever the distribution, estimates stay within the documented bound:
+// less than the width of the bucket the exact value falls into
+// 
+static VOID
+TestPercentileBound(
+    VOID)
+{
+    static ULONGLONG    samples[2000];
+    static const ULONG  percents[] = { 1, 10, 50, 90, 99, 100 };
+    HISTOGRAM           histogram;
+    FIRESHOCK_HISTOGRAM snapshot;
+    ULONG               seed = 0x2545F491;
+    ULONG               round;
+    ULONG               i;
+    ULONG               exact;
+    ULONG               estimate;
+    ULONG               width;
+    BOOLEAN             bounded = TRUE;
+
+    for (round = 0; round < 50; round++)
+    {
+        HistogramReset(&histogram);
+
+        for (i = 0; i < 2000; i++)
+        {
+            seed = seed * 1664525 + 1013904223;
+
+            //
+            // Mostly small values with a long tail, scaled per round
+            // 
+            samples[i] = ((seed >> 16) % 1000) * ((i % 16 == 0) ? 64 : 1) * (round % 5 + 1);
+
+            HistogramRecord(&histogram, samples[i]);
+        }
+
+        HistogramSnapshot(&histogram, &snapshot, FALSE);
+
+        for (i = 0; i < sizeof(percents) / sizeof(percents[0]); i++)
+        {
+            exact = (ULONG)BenchPercentile(samples, 2000, percents[i]);
+            estimate = HistogramPercentile(&snapshot, percents[i]);
+
+            width = 1;
+
+            while (width <= exact / 2)
+            {
+                width *= 2;
+            }
+
+            bounded = bounded && (estimate > exact ? estimate - exact : exact - estimate) < width;
+        }
+    }
+
+    TEST_ASSERT(bounded);
+}
+
+static VOID
+RecordConcurrently(
+    PVOID Context)
+{
+    ULONG i;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    for (i = 0; i < CONCURRENT_SAMPLES; i++)
+    {
+        HistogramRecord(&Concurrent, (i % 1000) + 1);
+    }
+}
+
+//
+// No sample may get lost without a lock
+// 
+static VOID
+TestConcurrent(
+    VOID)
+{
+    PBENCH_THREAD       threads[CONCURRENT_THREADS];
+    FIRESHOCK_HISTOGRAM snapshot;
+    ULONG               i;
+
+    HistogramReset(&Concurrent);
+
+    for (i = 0; i < CONCURRENT_THREADS; i++)
+    {
+        threads[i] = BenchThreadStart(RecordConcurrently, NULL);
+    }
+
+    for (i = 0; i < CONCURRENT_THREADS; i++)
+    {
+        BenchThreadJoin(threads[i]);
+    }
+
+    HistogramSnapshot(&Concurrent, &snapshot, FALSE);
+
+    TEST_ASSERT(snapshot.Count == CONCURRENT_THREADS * CONCURRENT_SAMPLES);
+    TEST_ASSERT(BucketTotal(&snapshot) == CONCURRENT_THREADS * CONCURRENT_SAMPLES);
+    TEST_ASSERT(snapshot.Min == 1 && snapshot.Max == 1000);
+    TEST_ASSERT(snapshot.Total == (ULONGLONG)CONCURRENT_THREADS * (CONCURRENT_SAMPLES / 1000) * 500500);
+}
+
+int
+main(
+    VOID)
+{
+    TEST_RUN(TestEmpty);
+    TEST_RUN(TestBuckets);
+    TEST_RUN(TestStatistics);
+    TEST_RUN(TestReset);
+    TEST_RUN(TestPercentile);
+    TEST_RUN(TestPercentileBound);
+    TEST_RUN(TestConcurrent);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,275 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+#include "InputRing.h"
+#include "Test.h"
+
+//
+// Header plus Slots entries, aligned for the 64 bit timestamps
+// 
+#define RING_BUFFER_LENGTH(_slots_) \
+    (sizeof(FIRESHOCK_INPUT_RING_HEADER) + (_slots_) * sizeof(FIRESHOCK_INPUT_RING_ENTRY))
+
+static ULONGLONG Buffer[RING_BUFFER_LENGTH(64) / sizeof(ULONGLONG)];
+
+static VOID
+FillReport(
+    PUCHAR Report,
+    size_t Length,
+    UCHAR Seed)
+{
+    size_t i;
+
+    for (i = 0; i < Length; i++)
+    {
+        Report[i] = (UCHAR)(Seed + i);
+    }
+}
+
+static BOOLEAN
+CheckEntry(
+    const FIRESHOCK_INPUT_RING_ENTRY *Entry,
+    ULONG Sequence,
+    size_t Length)
+{
+    UCHAR   expected[FIRESHOCK_INPUT_RING_REPORT_LENGTH];
+
+    FillReport(expected, Length, (UCHAR)Sequence);
+
+    return Entry->Sequence == Sequence
+        && Entry->Timestamp == (LONGLONG)Sequence * 10
+        && Entry->Length == Length
+        && memcmp(Entry->Report, expected, Length) == 0;
+}
+
+static BOOLEAN
+PushSequence(
+    PINPUT_RING Ring,
+    ULONG Sequence,
+    size_t Length)
+{
+    UCHAR   report[FIRESHOCK_INPUT_RING_REPORT_LENGTH];
+
+    FillReport(report, Length, (UCHAR)Sequence);
+
+    return InputRingPush(Ring, (LONGLONG)Sequence * 10, Sequence, report, Length);
+}
+
+//
+// The layout is shared with user mode and must not move
+// 
+static VOID
+TestLayout(
+    VOID)
+{
+    TEST_ASSERT(sizeof(FIRESHOCK_INPUT_RING_ENTRY) == 0x90);
+    TEST_ASSERT(sizeof(FIRESHOCK_INPUT_RING_HEADER) == 3 * FIRESHOCK_INPUT_RING_CACHE_LINE);
+    TEST_ASSERT(offsetof(FIRESHOCK_INPUT_RING_HEADER, Head) == FIRESHOCK_INPUT_RING_CACHE_LINE);
+    TEST_ASSERT(offsetof(FIRESHOCK_INPUT_RING_HEADER, Tail) == 2 * FIRESHOCK_INPUT_RING_CACHE_LINE);
+    TEST_ASSERT(FIRESHOCK_INPUT_RING_MIN_LENGTH <= FIRESHOCK_INPUT_RING_ALIGNMENT);
+}
+
+static VOID
+TestAttach(
+    VOID)
+{
+    INPUT_RING  ring;
+
+    TEST_ASSERT(!InputRingAttach(&ring, NULL, sizeof(Buffer)));
+    TEST_ASSERT(!InputRingIsAttached(&ring));
+
+    TEST_ASSERT(!InputRingAttach(&ring, Buffer, FIRESHOCK_INPUT_RING_MIN_LENGTH - 1));
+    TEST_ASSERT(!InputRingIsAttached(&ring));
+
+    TEST_ASSERT(InputRingAttach(&ring, Buffer, FIRESHOCK_INPUT_RING_MIN_LENGTH));
+    TEST_ASSERT(ring.Capacity == 2);
+
+    //
+    // Capacity rounds down to a power of two
+    // 
+    memset(Buffer, 0xCC, sizeof(Buffer));
+
+    TEST_ASSERT(InputRingAttach(&ring, Buffer, RING_BUFFER_LENGTH(7)));
+    TEST_ASSERT(InputRingIsAttached(&ring));
+    TEST_ASSERT(InputRingIsEmpty(&ring));
+    TEST_ASSERT(ring.Capacity == 4);
+    TEST_ASSERT(ring.Header->Magic == FIRESHOCK_INPUT_RING_MAGIC);
+    TEST_ASSERT(ring.Header->Capacity == 4);
+    TEST_ASSERT(ring.Header->Head == 0 && ring.Header->Tail == 0 && ring.Header->Dropped == 0);
+    TEST_ASSERT(ring.Header->Truncated == 0);
+
+    InputRingDetach(&ring);
+    TEST_ASSERT(!InputRingIsAttached(&ring));
+    TEST_ASSERT(InputRingIsEmpty(&ring));
+    TEST_ASSERT(!PushSequence(&ring, 1, 8));
+}
+
+static VOID
+TestOrder(
+    VOID)
+{
+    INPUT_RING                  ring;
+    FIRESHOCK_INPUT_RING_ENTRY  entry;
+    UCHAR                       report[FIRESHOCK_INPUT_RING_REPORT_LENGTH * 2];
+
+    TEST_ASSERT(InputRingAttach(&ring, Buffer, RING_BUFFER_LENGTH(8)));
+    TEST_ASSERT(!InputRingPop(ring.Header, &entry));
+
+    TEST_ASSERT(PushSequence(&ring, 1, 49));
+    TEST_ASSERT(PushSequence(&ring, 2, 1));
+
+    //
+    // The largest interrupt-in transfer fits without truncation
+    // 
+    TEST_ASSERT(PushSequence(&ring, 4, FIRESHOCK_INPUT_REPORT_LENGTH));
+    TEST_ASSERT(!InputRingIsEmpty(&ring));
+
+    TEST_ASSERT(InputRingPop(ring.Header, &entry) && CheckEntry(&entry, 1, 49));
+    TEST_ASSERT(InputRingPop(ring.Header, &entry) && CheckEntry(&entry, 2, 1));
+    TEST_ASSERT(InputRingPop(ring.Header, &entry) && CheckEntry(&entry, 4, FIRESHOCK_INPUT_REPORT_LENGTH));
+    TEST_ASSERT(!InputRingPop(ring.Header, &entry));
+    TEST_ASSERT(ring.Header->Truncated == 0);
+    TEST_ASSERT(InputRingIsEmpty(&ring));
+
+    //
+    // Oversized reports get truncated to the entry
+    // 
+    FillReport(report, sizeof(report), 3);
+    TEST_ASSERT(InputRingPush(&ring, 30, 3, report, sizeof(report)));
+    TEST_ASSERT(InputRingPop(ring.Header, &entry) && CheckEntry(&entry, 3, FIRESHOCK_INPUT_RING_REPORT_LENGTH));
+    TEST_ASSERT(ring.Header->Truncated == 1);
+}
+
+static VOID
+TestWraparound(
+    VOID)
+{
+    INPUT_RING                  ring;
+    FIRESHOCK_INPUT_RING_ENTRY  entry;
+    ULONG                       sequence = 0;
+    ULONG                       expected = 0;
+    ULONG                       round;
+
+    TEST_ASSERT(InputRingAttach(&ring, Buffer, RING_BUFFER_LENGTH(4)));
+
+    //
+    // Start just short of the counters overflowing
+    // 
+    ring.Head = ring.Header->Head = ring.Header->Tail = 0xFFFFFFFA;
+
+    for (round = 0; round < 16; round++)
+    {
+        TEST_ASSERT(PushSequence(&ring, ++sequence, 20));
+        TEST_ASSERT(PushSequence(&ring, ++sequence, 20));
+        TEST_ASSERT(PushSequence(&ring, ++sequence, 20));
+
+        TEST_ASSERT(InputRingPop(ring.Header, &entry) && CheckEntry(&entry, ++expected, 20));
+        TEST_ASSERT(InputRingPop(ring.Header, &entry) && CheckEntry(&entry, ++expected, 20));
+        TEST_ASSERT(InputRingPop(ring.Header, &entry) && CheckEntry(&entry, ++expected, 20));
+    }
+
+    TEST_ASSERT(ring.Header->Head == 0xFFFFFFFA + 48);
+    TEST_ASSERT(InputRingIsEmpty(&ring));
+    TEST_ASSERT(ring.Header->Dropped == 0);
+}
+
+static VOID
+TestOverrun(
+    VOID)
+{
+    INPUT_RING                  ring;
+    FIRESHOCK_INPUT_RING_ENTRY  entry;
+    ULONG                       i;
+
+    TEST_ASSERT(InputRingAttach(&ring, Buffer, RING_BUFFER_LENGTH(4)));
+
+    for (i = 1; i <= 4; i++)
+    {
+        TEST_ASSERT(PushSequence(&ring, i, 16));
+    }
+
+    //
+    // Full: new reports get dropped, unread ones stay intact
+    // 
+    TEST_ASSERT(!PushSequence(&ring, 5, 16));
+    TEST_ASSERT(!PushSequence(&ring, 6, 16));
+    TEST_ASSERT(ring.Header->Dropped == 2);
+    TEST_ASSERT(ring.Header->Head == 4);
+
+    TEST_ASSERT(InputRingPop(ring.Header, &entry) && CheckEntry(&entry, 1, 16));
+    TEST_ASSERT(PushSequence(&ring, 7, 16));
+
+    for (i = 2; i <= 4; i++)
+    {
+        TEST_ASSERT(InputRingPop(ring.Header, &entry) && CheckEntry(&entry, i, 16));
+    }
+
+    TEST_ASSERT(InputRingPop(ring.Header, &entry) && CheckEntry(&entry, 7, 16));
+    TEST_ASSERT(!InputRingPop(ring.Header, &entry));
+}
+
+//
+// The consumer owns Tail; nonsense written there must not let the
+// producer write past the entries or over unread ones
+// 
+static VOID
+TestHostileConsumer(
+    VOID)
+{
+    INPUT_RING  ring;
+
+    TEST_ASSERT(InputRingAttach(&ring, Buffer, RING_BUFFER_LENGTH(4)));
+    TEST_ASSERT(PushSequence(&ring, 1, 8));
+
+    ring.Header->Tail = 100;
+    TEST_ASSERT(!PushSequence(&ring, 2, 8));
+
+    ring.Header->Tail = 0xFFFFFFF0;
+    TEST_ASSERT(!PushSequence(&ring, 3, 8));
+
+    //
+    // Producer state is not taken from shared memory
+    // 
+    ring.Header->Head = 1000;
+    ring.Header->Capacity = 1 << 20;
+    ring.Header->Tail = 1;
+    TEST_ASSERT(PushSequence(&ring, 4, 8));
+    TEST_ASSERT(ring.Head == 2 && ring.Header->Head == 2);
+    TEST_ASSERT(ring.Header->Dropped == 2);
+}
+
+int
+main(
+    VOID)
+{
+    TEST_RUN(TestLayout);
+    TEST_RUN(TestAttach);
+    TEST_RUN(TestOrder);
+    TEST_RUN(TestWraparound);
+    TEST_RUN(TestOverrun);
+    TEST_RUN(TestHostileConsumer);
+
+    return TEST_RESULT();
+}
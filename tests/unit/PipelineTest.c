@@ -0,0 +1,363 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Pipeline.h"
+#include "Test.h"
+
+#include <string.h>
+
+//
+// 1 kHz pads, microseconds per report
+// 
+#define PIPELINE_TICK   1000
+
+#define PIPELINE_PADS   16
+
+static PIPELINE_PAD Pads[PIPELINE_PADS];
+
+static ULONGLONG BatchBuffer[PIPELINE_BATCH_LENGTH(PIPELINE_HISTORY_DEPTH) / sizeof(ULONGLONG) + 1];
+
+static ULONGLONG RingBuffer[(sizeof(FIRESHOCK_INPUT_RING_HEADER)
+    + 64 * sizeof(FIRESHOCK_INPUT_RING_ENTRY)) / sizeof(ULONGLONG)];
+
+static VOID
+Decode(
+    const PIPELINE_PAD *Pad,
+    const PIPELINE_REPORT *Report,
+    PFIRESHOCK_CONTROLLER_STATE State)
+{
+    if (Pad->Simulator.DeviceType == DualShock3)
+    {
+        DsDecodeDs3Report(Report->Buffer, Report->Length, State);
+    }
+    else
+    {
+        DsDecodeDs4Report(Report->Buffer, Report->Length,
+            Pad->CalibrationValid ? &Pad->Calibration : NULL, State);
+    }
+}
+
+//
+// Compares a batch entry with the report still in the history
+// 
+static BOOLEAN
+CheckEntry(
+    const PIPELINE_PAD *Pad,
+    const FIRESHOCK_INPUT_BATCH_ENTRY *Entry,
+    BOOLEAN Normalize)
+{
+    const PIPELINE_REPORT       *report = &Pad->History[Entry->Envelope.Sequence % PIPELINE_HISTORY_DEPTH];
+    FIRESHOCK_CONTROLLER_STATE  state;
+
+    if (report->Sequence != Entry->Envelope.Sequence || report->Timestamp != Entry->Envelope.Timestamp)
+    {
+        return FALSE;
+    }
+
+    if (Normalize)
+    {
+        Decode(Pad, report, &state);
+
+        return Entry->Envelope.Length == sizeof(FIRESHOCK_CONTROLLER_STATE)
+            && memcmp(Entry->Report, &state, sizeof(state)) == 0;
+    }
+
+    return Entry->Envelope.Length == report->Length
+        && memcmp(Entry->Report, report->Buffer, report->Length) == 0;
+}
+
+//
+// Every pad served by a raw, a normalized and a change-filtered handle
+// draining after each report
+// 
+static VOID
+TestFanOut(VOID)
+{
+    PFIRESHOCK_INPUT_BATCH  batch = (PFIRESHOCK_INPUT_BATCH)BatchBuffer;
+    PIPELINE_READER         readers[PIPELINE_PADS][3];
+    ULONG                   delivered[3] = { 0 };
+    BOOLEAN                 inOrder = TRUE;
+    BOOLEAN                 intact = TRUE;
+    ULONG                   dropped = 0;
+    ULONG                   pad;
+    ULONG                   reader;
+    ULONG                   tick;
+    ULONG                   sequence;
+    LONGLONG                now;
+    FIRESHOCK_HISTOGRAM     snapshot;
+
+    for (pad = 0; pad < PIPELINE_PADS; pad++)
+    {
+        PipelinePadInitialize(&Pads[pad], (pad & 1) ? DualShock4 : DualShock3, SimulatorPatternNoise, pad + 1);
+
+        PipelineReaderInitialize(&readers[pad][0], &Pads[pad], FALSE);
+        PipelineReaderInitialize(&readers[pad][1], &Pads[pad], TRUE);
+        PipelineReaderInitialize(&readers[pad][2], &Pads[pad], TRUE);
+
+        ChangeFilterConfigure(&readers[pad][2].ChangeFilter, TRUE, 0, 0);
+    }
+
+    for (tick = 1; tick <= 500; tick++)
+    {
+        now = (LONGLONG)tick * PIPELINE_TICK;
+
+        for (pad = 0; pad < PIPELINE_PADS; pad++)
+        {
+            sequence = PipelinePadReceive(&Pads[pad], now);
+
+            for (reader = 0; reader < 3; reader++)
+            {
+                if (PipelineReaderDrain(&Pads[pad], &readers[pad][reader], batch, 8, now + 50) == 0)
+                {
+                    continue;
+                }
+
+                delivered[reader] += batch->Count;
+                dropped += batch->Dropped;
+
+                inOrder = inOrder && batch->Count == 1 && batch->Entries[0].Envelope.Sequence == sequence;
+                intact = intact && CheckEntry(&Pads[pad], &batch->Entries[0], readers[pad][reader].Normalize);
+            }
+        }
+    }
+
+    TEST_ASSERT(inOrder);
+    TEST_ASSERT(intact);
+    TEST_ASSERT(dropped == 0);
+    TEST_ASSERT(delivered[0] == 500 * PIPELINE_PADS);
+    TEST_ASSERT(delivered[1] == 500 * PIPELINE_PADS);
+    TEST_ASSERT(delivered[2] > 0 && delivered[2] <= 500 * PIPELINE_PADS);
+
+    HistogramSnapshot(&Pads[0].InterArrival, &snapshot, FALSE);
+    TEST_ASSERT(snapshot.Count == 499 && snapshot.Min == PIPELINE_TICK && snapshot.Max == PIPELINE_TICK);
+
+    HistogramSnapshot(&Pads[0].Delivery, &snapshot, FALSE);
+    TEST_ASSERT(snapshot.Min == 50 && snapshot.Max == 50);
+}
+
+//
+// A handle falling behind the history loses the oldest reports and gets
+// told how many with its next batch
+// 
+static VOID
+TestSlowReader(VOID)
+{
+    PFIRESHOCK_INPUT_BATCH  batch = (PFIRESHOCK_INPUT_BATCH)BatchBuffer;
+    PIPELINE_PAD            *pPad = &Pads[0];
+    PIPELINE_READER         reader;
+    ULONG                   delivered = 0;
+    ULONG                   dropped = 0;
+    ULONG                   last = 0;
+    BOOLEAN                 ascending = TRUE;
+    ULONG                   tick;
+    ULONG                   index;
+
+    PipelinePadInitialize(pPad, DualShock3, SimulatorPatternSweep, 7);
+    PipelineReaderInitialize(&reader, pPad, FALSE);
+
+    for (tick = 1; tick <= 1000; tick++)
+    {
+        PipelinePadReceive(pPad, (LONGLONG)tick * PIPELINE_TICK);
+
+        if (tick % 100 != 0)
+        {
+            continue;
+        }
+
+        PipelineReaderDrain(pPad, &reader, batch, 16, (LONGLONG)tick * PIPELINE_TICK);
+
+        TEST_ASSERT(batch->Count == 16);
+
+        delivered += batch->Count;
+        dropped += batch->Dropped;
+
+        for (index = 0; index < batch->Count; index++)
+        {
+            ascending = ascending && batch->Entries[index].Envelope.Sequence == last + 1 + (index == 0 ? batch->Dropped : 0);
+            last = batch->Entries[index].Envelope.Sequence;
+        }
+    }
+
+    while (PipelineReaderDrain(pPad, &reader, batch, PIPELINE_HISTORY_DEPTH, 0) > 0)
+    {
+        delivered += batch->Count;
+        dropped += batch->Dropped;
+        last = batch->Entries[batch->Count - 1].Envelope.Sequence;
+    }
+
+    TEST_ASSERT(ascending);
+    TEST_ASSERT(dropped > 0);
+    TEST_ASSERT(last == 1000);
+    TEST_ASSERT(delivered + dropped == 1000);
+    TEST_ASSERT(reader.Dropped == 0);
+}
+
+//
+// A run crossing the end of the history gets decoded in two parts
+// 
+static VOID
+TestWrappedRun(VOID)
+{
+    PFIRESHOCK_INPUT_BATCH  batch = (PFIRESHOCK_INPUT_BATCH)BatchBuffer;
+    PIPELINE_READER         reader;
+    BOOLEAN                 intact = TRUE;
+    ULONG                   pad;
+    ULONG                   tick;
+    ULONG                   index;
+
+    for (pad = 0; pad < 2; pad++)
+    {
+        PipelinePadInitialize(&Pads[pad], pad ? DualShock4 : DualShock3, SimulatorPatternNoise, 3);
+
+        for (tick = 1; tick <= 40; tick++)
+        {
+            PipelinePadReceive(&Pads[pad], (LONGLONG)tick * PIPELINE_TICK);
+        }
+
+        PipelineReaderInitialize(&reader, &Pads[pad], TRUE);
+
+        for (; tick <= 90; tick++)
+        {
+            PipelinePadReceive(&Pads[pad], (LONGLONG)tick * PIPELINE_TICK);
+        }
+
+        TEST_ASSERT(PipelineReaderDrain(&Pads[pad], &reader, batch, PIPELINE_HISTORY_DEPTH, 0) == 50);
+        TEST_ASSERT(batch->Dropped == 0);
+
+        for (index = 0; index < batch->Count; index++)
+        {
+            intact = intact && batch->Entries[index].Envelope.Sequence == 41 + index
+                && CheckEntry(&Pads[pad], &batch->Entries[index], TRUE);
+        }
+    }
+
+    TEST_ASSERT(intact);
+}
+
+//
+// Controls at rest only wake a filtering handle for the keep-alive
+// 
+static VOID
+TestIdleFilter(VOID)
+{
+    PFIRESHOCK_INPUT_BATCH  batch = (PFIRESHOCK_INPUT_BATCH)BatchBuffer;
+    PIPELINE_READER         quiet;
+    PIPELINE_READER         alive;
+    ULONG                   delivered[2];
+    ULONG                   pad;
+    ULONG                   tick;
+    LONGLONG                now;
+
+    for (pad = 0; pad < 2; pad++)
+    {
+        PipelinePadInitialize(&Pads[pad], pad ? DualShock4 : DualShock3, SimulatorPatternIdle, 5);
+
+        PipelineReaderInitialize(&quiet, &Pads[pad], TRUE);
+        PipelineReaderInitialize(&alive, &Pads[pad], FALSE);
+
+        ChangeFilterConfigure(&quiet.ChangeFilter, TRUE, 2, 0);
+        ChangeFilterConfigure(&alive.ChangeFilter, TRUE, 2, 50 * PIPELINE_TICK);
+
+        delivered[0] = delivered[1] = 0;
+
+        for (tick = 1; tick <= 200; tick++)
+        {
+            now = (LONGLONG)tick * PIPELINE_TICK;
+
+            PipelinePadReceive(&Pads[pad], now);
+
+            delivered[0] += PipelineReaderDrain(&Pads[pad], &quiet, batch, 8, now);
+            delivered[1] += PipelineReaderDrain(&Pads[pad], &alive, batch, 8, now);
+        }
+
+        //
+        // Ticks 1, 51, 101 and 151 for the keep-alive
+        // 
+        TEST_ASSERT(delivered[0] == 1);
+        TEST_ASSERT(delivered[1] == 4);
+    }
+}
+
+//
+// The shared ring receives every report next to the history
+// 
+static VOID
+TestRing(VOID)
+{
+    PIPELINE_PAD                *pPad = &Pads[0];
+    INPUT_RING                  ring;
+    FIRESHOCK_INPUT_RING_ENTRY  entry;
+    ULONG                       expected = 1;
+    BOOLEAN                     intact = TRUE;
+    ULONG                       tick;
+    const PIPELINE_REPORT       *report;
+
+    PipelinePadInitialize(pPad, DualShock4, SimulatorPatternSweep, 9);
+
+    TEST_ASSERT(InputRingAttach(&ring, RingBuffer, sizeof(RingBuffer)));
+
+    pPad->Ring = &ring;
+
+    for (tick = 1; tick <= 1000; tick++)
+    {
+        PipelinePadReceive(pPad, (LONGLONG)tick * PIPELINE_TICK);
+
+        //
+        // The client catches up every 16 reports
+        // 
+        if (tick % 16 != 0)
+        {
+            continue;
+        }
+
+        while (InputRingPop(ring.Header, &entry))
+        {
+            report = &pPad->History[entry.Sequence % PIPELINE_HISTORY_DEPTH];
+
+            intact = intact && entry.Sequence == expected++
+                && entry.Length == report->Length
+                && memcmp(entry.Report, report->Buffer, report->Length) == 0;
+        }
+    }
+
+    TEST_ASSERT(intact);
+    TEST_ASSERT(expected == 1000 - 1000 % 16 + 1);
+    TEST_ASSERT(ring.Header->Dropped == 0);
+
+    InputRingDetach(&ring);
+}
+
+int
+main(VOID)
+{
+    TEST_RUN(TestFanOut);
+    TEST_RUN(TestSlowReader);
+    TEST_RUN(TestWrappedRun);
+    TEST_RUN(TestIdleFilter);
+    TEST_RUN(TestRing);
+
+    return TEST_RESULT();
+}
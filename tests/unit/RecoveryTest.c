@@ -0,0 +1,329 @@
+/*
+* MIT License
+*
+* Copyright (c) 2017-2019 Nefarius Software Solutions e.U.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+
+
+#include "Recovery.h"
+#include "FaultTransport.h"
+#include "Test.h"
+
+//
+// Reader recovery settings of the driver (INTERRUPT_IN_* in DsUsb.h),
+// milliseconds
+// 
+#define READER_RESET_THRESHOLD  3
+#define READER_MIN_RETRY_DELAY  10
+#define READER_MAX_RETRY_DELAY  2000
+
+//
+// Continuous reader on top of the fault-injecting transport
+// 
+// Mirrors what the driver does: a failed read stops the reader and
+// schedules a restart after the backoff (DsUsbEvtUsbInterruptReadersFailed),
+// the restart resets the pipe once failures pile up and the first report
+// afterwards re-initializes a DualShock 3 (DsUsbEvtReaderRecoveryWorkItem).
+// The clock is virtual, one read per millisecond like a 1 kHz pad.
+// 
+typedef struct _READER
+{
+    FAULT_TRANSPORT Transport;
+
+    RECOVERY_POLICY Policy;
+
+    LONGLONG Now;
+
+    BOOLEAN Running;
+
+    LONGLONG RestartTime;
+
+    BOOLEAN ResetPending;
+
+    ULONG LongestDelay;
+
+    ULONG Reports;
+
+    ULONG Restarts;
+
+    ULONG Recoveries;
+
+    LONGLONG TimeToRecover;
+
+} READER, *PREADER;
+
+static VOID
+ReaderInitialize(
+    PREADER Reader,
+    DS_DEVICE_TYPE DeviceType)
+{
+    RtlZeroMemory(Reader, sizeof(READER));
+
+    FaultTransportInitialize(&Reader->Transport, DeviceType);
+
+    RecoveryPolicyInitialize(
+        &Reader->Policy,
+        READER_RESET_THRESHOLD,
+        READER_MIN_RETRY_DELAY,
+        READER_MAX_RETRY_DELAY);
+
+    Reader->Running = TRUE;
+}
+
+static VOID
+ReaderReinitialize(
+    PREADER Reader)
+{
+    //
+    // SET_REPORT of the DualShock 3 enable feature, see Ds3Init
+    // 
+    static const UCHAR enableRequest[8] =
+    {
+        0x21, SetReport, Ds3FeatureStartDevice & 0xFF, Ds3FeatureStartDevice >> 8,
+        0x00, 0x00, DS3_HID_COMMAND_ENABLE_SIZE, 0x00
+    };
+    UCHAR   command[DS3_HID_COMMAND_ENABLE_SIZE] = { 0x42, 0x0C, 0x00, 0x00 };
+    ULONG   transferred;
+
+    if (Reader->Transport.Simulator.DeviceType == DualShock3)
+    {
+        FaultTransportControl(&Reader->Transport, enableRequest, command, sizeof(command), &transferred);
+    }
+}
+
+static VOID
+ReaderRun(
+    PREADER Reader,
+    ULONG Milliseconds)
+{
+    UCHAR       report[FIRESHOCK_INPUT_REPORT_LENGTH];
+    LONGLONG    end = Reader->Now + Milliseconds;
+    LONGLONG    timeToRecover;
+    ULONG       transferred;
+    ULONG       delay;
+    BOOLEAN     reset;
+
+    for (; Reader->Now < end; Reader->Now++)
+    {
+        if (!Reader->Running)
+        {
+            if (Reader->Now < Reader->RestartTime)
+            {
+                continue;
+            }
+
+            if (Reader->ResetPending)
+            {
+                FaultTransportResetPipe(&Reader->Transport);
+                Reader->ResetPending = FALSE;
+            }
+
+            Reader->Running = TRUE;
+            Reader->Restarts++;
+        }
+
+        if (FaultTransportRead(&Reader->Transport, report, sizeof(report), &transferred) != FaultNone)
+        {
+            delay = RecoveryPolicyOnFailure(&Reader->Policy, Reader->Now, &reset);
+
+            Reader->LongestDelay = max(Reader->LongestDelay, delay);
+            Reader->ResetPending |= reset;
+            Reader->Running = FALSE;
+            Reader->RestartTime = Reader->Now + delay;
+            continue;
+        }
+
+        if (transferred == 0)
+        {
+            continue;
+        }
+
+        Reader->Reports++;
+
+        if (RecoveryPolicyOnSuccess(&Reader->Policy, Reader->Now, &timeToRecover))
+        {
+            Reader->Recoveries++;
+            Reader->TimeToRecover = timeToRecover;
+
+            ReaderReinitialize(Reader);
+        }
+    }
+}
+
+//
+// Retry delays double from the minimum up to the cap, resets are asked
+// for from the threshold on and a success starts the series over
+// 
+static VOID
+TestBackoff(
+    VOID)
+{
+    static const ULONG expected[] = { 10, 20, 40, 80, 160, 320, 640, 1280, 2000, 2000, 2000 };
+    RECOVERY_POLICY     policy;
+    LONGLONG            timeToRecover;
+    BOOLEAN             reset;
+    ULONG               i;
+
+    RecoveryPolicyInitialize(&policy, READER_RESET_THRESHOLD, READER_MIN_RETRY_DELAY, READER_MAX_RETRY_DELAY);
+
+    TEST_ASSERT(!RecoveryPolicyOnSuccess(&policy, 5, &timeToRecover));
+
+    for (i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+    {
+        TEST_ASSERT(RecoveryPolicyOnFailure(&policy, 100 + i, &reset) == expected[i]);
+        TEST_ASSERT(reset == (i + 1 >= READER_RESET_THRESHOLD));
+    }
+
+    TEST_ASSERT(RecoveryPolicyOnSuccess(&policy, 1100, &timeToRecover));
+    TEST_ASSERT(timeToRecover == 1000);
+
+    TEST_ASSERT(RecoveryPolicyOnFailure(&policy, 2000, &reset) == READER_MIN_RETRY_DELAY);
+    TEST_ASSERT(!reset);
+
+    //
+    // Never asks for a reset with the threshold off
+    // 
+    RecoveryPolicyInitialize(&policy, 0, 1, 4);
+
+    for (i = 0; i < 8; i++)
+    {
+        TEST_ASSERT(RecoveryPolicyOnFailure(&policy, i, &reset) == min(1U << i, 4U));
+        TEST_ASSERT(!reset);
+    }
+}
+
+//
+// A couple of timeouts get retried without touching the pipe
+// 
+static VOID
+TestTimeouts(
+    VOID)
+{
+    READER reader;
+
+    ReaderInitialize(&reader, DualShock3);
+    ReaderRun(&reader, 100);
+
+    TEST_ASSERT(reader.Reports == 100);
+
+    FaultTransportInject(&reader.Transport, FaultTimeout, 2);
+    ReaderRun(&reader, 1000);
+
+    TEST_ASSERT(reader.Transport.FailedReads == 2);
+    TEST_ASSERT(reader.Transport.PipeResets == 0);
+    TEST_ASSERT(reader.Restarts == 2);
+    TEST_ASSERT(reader.Recoveries == 1);
+    TEST_ASSERT(reader.TimeToRecover == READER_MIN_RETRY_DELAY * 3);
+
+    //
+    // Down for the backoff only
+    // 
+    TEST_ASSERT(reader.Reports == 1100 - READER_MIN_RETRY_DELAY * 3);
+}
+
+//
+// A halted endpoint only recovers through the pipe reset
+// 
+static VOID
+TestStall(
+    VOID)
+{
+    READER reader;
+
+    ReaderInitialize(&reader, DualShock3);
+
+    FaultTransportInject(&reader.Transport, FaultStall, 0);
+    ReaderRun(&reader, 1000);
+
+    TEST_ASSERT(reader.Transport.FailedReads == READER_RESET_THRESHOLD);
+    TEST_ASSERT(reader.Transport.PipeResets == 1);
+    TEST_ASSERT(reader.Recoveries == 1);
+    TEST_ASSERT(reader.TimeToRecover == READER_MIN_RETRY_DELAY * 7);
+    TEST_ASSERT(reader.Transport.EnableRequests == 1);
+    TEST_ASSERT(reader.Transport.Simulator.Started);
+}
+
+//
+// A long outage must neither spin nor wait longer than the cap once the
+// device is back
+// 
+static VOID
+TestDisconnect(
+    VOID)
+{
+    READER  reader;
+
+    ReaderInitialize(&reader, DualShock3);
+
+    FaultTransportInject(&reader.Transport, FaultDisconnect, 0);
+    ReaderRun(&reader, 10000);
+
+    TEST_ASSERT(reader.Transport.FailedReads <= 16);
+    TEST_ASSERT(reader.LongestDelay == READER_MAX_RETRY_DELAY);
+    TEST_ASSERT(reader.Recoveries == 0);
+    TEST_ASSERT(reader.Reports == 0);
+
+    FaultTransportInject(&reader.Transport, FaultNone, 0);
+    ReaderRun(&reader, READER_MAX_RETRY_DELAY + 100);
+
+    //
+    // Every retry past the threshold reset the pipe
+    // 
+    TEST_ASSERT(reader.Transport.PipeResets == reader.Transport.FailedReads - READER_RESET_THRESHOLD + 1);
+    TEST_ASSERT(reader.Recoveries == 1);
+    TEST_ASSERT(reader.TimeToRecover >= 10000);
+    TEST_ASSERT(reader.TimeToRecover <= 10000 + READER_MAX_RETRY_DELAY);
+    TEST_ASSERT(reader.Transport.EnableRequests == 1);
+    TEST_ASSERT(reader.Reports > 0);
+}
+
+//
+// The DualShock 4 needs no re-initialization
+// 
+static VOID
+TestDs4(
+    VOID)
+{
+    READER reader;
+
+    ReaderInitialize(&reader, DualShock4);
+
+    FaultTransportInject(&reader.Transport, FaultStall, 0);
+    ReaderRun(&reader, 1000);
+
+    TEST_ASSERT(reader.Recoveries == 1);
+    TEST_ASSERT(reader.Transport.PipeResets == 1);
+    TEST_ASSERT(reader.Transport.EnableRequests == 0);
+}
+
+int
+main(
+    VOID)
+{
+    TEST_RUN(TestBackoff);
+    TEST_RUN(TestTimeouts);
+    TEST_RUN(TestStall);
+    TEST_RUN(TestDisconnect);
+    TEST_RUN(TestDs4);
+
+    return TEST_RESULT();
+}